@@ -0,0 +1,70 @@
+#pragma once
+
+#include <control_plane.h>
+
+#include <benchmark/benchmark.h>
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+// Сессии для бенчмарков: PDN connection с default bearer в одном APN. Набор строится при первом
+// запросе своего размера и живет до запроса другого, чтобы 1M и 10M не держались в памяти вместе.
+// teid_shard_bits - деление TEID на шарды control plane, как у sharded_data_plane
+struct bench_sessions {
+    // С запасом на записи, индексы и пул адресов; проверено по RSS на 1M сессий
+    static constexpr size_t bytes_per_session = 1024;
+
+    explicit bench_sessions(size_t count, uint8_t teid_shard_bits = 0) :
+        _control_plane(control_plane::config{.teids = {.shard_bits = teid_shard_bits}}),
+        _teid_shard_bits(teid_shard_bits) {
+        _control_plane.add_apn("bench.apn", boost::asio::ip::make_address_v4("192.168.0.1"));
+        _control_plane.reserve(count, count);
+        _cp_teids.reserve(count);
+        _dp_teids.reserve(count);
+        _ue_ips.reserve(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            auto pdn = _control_plane.create_pdn_connection(
+                    "bench.apn", boost::asio::ip::make_address_v4("192.168.1.1"), i);
+            auto bearer = _control_plane.create_bearer(pdn, i);
+            pdn->set_default_bearer(bearer);
+            _cp_teids.push_back(pdn->get_cp_teid());
+            _dp_teids.push_back(bearer->get_dp_teid());
+            _ue_ips.push_back(pdn->get_ue_ip_addr());
+        }
+
+        _order.resize(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            _order[i] = i;
+        }
+        std::shuffle(_order.begin(), _order.end(), std::mt19937(count));
+    }
+
+    // nullptr и пропуск бенчмарка, если набор не поместится в память машины
+    static bench_sessions *get(benchmark::State &state, size_t count, uint8_t teid_shard_bits = 0) {
+        static std::unique_ptr<bench_sessions> current;
+        if (current && current->_dp_teids.size() == count && current->_teid_shard_bits == teid_shard_bits) {
+            return current.get();
+        }
+        current.reset();
+
+        const auto memory = static_cast<size_t>(sysconf(_SC_PHYS_PAGES)) * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        if (count * bytes_per_session > memory / 2) {
+            state.SkipWithError("not enough memory for this many sessions");
+            return nullptr;
+        }
+        current = std::make_unique<bench_sessions>(count, teid_shard_bits);
+        return current.get();
+    }
+
+    control_plane _control_plane;
+    uint8_t _teid_shard_bits;
+    std::vector<uint32_t> _cp_teids;
+    std::vector<uint32_t> _dp_teids;
+    std::vector<boost::asio::ip::address_v4> _ue_ips;
+    // Перемешанные номера сессий: по большим наборам идем вразброс, как настоящий трафик, а не подряд
+    std::vector<uint32_t> _order;
+};
@@ -0,0 +1,147 @@
+#include <control_plane.h>
+
+#include <benchmark/benchmark.h>
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "bench_sessions.h"
+
+// Жизненный цикл сессии поверх range(0) постоянных: создание PDN connection и default bearer,
+// затем удаление. Показывает, сколько Create/Delete Session в секунду выдержит управляющий поток
+static void BM_control_plane_session_churn(benchmark::State &state) {
+    auto *s = bench_sessions::get(state, static_cast<size_t>(state.range(0)));
+    if (!s) {
+        return;
+    }
+    const auto sgw = boost::asio::ip::make_address_v4("192.168.1.2");
+    uint32_t sgw_teid = 0;
+    for (auto _ : state) {
+        auto pdn = s->_control_plane.create_pdn_connection("bench.apn", sgw, ++sgw_teid);
+        auto bearer = s->_control_plane.create_bearer(pdn, sgw_teid);
+        pdn->set_default_bearer(bearer);
+        s->_control_plane.delete_pdn_connection(pdn->get_cp_teid());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_control_plane_session_churn)->Arg(1'000)->Arg(100'000)->Arg(1'000'000)->ArgName("sessions");
+
+namespace {
+    std::vector<control_plane::session_spec> bulk_specs(size_t count) {
+        std::vector<control_plane::session_spec> specs(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            specs[i] = {"bench.apn", boost::asio::ip::make_address_v4("192.168.1.1"), i, i};
+        }
+        return specs;
+    }
+
+    bool fits_in_memory(benchmark::State &state, size_t count) {
+        const auto memory = static_cast<size_t>(sysconf(_SC_PHYS_PAGES)) * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        if (count * bench_sessions::bytes_per_session > memory / 2) {
+            state.SkipWithError("not enough memory for this many sessions");
+            return false;
+        }
+        return true;
+    }
+} // namespace
+
+// Загрузка range(0) сессий одним create_sessions в пустой control plane
+static void BM_control_plane_bulk_create(benchmark::State &state) {
+    const auto count = static_cast<size_t>(state.range(0));
+    if (!fits_in_memory(state, count)) {
+        return;
+    }
+    const auto specs = bulk_specs(count);
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto cp = std::make_unique<control_plane>();
+        cp->add_apn("bench.apn", boost::asio::ip::make_address_v4("192.168.0.1"));
+        state.ResumeTiming();
+
+        benchmark::DoNotOptimize(cp->create_sessions(specs));
+
+        state.PauseTiming();
+        cp.reset();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_control_plane_bulk_create)
+        ->Arg(100'000)
+        ->Arg(1'000'000)
+        ->ArgName("sessions")
+        ->Unit(benchmark::kMillisecond)
+        ->Iterations(3);
+
+// Удаление всех range(0) сессий одним delete_sessions, в случайном порядке
+static void BM_control_plane_bulk_delete(benchmark::State &state) {
+    const auto count = static_cast<size_t>(state.range(0));
+    if (!fits_in_memory(state, count)) {
+        return;
+    }
+    const auto specs = bulk_specs(count);
+    std::vector<uint32_t> cp_teids(count);
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto cp = std::make_unique<control_plane>();
+        cp->add_apn("bench.apn", boost::asio::ip::make_address_v4("192.168.0.1"));
+        {
+            const auto created = cp->create_sessions(specs);
+            for (size_t i = 0; i < count; ++i) {
+                cp_teids[i] = created[i]->get_cp_teid();
+            }
+        }
+        std::shuffle(cp_teids.begin(), cp_teids.end(), std::mt19937(count));
+        state.ResumeTiming();
+
+        cp->delete_sessions(cp_teids);
+
+        state.PauseTiming();
+        cp.reset();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_control_plane_bulk_delete)
+        ->Arg(100'000)
+        ->Arg(1'000'000)
+        ->ArgName("sessions")
+        ->Unit(benchmark::kMillisecond)
+        ->Iterations(3);
+
+// Перезапуск SGW: удаление всех его range(0) сессий, в control plane вдвое больше сессий
+static void BM_control_plane_sgw_restart(benchmark::State &state) {
+    const auto count = static_cast<size_t>(state.range(0));
+    if (!fits_in_memory(state, 2 * count)) {
+        return;
+    }
+    // Сессии двух SGW вперемешку
+    auto specs = bulk_specs(2 * count);
+    for (size_t i = 0; i < specs.size(); i += 2) {
+        specs[i].sgw_addr = boost::asio::ip::make_address_v4("192.168.1.2");
+    }
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto cp = std::make_unique<control_plane>();
+        cp->add_apn("bench.apn", boost::asio::ip::make_address_v4("192.168.0.1"));
+        cp->create_sessions(specs);
+        state.ResumeTiming();
+
+        benchmark::DoNotOptimize(cp->delete_sgw_sessions(boost::asio::ip::make_address_v4("192.168.1.2")));
+
+        state.PauseTiming();
+        cp.reset();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_control_plane_sgw_restart)
+        ->Arg(100'000)
+        ->Arg(1'000'000)
+        ->ArgName("sessions")
+        ->Unit(benchmark::kMillisecond)
+        ->Iterations(3);
@@ -0,0 +1,112 @@
+#include <data_plane.h>
+#include <rate_limited_data_plane.h>
+
+#include <benchmark/benchmark.h>
+
+#include "bench_sessions.h"
+#include "null_data_plane.h"
+
+namespace {
+    // Размеры таблицы сессий: от помещающейся в L2 до заметно большей LLC
+    void session_counts(benchmark::internal::Benchmark *b) {
+        for (int64_t count : {1'000, 100'000, 1'000'000, 10'000'000}) {
+            b->Arg(count);
+        }
+        b->ArgName("sessions");
+    }
+} // namespace
+
+// Поштучный uplink вразброс по range(0) сессиям; Packet перемещается туда и обратно без выделений
+static void BM_data_plane_uplink(benchmark::State &state) {
+    auto *s = bench_sessions::get(state, static_cast<size_t>(state.range(0)));
+    if (!s) {
+        return;
+    }
+    null_data_plane plane(s->_control_plane);
+    size_t i = 0;
+    for (auto _ : state) {
+        plane.handle_uplink(s->_dp_teids[s->_order[i]], data_plane::Packet());
+        if (++i == s->_order.size()) {
+            i = 0;
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_data_plane_uplink)->Apply(session_counts);
+
+// Поштучный downlink: поиск по UE IP и выбор bearer
+static void BM_data_plane_downlink(benchmark::State &state) {
+    auto *s = bench_sessions::get(state, static_cast<size_t>(state.range(0)));
+    if (!s) {
+        return;
+    }
+    null_data_plane plane(s->_control_plane);
+    size_t i = 0;
+    for (auto _ : state) {
+        plane.handle_downlink(s->_ue_ips[s->_order[i]], data_plane::Packet());
+        if (++i == s->_order.size()) {
+            i = 0;
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_data_plane_downlink)->Apply(session_counts);
+
+// Uplink burst'ами по 32 пакета
+static void BM_data_plane_uplink_burst(benchmark::State &state) {
+    auto *s = bench_sessions::get(state, static_cast<size_t>(state.range(0)));
+    if (!s) {
+        return;
+    }
+    null_data_plane plane(s->_control_plane);
+    std::vector<data_plane::uplink_packet> burst(32);
+    size_t i = 0;
+    for (auto _ : state) {
+        for (auto &packet : burst) {
+            packet.dp_teid = s->_dp_teids[s->_order[i]];
+            packet.packet.resize(64);
+            if (++i == s->_order.size()) {
+                i = 0;
+            }
+        }
+        plane.handle_uplink_burst(burst);
+    }
+    state.SetItemsProcessed(state.iterations() * burst.size());
+}
+BENCHMARK(BM_data_plane_uplink_burst)->Apply(session_counts);
+
+// Цена rate_limited_data_plane на том же пути, что BM_data_plane_uplink. range(1): 0 - лимиты
+// не заданы, 1 - session AMBR у каждой сессии с запасом, так что пакеты проходят все проверки
+static void BM_rate_limited_uplink(benchmark::State &state) {
+    auto *s = bench_sessions::get(state, static_cast<size_t>(state.range(0)));
+    if (!s) {
+        return;
+    }
+    null_sink<rate_limited_data_plane> plane(s->_control_plane);
+    rate_limited_data_plane::rate_limit_config limits{.uplink_rate = size_t{1} << 40,
+                                                      .uplink_capacity = size_t{1} << 40,
+                                                      .downlink_rate = size_t{1} << 40,
+                                                      .downlink_capacity = size_t{1} << 40};
+    if (state.range(1)) {
+        for (auto cp_teid : s->_cp_teids) {
+            plane.set_rate_limits(cp_teid, limits);
+        }
+    }
+
+    size_t i = 0;
+    for (auto _ : state) {
+        plane.handle_uplink(s->_dp_teids[s->_order[i]], data_plane::Packet());
+        if (++i == s->_order.size()) {
+            i = 0;
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+
+    // Лимиты живут в записях сессий, которые переживают этот data plane
+    if (state.range(1)) {
+        for (auto cp_teid : s->_cp_teids) {
+            plane.delete_rate_limits(cp_teid);
+        }
+    }
+}
+BENCHMARK(BM_rate_limited_uplink)->ArgsProduct({{1'000, 1'000'000}, {0, 1}})->ArgNames({"sessions", "limits"});
@@ -0,0 +1,115 @@
+#include <flat_index.h>
+
+#include <benchmark/benchmark.h>
+
+#include <random>
+#include <unordered_map>
+
+namespace {
+    std::vector<uint32_t> random_keys(size_t count, uint32_t seed) {
+        std::mt19937 gen(seed);
+        std::vector<uint32_t> keys(count);
+        for (auto &key : keys) {
+            key = gen();
+        }
+        return keys;
+    }
+
+    // Порядок поиска отличается от порядка вставки, чтобы не попадать в кэш по соседству
+    std::vector<uint32_t> lookup_order(const std::vector<uint32_t> &keys) {
+        auto order = keys;
+        std::shuffle(order.begin(), order.end(), std::mt19937(7));
+        return order;
+    }
+} // namespace
+
+static void BM_flat_index_find(benchmark::State &state) {
+    const auto keys = random_keys(static_cast<size_t>(state.range(0)), 1);
+    flat_index<uint32_t> index;
+    index.reserve(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        index.insert_or_assign(keys[i], static_cast<uint32_t>(i + 1));
+    }
+    const auto order = lookup_order(keys);
+
+    epoch_guard guard;
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(index.find(order[i++ % order.size()]));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_flat_index_find)->Arg(1000)->Arg(100000)->Arg(1000000)->Arg(10000000);
+
+static void BM_flat_index_find_prefetched_burst(benchmark::State &state) {
+    const auto keys = random_keys(static_cast<size_t>(state.range(0)), 1);
+    flat_index<uint32_t> index;
+    index.reserve(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        index.insert_or_assign(keys[i], static_cast<uint32_t>(i + 1));
+    }
+    const auto order = lookup_order(keys);
+
+    constexpr size_t burst = 32;
+    epoch_guard guard;
+    size_t offset = 0;
+    for (auto _ : state) {
+        if (offset + burst > order.size()) {
+            offset = 0;
+        }
+        for (size_t i = 0; i < burst; ++i) {
+            index.prefetch(order[offset + i]);
+        }
+        for (size_t i = 0; i < burst; ++i) {
+            benchmark::DoNotOptimize(index.find(order[offset + i]));
+        }
+        offset += burst;
+    }
+    state.SetItemsProcessed(state.iterations() * burst);
+}
+BENCHMARK(BM_flat_index_find_prefetched_burst)->Arg(1000)->Arg(100000)->Arg(1000000)->Arg(10000000);
+
+static void BM_unordered_map_find(benchmark::State &state) {
+    const auto keys = random_keys(static_cast<size_t>(state.range(0)), 1);
+    std::unordered_map<uint32_t, uint32_t> map;
+    map.reserve(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        map[keys[i]] = static_cast<uint32_t>(i + 1);
+    }
+    const auto order = lookup_order(keys);
+
+    size_t i = 0;
+    for (auto _ : state) {
+        auto it = map.find(order[i++ % order.size()]);
+        benchmark::DoNotOptimize(it != map.end() ? it->second : 0);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_unordered_map_find)->Arg(1000)->Arg(100000)->Arg(1000000)->Arg(10000000);
+
+static void BM_flat_index_insert(benchmark::State &state) {
+    const auto keys = random_keys(static_cast<size_t>(state.range(0)), 2);
+    for (auto _ : state) {
+        flat_index<uint32_t> index;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            index.insert_or_assign(keys[i], static_cast<uint32_t>(i + 1));
+        }
+        benchmark::DoNotOptimize(index.size());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    epoch_domain::global().synchronize();
+}
+BENCHMARK(BM_flat_index_insert)->Arg(100000)->Arg(1000000);
+
+static void BM_unordered_map_insert(benchmark::State &state) {
+    const auto keys = random_keys(static_cast<size_t>(state.range(0)), 2);
+    for (auto _ : state) {
+        std::unordered_map<uint32_t, uint32_t> map;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            map[keys[i]] = static_cast<uint32_t>(i + 1);
+        }
+        benchmark::DoNotOptimize(map.size());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_unordered_map_insert)->Arg(100000)->Arg(1000000);
@@ -0,0 +1,131 @@
+#include <gtpc_engine.h>
+
+#include <benchmark/benchmark.h>
+
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/io_context.hpp>
+
+#include <array>
+
+namespace {
+    using boost::asio::ip::udp;
+
+    const auto pgw_addr = boost::asio::ip::make_address_v4("127.0.0.1");
+    const auto sgw_addr = boost::asio::ip::make_address_v4("127.1.0.1");
+
+    std::span<const uint8_t> create_session_request(std::span<uint8_t> buffer, uint32_t sequence, uint32_t sgw_teid) {
+        return gtpc::writer(buffer, gtpc::create_session_request, 0, sequence)
+            .add_imsi("250011234567890")
+            .add_apn("bench.apn")
+            .add_fteid({gtpc::s5_s8_sgw_gtp_c, sgw_teid, sgw_addr}, gtpc::instance::sender_f_teid)
+            .begin_group(gtpc::bearer_context)
+            .add_ebi(5)
+            .add_fteid({gtpc::s5_s8_sgw_gtp_u, sgw_teid, sgw_addr}, gtpc::instance::s5_s8_u_sgw_f_teid)
+            .end_group()
+            .finish();
+    }
+
+    // Запоминает последнюю отправленную датаграмму; прием не нужен, handle вызывается напрямую
+    class capture_transport : public gtpc_transport {
+    public:
+        boost::asio::awaitable<size_t> receive(std::span<uint8_t>, udp::endpoint &) override { co_return 0; }
+
+        void send(std::span<const uint8_t> datagram, const udp::endpoint &) override {
+            std::copy(datagram.begin(), datagram.end(), _last.begin());
+            _size = datagram.size();
+        }
+
+        [[nodiscard]] std::span<const uint8_t> last() const { return std::span(_last).first(_size); }
+
+    private:
+        std::array<uint8_t, gtpc_engine::max_datagram_size> _last;
+        size_t _size = 0;
+    };
+} // namespace
+
+// Разбор Create Session Request и всех IE, которые читает движок
+static void BM_gtpc_parse_create_session(benchmark::State &state) {
+    std::array<uint8_t, 256> buffer;
+    const auto message = create_session_request(buffer, 1, 100);
+    std::array<char, 100> apn;
+
+    for (auto _ : state) {
+        const auto header = gtpc::parse(message);
+        const auto sender = gtpc::decode_fteid(header->ies.find(gtpc::f_teid)->value);
+        const auto name = gtpc::decode_apn(header->ies.find(gtpc::apn)->value, apn);
+        const auto context = gtpc::grouped(header->ies.find(gtpc::bearer_context)->value);
+        const auto user = gtpc::decode_fteid(context->find(gtpc::f_teid, gtpc::instance::s5_s8_u_sgw_f_teid)->value);
+        benchmark::DoNotOptimize(sender);
+        benchmark::DoNotOptimize(name);
+        benchmark::DoNotOptimize(user);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_gtpc_parse_create_session);
+
+// Create Session и Delete Session через gtpc_engine::handle без сети: разбор, control_plane,
+// сборка ответа и кэш повторов. Два сообщения за итерацию
+static void BM_gtpc_engine_session_cycle(benchmark::State &state) {
+    control_plane cp;
+    cp.add_apn("bench.apn", pgw_addr);
+    capture_transport transport;
+    gtpc_engine engine(cp, transport, {.control_address = pgw_addr, .user_address = pgw_addr});
+    const udp::endpoint sgw(sgw_addr, gtpc::port);
+
+    std::array<uint8_t, 256> buffer;
+    uint32_t sequence = 0;
+    for (auto _ : state) {
+        const auto sgw_teid = ++sequence;
+        engine.handle(create_session_request(buffer, sgw_teid & gtpc::max_sequence, sgw_teid), sgw);
+        const auto response = gtpc::parse(transport.last());
+        const auto pgw_control = gtpc::decode_fteid(response->ies.find(gtpc::f_teid)->value);
+        engine.handle(gtpc::writer(buffer, gtpc::delete_session_request, pgw_control->teid,
+                                   ++sequence & gtpc::max_sequence)
+                          .add_ebi(5)
+                          .finish(),
+                      sgw);
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK(BM_gtpc_engine_session_cycle);
+
+// Echo по loopback UDP: SGW держит range(0) запросов в полете, движок отвечает из корутины run.
+// Оба конца в одном потоке, так что это цена двух пар системных вызовов на сообщение
+static void BM_gtpc_engine_udp_echo(benchmark::State &state) {
+    boost::asio::io_context io;
+    control_plane cp;
+    udp_transport pgw(io.get_executor(), udp::endpoint(pgw_addr, 0));
+    udp_transport sgw(io.get_executor(), udp::endpoint(pgw_addr, 0));
+    gtpc_engine engine(cp, pgw, {.control_address = pgw_addr, .user_address = pgw_addr});
+    boost::asio::co_spawn(io, engine.run(), boost::asio::detached);
+
+    const auto window = static_cast<size_t>(state.range(0));
+    std::array<uint8_t, 64> request;
+    uint32_t sequence = 0;
+    for (auto _ : state) {
+        for (size_t i = 0; i < window; ++i) {
+            sgw.send(gtpc::writer(request, gtpc::echo_request, std::nullopt, ++sequence & gtpc::max_sequence)
+                         .add_recovery(0)
+                         .finish(),
+                     pgw.local_endpoint());
+        }
+        size_t received = 0;
+        boost::asio::co_spawn(
+            io,
+            [&]() -> boost::asio::awaitable<void> {
+                std::array<uint8_t, 64> response;
+                udp::endpoint from;
+                while (received < window) {
+                    co_await sgw.receive(response, from);
+                    ++received;
+                }
+            },
+            boost::asio::detached);
+        while (received < window) {
+            io.run_one();
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * window));
+}
+BENCHMARK(BM_gtpc_engine_udp_echo)->Arg(1)->Arg(64);
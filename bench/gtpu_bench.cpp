@@ -0,0 +1,89 @@
+#include <gtpu.h>
+
+#include <benchmark/benchmark.h>
+
+#include "null_data_plane.h"
+
+namespace {
+    const auto sgw_addr = boost::asio::ip::make_address_v4("192.168.1.1");
+    const auto pgw_addr = boost::asio::ip::make_address_v4("192.168.2.1");
+
+    // Внутренний IPv4 пакет размером size от UE src к dst
+    data_plane::Packet make_inner(size_t size, boost::asio::ip::address_v4 src, boost::asio::ip::address_v4 dst) {
+        data_plane::Packet inner(size, 0);
+        inner[0] = 0x45;
+        const auto src_bytes = src.to_bytes();
+        const auto dst_bytes = dst.to_bytes();
+        std::copy(src_bytes.begin(), src_bytes.end(), inner.begin() + 12);
+        std::copy(dst_bytes.begin(), dst_bytes.end(), inner.begin() + 16);
+        return inner;
+    }
+} // namespace
+
+// Разбор, снятие и повторная сборка заголовков в одном буфере; размер внутреннего пакета - range(0)
+static void BM_gtpu_decapsulate_encapsulate(benchmark::State &state) {
+    packet_pool pool({.buffer_count = 1, .buffer_size = 2048, .headroom = 128});
+    auto packet = pool.allocate(make_inner(state.range(0), {}, {}));
+    gtpu::encapsulate(packet, {sgw_addr, pgw_addr, 1});
+
+    for (auto _ : state) {
+        const auto header = gtpu::parse(packet.bytes());
+        gtpu::decapsulate(packet, *header);
+        benchmark::DoNotOptimize(packet.data());
+        gtpu::encapsulate(packet, {sgw_addr, pgw_addr, header->teid});
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_gtpu_decapsulate_encapsulate)->Arg(64)->Arg(1400);
+
+namespace {
+    struct gtpu_plane {
+        static constexpr size_t count = 4096;
+
+        gtpu_plane() {
+            _control_plane.add_apn("bench.apn", boost::asio::ip::make_address_v4("192.168.0.1"));
+            _data_plane.set_gtpu_address(pgw_addr);
+            for (uint32_t i = 0; i < count; ++i) {
+                auto pdn = _control_plane.create_pdn_connection("bench.apn", sgw_addr, i);
+                auto bearer = _control_plane.create_bearer(pdn, i);
+                pdn->set_default_bearer(bearer);
+
+                // Датаграммы uplink от SGW и ответы сервера для downlink
+                const auto ue_ip = pdn->get_ue_ip_addr();
+                auto uplink = _pool.allocate(make_inner(64, ue_ip, pgw_addr));
+                gtpu::encapsulate(uplink, {sgw_addr, pgw_addr, bearer->get_dp_teid()});
+                _uplink.emplace_back(uplink.data(), uplink.data() + uplink.size());
+                _downlink.push_back(make_inner(64, pgw_addr, ue_ip));
+            }
+        }
+
+        control_plane _control_plane;
+        null_data_plane _data_plane{_control_plane};
+        packet_pool _pool{{.buffer_count = 256, .buffer_size = 2048, .headroom = 128}};
+        std::vector<data_plane::Packet> _uplink;
+        std::vector<data_plane::Packet> _downlink;
+    };
+} // namespace
+
+// Полный путь uplink: буфер из пула, разбор GTP-U, поиск bearer, пересылка внутреннего пакета
+static void BM_data_plane_gtpu_uplink(benchmark::State &state) {
+    gtpu_plane s;
+    size_t i = 0;
+    for (auto _ : state) {
+        s._data_plane.handle_gtpu_datagram(s._pool.allocate(s._uplink[i++ % gtpu_plane::count]));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_data_plane_gtpu_uplink);
+
+// Полный путь downlink: поиск PDN по адресу назначения и инкапсуляция в headroom
+static void BM_data_plane_gtpu_downlink(benchmark::State &state) {
+    gtpu_plane s;
+    size_t i = 0;
+    for (auto _ : state) {
+        s._data_plane.handle_ip_packet(s._pool.allocate(s._downlink[i++ % gtpu_plane::count]));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_data_plane_gtpu_downlink);
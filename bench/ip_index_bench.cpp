@@ -0,0 +1,131 @@
+#include <flat_index.h>
+#include <ip_index.h>
+
+#include <benchmark/benchmark.h>
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <vector>
+
+// ip_index против flat_index, которым раньше был индекс адресов UE в control_plane. Адреса как
+// у ip_pool: подряд от начала 10.0.0.0/8, поиск в случайном порядке
+namespace {
+    constexpr uint32_t pool_start = 0x0a000001;
+    constexpr size_t burst = 32;
+
+    std::vector<uint32_t> ue_addresses(size_t count) {
+        std::vector<uint32_t> addresses(count);
+        for (size_t i = 0; i < count; ++i) {
+            addresses[i] = pool_start + static_cast<uint32_t>(i);
+        }
+        std::shuffle(addresses.begin(), addresses.end(), std::mt19937(7));
+        return addresses;
+    }
+
+    size_t resident_bytes() {
+        size_t total = 0, resident = 0;
+        std::ifstream("/proc/self/statm") >> total >> resident;
+        return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+
+    template<class Index>
+    void fill(Index &index, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            index.insert_or_assign(pool_start + static_cast<uint32_t>(i), static_cast<uint32_t>(i + 1));
+        }
+    }
+
+    // Память, занятая индексом с момента before: ip_index резервирует адресное пространство, но
+    // платит только за страницы, в которые писал
+    void report_resident(benchmark::State &state, size_t before) {
+        state.counters["resident_mb"] = static_cast<double>(resident_bytes() - before) / (1 << 20);
+    }
+} // namespace
+
+static void BM_ip_index_find(benchmark::State &state) {
+    const auto count = static_cast<size_t>(state.range(0));
+    const auto before = resident_bytes();
+    ip_index index;
+    index.add_range(boost::asio::ip::make_network_v4("10.0.0.0/8"));
+    fill(index, count);
+    report_resident(state, before);
+    const auto order = ue_addresses(count);
+
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(index.find(order[i++ % order.size()]));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ip_index_find)->Arg(1000)->Arg(100000)->Arg(1000000)->Arg(10000000);
+
+static void BM_flat_index_find_ue_ip(benchmark::State &state) {
+    const auto count = static_cast<size_t>(state.range(0));
+    const auto before = resident_bytes();
+    flat_index<uint32_t> index;
+    index.reserve(count);
+    fill(index, count);
+    report_resident(state, before);
+    const auto order = ue_addresses(count);
+
+    epoch_guard guard;
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(index.find(order[i++ % order.size()]));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_flat_index_find_ue_ip)->Arg(1000)->Arg(100000)->Arg(1000000)->Arg(10000000);
+
+static void BM_ip_index_find_burst(benchmark::State &state) {
+    const auto count = static_cast<size_t>(state.range(0));
+    const auto before = resident_bytes();
+    ip_index index;
+    index.add_range(boost::asio::ip::make_network_v4("10.0.0.0/8"));
+    fill(index, count);
+    report_resident(state, before);
+    const auto order = ue_addresses(count);
+
+    uint32_t values[burst];
+    size_t offset = 0;
+    for (auto _ : state) {
+        if (offset + burst > order.size()) {
+            offset = 0;
+        }
+        index.find({order.data() + offset, burst}, values);
+        benchmark::DoNotOptimize(values);
+        offset += burst;
+    }
+    state.SetItemsProcessed(state.iterations() * burst);
+}
+BENCHMARK(BM_ip_index_find_burst)->Arg(1000)->Arg(100000)->Arg(1000000)->Arg(10000000);
+
+static void BM_flat_index_find_ue_ip_burst(benchmark::State &state) {
+    const auto count = static_cast<size_t>(state.range(0));
+    const auto before = resident_bytes();
+    flat_index<uint32_t> index;
+    index.reserve(count);
+    fill(index, count);
+    report_resident(state, before);
+    const auto order = ue_addresses(count);
+
+    epoch_guard guard;
+    size_t offset = 0;
+    for (auto _ : state) {
+        if (offset + burst > order.size()) {
+            offset = 0;
+        }
+        for (size_t i = 0; i < burst; ++i) {
+            index.prefetch(order[offset + i]);
+        }
+        for (size_t i = 0; i < burst; ++i) {
+            benchmark::DoNotOptimize(index.find(order[offset + i]));
+        }
+        offset += burst;
+    }
+    state.SetItemsProcessed(state.iterations() * burst);
+}
+BENCHMARK(BM_flat_index_find_ue_ip_burst)->Arg(1000)->Arg(100000)->Arg(1000000)->Arg(10000000);
@@ -0,0 +1,33 @@
+#include <ip_pool.h>
+
+#include <benchmark/benchmark.h>
+
+#include <random>
+#include <vector>
+
+// Выделение и освобождение адреса в пуле /8, заполненном на range(0) процентов
+static void BM_ip_pool_allocate_release(benchmark::State &state) {
+    ip_pool pool({boost::asio::ip::make_network_v4("10.0.0.0/8"), {}});
+    std::vector<boost::asio::ip::address_v4> allocated;
+    allocated.reserve(pool.capacity());
+    while (allocated.size() * 100 < pool.capacity() * static_cast<size_t>(state.range(0))) {
+        allocated.push_back(*pool.allocate());
+    }
+
+    // Освобождаем случайные адреса, чтобы свободные были разбросаны по всему пулу
+    std::mt19937 gen(1);
+    std::vector<boost::asio::ip::address_v4> victims(4096);
+    for (auto &victim : victims) {
+        victim = allocated[gen() % allocated.size()];
+    }
+
+    size_t i = 0;
+    for (auto _ : state) {
+        const auto &victim = victims[i++ % victims.size()];
+        if (pool.release(victim)) {
+            benchmark::DoNotOptimize(pool.allocate());
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ip_pool_allocate_release)->Arg(50)->Arg(99);
@@ -0,0 +1,24 @@
+#include <latency.h>
+
+#include <benchmark/benchmark.h>
+
+// Замер целиком: два чтения TSC и запись в гистограмму потока
+static void BM_latency_scope(benchmark::State &state) {
+    for (auto _ : state) {
+        latency::scope timing(latency::uplink);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["enabled"] = latency::enabled;
+}
+BENCHMARK(BM_latency_scope);
+
+static void BM_latency_record(benchmark::State &state) {
+    uint64_t value = 1;
+    for (auto _ : state) {
+        latency::record(latency::uplink, value);
+        value = value * 3 % 100003;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_latency_record);
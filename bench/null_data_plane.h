@@ -0,0 +1,33 @@
+#pragma once
+
+#include <data_plane.h>
+
+// Data plane, который только считает пересланные пакеты. Base - data_plane или его наследник,
+// например rate_limited_data_plane, чтобы сравнивать их с одинаковым стоком
+template<class Base>
+class null_sink : public Base {
+public:
+    explicit null_sink(control_plane &control_plane) : Base(control_plane) {}
+
+    uint64_t _forwarded{};
+
+protected:
+    using typename Base::Packet;
+    using typename Base::sgw_packet;
+
+    void forward_packet_to_sgw(boost::asio::ip::address_v4, uint32_t, Packet &&) override { ++_forwarded; }
+    void forward_packet_to_apn(boost::asio::ip::address_v4, Packet &&) override { ++_forwarded; }
+
+    void forward_burst_to_sgw(boost::asio::ip::address_v4, std::span<sgw_packet> packets) override {
+        _forwarded += packets.size();
+    }
+    void forward_burst_to_apn(boost::asio::ip::address_v4, std::span<Packet> packets) override {
+        _forwarded += packets.size();
+    }
+
+    void forward_buffer_to_sgw(boost::asio::ip::address_v4, uint32_t, packet_buffer &&) override { ++_forwarded; }
+    void forward_buffer_to_apn(boost::asio::ip::address_v4, packet_buffer &&) override { ++_forwarded; }
+    void send_gtpu(boost::asio::ip::address_v4, packet_buffer &&) override { ++_forwarded; }
+};
+
+using null_data_plane = null_sink<data_plane>;
@@ -0,0 +1,183 @@
+#include <packet_pipeline.h>
+#include <rate_limited_data_plane.h>
+
+#include <benchmark/benchmark.h>
+
+#include "bench_sessions.h"
+#include "null_data_plane.h"
+
+#include <vector>
+
+// packet_pipeline против data_plane с виртуальными хуками на одинаковых burst'ах по 32 пакета и
+// одинаковом стоке, который только считает пакеты
+namespace {
+    constexpr size_t burst_size = 32;
+
+    struct counting_sink {
+        void forward_to_apn(boost::asio::ip::address_v4, data_plane::Packet &&) { ++_forwarded; }
+        void forward_to_sgw(boost::asio::ip::address_v4, uint32_t, data_plane::Packet &&) { ++_forwarded; }
+
+        uint64_t _forwarded{};
+    };
+
+    void session_counts(benchmark::internal::Benchmark *b) {
+        for (int64_t count : {1'000, 100'000, 1'000'000}) {
+            b->Arg(count);
+        }
+        b->ArgName("sessions");
+    }
+
+    // Лимиты с запасом, чтобы пакеты проходили все проверки
+    constexpr size_t unlimited = size_t{1} << 40;
+    const rate_limited_data_plane::rate_limit_config generous{.uplink_rate = unlimited,
+                                                             .uplink_capacity = unlimited,
+                                                             .downlink_rate = unlimited,
+                                                             .downlink_capacity = unlimited};
+
+    token_bucket_pair generous_limiters() {
+        token_bucket_pair pair;
+        pair[uplink_direction].emplace(unlimited, unlimited);
+        pair[downlink_direction].emplace(unlimited, unlimited);
+        return pair;
+    }
+
+    void set_session_limits(bench_sessions &s) {
+        for (auto cp_teid : s._cp_teids) {
+            s._control_plane.find_pdn_by_cp_teid(cp_teid)->set_qos_limits(
+                    std::make_unique<pdn_connection::qos_limits>(generous_limiters()));
+        }
+    }
+
+    // Лимиты живут в записях сессий, которые переживают бенчмарк
+    void clear_session_limits(bench_sessions &s) {
+        for (auto cp_teid : s._cp_teids) {
+            s._control_plane.find_pdn_by_cp_teid(cp_teid)->set_qos_limits(nullptr);
+        }
+    }
+
+    template<class Handler>
+    void run_uplink(benchmark::State &state, bench_sessions &s, Handler &&handle) {
+        std::vector<data_plane::uplink_packet> burst(burst_size);
+        size_t i = 0;
+        for (auto _ : state) {
+            for (auto &packet : burst) {
+                packet.dp_teid = s._dp_teids[s._order[i]];
+                packet.packet.resize(64);
+                if (++i == s._order.size()) {
+                    i = 0;
+                }
+            }
+            handle(burst);
+        }
+        state.SetItemsProcessed(state.iterations() * burst_size);
+    }
+
+    template<class Handler>
+    void run_downlink(benchmark::State &state, bench_sessions &s, Handler &&handle) {
+        std::vector<data_plane::downlink_packet> burst(burst_size);
+        size_t i = 0;
+        for (auto _ : state) {
+            for (auto &packet : burst) {
+                packet.ue_ip = s._ue_ips[s._order[i]];
+                packet.packet.resize(64);
+                if (++i == s._order.size()) {
+                    i = 0;
+                }
+            }
+            handle(burst);
+        }
+        state.SetItemsProcessed(state.iterations() * burst_size);
+    }
+
+    template<class Policer>
+    using bench_pipeline = packet_pipeline<session_lookup, Policer, counting_sink>;
+} // namespace
+
+static void BM_pipeline_uplink_burst(benchmark::State &state) {
+    auto *s = bench_sessions::get(state, static_cast<size_t>(state.range(0)));
+    if (!s) {
+        return;
+    }
+    traffic_counters counters;
+    bench_pipeline<no_policer> pipeline(session_lookup(s->_control_plane), {}, {}, counters);
+    run_uplink(state, *s, [&](auto &burst) { pipeline.handle_uplink_burst(burst); });
+}
+BENCHMARK(BM_pipeline_uplink_burst)->Apply(session_counts);
+
+static void BM_virtual_uplink_burst(benchmark::State &state) {
+    auto *s = bench_sessions::get(state, static_cast<size_t>(state.range(0)));
+    if (!s) {
+        return;
+    }
+    null_data_plane plane(s->_control_plane);
+    run_uplink(state, *s, [&](auto &burst) { plane.handle_uplink_burst(burst); });
+}
+BENCHMARK(BM_virtual_uplink_burst)->Apply(session_counts);
+
+static void BM_pipeline_downlink_burst(benchmark::State &state) {
+    auto *s = bench_sessions::get(state, static_cast<size_t>(state.range(0)));
+    if (!s) {
+        return;
+    }
+    traffic_counters counters;
+    bench_pipeline<no_policer> pipeline(session_lookup(s->_control_plane), {}, {}, counters);
+    run_downlink(state, *s, [&](auto &burst) { pipeline.handle_downlink_burst(burst); });
+}
+BENCHMARK(BM_pipeline_downlink_burst)->Apply(session_counts);
+
+static void BM_virtual_downlink_burst(benchmark::State &state) {
+    auto *s = bench_sessions::get(state, static_cast<size_t>(state.range(0)));
+    if (!s) {
+        return;
+    }
+    null_data_plane plane(s->_control_plane);
+    run_downlink(state, *s, [&](auto &burst) { plane.handle_downlink_burst(burst); });
+}
+BENCHMARK(BM_virtual_downlink_burst)->Apply(session_counts);
+
+// Session AMBR у каждой сессии: один token bucket на пакет
+static void BM_pipeline_session_ambr_uplink_burst(benchmark::State &state) {
+    auto *s = bench_sessions::get(state, static_cast<size_t>(state.range(0)));
+    if (!s) {
+        return;
+    }
+    set_session_limits(*s);
+    traffic_counters counters;
+    bench_pipeline<session_ambr_policer> pipeline(session_lookup(s->_control_plane), {}, {}, counters);
+    run_uplink(state, *s, [&](auto &burst) { pipeline.handle_uplink_burst(burst); });
+    clear_session_limits(*s);
+}
+BENCHMARK(BM_pipeline_session_ambr_uplink_burst)->Apply(session_counts);
+
+// Session AMBR и APN-AMBR: вся иерархия rate_limited_data_plane
+static void BM_pipeline_hierarchical_uplink_burst(benchmark::State &state) {
+    auto *s = bench_sessions::get(state, static_cast<size_t>(state.range(0)));
+    if (!s) {
+        return;
+    }
+    set_session_limits(*s);
+    traffic_counters counters;
+    bench_pipeline<hierarchical_policer> pipeline(session_lookup(s->_control_plane), {}, {}, counters);
+    pipeline.policer().set_apn_limits(*s->_control_plane.find_apn_id("bench.apn"), generous_limiters());
+    run_uplink(state, *s, [&](auto &burst) { pipeline.handle_uplink_burst(burst); });
+    clear_session_limits(*s);
+}
+BENCHMARK(BM_pipeline_hierarchical_uplink_burst)->Apply(session_counts);
+
+static void BM_virtual_rate_limited_uplink_burst(benchmark::State &state) {
+    auto *s = bench_sessions::get(state, static_cast<size_t>(state.range(0)));
+    if (!s) {
+        return;
+    }
+    null_sink<rate_limited_data_plane> plane(s->_control_plane);
+    auto limits = generous;
+    for (auto cp_teid : s->_cp_teids) {
+        plane.set_rate_limits(cp_teid, limits);
+    }
+    plane.set_apn_rate_limits("bench.apn", generous);
+    run_uplink(state, *s, [&](auto &burst) { plane.handle_uplink_burst(burst); });
+    for (auto cp_teid : s->_cp_teids) {
+        plane.delete_rate_limits(cp_teid);
+    }
+}
+BENCHMARK(BM_virtual_rate_limited_uplink_burst)->Apply(session_counts);
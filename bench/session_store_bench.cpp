@@ -0,0 +1,111 @@
+#include <control_plane.h>
+#include <session_store.h>
+
+#include <benchmark/benchmark.h>
+
+#include <unistd.h>
+
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "bench_sessions.h"
+
+namespace {
+    // Файл хранилища с count сессиями: PDN connection и default bearer в одном APN. Строится при
+    // первом запросе своего размера, файл удаляется при запросе другого
+    struct stored_sessions {
+        explicit stored_sessions(size_t count)
+            : _path((std::filesystem::temp_directory_path() /
+                     ("session_store_bench." + std::to_string(::getpid()))).string()) {
+            std::filesystem::remove(_path);
+            _store.emplace(_path, session_store::config{.initial_records = 2 * count + 1});
+            _control_plane = std::make_unique<control_plane>();
+            _control_plane->add_apn("bench.apn", boost::asio::ip::make_address_v4("192.168.0.1"));
+            _control_plane->attach_store(*_store);
+            _control_plane->reserve(count, count);
+            for (uint32_t i = 0; i < count; ++i) {
+                auto pdn = _control_plane->create_pdn_connection(
+                        "bench.apn", boost::asio::ip::make_address_v4("192.168.1.1"), i);
+                pdn->set_default_bearer(_control_plane->create_bearer(pdn, i));
+            }
+            _count = count;
+        }
+
+        ~stored_sessions() {
+            _control_plane.reset();
+            _store.reset();
+            std::filesystem::remove(_path);
+        }
+
+        static stored_sessions *get(benchmark::State &state, size_t count) {
+            static std::unique_ptr<stored_sessions> current;
+            if (current && current->_count == count) {
+                return current.get();
+            }
+            current.reset();
+
+            const auto memory =
+                    static_cast<size_t>(sysconf(_SC_PHYS_PAGES)) * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+            // Сессии в памяти и, при восстановлении, еще раз
+            if (2 * count * bench_sessions::bytes_per_session > memory / 2) {
+                state.SkipWithError("not enough memory for this many sessions");
+                return nullptr;
+            }
+            current = std::make_unique<stored_sessions>(count);
+            return current.get();
+        }
+
+        std::string _path;
+        std::optional<session_store> _store;
+        std::unique_ptr<control_plane> _control_plane;
+        size_t _count = 0;
+    };
+} // namespace
+
+// Перезапуск: открытие файла с range(0) сессиями и подъем индексов control plane из него.
+// Страницы файла уже в page cache, холодный старт с диска добавляет чтение файла
+static void BM_session_store_restore(benchmark::State &state) {
+    auto *s = stored_sessions::get(state, static_cast<size_t>(state.range(0)));
+    if (!s) {
+        return;
+    }
+    for (auto _ : state) {
+        auto store = std::make_unique<session_store>(s->_path);
+        auto cp = std::make_unique<control_plane>();
+        cp->add_apn("bench.apn", boost::asio::ip::make_address_v4("192.168.0.1"));
+        benchmark::DoNotOptimize(cp->attach_store(*store));
+
+        state.PauseTiming();
+        cp.reset();
+        store.reset();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_session_store_restore)
+        ->Arg(100'000)
+        ->Arg(1'000'000)
+        ->ArgName("sessions")
+        ->Unit(benchmark::kMillisecond)
+        ->Iterations(3);
+
+// То же, что BM_control_plane_session_churn, но каждое изменение записывается в хранилище
+static void BM_session_store_churn(benchmark::State &state) {
+    auto *s = stored_sessions::get(state, static_cast<size_t>(state.range(0)));
+    if (!s) {
+        return;
+    }
+    auto &cp = *s->_control_plane;
+    const auto sgw = boost::asio::ip::make_address_v4("192.168.1.2");
+    uint32_t sgw_teid = 0;
+    for (auto _ : state) {
+        auto pdn = cp.create_pdn_connection("bench.apn", sgw, ++sgw_teid);
+        auto bearer = cp.create_bearer(pdn, sgw_teid);
+        pdn->set_default_bearer(bearer);
+        cp.delete_pdn_connection(pdn->get_cp_teid());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_session_store_churn)->Arg(1'000)->Arg(100'000)->ArgName("sessions");
@@ -0,0 +1,45 @@
+#include <sharded_data_plane.h>
+
+#include <benchmark/benchmark.h>
+
+#include "bench_sessions.h"
+#include "null_data_plane.h"
+
+// Uplink через sharded_data_plane по 100K сессиям; масштабирование по числу рабочих потоков.
+// Итерация - пачка, которую рабочие потоки успевают принять в кольца, и ожидание ее обработки,
+// поэтому считаются пакеты, прошедшие data plane, а не только попавшие в кольца. TEID поделены на
+// шарды, и диспетчер выбирает поток по битам TEID, без поиска bearer
+static void BM_sharded_uplink(benchmark::State &state) {
+    constexpr uint8_t teid_shard_bits = 4;
+    auto *s = bench_sessions::get(state, 100'000, teid_shard_bits);
+    if (!s) {
+        return;
+    }
+    const auto workers = static_cast<size_t>(state.range(0));
+    constexpr size_t ring_size = 8192;
+    sharded_data_plane plane(s->_control_plane,
+                             {.workers = workers, .ring_size = ring_size, .burst_size = 64,
+                              .teid_shard_bits = teid_shard_bits},
+                             [](control_plane &cp, size_t) { return std::make_unique<null_data_plane>(cp); });
+    const auto apn_id = *s->_control_plane.find_apn_id("bench.apn");
+
+    constexpr size_t burst_size = 256;
+    // Половина кольца на поток: разброс сессий по потокам не переполняет кольца
+    const size_t bursts = workers * ring_size / 2 / burst_size;
+    std::vector<data_plane::uplink_packet> burst(burst_size);
+    size_t next = 0;
+
+    for (auto _ : state) {
+        for (size_t b = 0; b < bursts; ++b) {
+            for (auto &packet : burst) {
+                packet.dp_teid = s->_dp_teids[s->_order[next++ % s->_order.size()]];
+            }
+            plane.handle_uplink_burst(burst);
+        }
+        plane.drain();
+    }
+
+    state.SetItemsProcessed(static_cast<int64_t>(plane.apn_usage(apn_id).uplink_packets));
+    state.counters["dropped"] = static_cast<double>(plane.dropped());
+}
+BENCHMARK(BM_sharded_uplink)->RangeMultiplier(2)->Range(1, 16)->UseRealTime();
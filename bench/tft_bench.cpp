@@ -0,0 +1,77 @@
+#include <tft.h>
+
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <random>
+#include <vector>
+
+namespace {
+    // range(0) фильтров на двух bearers и 1024 случайных ключа, примерно половина из них совпадает
+    struct tft_setup {
+        explicit tft_setup(size_t count) : filters(count) {
+            std::mt19937 gen(1);
+            for (auto &f : filters) {
+                f.precedence = static_cast<uint8_t>(gen() % 256);
+                f.remote_address = 0x0a000000 | (gen() % 256) << 8;
+                f.remote_mask = 0xffffff00;
+                f.protocol = gen() % 2 ? 17 : 6;
+                f.local_port_low = static_cast<uint16_t>(gen() % 60000);
+                f.local_port_high = static_cast<uint16_t>(f.local_port_low + 1000);
+            }
+            const auto half = filters.size() / 2;
+            bearers = {{reinterpret_cast<bearer *>(64), {filters.data(), half}},
+                       {reinterpret_cast<bearer *>(128), {filters.data() + half, filters.size() - half}}};
+            for (auto &key : keys) {
+                const auto &f = filters[gen() % filters.size()];
+                const bool hit = gen() % 2;
+                key = {.remote_address = (hit ? f.remote_address : 0x0b000000) | static_cast<uint32_t>(gen() % 256),
+                       .remote_port = static_cast<uint16_t>(gen()),
+                       .local_port = static_cast<uint16_t>(f.local_port_low + gen() % 1000),
+                       .protocol = f.protocol};
+            }
+        }
+
+        std::vector<tft::packet_filter> filters;
+        std::vector<tft_classifier::bearer_filters> bearers;
+        std::array<tft::flow_key, 1024> keys;
+    };
+} // namespace
+
+static void BM_tft_classify(benchmark::State &state) {
+    tft_setup setup(static_cast<size_t>(state.range(0)));
+    tft_classifier classifier(setup.bearers);
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(classifier.classify(setup.keys[i++ % setup.keys.size()]));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_tft_classify)->Arg(1)->Arg(4)->Arg(16)->Arg(64);
+
+// Пакетная классификация burst'а из 32 пакетов одного UE
+static void BM_tft_classify_burst(benchmark::State &state) {
+    tft_setup setup(static_cast<size_t>(state.range(0)));
+    tft_classifier classifier(setup.bearers);
+    std::array<bearer *, 32> result{};
+    size_t i = 0;
+    for (auto _ : state) {
+        classifier.classify(std::span(setup.keys).subspan(i, result.size()), result);
+        benchmark::DoNotOptimize(result.data());
+        i = (i + result.size()) % setup.keys.size();
+    }
+    state.SetItemsProcessed(state.iterations() * result.size());
+}
+BENCHMARK(BM_tft_classify_burst)->Arg(16);
+
+// Разбор ключа из заголовков IPv4/UDP
+static void BM_tft_downlink_key(benchmark::State &state) {
+    std::vector<uint8_t> packet(64, 0);
+    packet[0] = 0x45;
+    packet[9] = 17;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(tft::downlink_key(packet));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_tft_downlink_key);
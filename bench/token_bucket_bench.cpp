@@ -0,0 +1,27 @@
+#include <rate_limited_data_plane.h>
+
+#include <benchmark/benchmark.h>
+
+// Лимит настолько большой, что все пакеты проходят: измеряется только стоимость проверки
+
+static void BM_token_bucket_spend(benchmark::State &state) {
+    token_bucket bucket(1e12, 1e12);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(bucket.spend_tokens(1500.0));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_token_bucket_spend);
+
+// Часы читаются раз на burst из 32 пакетов, как в police_*_burst
+static void BM_token_bucket_spend_burst(benchmark::State &state) {
+    token_bucket bucket(1e12, 1e12);
+    for (auto _ : state) {
+        const auto now = token_bucket::now();
+        for (int i = 0; i < 32; ++i) {
+            benchmark::DoNotOptimize(bucket.spend_tokens(uint64_t{1500}, now));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * 32);
+}
+BENCHMARK(BM_token_bucket_spend_burst);
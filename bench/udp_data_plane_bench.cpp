@@ -0,0 +1,105 @@
+#include <udp_data_plane.h>
+
+#include <benchmark/benchmark.h>
+
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include <vector>
+
+namespace {
+    const auto pgw_addr = boost::asio::ip::make_address_v4("127.0.0.1");
+    const auto sgw_addr = boost::asio::ip::make_address_v4("127.0.0.2");
+    const auto apn_gw = boost::asio::ip::make_address_v4("127.0.0.3");
+
+    sockaddr_in make_sockaddr(boost::asio::ip::address_v4 address, uint16_t port) {
+        sockaddr_in result{};
+        result.sin_family = AF_INET;
+        result.sin_addr.s_addr = htonl(address.to_uint());
+        result.sin_port = htons(port);
+        return result;
+    }
+
+    int bound_socket(boost::asio::ip::address_v4 address) {
+        const int fd = socket(AF_INET, SOCK_DGRAM, 0);
+        const auto local = make_sockaddr(address, 0);
+        bind(fd, reinterpret_cast<const sockaddr *>(&local), sizeof(local));
+        const int buffer_size = 4 << 20;
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+        return fd;
+    }
+
+    uint16_t port_of(int fd) {
+        sockaddr_in local{};
+        socklen_t size = sizeof(local);
+        getsockname(fd, reinterpret_cast<sockaddr *>(&local), &size);
+        return ntohs(local.sin_port);
+    }
+} // namespace
+
+// Uplink по loopback: SGW отправляет пачку G-PDU одним sendmmsg, udp_data_plane принимает их
+// recvmmsg, пересылает шлюзу APN sendmmsg, шлюз вычитывает recvmmsg. Все в одном потоке, так что
+// это цена четырех системных вызовов на пачку из range(0) пакетов размером 64 байта
+static void BM_udp_data_plane_uplink(benchmark::State &state) {
+    const auto batch = static_cast<size_t>(state.range(0));
+    const int sgw = bound_socket(sgw_addr);
+    const int gateway = bound_socket(apn_gw);
+
+    control_plane cp;
+    cp.add_apn("bench.apn", apn_gw);
+    auto pdn = cp.create_pdn_connection("bench.apn", sgw_addr, 1);
+    auto bearer = cp.create_bearer(pdn, 1);
+    pdn->set_default_bearer(bearer);
+    udp_data_plane data_plane(cp, {.gtpu_address = pgw_addr,
+                                   .gtpu_port = 0,
+                                   .sgi_address = pgw_addr,
+                                   .sgi_port = 0,
+                                   .apn_gateway_port = port_of(gateway),
+                                   .batch_size = batch});
+
+    // G-PDU без внешних заголовков
+    std::vector<uint8_t> message(gtpu::header_size + 64, 0);
+    message[0] = 0x30;
+    message[1] = gtpu::g_pdu;
+    message[3] = 64;
+    const auto teid = bearer->get_dp_teid();
+    for (int i = 0; i < 4; ++i) {
+        message[4 + i] = static_cast<uint8_t>(teid >> (24 - 8 * i));
+    }
+    message[gtpu::header_size] = 0x45;
+
+    auto to = make_sockaddr(pgw_addr, data_plane.gtpu_port());
+    iovec iov{message.data(), message.size()};
+    std::vector<mmsghdr> requests(batch);
+    for (auto &request : requests) {
+        request.msg_hdr.msg_name = &to;
+        request.msg_hdr.msg_namelen = sizeof(to);
+        request.msg_hdr.msg_iov = &iov;
+        request.msg_hdr.msg_iovlen = 1;
+    }
+    std::vector<uint8_t> sink(batch * 128);
+    std::vector<iovec> sink_iovs(batch);
+    std::vector<mmsghdr> received(batch);
+    for (size_t i = 0; i < batch; ++i) {
+        sink_iovs[i] = {sink.data() + i * 128, 128};
+        received[i].msg_hdr.msg_iov = &sink_iovs[i];
+        received[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    for (auto _ : state) {
+        sendmmsg(sgw, requests.data(), static_cast<unsigned>(batch), 0);
+        size_t forwarded = 0;
+        while (forwarded < batch) {
+            data_plane.poll_sockets();
+            const int count = recvmmsg(gateway, received.data(), static_cast<unsigned>(batch - forwarded),
+                                       MSG_DONTWAIT, nullptr);
+            if (count > 0) {
+                forwarded += static_cast<size_t>(count);
+            }
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * batch));
+    close(sgw);
+    close(gateway);
+}
+BENCHMARK(BM_udp_data_plane_uplink)->Arg(1)->Arg(32);
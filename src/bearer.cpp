@@ -1,13 +1,36 @@
 #include <bearer.h>
 
+#include <epoch.h>
 #include <pdn_connection.h>
 
-bearer::bearer(uint32_t dp_teid, pdn_connection &pdn) : _dp_teid(dp_teid), _pdn(pdn) {}
+#include <utility>
 
-uint32_t bearer::get_sgw_dp_teid() const { return _sgw_dp_teid; }
+bearer::bearer(uint32_t dp_teid, pdn_connection &pdn) :
+    _dp_teid(dp_teid), _pdn(pdn.weak_from_this()), _pdn_view(&pdn) {}
 
-void bearer::set_sgw_dp_teid(uint32_t sgw_cp_teid) { _sgw_dp_teid = sgw_cp_teid; }
+uint32_t bearer::get_sgw_dp_teid() const { return _sgw_dp_teid.load(std::memory_order_relaxed); }
+
+void bearer::set_sgw_dp_teid(uint32_t sgw_cp_teid) {
+    _sgw_dp_teid.store(sgw_cp_teid, std::memory_order_relaxed);
+    if (_store) {
+        _store->modify<session_store::bearer_record>(
+                _store_slot, [sgw_cp_teid](session_store::bearer_record &record) { record.sgw_dp_teid = sgw_cp_teid; });
+    }
+}
 
 uint32_t bearer::get_dp_teid() const { return _dp_teid; }
 
-std::shared_ptr<pdn_connection> bearer::get_pdn_connection() const { return _pdn.shared_from_this(); }
+uint32_t bearer::get_handle() const { return _handle; }
+
+std::shared_ptr<pdn_connection> bearer::get_pdn_connection() const { return _pdn.lock(); }
+
+pdn_connection &bearer::get_pdn_view() const { return *_pdn_view; }
+
+bearer::qos_limits *bearer::get_qos_limits_view() const { return _qos_limits_ptr.load(std::memory_order_acquire); }
+
+void bearer::set_qos_limits(std::unique_ptr<qos_limits> limits) {
+    _qos_limits_ptr.store(limits.get(), std::memory_order_release);
+    epoch_domain::global().retire(std::exchange(_qos_limits, std::move(limits)));
+}
+
+uint32_t bearer::get_store_slot() const { return _store_slot; }
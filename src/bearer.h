@@ -1,22 +1,57 @@
 #pragma once
 
+#include <session_store.h>
+#include <token_bucket.h>
+
 #include <boost/asio/ip/address_v4.hpp>
 
+#include <atomic>
+#include <memory>
+
+class control_plane;
 class pdn_connection;
 
-class bearer {
+class bearer : public std::enable_shared_from_this<bearer> {
 public:
+    struct qos_limits {
+        token_bucket_pair mbr;
+        token_bucket_pair gbr;
+    };
+
     bearer(uint32_t dp_teid, pdn_connection &pdn);
 
     [[nodiscard]] uint32_t get_sgw_dp_teid() const;
     void set_sgw_dp_teid(uint32_t sgw_cp_teid);
 
     [[nodiscard]] uint32_t get_dp_teid() const;
+    // Дескриптор в slot_map control plane: уникален среди живых bearers, с поколением
+    [[nodiscard]] uint32_t get_handle() const;
 
+    // nullptr, если PDN connection уже удален
     [[nodiscard]] std::shared_ptr<pdn_connection> get_pdn_connection() const;
 
+    // Не владеющая ссылка для data plane. PDN удаляется только после всех своих bearers,
+    // поэтому внутри epoch_guard ссылка действительна
+    [[nodiscard]] pdn_connection &get_pdn_view() const;
+
+    // Лимиты ведет rate_limited_data_plane: блок заменяется целиком, старый освобождается через
+    // epoch_domain. Buckets блока меняет только поток, который обрабатывает трафик bearer
+    [[nodiscard]] qos_limits *get_qos_limits_view() const;
+    void set_qos_limits(std::unique_ptr<qos_limits> limits);
+
+    // Слот записи в session_store control plane; session_store::no_slot без хранилища
+    [[nodiscard]] uint32_t get_store_slot() const;
+
 private:
-    uint32_t _sgw_dp_teid{};
+    friend control_plane;
+
+    std::atomic<uint32_t> _sgw_dp_teid{};
     uint32_t _dp_teid{};
-    pdn_connection &_pdn;
+    uint32_t _handle{};
+    std::weak_ptr<pdn_connection> _pdn;
+    pdn_connection *_pdn_view;
+    std::unique_ptr<qos_limits> _qos_limits;
+    std::atomic<qos_limits *> _qos_limits_ptr{};
+    session_store *_store{};
+    uint32_t _store_slot = session_store::no_slot;
 };
@@ -1,151 +1,700 @@
 #include <control_plane.h>
 #include <bearer.h>
+#include <latency.h>
 #include <algorithm>
-#include <random>
+#include <array>
+#include <cstring>
+#include <unordered_set>
 
-static uint32_t generate_teid() {
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    static std::uniform_int_distribution<uint32_t> dis(1, UINT32_MAX - 1);
-    return dis(gen);
-}
+namespace {
+    // Сессий в пачке массовых операций: группы индексов, подгруженные для пачки, еще в кэше,
+    // когда до них доходит очередь
+    constexpr size_t batch_size = 64;
+} // namespace
+
+control_plane::control_plane() : control_plane(config{}) {}
+
+control_plane::control_plane(const config &config) : _cp_teids(config.teids), _dp_teids(config.teids) {}
 
 std::shared_ptr<pdn_connection> control_plane::find_pdn_by_cp_teid(uint32_t cp_teid) const {
-    auto it = _pdns.find(cp_teid);
-    if (it != _pdns.end()) {
-        return it->second;
-    }
-    return nullptr;
+    epoch_guard guard;
+    auto *pdn = _pdns.get(_pdns_by_cp_teid.find(cp_teid));
+    return pdn ? pdn->shared_from_this() : nullptr;
 }
 
 std::shared_ptr<pdn_connection> control_plane::find_pdn_by_ip_address(const boost::asio::ip::address_v4 &ip) const {
-    auto it = _pdns_by_ue_ip_addr.find(ip);
-    if (it != _pdns_by_ue_ip_addr.end()) {
-        return it->second;
-    }
-    return nullptr;
+    epoch_guard guard;
+    auto *pdn = find_pdn_view_by_ip_address(ip);
+    return pdn ? pdn->shared_from_this() : nullptr;
 }
 
 std::shared_ptr<bearer> control_plane::find_bearer_by_dp_teid(uint32_t dp_teid) const {
-    auto it = _bearers.find(dp_teid);
-    if (it != _bearers.end()) {
-        return it->second;
+    epoch_guard guard;
+    auto *found = find_bearer_view(dp_teid);
+    return found ? found->shared_from_this() : nullptr;
+}
+
+bearer *control_plane::find_bearer_view(uint32_t dp_teid) const {
+    return _bearers.get(_bearers_by_dp_teid.find(dp_teid));
+}
+
+pdn_connection *control_plane::find_pdn_view_by_ip_address(const boost::asio::ip::address_v4 &ip) const {
+    return _pdns.get(_pdns_by_ue_ip_addr.find(ip.to_uint()));
+}
+
+void control_plane::find_bearers_by_dp_teid(std::span<const uint32_t> dp_teids, std::span<bearer *> bearers) const {
+    // Сначала запрашиваем все группы таблицы, затем ищем: промахи кэша перекрываются
+    for (auto dp_teid : dp_teids) {
+        _bearers_by_dp_teid.prefetch(dp_teid);
+    }
+    for (size_t i = 0; i < dp_teids.size(); ++i) {
+        bearers[i] = find_bearer_view(dp_teids[i]);
+    }
+}
+
+void control_plane::find_pdns_by_ip_address(std::span<const boost::asio::ip::address_v4> ips,
+                                            std::span<pdn_connection *> pdns) const {
+    uint32_t addresses[batch_size];
+    pdn_handle handles[batch_size];
+    for (size_t offset = 0; offset < ips.size(); offset += batch_size) {
+        const auto count = std::min(batch_size, ips.size() - offset);
+        for (size_t i = 0; i < count; ++i) {
+            addresses[i] = ips[offset + i].to_uint();
+        }
+        _pdns_by_ue_ip_addr.find({addresses, count}, {handles, count});
+        for (size_t i = 0; i < count; ++i) {
+            pdns[offset + i] = _pdns.get(handles[i]);
+        }
     }
-    return nullptr;
 }
 
 std::shared_ptr<pdn_connection> control_plane::create_pdn_connection(const std::string &apn,
                                                                     boost::asio::ip::address_v4 sgw_addr,
                                                                     uint32_t sgw_cp_teid) {
+    latency::scope timing(latency::create_pdn_connection);
     // Проверяем, существует ли APN
     auto apn_it = _apns.find(apn);
     if (apn_it == _apns.end()) {
         return nullptr;
     }
 
-    // Генерируем уникальный CP TEID для PGW
-    uint32_t cp_teid = generate_teid();
-    while (_pdns.find(cp_teid) != _pdns.end()) {
-        cp_teid = generate_teid();
+    // Выделяем IP адрес для UE из пула APN
+    auto ue_ip = apn_it->second.pool->allocate();
+    if (!ue_ip) {
+        return nullptr;
     }
 
-    // Выделяем IP адрес для UE
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    static std::uniform_int_distribution<uint8_t> dis(1, 254);
+    // Выделяем CP TEID для PGW; шарды занимаются по очереди
+    const uint32_t cp_teid = _cp_teids.allocate(_next_teid_shard++ % _cp_teids.shards());
+    if (!cp_teid) {
+        apn_it->second.pool->release(*ue_ip);
+        return nullptr;
+    }
 
-    boost::asio::ip::address_v4 ue_ip(boost::asio::ip::address_v4::bytes_type{
-        10, static_cast<uint8_t>(dis(gen)), static_cast<uint8_t>(dis(gen)), static_cast<uint8_t>(dis(gen))
-    });
+    return insert_pdn(apn_it->second, cp_teid, *ue_ip, find_or_add_sgw(sgw_addr), sgw_cp_teid);
+}
 
-    // Убеждаемся, что IP адрес уникален
-    while (_pdns_by_ue_ip_addr.find(ue_ip) != _pdns_by_ue_ip_addr.end()) {
-        ue_ip = boost::asio::ip::address_v4(boost::asio::ip::address_v4::bytes_type{
-            10, static_cast<uint8_t>(dis(gen)), static_cast<uint8_t>(dis(gen)), static_cast<uint8_t>(dis(gen))
-        });
+void control_plane::delete_pdn_connection(uint32_t cp_teid) {
+    latency::scope timing(latency::delete_pdn_connection);
+    const auto handle = _pdns_by_cp_teid.find(cp_teid);
+    if (!_pdns.get(handle)) {
+        return;
     }
+    retired_objects retired;
+    erase_pdn(handle, teid_allocator::clock::now(), retired);
+    retire(std::move(retired));
+}
 
-    // Создаем PDN connection
-    auto pdn = pdn_connection::create(cp_teid, apn_it->second, ue_ip);
-    pdn->set_sgw_addr(sgw_addr);
-    pdn->set_sgw_cp_teid(sgw_cp_teid);
+std::shared_ptr<bearer> control_plane::create_bearer(const std::shared_ptr<pdn_connection> &pdn, uint32_t sgw_teid) {
+    latency::scope timing(latency::create_bearer);
+    // PDN уже удален: bearer ссылался бы на объект, который освободится с последним shared_ptr
+    if (!pdn || _pdns.get(pdn->get_handle()) != pdn.get()) {
+        return nullptr;
+    }
 
-    // Сохраняем
-    _pdns[cp_teid] = pdn;
-    _pdns_by_ue_ip_addr[ue_ip] = pdn;
+    // Выделяем DP TEID из шарда PDN
+    const uint32_t dp_teid = _dp_teids.allocate(_cp_teids.shard_of(pdn->get_cp_teid()));
+    if (!dp_teid) {
+        return nullptr;
+    }
 
-    return pdn;
+    return insert_bearer(*pdn, dp_teid, sgw_teid);
 }
 
-void control_plane::delete_pdn_connection(uint32_t cp_teid) {
-    auto it = _pdns.find(cp_teid);
-    if (it == _pdns.end()) {
+void control_plane::delete_bearer(uint32_t dp_teid) {
+    latency::scope timing(latency::delete_bearer);
+    const auto handle = _bearers_by_dp_teid.find(dp_teid);
+    if (!_bearers.get(handle)) {
         return;
     }
+    retired_objects retired;
+    erase_bearer(handle, teid_allocator::clock::now(), retired);
+    retire(std::move(retired));
+}
+
+std::vector<std::shared_ptr<pdn_connection>> control_plane::create_sessions(std::span<const session_spec> specs) {
+    std::vector<std::shared_ptr<pdn_connection>> created(specs.size());
+    reserve(_pdns.size() + specs.size(), _bearers.size() + specs.size());
+
+    std::array<apn_entry *, batch_size> apns;
+    std::array<boost::asio::ip::address_v4, batch_size> ue_ips;
+    std::array<uint32_t, batch_size> cp_teids;
+    std::array<uint32_t, batch_size> dp_teids;
+    // Сессии набора обычно идут от одного SGW
+    const std::shared_ptr<sgw_peer> *sgw = nullptr;
 
-    auto pdn = it->second;
+    for (size_t begin = 0; begin < specs.size(); begin += batch_size) {
+        const auto batch = specs.subspan(begin, std::min(batch_size, specs.size() - begin));
 
-    // Удаляем все bearers этого PDN
-    std::vector<uint32_t> bearer_teids;
-    for (const auto& [teid, bearer] : _bearers) {
-        if (bearer->get_pdn_connection() == pdn) {
-            bearer_teids.push_back(teid);
+        // Адреса выделяются блоком на каждую серию соседних сессий одного APN
+        size_t count = 0;
+        for (size_t run = 0; run < batch.size();) {
+            auto end = run + 1;
+            while (end < batch.size() && batch[end].apn == batch[run].apn) {
+                ++end;
+            }
+            auto apn_it = _apns.find(batch[run].apn);
+            if (apn_it != _apns.end()) {
+                const auto allocated = apn_it->second.pool->allocate(std::span(ue_ips).subspan(count, end - run));
+                for (size_t i = 0; i < end - run; ++i) {
+                    apns[run + i] = i < allocated ? &apn_it->second : nullptr;
+                }
+                count += allocated;
+            } else {
+                std::fill(apns.begin() + static_cast<ptrdiff_t>(run), apns.begin() + static_cast<ptrdiff_t>(end),
+                          nullptr);
+            }
+            run = end;
+        }
+
+        // ue_ips[0, count) идут по порядку сессий, которым достался адрес
+        const auto shard = _next_teid_shard++ % _cp_teids.shards();
+        const auto cp_count = _cp_teids.allocate(std::span(cp_teids).first(count), shard);
+        const auto dp_count = _dp_teids.allocate(std::span(dp_teids).first(cp_count), shard);
+        for (size_t i = dp_count; i < cp_count; ++i) {
+            _cp_teids.release(cp_teids[i]);
+        }
+        for (size_t i = 0; i < dp_count; ++i) {
+            _pdns_by_cp_teid.prefetch(cp_teids[i]);
+            _pdns_by_ue_ip_addr.prefetch(ue_ips[i].to_uint());
+            _bearers_by_dp_teid.prefetch(dp_teids[i]);
+        }
+
+        size_t i = 0;
+        for (size_t session = 0; session < batch.size(); ++session) {
+            if (!apns[session]) {
+                continue;
+            }
+            if (i >= dp_count) {
+                // TEID кончились раньше адресов
+                apns[session]->pool->release(ue_ips[i++]);
+                continue;
+            }
+            const auto &spec = batch[session];
+            if (!sgw || (*sgw)->get_address() != spec.sgw_addr) {
+                sgw = &find_or_add_sgw(spec.sgw_addr);
+            }
+            auto pdn = insert_pdn(*apns[session], cp_teids[i], ue_ips[i], *sgw, spec.sgw_cp_teid);
+            pdn->set_default_bearer(insert_bearer(*pdn, dp_teids[i], spec.sgw_dp_teid));
+            created[begin + session] = std::move(pdn);
+            ++i;
         }
     }
+    return created;
+}
 
-    for (uint32_t teid : bearer_teids) {
-        delete_bearer(teid);
+void control_plane::delete_sessions(std::span<const uint32_t> cp_teids) {
+    std::array<pdn_handle, batch_size> handles;
+    for (size_t begin = 0; begin < cp_teids.size(); begin += batch_size) {
+        const auto batch = cp_teids.subspan(begin, std::min(batch_size, cp_teids.size() - begin));
+        for (auto cp_teid : batch) {
+            _pdns_by_cp_teid.prefetch(cp_teid);
+        }
+        for (size_t i = 0; i < batch.size(); ++i) {
+            handles[i] = _pdns_by_cp_teid.find(batch[i]);
+        }
+        erase_pdns(std::span(handles).first(batch.size()));
     }
+}
 
-    // Удаляем из индекса по IP адресу
-    _pdns_by_ue_ip_addr.erase(pdn->get_ue_ip_addr());
+bool control_plane::set_sgw_address(uint32_t cp_teid, boost::asio::ip::address_v4 sgw_addr) {
+    auto *pdn = _pdns.get(_pdns_by_cp_teid.find(cp_teid));
+    if (!pdn) {
+        return false;
+    }
+    if (pdn->get_sgw_address() != sgw_addr) {
+        // Старый peer мог быть только что прочитан другим потоком
+        auto previous = pdn->_sgw_peer;
+        detach_sgw(*pdn);
+        attach_sgw(*pdn, find_or_add_sgw(sgw_addr));
+        epoch_domain::global().retire(std::move(previous));
+        pdn->persist();
+    }
+    return true;
+}
 
-    // Удаляем сам PDN
-    _pdns.erase(it);
+size_t control_plane::delete_sgw_sessions(boost::asio::ip::address_v4 sgw_addr) {
+    auto it = _sgw_peers.find(sgw_addr.to_uint());
+    if (it == _sgw_peers.end()) {
+        return 0;
+    }
+    // С конца списка: удаляемый PDN всегда последний, и detach_sgw не трогает другие PDN
+    const std::vector<pdn_handle> handles(it->second->_sessions.rbegin(), it->second->_sessions.rend());
+    erase_pdns(handles);
+    return handles.size();
 }
 
-std::shared_ptr<bearer> control_plane::create_bearer(const std::shared_ptr<pdn_connection> &pdn, uint32_t sgw_teid) {
-    if (!pdn) {
-        return nullptr;
+bool control_plane::relocate_sgw(boost::asio::ip::address_v4 from, boost::asio::ip::address_v4 to) {
+    auto node = _sgw_peers.extract(from.to_uint());
+    if (node.empty()) {
+        return false;
+    }
+    auto peer = std::move(node.mapped());
+    auto target = _sgw_peers.find(to.to_uint());
+    if (target == _sgw_peers.end()) {
+        // Адрес меняется у самого peer, все его сессии видят новый сразу
+        peer->_address.store(to.to_uint(), std::memory_order_relaxed);
+        node.key() = to.to_uint();
+        node.mapped() = peer;
+        _sgw_peers.insert(std::move(node));
+        if (_store) {
+            for (auto handle : peer->_sessions) {
+                _pdns.get(handle)->persist();
+            }
+        }
+        return true;
+    }
+
+    // По новому адресу уже есть сессии: переносим эти в список его peer
+    for (auto handle : peer->_sessions) {
+        auto *pdn = _pdns.get(handle);
+        pdn->_sgw_peer_slot = static_cast<uint32_t>(target->second->_sessions.size());
+        target->second->_sessions.push_back(handle);
+        pdn->_sgw_peer_ptr.store(target->second.get(), std::memory_order_release);
+        pdn->_sgw_peer = target->second;
+        pdn->persist();
+    }
+    epoch_domain::global().retire(std::move(peer));
+    return true;
+}
+
+size_t control_plane::count_sgw_sessions(boost::asio::ip::address_v4 sgw_addr) const {
+    auto it = _sgw_peers.find(sgw_addr.to_uint());
+    return it != _sgw_peers.end() ? it->second->_sessions.size() : 0;
+}
+
+void control_plane::erase_pdns(std::span<const pdn_handle> handles) {
+    // Вразброс удаляемые сессии - цепочка промахов: слот, PDN, вектор bearers, bearer, его слот.
+    // Пачка проходит ее по шагу за раз, каждый шаг подгружает в кэш то, что нужно следующему
+    std::array<pdn_connection *, batch_size> pdns;
+    for (size_t begin = 0; begin < handles.size(); begin += batch_size) {
+        const auto batch = handles.subspan(begin, std::min(batch_size, handles.size() - begin));
+        for (auto handle : batch) {
+            _pdns.prefetch(handle);
+        }
+        for (size_t i = 0; i < batch.size(); ++i) {
+            pdns[i] = _pdns.get(batch[i]);
+            for (size_t offset = 0; pdns[i] && offset < sizeof(pdn_connection); offset += 64) {
+                __builtin_prefetch(reinterpret_cast<const char *>(pdns[i]) + offset);
+            }
+        }
+        // detach_sgw переставляет на место удаленных PDN последние из списка peer: их тоже в кэш
+        const sgw_peer *tail_of = nullptr;
+        for (size_t i = 0; i < batch.size(); ++i) {
+            if (pdns[i]) {
+                __builtin_prefetch(pdns[i]->_bearers.data());
+                _pdns_by_ue_ip_addr.prefetch(pdns[i]->get_ue_ip_addr().to_uint());
+                const auto &sessions = pdns[i]->_sgw_peer->_sessions;
+                __builtin_prefetch(&sessions[pdns[i]->_sgw_peer_slot]);
+                if (tail_of != pdns[i]->_sgw_peer.get()) {
+                    tail_of = pdns[i]->_sgw_peer.get();
+                    for (auto moved : std::span(sessions).last(std::min(sessions.size(), batch.size()))) {
+                        _pdns.prefetch(moved);
+                    }
+                }
+            }
+        }
+        tail_of = nullptr;
+        for (size_t i = 0; i < batch.size(); ++i) {
+            for (size_t b = 0; pdns[i] && b < pdns[i]->_bearers.size(); ++b) {
+                __builtin_prefetch(pdns[i]->_bearers[b].get());
+            }
+            if (pdns[i] && tail_of != pdns[i]->_sgw_peer.get()) {
+                tail_of = pdns[i]->_sgw_peer.get();
+                const auto &sessions = tail_of->_sessions;
+                for (auto moved : std::span(sessions).last(std::min(sessions.size(), batch.size()))) {
+                    __builtin_prefetch(&_pdns.get(moved)->_sgw_peer_slot);
+                }
+            }
+        }
+        for (size_t i = 0; i < batch.size(); ++i) {
+            for (size_t b = 0; pdns[i] && b < pdns[i]->_bearers.size(); ++b) {
+                const auto &bearer = *pdns[i]->_bearers[b];
+                _bearers.prefetch(bearer.get_handle());
+                _bearers_by_dp_teid.prefetch(bearer.get_dp_teid());
+            }
+        }
+        const auto now = teid_allocator::clock::now();
+        retired_objects retired;
+        retired.reserve(3 * batch.size());
+        for (size_t i = 0; i < batch.size(); ++i) {
+            // pdns[i] прочитан до удаления: повтор того же дескриптора в пачке уже освобожден
+            if (pdns[i] && _pdns.get(batch[i])) {
+                erase_pdn(batch[i], now, retired);
+            }
+        }
+        retire(std::move(retired));
     }
+}
+
+std::shared_ptr<pdn_connection> control_plane::insert_pdn(const apn_entry &apn, uint32_t cp_teid,
+                                                         boost::asio::ip::address_v4 ue_ip,
+                                                         const std::shared_ptr<sgw_peer> &sgw, uint32_t sgw_cp_teid) {
+    // Создаем PDN connection
+    auto pdn = pdn_connection::create(object_arena::allocator<pdn_connection>(_arena), cp_teid, apn.gateway, ue_ip);
+    pdn->set_sgw_cp_teid(sgw_cp_teid);
+    pdn->_apn_id = apn.id;
+
+    // Сохраняем; после вставки в индексы PDN виден data plane потокам
+    const auto handle = _pdns.insert(pdn);
+    pdn->_handle = handle;
+    attach_sgw(*pdn, sgw);
+    _pdns_by_cp_teid.insert_or_assign(cp_teid, handle);
+    _pdns_by_ue_ip_addr.insert_or_assign(ue_ip.to_uint(), handle);
 
-    // Генерируем уникальный DP TEID для bearer
-    uint32_t dp_teid = generate_teid();
-    while (_bearers.find(dp_teid) != _bearers.end()) {
-        dp_teid = generate_teid();
+    if (_store) {
+        pdn->_store_slot = _store->insert(session_store::pdn_record{.cp_teid = cp_teid,
+                                                                    .sgw_cp_teid = sgw_cp_teid,
+                                                                    .sgw_address = sgw->get_address().to_uint(),
+                                                                    .ue_ip = ue_ip.to_uint(),
+                                                                    .apn_slot = apn.store_slot});
+        pdn->_store = _store;
     }
+    return pdn;
+}
 
+std::shared_ptr<bearer> control_plane::insert_bearer(pdn_connection &pdn, uint32_t dp_teid, uint32_t sgw_teid) {
     // Создаем bearer
-    auto new_bearer = std::make_shared<bearer>(dp_teid, *pdn);
+    auto new_bearer = std::allocate_shared<bearer>(object_arena::allocator<bearer>(_arena), dp_teid, pdn);
     new_bearer->set_sgw_dp_teid(sgw_teid);
 
     // Добавляем bearer в PDN
-    pdn->add_bearer(new_bearer);
+    pdn.add_bearer(new_bearer);
 
     // Сохраняем
-    _bearers[dp_teid] = new_bearer;
+    const auto handle = _bearers.insert(new_bearer);
+    new_bearer->_handle = handle;
+    _bearers_by_dp_teid.insert_or_assign(dp_teid, handle);
 
+    if (_store) {
+        new_bearer->_store_slot = _store->insert(session_store::bearer_record{
+                .dp_teid = dp_teid, .sgw_dp_teid = sgw_teid, .pdn_cp_teid = pdn.get_cp_teid()});
+        new_bearer->_store = _store;
+    }
     return new_bearer;
 }
 
-void control_plane::delete_bearer(uint32_t dp_teid) {
-    auto it = _bearers.find(dp_teid);
-    if (it == _bearers.end()) {
-        return;
+void control_plane::erase_pdn(pdn_handle handle, teid_allocator::clock::time_point now, retired_objects &retired) {
+    auto *pdn = _pdns.get(handle);
+
+    // Снимаем все bearers этого PDN и отпускаем их разом: в отличие от remove_bearer, без
+    // перестройки классификатора и записи в хранилище для каждого
+    for (const auto &bearer : pdn->_bearers) {
+        unregister_bearer(bearer->get_handle(), now, retired);
+    }
+    pdn->_bearers.clear();
+    pdn->_classifier_ptr.store(nullptr, std::memory_order_release);
+    pdn->_default_bearer_ptr.store(nullptr, std::memory_order_release);
+    retired.push_back(std::move(pdn->_default_bearer));
+
+    // Убираем из индексов; читатели могут еще держать указатель, поэтому освобождаем через эпохи
+    _pdns_by_ue_ip_addr.erase(pdn->get_ue_ip_addr().to_uint());
+    _pdns_by_cp_teid.erase(pdn->get_cp_teid());
+    if (auto *pool = find_ip_pool(pdn->get_ue_ip_addr())) {
+        pool->release(pdn->get_ue_ip_addr());
+    }
+    _cp_teids.release(pdn->get_cp_teid(), now);
+    detach_sgw(*pdn);
+    if (pdn->_store) {
+        pdn->_store->erase(pdn->_store_slot);
+    }
+
+    retired.push_back(_pdns.erase(handle));
+}
+
+void control_plane::erase_bearer(bearer_handle handle, teid_allocator::clock::time_point now,
+                                 retired_objects &retired) {
+    auto *found = _bearers.get(handle);
+    found->get_pdn_view().remove_bearer(found->get_dp_teid());
+    unregister_bearer(handle, now, retired);
+}
+
+void control_plane::unregister_bearer(bearer_handle handle, teid_allocator::clock::time_point now,
+                                      retired_objects &retired) {
+    auto *found = _bearers.get(handle);
+    const auto dp_teid = found->get_dp_teid();
+
+    _bearers_by_dp_teid.erase(dp_teid);
+    _dp_teids.release(dp_teid, now);
+    if (found->_store) {
+        found->_store->erase(found->_store_slot);
+    }
+
+    retired.push_back(_bearers.erase(handle));
+}
+
+void control_plane::retire(retired_objects &&retired) {
+    if (!retired.empty()) {
+        epoch_domain::global().retire(std::make_unique<retired_objects>(std::move(retired)));
+    }
+    epoch_domain::global().reclaim();
+}
+
+const std::shared_ptr<sgw_peer> &control_plane::find_or_add_sgw(boost::asio::ip::address_v4 sgw_addr) {
+    auto &peer = _sgw_peers[sgw_addr.to_uint()];
+    if (!peer) {
+        peer = std::make_shared<sgw_peer>(sgw_addr);
     }
+    return peer;
+}
 
-    auto bearer_to_delete = it->second;
-    auto pdn = bearer_to_delete->get_pdn_connection();
+void control_plane::attach_sgw(pdn_connection &pdn, const std::shared_ptr<sgw_peer> &sgw) {
+    pdn._sgw_peer_slot = static_cast<uint32_t>(sgw->_sessions.size());
+    sgw->_sessions.push_back(pdn._handle);
+    pdn._sgw_peer_ptr.store(sgw.get(), std::memory_order_release);
+    pdn._sgw_peer = sgw;
+}
 
-    if (pdn) {
-        // Удаляем bearer из PDN
-        pdn->remove_bearer(dp_teid);
+void control_plane::detach_sgw(pdn_connection &pdn) {
+    auto &sessions = pdn._sgw_peer->_sessions;
+    // На место PDN встает последний в списке
+    const auto moved = sessions.back();
+    sessions[pdn._sgw_peer_slot] = moved;
+    _pdns.get(moved)->_sgw_peer_slot = pdn._sgw_peer_slot;
+    sessions.pop_back();
+    if (sessions.empty()) {
+        _sgw_peers.erase(pdn._sgw_peer->get_address().to_uint());
     }
+}
 
-    // Удаляем из мапы
-    _bearers.erase(it);
+bool control_plane::set_bearer_tft(uint32_t dp_teid, std::vector<tft::packet_filter> filters) {
+    auto *found = _bearers.get(_bearers_by_dp_teid.find(dp_teid));
+    return found && found->get_pdn_view().set_bearer_tft(dp_teid, std::move(filters));
 }
 
 void control_plane::add_apn(std::string apn_name, boost::asio::ip::address_v4 apn_gateway) {
-    _apns[apn_name] = apn_gateway;
-}
\ No newline at end of file
+    if (!_default_ip_pool) {
+        // Подсети уже заданных пулов APN из общего пула не выдаются
+        ip_pool::config config{boost::asio::ip::make_network_v4(boost::asio::ip::address_v4(0x0a000000), 8), {}};
+        for (const auto &pool : _ip_pools) {
+            config.excluded.push_back(pool->network());
+        }
+        _ip_pools.push_back(std::make_unique<ip_pool>(config));
+        _default_ip_pool = _ip_pools.back().get();
+        _pdns_by_ue_ip_addr.add_range(config.network);
+    }
+    register_apn(std::move(apn_name), apn_gateway, _default_ip_pool);
+}
+
+bool control_plane::add_apn(std::string apn_name, boost::asio::ip::address_v4 apn_gateway,
+                            const ip_pool::config &pool) {
+    // Общий пул не в счет: подсеть APN просто перестает выдаваться из него, как и при создании
+    // общего пула после пулов APN
+    for (const auto &existing : _ip_pools) {
+        if (existing.get() != _default_ip_pool && existing->overlaps(pool.network)) {
+            return false;
+        }
+    }
+    if (_default_ip_pool && !_default_ip_pool->exclude(pool.network)) {
+        return false;
+    }
+    _ip_pools.push_back(std::make_unique<ip_pool>(pool));
+    _pdns_by_ue_ip_addr.add_range(pool.network);
+    register_apn(std::move(apn_name), apn_gateway, _ip_pools.back().get());
+    return true;
+}
+
+void control_plane::register_apn(std::string apn_name, boost::asio::ip::address_v4 apn_gateway, ip_pool *pool) {
+    // Повторная регистрация APN сохраняет его номер
+    auto [it, inserted] = _apns.try_emplace(std::move(apn_name), apn_entry{apn_gateway, pool, 0});
+    if (inserted) {
+        it->second.id = static_cast<uint32_t>(_apns.size() - 1);
+    } else {
+        it->second.gateway = apn_gateway;
+        it->second.pool = pool;
+    }
+    if (_store) {
+        persist_apn(it->first, it->second);
+    }
+}
+
+void control_plane::persist_apn(const std::string &apn_name, apn_entry &apn) {
+    session_store::apn_record record;
+    if (apn_name.size() >= sizeof(record.name)) {
+        return;
+    }
+    std::memcpy(record.name, apn_name.data(), apn_name.size());
+    record.gateway = apn.gateway.to_uint();
+    if (apn.pool != _default_ip_pool) {
+        record.pool_network = apn.pool->network().network().to_uint();
+        record.pool_prefix = apn.pool->network().prefix_length();
+    }
+
+    // APN-AMBR в записи ведет rate_limited_data_plane
+    if (auto slot = _store->find_apn(apn_name)) {
+        apn.store_slot = *slot;
+        _store->modify<session_store::apn_record>(*slot, [&record](session_store::apn_record &stored) {
+            record.has_ambr = stored.has_ambr;
+            record.ambr = stored.ambr;
+            stored = record;
+        });
+    } else {
+        apn.store_slot = _store->insert(record);
+    }
+}
+
+size_t control_plane::attach_store(session_store &store) {
+    // Сначала APN: из файла добавляются только те, которых нет в конфигурации. Пул APN, который
+    // не удалось зарегистрировать, его сессии не поднимаются, но и не удаляются из файла
+    std::vector<std::pair<uint32_t, std::string>> stored_apns;
+    std::unordered_set<uint32_t> unregistered_apn_slots;
+    store.for_each<session_store::apn_record>([&](uint32_t slot, const session_store::apn_record &record) {
+        stored_apns.emplace_back(slot, std::string(record.name, strnlen(record.name, sizeof(record.name))));
+        if (!_apns.contains(stored_apns.back().second)) {
+            const boost::asio::ip::address_v4 gateway(record.gateway);
+            if (record.pool_prefix) {
+                const boost::asio::ip::address_v4 network(record.pool_network);
+                if (!add_apn(stored_apns.back().second, gateway,
+                             ip_pool::config{boost::asio::ip::make_network_v4(network, record.pool_prefix), {}})) {
+                    unregistered_apn_slots.insert(slot);
+                }
+            } else {
+                add_apn(stored_apns.back().second, gateway);
+            }
+        }
+    });
+
+    _store = &store;
+    for (auto &[name, apn] : _apns) {
+        persist_apn(name, apn);
+    }
+    std::unordered_map<uint32_t, const apn_entry *> apns_by_slot;
+    for (const auto &[slot, name] : stored_apns) {
+        auto it = _apns.find(name);
+        if (it != _apns.end() && it->second.store_slot == slot) {
+            apns_by_slot.emplace(slot, &it->second);
+        }
+    }
+
+    reserve(_pdns.size() + store.size<session_store::pdn_record>(),
+            _bearers.size() + store.size<session_store::bearer_record>());
+
+    // Объекты получают хранилище в самом конце, чтобы восстановление не переписывало их записи
+    struct restored_pdn {
+        pdn_connection *pdn;
+        uint32_t default_bearer_dp_teid;
+    };
+    std::vector<restored_pdn> restored;
+    std::vector<uint32_t> stale;
+    // CP TEID сессий незарегистрированных APN: их bearers тоже остаются в файле
+    std::unordered_set<uint32_t> kept_cp_teids;
+
+    store.for_each<session_store::pdn_record>([&](uint32_t slot, const session_store::pdn_record &record) {
+        if (unregistered_apn_slots.contains(record.apn_slot)) {
+            kept_cp_teids.insert(record.cp_teid);
+            return;
+        }
+        const boost::asio::ip::address_v4 ue_ip(record.ue_ip);
+        auto apn = apns_by_slot.find(record.apn_slot);
+        if (apn == apns_by_slot.end() || !record.cp_teid || _pdns_by_cp_teid.find(record.cp_teid) ||
+            find_ip_pool(ue_ip) != apn->second->pool || !apn->second->pool->take(ue_ip)) {
+            stale.push_back(slot);
+            return;
+        }
+        _cp_teids.restore(record.cp_teid);
+
+        auto pdn = pdn_connection::create(object_arena::allocator<pdn_connection>(_arena), record.cp_teid,
+                                          apn->second->gateway, ue_ip);
+        pdn->set_sgw_cp_teid(record.sgw_cp_teid);
+        pdn->_apn_id = apn->second->id;
+        pdn->_store_slot = slot;
+
+        const auto handle = _pdns.insert(pdn);
+        pdn->_handle = handle;
+        attach_sgw(*pdn, find_or_add_sgw(boost::asio::ip::address_v4(record.sgw_address)));
+        _pdns_by_cp_teid.insert_or_assign(record.cp_teid, handle);
+        _pdns_by_ue_ip_addr.insert_or_assign(record.ue_ip, handle);
+        restored.push_back({pdn.get(), record.default_bearer_dp_teid});
+    });
+
+    store.for_each<session_store::bearer_record>([&](uint32_t slot, const session_store::bearer_record &record) {
+        auto *pdn = _pdns.get(_pdns_by_cp_teid.find(record.pdn_cp_teid));
+        if (!pdn && kept_cp_teids.contains(record.pdn_cp_teid)) {
+            return;
+        }
+        if (!pdn || !record.dp_teid || _bearers_by_dp_teid.find(record.dp_teid)) {
+            stale.push_back(slot);
+            return;
+        }
+        _dp_teids.restore(record.dp_teid);
+
+        auto restored_bearer =
+                std::allocate_shared<bearer>(object_arena::allocator<bearer>(_arena), record.dp_teid, *pdn);
+        restored_bearer->set_sgw_dp_teid(record.sgw_dp_teid);
+        restored_bearer->_store_slot = slot;
+        restored_bearer->_store = &store;
+        pdn->add_bearer(restored_bearer);
+
+        const auto handle = _bearers.insert(restored_bearer);
+        restored_bearer->_handle = handle;
+        _bearers_by_dp_teid.insert_or_assign(record.dp_teid, handle);
+    });
+
+    _cp_teids.finish_restore();
+    _dp_teids.finish_restore();
+
+    for (const auto &[pdn, default_bearer_dp_teid] : restored) {
+        auto *default_bearer = pdn->find_bearer(default_bearer_dp_teid);
+        if (default_bearer) {
+            pdn->set_default_bearer(default_bearer->shared_from_this());
+        }
+        pdn->_store = &store;
+        if (default_bearer_dp_teid && !default_bearer) {
+            // Default bearer не восстановился
+            pdn->persist();
+        }
+    }
+    for (auto slot : stale) {
+        store.erase(slot);
+    }
+    return restored.size();
+}
+
+std::optional<uint32_t> control_plane::find_apn_id(const std::string &apn) const {
+    auto it = _apns.find(apn);
+    if (it == _apns.end()) {
+        return std::nullopt;
+    }
+    return it->second.id;
+}
+
+ip_pool *control_plane::find_ip_pool(boost::asio::ip::address_v4 ue_ip) const {
+    // Общий пул может содержать подсети других пулов, поэтому проверяем его последним
+    ip_pool *found = nullptr;
+    for (const auto &pool : _ip_pools) {
+        if (pool->contains(ue_ip)) {
+            found = pool.get();
+            if (found != _default_ip_pool) {
+                break;
+            }
+        }
+    }
+    return found;
+}
+
+void control_plane::reserve(size_t pdn_connections, size_t bearers) {
+    _pdns.reserve(pdn_connections);
+    _pdns_by_cp_teid.reserve(pdn_connections);
+    _bearers.reserve(bearers);
+    _bearers_by_dp_teid.reserve(bearers);
+}
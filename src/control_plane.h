@@ -1,19 +1,64 @@
 #pragma once
 
+#include <flat_index.h>
+#include <ip_index.h>
+#include <ip_pool.h>
 #include <pdn_connection.h>
+#include <session_store.h>
+#include <sgw_peer.h>
+#include <slot_map.h>
+#include <teid_allocator.h>
 
 #include <boost/asio/ip/address.hpp>
 
 #include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
 
+// Поиск (find_*) можно вызывать из любого числа потоков одновременно с изменениями;
+// create_*, delete_* и add_apn должны вызываться из одного управляющего потока.
+//
+// Сессии лежат в slot_map, индексы хранят 32-битные дескрипторы с поколением. find_* возвращают
+// владеющие указатели для управляющего кода; data plane пользуется find_*_view и пакетными
+// методами, которые не трогают счетчики ссылок.
 class control_plane {
 public:
+    using pdn_handle = slot_map<pdn_connection>::handle;
+    using bearer_handle = slot_map<bearer>::handle;
+
+    // Сессия для create_sessions: PDN connection с default bearer
+    struct session_spec {
+        std::string apn;
+        boost::asio::ip::address_v4 sgw_addr;
+        uint32_t sgw_cp_teid{};
+        uint32_t sgw_dp_teid{};
+    };
+
+    struct config {
+        // CP и DP TEID выделяются с одинаковым делением на шарды; bearers PDN берут TEID
+        // из шарда его CP TEID, поэтому сессия целиком попадает в один шард
+        teid_allocator::config teids;
+    };
+
+    control_plane();
+    explicit control_plane(const config &config);
+
     std::shared_ptr<pdn_connection> find_pdn_by_cp_teid(uint32_t cp_teid) const;
 
     std::shared_ptr<pdn_connection> find_pdn_by_ip_address(const boost::asio::ip::address_v4 &ip) const;
 
     std::shared_ptr<bearer> find_bearer_by_dp_teid(uint32_t dp_teid) const;
 
+    // Для data plane: указатели не владеющие и действительны, пока вызывающий держит epoch_guard
+    [[nodiscard]] bearer *find_bearer_view(uint32_t dp_teid) const;
+    [[nodiscard]] pdn_connection *find_pdn_view_by_ip_address(const boost::asio::ip::address_v4 &ip) const;
+
+    void find_bearers_by_dp_teid(std::span<const uint32_t> dp_teids, std::span<bearer *> bearers) const;
+    void find_pdns_by_ip_address(std::span<const boost::asio::ip::address_v4> ips,
+                                 std::span<pdn_connection *> pdns) const;
+
     std::shared_ptr<pdn_connection> create_pdn_connection(const std::string &apn, boost::asio::ip::address_v4 sgw_addr,
                                                           uint32_t sgw_cp_teid);
     void delete_pdn_connection(uint32_t cp_teid);
@@ -22,11 +67,104 @@ public:
 
     void delete_bearer(uint32_t dp_teid);
 
+    // Массовые create/delete для загрузки тестовых наборов и рестарта SGW. Место в индексах
+    // резервируется сразу на весь набор; сессии идут пачками, пачка целиком берет TEID из одного
+    // шарда и адреса блоком, группы индексов пачки подгружаются в кэш заранее. Результат по
+    // порядку спецификаций; nullptr, если APN нет или не хватило адресов или TEID
+    std::vector<std::shared_ptr<pdn_connection>> create_sessions(std::span<const session_spec> specs);
+    // Удаляет PDN connections вместе с bearers; неизвестные CP TEID пропускаются
+    void delete_sessions(std::span<const uint32_t> cp_teids);
+
+    // Сессии сгруппированы по SGW peer, см. sgw_peer. Перевод одной сессии на другой SGW
+    // (Modify Bearer с новым адресом); false, если PDN нет
+    bool set_sgw_address(uint32_t cp_teid, boost::asio::ip::address_v4 sgw_addr);
+    // SGW перезапустился: удаляет все его сессии, как delete_sessions. Число удаленных
+    size_t delete_sgw_sessions(boost::asio::ip::address_v4 sgw_addr);
+    // SGW сменил адрес: его сессии переходят на новый адрес, для data plane - одной записью, если
+    // по новому адресу сессий еще нет. false, если у старого адреса сессий нет
+    bool relocate_sgw(boost::asio::ip::address_v4 from, boost::asio::ip::address_v4 to);
+    [[nodiscard]] size_t count_sgw_sessions(boost::asio::ip::address_v4 sgw_addr) const;
+
+    // Downlink TFT bearer; пустой список снимает фильтры. false, если bearer не найден или у PDN
+    // получилось бы больше tft_classifier::max_filters фильтров
+    bool set_bearer_tft(uint32_t dp_teid, std::vector<tft::packet_filter> filters);
+
+    // Адреса UE выдаются из общего пула 10.0.0.0/8 за вычетом подсетей пулов других APN
     void add_apn(std::string apn_name, boost::asio::ip::address_v4 apn_gateway);
+    // Собственный пул APN; false, если подсеть пересекается с уже заданным пулом другого APN или
+    // в ней есть адреса, уже выданные из общего пула
+    bool add_apn(std::string apn_name, boost::asio::ip::address_v4 apn_gateway, const ip_pool::config &pool);
+
+    // Плотный номер APN (0, 1, ...) для таблиц data plane, индексируемых pdn_connection::get_apn_id()
+    [[nodiscard]] std::optional<uint32_t> find_apn_id(const std::string &apn) const;
+
+    // Резервирует место в индексах, чтобы массовое создание сессий не перестраивало таблицы
+    void reserve(size_t pdn_connections, size_t bearers);
+
+    // Поднимает сессии из хранилища и дальше записывает в него все изменения APN, PDN connections
+    // и bearers. Вызывается после add_apn из конфигурации и до создания сессий; хранилище должно
+    // пережить control plane. APN из файла, которых нет в конфигурации, добавляются с сохраненными
+    // пулами; если пул пересекается с пулом из конфигурации, сессии такого APN не поднимаются и
+    // остаются в файле до следующего запуска. Записи, которые не сходятся с остальными (bearer без
+    // PDN, адрес не из пула APN, повторный TEID), удаляются. Возвращает число восстановленных PDN
+    // connections
+    size_t attach_store(session_store &store);
+    [[nodiscard]] session_store *get_session_store() const { return _store; }
 
 private:
-    std::unordered_map<uint32_t, std::shared_ptr<pdn_connection>> _pdns;
-    std::unordered_map<boost::asio::ip::address_v4, std::shared_ptr<pdn_connection>> _pdns_by_ue_ip_addr;
-    std::unordered_map<uint32_t, std::shared_ptr<bearer>> _bearers;
-    std::unordered_map<std::string, boost::asio::ip::address_v4> _apns;
+    struct apn_entry {
+        boost::asio::ip::address_v4 gateway;
+        ip_pool *pool;
+        uint32_t id;
+        uint32_t store_slot = session_store::no_slot;
+    };
+
+    // Объект с уже выделенными TEID и адресом: в slot_map, индексы и хранилище
+    std::shared_ptr<pdn_connection> insert_pdn(const apn_entry &apn, uint32_t cp_teid,
+                                               boost::asio::ip::address_v4 ue_ip,
+                                               const std::shared_ptr<sgw_peer> &sgw, uint32_t sgw_cp_teid);
+    std::shared_ptr<bearer> insert_bearer(pdn_connection &pdn, uint32_t dp_teid, uint32_t sgw_teid);
+    // Удаление по живому дескриптору. Снятые объекты копятся в retired, вызывающий передает их
+    // в epoch_domain одним retire и делает reclaim: массовое удаление - раз на пачку
+    using retired_objects = std::vector<std::shared_ptr<void>>;
+    // Пачками, как delete_sessions
+    void erase_pdns(std::span<const pdn_handle> handles);
+    void erase_pdn(pdn_handle handle, teid_allocator::clock::time_point now, retired_objects &retired);
+    void erase_bearer(bearer_handle handle, teid_allocator::clock::time_point now, retired_objects &retired);
+    // Как erase_bearer, но PDN не меняется
+    void unregister_bearer(bearer_handle handle, teid_allocator::clock::time_point now, retired_objects &retired);
+    static void retire(retired_objects &&retired);
+
+    const std::shared_ptr<sgw_peer> &find_or_add_sgw(boost::asio::ip::address_v4 sgw_addr);
+    // PDN с уже назначенным дескриптором в список сессий peer
+    void attach_sgw(pdn_connection &pdn, const std::shared_ptr<sgw_peer> &sgw);
+    // Убирает PDN из списка сессий его peer, а опустевший peer - из таблицы. Сам PDN ссылается на
+    // peer по-прежнему: его еще могут читать
+    void detach_sgw(pdn_connection &pdn);
+
+    void register_apn(std::string apn_name, boost::asio::ip::address_v4 apn_gateway, ip_pool *pool);
+    void persist_apn(const std::string &apn_name, apn_entry &apn);
+
+    ip_pool *find_ip_pool(boost::asio::ip::address_v4 ue_ip) const;
+
+    teid_allocator _cp_teids;
+    teid_allocator _dp_teids;
+    size_t _next_teid_shard{};
+
+    slot_map<pdn_connection> _pdns;
+    slot_map<bearer> _bearers;
+
+    flat_index<pdn_handle> _pdns_by_cp_teid;
+    // Адреса UE выдаются из пулов, поэтому вместо хеш-таблицы - прямая адресация по подсетям пулов
+    ip_index _pdns_by_ue_ip_addr;
+    flat_index<bearer_handle> _bearers_by_dp_teid;
+    std::unordered_map<std::string, apn_entry> _apns;
+    // SGW peers по адресу; peer без сессий удаляется
+    std::unordered_map<uint32_t, std::shared_ptr<sgw_peer>> _sgw_peers;
+    // Пулы APN не пересекаются между собой; их подсети исключены из общего пула
+    std::vector<std::unique_ptr<ip_pool>> _ip_pools;
+    ip_pool *_default_ip_pool{};
+    session_store *_store{};
+    // PDN connections и bearers вместе со счетчиками ссылок
+    std::shared_ptr<object_arena> _arena = std::make_shared<object_arena>();
 };
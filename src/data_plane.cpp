@@ -1,40 +1,369 @@
 #include <data_plane.h>
 #include <bearer.h>
+#include <epoch.h>
+#include <latency.h>
+#include <packet_pipeline.h>
 
-data_plane::data_plane(control_plane &control_plane) : _control_plane(control_plane) {}
+#include <algorithm>
 
-void data_plane::handle_uplink(uint32_t dp_teid, Packet &&packet) {
-    // Находим bearer по DP TEID
-    auto bearer = _control_plane.find_bearer_by_dp_teid(dp_teid);
-    if (!bearer) {
-        return;
+// Лимиты - police_*_burst, отклоненные пакеты - shape_*
+struct data_plane::hook_policer {
+    static constexpr bool enabled = true;
+
+    void police(policer_direction dir, std::span<bearer *const> bearers, std::span<pdn_connection *> pdns,
+                std::span<const size_t> sizes) {
+        if (dir == uplink_direction) {
+            plane.police_uplink_burst(bearers, pdns, sizes);
+        } else {
+            plane.police_downlink_burst(bearers, pdns, sizes);
+        }
     }
 
-    // Получаем PDN connection
-    auto pdn = bearer->get_pdn_connection();
-    if (!pdn) {
-        return;
+    bool reject(policer_direction dir, bearer &bearer, Packet &&packet) {
+        return dir == uplink_direction ? plane.shape_uplink(bearer, std::move(packet))
+                                       : plane.shape_downlink(bearer, std::move(packet));
+    }
+
+    // Очереди шейпинга хранят Packet, как и в поштучном пути буферов
+    bool reject(policer_direction dir, bearer &bearer, packet_buffer &&packet) {
+        return reject(dir, bearer, Packet(packet.data(), packet.data() + packet.size()));
+    }
+
+    data_plane &plane;
+};
+
+// Группирует пакеты куска burst'а по адресу пересылки, сохраняя порядок внутри группы, и отдает
+// группы в forward_burst_to_*
+struct data_plane::hook_sink {
+    template<class Entry>
+    struct group {
+        boost::asio::ip::address_v4 peer;
+        std::vector<Entry> packets;
+    };
+
+    template<class Entry>
+    struct groups {
+        std::vector<group<Entry>> list;
+        size_t used = 0;
+        size_t last = 0;
+
+        std::vector<Entry> &find(boost::asio::ip::address_v4 peer) {
+            if (used == 0 || list[last].peer != peer) {
+                last = 0;
+                while (last < used && list[last].peer != peer) {
+                    ++last;
+                }
+                if (last == used) {
+                    if (used == list.size()) {
+                        list.emplace_back();
+                    }
+                    list[last].peer = peer;
+                    ++used;
+                }
+            }
+            return list[last].packets;
+        }
+    };
+
+    void forward_to_apn(boost::asio::ip::address_v4 apn_gateway, Packet &&packet) {
+        apns.find(apn_gateway).emplace_back(std::move(packet));
+    }
+
+    void forward_to_sgw(boost::asio::ip::address_v4 sgw_addr, uint32_t sgw_dp_teid, Packet &&packet) {
+        sgws.find(sgw_addr).push_back({sgw_dp_teid, std::move(packet)});
+    }
+
+    // Буферы не группируются: их сразу берут forward_buffer_to_apn и send_gtpu, как в
+    // handle_gtpu_datagram и handle_ip_packet
+    void forward_to_apn(boost::asio::ip::address_v4 apn_gateway, packet_buffer &&packet) {
+        plane.forward_buffer_to_apn(apn_gateway, std::move(packet));
+    }
+
+    void forward_to_sgw(boost::asio::ip::address_v4 sgw_addr, uint32_t sgw_dp_teid, packet_buffer &&packet) {
+        if (gtpu::encapsulate(packet, {plane._gtpu_address, sgw_addr, sgw_dp_teid})) {
+            plane.send_gtpu(sgw_addr, std::move(packet));
+        }
+    }
+
+    void flush() {
+        for (size_t g = 0; g < apns.used; ++g) {
+            plane.forward_burst_to_apn(apns.list[g].peer, apns.list[g].packets);
+            apns.list[g].packets.clear();
+        }
+        apns.used = 0;
+        for (size_t g = 0; g < sgws.used; ++g) {
+            plane.forward_burst_to_sgw(sgws.list[g].peer, sgws.list[g].packets);
+            sgws.list[g].packets.clear();
+        }
+        sgws.used = 0;
+    }
+
+    data_plane &plane;
+    groups<Packet> apns{};
+    groups<sgw_packet> sgws{};
+};
+
+struct data_plane::burst_pipeline : packet_pipeline<session_lookup, hook_policer, hook_sink> {
+    using packet_pipeline::packet_pipeline;
+};
+
+data_plane::data_plane(control_plane &control_plane)
+    : _control_plane(control_plane),
+      _pipeline(std::make_unique<burst_pipeline>(session_lookup(control_plane), hook_policer{*this},
+                                                 hook_sink{*this}, _counters)) {}
+
+data_plane::~data_plane() = default;
+
+void data_plane::handle_uplink(uint32_t dp_teid, Packet &&packet) {
+    latency::scope timing(latency::uplink);
+    boost::asio::ip::address_v4 apn_gw;
+    {
+        // Сессия не освободится, пока держим guard; счетчики ссылок не трогаем
+        epoch_guard guard;
+
+        // Находим bearer по DP TEID
+        auto *found = _control_plane.find_bearer_view(dp_teid);
+        if (!found) {
+            _counters.count_drop(traffic_counters::no_session);
+            return;
+        }
+
+        // Получаем PDN connection и проверяем лимиты
+        bearer *bearers[1]{found};
+        pdn_connection *pdns[1]{&found->get_pdn_view()};
+        const size_t sizes[1]{packet.size()};
+        police_uplink_burst(bearers, pdns, sizes);
+        if (!pdns[0]) {
+            if (!shape_uplink(*found, std::move(packet))) {
+                _counters.count_drop(traffic_counters::policed);
+            }
+            return;
+        }
+        _counters.count_uplink(*found, *pdns[0], packet.size());
+        apn_gw = pdns[0]->get_apn_gw();
     }
 
     // Пересылаем пакет на APN Gateway
-    forward_packet_to_apn(pdn->get_apn_gw(), std::move(packet));
+    forward_packet_to_apn(apn_gw, std::move(packet));
 }
 
 void data_plane::handle_downlink(const boost::asio::ip::address_v4 &ue_ip, Packet &&packet) {
-    // Находим PDN connection по IP адресу
-    auto pdn = _control_plane.find_pdn_by_ip_address(ue_ip);
-    if (!pdn) {
-        return;
+    latency::scope timing(latency::downlink);
+    boost::asio::ip::address_v4 sgw_addr;
+    uint32_t sgw_dp_teid;
+    {
+        epoch_guard guard;
+
+        // Находим PDN connection по IP адресу
+        auto *pdn = _control_plane.find_pdn_view_by_ip_address(ue_ip);
+        if (!pdn) {
+            _counters.count_drop(traffic_counters::no_session);
+            return;
+        }
+
+        // Получаем bearer для downlink трафика
+        auto *found = pdn->find_downlink_bearer_view(tft::downlink_key(packet));
+        if (!found) {
+            _counters.count_drop(traffic_counters::no_bearer);
+            return;
+        }
+
+        bearer *bearers[1]{found};
+        pdn_connection *pdns[1]{pdn};
+        const size_t sizes[1]{packet.size()};
+        police_downlink_burst(bearers, pdns, sizes);
+        if (!pdns[0]) {
+            if (!shape_downlink(*found, std::move(packet))) {
+                _counters.count_drop(traffic_counters::policed);
+            }
+            return;
+        }
+        _counters.count_downlink(*found, *pdn, packet.size());
+        sgw_addr = pdn->get_sgw_address();
+        sgw_dp_teid = found->get_sgw_dp_teid();
+    }
+
+    // Пересылаем пакет на SGW через default bearer
+    forward_packet_to_sgw(sgw_addr, sgw_dp_teid, std::move(packet));
+}
+
+void data_plane::handle_uplink_burst(std::span<uplink_packet> burst) { _pipeline->handle_uplink_burst(burst); }
+
+void data_plane::handle_downlink_burst(std::span<downlink_packet> burst) { _pipeline->handle_downlink_burst(burst); }
+
+void data_plane::forward_burst_to_sgw(boost::asio::ip::address_v4 sgw_addr, std::span<sgw_packet> packets) {
+    for (auto &packet : packets) {
+        forward_packet_to_sgw(sgw_addr, packet.sgw_dp_teid, std::move(packet.packet));
+    }
+}
+
+void data_plane::forward_burst_to_apn(boost::asio::ip::address_v4 apn_gateway, std::span<Packet> packets) {
+    for (auto &packet : packets) {
+        forward_packet_to_apn(apn_gateway, std::move(packet));
+    }
+}
+
+void data_plane::handle_uplink_buffer(uint32_t dp_teid, packet_buffer &&packet) {
+    latency::scope timing(latency::uplink);
+    boost::asio::ip::address_v4 apn_gw;
+    {
+        epoch_guard guard;
+
+        auto *found = _control_plane.find_bearer_view(dp_teid);
+        if (!found) {
+            _counters.count_drop(traffic_counters::no_session);
+            return;
+        }
+
+        bearer *bearers[1]{found};
+        pdn_connection *pdns[1]{&found->get_pdn_view()};
+        const size_t sizes[1]{packet.size()};
+        police_uplink_burst(bearers, pdns, sizes);
+        if (!pdns[0]) {
+            if (!shape_uplink(*found, Packet(packet.data(), packet.data() + packet.size()))) {
+                _counters.count_drop(traffic_counters::policed);
+            }
+            return;
+        }
+        _counters.count_uplink(*found, *pdns[0], packet.size());
+        apn_gw = pdns[0]->get_apn_gw();
+    }
+
+    forward_buffer_to_apn(apn_gw, std::move(packet));
+}
+
+void data_plane::handle_downlink_buffer(const boost::asio::ip::address_v4 &ue_ip, packet_buffer &&packet) {
+    latency::scope timing(latency::downlink);
+    boost::asio::ip::address_v4 sgw_addr;
+    uint32_t sgw_dp_teid;
+    if (admit_downlink(ue_ip, packet, sgw_addr, sgw_dp_teid)) {
+        forward_buffer_to_sgw(sgw_addr, sgw_dp_teid, std::move(packet));
+    }
+}
+
+void data_plane::set_gtpu_address(boost::asio::ip::address_v4 local) { _gtpu_address = local; }
+
+void data_plane::handle_gtpu_datagram(packet_buffer &&datagram) {
+    if (const auto dp_teid = accept_gtpu(datagram)) {
+        handle_uplink_buffer(*dp_teid, std::move(datagram));
+    }
+}
+
+void data_plane::handle_gtpu_burst(std::span<packet_buffer> datagrams) {
+    for (auto &datagram : datagrams) {
+        if (const auto dp_teid = accept_gtpu(datagram)) {
+            _uplink_buffers.push_back({*dp_teid, std::move(datagram)});
+        }
+    }
+    _pipeline->handle_uplink_burst(_uplink_buffers);
+    // Отброшенные конвейером буферы остались здесь и возвращаются в пул
+    _uplink_buffers.clear();
+}
+
+void data_plane::handle_ip_burst(std::span<packet_buffer> packets) {
+    for (auto &packet : packets) {
+        if (const auto ue_ip = gtpu::destination(packet.bytes())) {
+            _downlink_buffers.push_back({*ue_ip, std::move(packet)});
+        } else {
+            _counters.count_drop(traffic_counters::malformed);
+        }
+    }
+    _pipeline->handle_downlink_burst(_downlink_buffers);
+    _downlink_buffers.clear();
+}
+
+std::optional<uint32_t> data_plane::accept_gtpu(packet_buffer &datagram) {
+    const auto header = gtpu::parse(datagram.bytes());
+    if (!header) {
+        _counters.count_drop(traffic_counters::malformed);
+        return std::nullopt;
+    }
+
+    switch (header->type) {
+        case gtpu::g_pdu:
+            if (gtpu::decapsulate(datagram, *header)) {
+                return header->teid;
+            }
+            break;
+        case gtpu::echo_request:
+            if (gtpu::make_echo_response(datagram, *header, _gtpu_address)) {
+                send_gtpu(header->peer, std::move(datagram));
+            }
+            break;
+        default:
+            // End Marker, Error Indication и ответы на Echo data plane не обрабатывает
+            break;
     }
+    return std::nullopt;
+}
 
-    // Получаем default bearer для downlink трафика
-    auto default_bearer = pdn->get_default_bearer();
-    if (!default_bearer) {
+void data_plane::handle_ip_packet(packet_buffer &&packet) {
+    const auto ue_ip = gtpu::destination(packet.bytes());
+    if (!ue_ip) {
+        _counters.count_drop(traffic_counters::malformed);
         return;
     }
 
-    // Пересылаем пакет на SGW через default bearer
-    forward_packet_to_sgw(pdn->get_sgw_address(),
-                         default_bearer->get_sgw_dp_teid(),
-                         std::move(packet));
-}
\ No newline at end of file
+    boost::asio::ip::address_v4 sgw_addr;
+    uint32_t sgw_dp_teid;
+    if (admit_downlink(*ue_ip, packet, sgw_addr, sgw_dp_teid) &&
+        gtpu::encapsulate(packet, {_gtpu_address, sgw_addr, sgw_dp_teid})) {
+        send_gtpu(sgw_addr, std::move(packet));
+    }
+}
+
+bool data_plane::admit_downlink(const boost::asio::ip::address_v4 &ue_ip, const packet_buffer &packet,
+                                boost::asio::ip::address_v4 &sgw_addr, uint32_t &sgw_dp_teid) {
+    epoch_guard guard;
+
+    auto *pdn = _control_plane.find_pdn_view_by_ip_address(ue_ip);
+    if (!pdn) {
+        _counters.count_drop(traffic_counters::no_session);
+        return false;
+    }
+
+    auto *found = pdn->find_downlink_bearer_view(tft::downlink_key(packet.bytes()));
+    if (!found) {
+        _counters.count_drop(traffic_counters::no_bearer);
+        return false;
+    }
+
+    bearer *bearers[1]{found};
+    pdn_connection *pdns[1]{pdn};
+    const size_t sizes[1]{packet.size()};
+    police_downlink_burst(bearers, pdns, sizes);
+    if (!pdns[0]) {
+        if (!shape_downlink(*found, Packet(packet.data(), packet.data() + packet.size()))) {
+            _counters.count_drop(traffic_counters::policed);
+        }
+        return false;
+    }
+    _counters.count_downlink(*found, *pdn, packet.size());
+    sgw_addr = pdn->get_sgw_address();
+    sgw_dp_teid = found->get_sgw_dp_teid();
+    return true;
+}
+
+void data_plane::forward_buffer_to_sgw(boost::asio::ip::address_v4 sgw_addr, uint32_t sgw_dp_teid,
+                                       packet_buffer &&packet) {
+    auto buffer = std::move(packet);
+    forward_packet_to_sgw(sgw_addr, sgw_dp_teid, Packet(buffer.data(), buffer.data() + buffer.size()));
+}
+
+void data_plane::forward_buffer_to_apn(boost::asio::ip::address_v4 apn_gateway, packet_buffer &&packet) {
+    auto buffer = std::move(packet);
+    forward_packet_to_apn(apn_gateway, Packet(buffer.data(), buffer.data() + buffer.size()));
+}
+
+void data_plane::poll() {}
+
+bool data_plane::shape_uplink(bearer &, Packet &&) { return false; }
+
+bool data_plane::shape_downlink(bearer &, Packet &&) { return false; }
+
+void data_plane::send_gtpu(boost::asio::ip::address_v4, packet_buffer &&) {}
+
+void data_plane::police_uplink_burst(std::span<bearer *const>, std::span<pdn_connection *>, std::span<const size_t>) {}
+
+void data_plane::police_downlink_burst(std::span<bearer *const>, std::span<pdn_connection *>,
+                                       std::span<const size_t>) {}
@@ -1,25 +1,137 @@
 #pragma once
 
 #include <control_plane.h>
+#include <gtpu.h>
+#include <packet_buffer.h>
+#include <traffic_counters.h>
 
 #include <boost/asio/ip/address.hpp>
 
 #include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
 #include <vector>
 
 class data_plane {
 public:
     using Packet = std::vector<uint8_t>;
 
+    struct uplink_packet {
+        uint32_t dp_teid;
+        Packet packet;
+    };
+
+    struct downlink_packet {
+        boost::asio::ip::address_v4 ue_ip;
+        Packet packet;
+    };
+
+    struct sgw_packet {
+        uint32_t sgw_dp_teid;
+        Packet packet;
+    };
+
+    // Burst'ы пути без копирования
+    struct uplink_buffer {
+        uint32_t dp_teid;
+        packet_buffer packet;
+    };
+
+    struct downlink_buffer {
+        boost::asio::ip::address_v4 ue_ip;
+        packet_buffer packet;
+    };
+
+    static constexpr size_t max_burst_size = 256;
+
     explicit data_plane(control_plane &control_plane);
-    virtual ~data_plane() = default;
+    virtual ~data_plane();
 
     virtual void handle_uplink(uint32_t dp_teid, Packet &&packet);
     virtual void handle_downlink(const boost::asio::ip::address_v4 &ue_ip, Packet &&packet);
 
+    // Пакеты из burst перемещаются; порядок сохраняется внутри каждого направления пересылки.
+    // Burst проходит packet_pipeline, политики которого зовут police_*_burst, shape_* и
+    // forward_burst_to_*
+    void handle_uplink_burst(std::span<uplink_packet> burst);
+    void handle_downlink_burst(std::span<downlink_packet> burst);
+
+    // Путь без копирования: буфер из packet_pool доходит до forward_buffer_to_* как есть
+    void handle_uplink_buffer(uint32_t dp_teid, packet_buffer &&packet);
+    void handle_downlink_buffer(const boost::asio::ip::address_v4 &ue_ip, packet_buffer &&packet);
+
+    // GTP-U на S5/S8-U. Адрес - источник внешних заголовков downlink и ответов на Echo
+    void set_gtpu_address(boost::asio::ip::address_v4 local);
+
+    // Датаграмма от SGW с внешними IPv4/UDP. Внутренний пакет G-PDU идет в handle_uplink_buffer
+    // без копирования, на Echo Request отвечаем через send_gtpu, остальное отбрасывается
+    void handle_gtpu_datagram(packet_buffer &&datagram);
+    // IP пакет из SGi: сессия ищется по адресу назначения, заголовки GTP-U/UDP/IPv4 к SGW
+    // дописываются в headroom, датаграмма уходит в send_gtpu
+    void handle_ip_packet(packet_buffer &&packet);
+
+    // То же для пачки, например принятой одним recvmmsg: G-PDU и IP пакеты проходят
+    // packet_pipeline одним burst'ом, с одним epoch_guard, поиском и policing на кусок.
+    // Принятые буферы забираются из span, отброшенные при разборе остаются в нем
+    void handle_gtpu_burst(std::span<packet_buffer> datagrams);
+    void handle_ip_burst(std::span<packet_buffer> packets);
+
+    // Счетчики этого data plane; читать можно из любого потока
+    [[nodiscard]] const traffic_counters &get_counters() const { return _counters; }
+
+    // Отложенная работа (например, выпуск пакетов из очередей шейпинга); владелец вызывает
+    // периодически из того же потока, что и handle_*
+    virtual void poll();
+
 protected:
     virtual void forward_packet_to_sgw(boost::asio::ip::address_v4 sgw_addr, uint32_t sgw_dp_teid, Packet &&packet) = 0;
     virtual void forward_packet_to_apn(boost::asio::ip::address_v4 apn_gateway, Packet &&packet) = 0;
 
+    // По умолчанию разворачиваются в вызовы forward_packet_to_*
+    virtual void forward_burst_to_sgw(boost::asio::ip::address_v4 sgw_addr, std::span<sgw_packet> packets);
+    virtual void forward_burst_to_apn(boost::asio::ip::address_v4 apn_gateway, std::span<Packet> packets);
+
+    // Адаптеры к forward_packet_to_*: копируют данные в Packet и освобождают буфер
+    virtual void forward_buffer_to_sgw(boost::asio::ip::address_v4 sgw_addr, uint32_t sgw_dp_teid,
+                                       packet_buffer &&packet);
+    virtual void forward_buffer_to_apn(boost::asio::ip::address_v4 apn_gateway, packet_buffer &&packet);
+
+    // Готовая GTP-U датаграмма с внешними заголовками; по умолчанию отбрасывается
+    virtual void send_gtpu(boost::asio::ip::address_v4 peer, packet_buffer &&datagram);
+
+    // Вызываются один раз на burst после поиска сессий; пакет отбрасывается обнулением pdns[i].
+    // bearers[i] - bearer пакета: найденный по DP TEID для uplink, выбранный TFT для downlink
+    virtual void police_uplink_burst(std::span<bearer *const> bearers, std::span<pdn_connection *> pdns,
+                                     std::span<const size_t> sizes);
+    virtual void police_downlink_burst(std::span<bearer *const> bearers, std::span<pdn_connection *> pdns,
+                                       std::span<const size_t> sizes);
+
+    // Получают пакеты, отклоненные police_*; false - пакет отброшен и учитывается в
+    // drops(policed). По умолчанию пакет отбрасывается
+    virtual bool shape_uplink(bearer &bearer, Packet &&packet);
+    virtual bool shape_downlink(bearer &bearer, Packet &&packet);
+
     control_plane &_control_plane;
+    // Пишет только поток data plane
+    traffic_counters _counters;
+
+private:
+    // Политики packet_pipeline над виртуальными хуками; определены в data_plane.cpp
+    struct hook_policer;
+    struct hook_sink;
+    struct burst_pipeline;
+
+    // Поиск сессии и policing одного downlink пакета; false, если пакет отброшен или отдан в шейпинг
+    bool admit_downlink(const boost::asio::ip::address_v4 &ue_ip, const packet_buffer &packet,
+                        boost::asio::ip::address_v4 &sgw_addr, uint32_t &sgw_dp_teid);
+    // Разбирает датаграмму GTP-U и отвечает на Echo; DP TEID, если это G-PDU и внутренний пакет
+    // остался в буфере
+    std::optional<uint32_t> accept_gtpu(packet_buffer &datagram);
+
+    std::unique_ptr<burst_pipeline> _pipeline;
+    boost::asio::ip::address_v4 _gtpu_address;
+    // Пачки handle_gtpu_burst и handle_ip_burst после разбора
+    std::vector<uplink_buffer> _uplink_buffers;
+    std::vector<downlink_buffer> _downlink_buffers;
 };
@@ -0,0 +1,147 @@
+#include <epoch.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+// Регистрации потока во всех доменах, в которые он заходил. Освобождаются при завершении потока.
+struct epoch_thread_registration {
+    std::vector<std::pair<epoch_domain *, size_t>> records;
+    epoch_domain *cached_domain{};
+    epoch_domain::thread_record *cached_record{};
+
+    ~epoch_thread_registration() {
+        for (auto [domain, index] : records) {
+            domain->release_record(index);
+        }
+    }
+};
+
+namespace {
+    thread_local epoch_thread_registration registration;
+}
+
+epoch_domain &epoch_domain::global() {
+    static epoch_domain domain;
+    return domain;
+}
+
+epoch_domain::~epoch_domain() {
+    // Читателей больше нет, освобождаем все без ожидания
+    for (auto &retired : _retired) {
+        retired.deleter(retired.object);
+    }
+}
+
+void epoch_domain::enter() {
+    auto &record = current_record();
+    if (record.nesting++ == 0) {
+        record.epoch.store(_epoch.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+}
+
+void epoch_domain::leave() {
+    auto &record = current_record();
+    if (--record.nesting == 0) {
+        record.epoch.store(inactive, std::memory_order_release);
+    }
+}
+
+void epoch_domain::retire(void *object, void (*deleter)(void *)) {
+    std::lock_guard lock(_retired_mutex);
+    _retired.push_back({_epoch.load(std::memory_order_seq_cst), object, deleter});
+}
+
+void epoch_domain::reclaim() {
+    auto epoch = _epoch.load(std::memory_order_seq_cst);
+    if (try_advance(epoch)) {
+        ++epoch;
+    }
+
+    // Объекты, снятые в эпоху e, недоступны читателям начиная с эпохи e + 2
+    std::vector<retired_object> ready;
+    {
+        std::lock_guard lock(_retired_mutex);
+        auto it = std::partition(_retired.begin(), _retired.end(),
+                                 [epoch](const retired_object &r) { return r.epoch + 2 > epoch; });
+        ready.assign(it, _retired.end());
+        _retired.erase(it, _retired.end());
+    }
+
+    for (auto &retired : ready) {
+        retired.deleter(retired.object);
+    }
+}
+
+void epoch_domain::synchronize() {
+    const auto target = _epoch.load(std::memory_order_seq_cst) + 2;
+    while (true) {
+        reclaim();
+        if (_epoch.load(std::memory_order_seq_cst) >= target) {
+            reclaim();
+            return;
+        }
+        std::this_thread::yield();
+    }
+}
+
+size_t epoch_domain::pending() const {
+    std::lock_guard lock(_retired_mutex);
+    return _retired.size();
+}
+
+epoch_domain::thread_record &epoch_domain::current_record() {
+    if (registration.cached_domain == this) {
+        return *registration.cached_record;
+    }
+
+    auto it = std::find_if(registration.records.begin(), registration.records.end(),
+                           [this](const auto &r) { return r.first == this; });
+    size_t index;
+    if (it != registration.records.end()) {
+        index = it->second;
+    } else {
+        index = acquire_record();
+        registration.records.emplace_back(this, index);
+    }
+
+    registration.cached_domain = this;
+    registration.cached_record = &_records[index];
+    return _records[index];
+}
+
+size_t epoch_domain::acquire_record() {
+    for (size_t i = 0; i < max_threads; ++i) {
+        bool expected = false;
+        if (_records[i].in_use.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+            auto used = _records_used.load(std::memory_order_relaxed);
+            while (used < i + 1 && !_records_used.compare_exchange_weak(used, i + 1, std::memory_order_acq_rel)) {
+            }
+            return i;
+        }
+    }
+    throw std::runtime_error("epoch_domain: too many threads");
+}
+
+void epoch_domain::release_record(size_t index) {
+    _records[index].nesting = 0;
+    _records[index].epoch.store(inactive, std::memory_order_release);
+    _records[index].in_use.store(false, std::memory_order_release);
+}
+
+bool epoch_domain::try_advance(uint64_t epoch) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    // Эпоху можно сдвинуть, только если все активные читатели уже в текущей
+    const auto used = _records_used.load(std::memory_order_acquire);
+    for (size_t i = 0; i < used; ++i) {
+        auto observed = _records[i].epoch.load(std::memory_order_relaxed);
+        if (observed != inactive && observed != epoch) {
+            return false;
+        }
+    }
+
+    return _epoch.compare_exchange_strong(epoch, epoch + 1, std::memory_order_seq_cst);
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Epoch-based reclamation. Читатели заходят в критическую секцию через epoch_guard и
+// обращаются к разделяемым объектам без блокировок; писатель снимает объект из индексов и
+// передает его в retire(). Объект освобождается, когда все потоки, которые могли его видеть,
+// вышли из своих критических секций.
+class epoch_domain {
+public:
+    static constexpr size_t max_threads = 256;
+
+    static epoch_domain &global();
+
+    epoch_domain() = default;
+    ~epoch_domain();
+
+    epoch_domain(const epoch_domain &) = delete;
+    epoch_domain &operator=(const epoch_domain &) = delete;
+
+    void enter();
+    void leave();
+
+    void retire(void *object, void (*deleter)(void *));
+
+    template<class T>
+    void retire(std::shared_ptr<T> object) {
+        if (object) {
+            retire(new std::shared_ptr<T>(std::move(object)),
+                   [](void *p) { delete static_cast<std::shared_ptr<T> *>(p); });
+        }
+    }
+
+    template<class T>
+    void retire(std::unique_ptr<T> object) {
+        if (object) {
+            retire(object.release(), [](void *p) { delete static_cast<T *>(p); });
+        }
+    }
+
+    // Пытается сдвинуть эпоху и освобождает то, что уже никто не может читать
+    void reclaim();
+
+    // Ждет освобождения всего, что было передано в retire() до вызова
+    void synchronize();
+
+    [[nodiscard]] size_t pending() const;
+
+private:
+    static constexpr uint64_t inactive = UINT64_MAX;
+
+    struct alignas(64) thread_record {
+        std::atomic<uint64_t> epoch{inactive};
+        std::atomic<bool> in_use{false};
+        uint32_t nesting{};
+    };
+
+    struct retired_object {
+        uint64_t epoch;
+        void *object;
+        void (*deleter)(void *);
+    };
+
+    thread_record &current_record();
+    size_t acquire_record();
+    void release_record(size_t index);
+    bool try_advance(uint64_t epoch);
+
+    std::atomic<uint64_t> _epoch{1};
+    std::atomic<size_t> _records_used{0};
+    thread_record _records[max_threads];
+
+    mutable std::mutex _retired_mutex;
+    std::vector<retired_object> _retired;
+
+    friend struct epoch_thread_registration;
+};
+
+class epoch_guard {
+public:
+    explicit epoch_guard(epoch_domain &domain = epoch_domain::global()) : _domain(domain) { _domain.enter(); }
+    ~epoch_guard() { _domain.leave(); }
+
+    epoch_guard(const epoch_guard &) = delete;
+    epoch_guard &operator=(const epoch_guard &) = delete;
+
+private:
+    epoch_domain &_domain;
+};
@@ -0,0 +1,303 @@
+#pragma once
+
+#include <epoch.h>
+#include <huge_pages.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Плоская хеш-таблица uint32 -> V в стиле Swiss table для одного писателя и многих читателей.
+//
+// Слоты сгруппированы по 16: 16 управляющих байт, затем 16 ключей и 16 значений. Управляющий
+// байт хранит 7 бит хеша занятого слота, empty или deleted, поэтому поиск сравнивает всю группу
+// одной SIMD-инструкцией и читает ключ только у совпавших слотов. Обычно это одна-две кэш-линии
+// на поиск при любом размере таблицы.
+//
+// find() не блокируется и не пишет в общую память; вызывать его нужно внутри epoch_guard.
+// Писатель публикует слот записью управляющих байт с release. Удаленные слоты помечаются
+// deleted и до перестроения достаются только тому же ключу, поэтому слот никогда не меняет ключ
+// на глазах у читателя. Перестроенная таблица публикуется атомарно, старая освобождается через epoch_domain.
+template<class V>
+class flat_index {
+    static_assert(std::is_trivially_copyable_v<V> && sizeof(V) <= 8);
+
+public:
+    explicit flat_index(size_t capacity = 0) : _table(new table(groups_for(capacity))) {}
+
+    ~flat_index() { delete _table.load(std::memory_order_relaxed); }
+
+    flat_index(const flat_index &) = delete;
+    flat_index &operator=(const flat_index &) = delete;
+
+    // V{}, если ключа нет
+    [[nodiscard]] V find(uint32_t key) const {
+        const auto *t = _table.load(std::memory_order_acquire);
+        const auto h = hash(key);
+        const auto tag = static_cast<uint8_t>(h & 0x7f);
+        size_t g = (h >> 7) & t->group_mask;
+        for (size_t step = 1;; g = (g + step++) & t->group_mask) {
+            const auto &grp = t->groups[g];
+            const auto ctrl = grp.load_ctrl();
+            for (auto match = match_byte(ctrl, tag); match; match &= match - 1) {
+                const auto i = std::countr_zero(match);
+                if (grp.keys[i].load(std::memory_order_relaxed) == key) {
+                    return grp.values[i].load(std::memory_order_acquire);
+                }
+            }
+            if (match_byte(ctrl, ctrl_empty)) {
+                return V{};
+            }
+        }
+    }
+
+    // Подгружает в кэш первую группу ключа перед пакетным поиском или вставкой: управляющие байты,
+    // ключи и значения группы лежат в разных кэш-линиях
+    void prefetch(uint32_t key) const {
+        const auto *t = _table.load(std::memory_order_acquire);
+        const auto *bytes = reinterpret_cast<const char *>(&t->groups[(hash(key) >> 7) & t->group_mask]);
+        for (size_t offset = 0; offset < sizeof(group); offset += 64) {
+            __builtin_prefetch(bytes + offset);
+        }
+    }
+
+    // Дальше - только для писателя
+
+    void insert_or_assign(uint32_t key, V value) {
+        auto *t = _table.load(std::memory_order_relaxed);
+        const auto h = hash(key);
+        const auto tag = static_cast<uint8_t>(h & 0x7f);
+        size_t g = (h >> 7) & t->group_mask;
+        group *reused = nullptr;
+        size_t reused_slot = 0;
+        for (size_t step = 1;; g = (g + step++) & t->group_mask) {
+            auto &grp = t->groups[g];
+            const auto ctrl = grp.load_ctrl();
+            for (auto match = match_byte(ctrl, tag); match; match &= match - 1) {
+                const auto i = std::countr_zero(match);
+                if (grp.keys[i].load(std::memory_order_relaxed) == key) {
+                    grp.values[i].store(value, std::memory_order_release);
+                    return;
+                }
+            }
+            for (auto match = reused ? 0 : match_byte(ctrl, ctrl_deleted); match; match &= match - 1) {
+                const auto i = std::countr_zero(match);
+                if (grp.keys[i].load(std::memory_order_relaxed) == key) {
+                    reused = &grp;
+                    reused_slot = i;
+                    break;
+                }
+            }
+            if (auto empty = match_byte(ctrl, ctrl_empty)) {
+                if (reused) {
+                    // Слот с тем же ключом: иначе ключ, который удаляют и вставляют снова (адрес UE
+                    // из пула), с каждым разом уходил бы дальше по цепочке проб до перестроения
+                    reused->values[reused_slot].store(value, std::memory_order_relaxed);
+                    reused->store_ctrl_byte(reused_slot, tag);
+                    ++_size;
+                    return;
+                }
+                if ((t->used + 1) * 8 > t->capacity() * 7) {
+                    // Живых ключей больше половины - таблица растет вдвое. Иначе слоты заняты
+                    // deleted, и перестроение того же размера их вычищает: до следующего остается
+                    // не меньше 3/8 емкости вставок, а не одна, как при росте ровно под _size
+                    const auto groups = t->group_mask + 1;
+                    rebuild(_size * 2 > t->capacity() ? groups * 2 : groups);
+                    insert_or_assign(key, value);
+                    return;
+                }
+
+                // Ключ и значение публикуются вместе с управляющим байтом
+                const auto i = std::countr_zero(empty);
+                grp.keys[i].store(key, std::memory_order_relaxed);
+                grp.values[i].store(value, std::memory_order_relaxed);
+                grp.store_ctrl_byte(i, tag);
+                ++t->used;
+                ++_size;
+                return;
+            }
+        }
+    }
+
+    bool erase(uint32_t key) {
+        auto *t = _table.load(std::memory_order_relaxed);
+        const auto h = hash(key);
+        const auto tag = static_cast<uint8_t>(h & 0x7f);
+        size_t g = (h >> 7) & t->group_mask;
+        for (size_t step = 1;; g = (g + step++) & t->group_mask) {
+            auto &grp = t->groups[g];
+            const auto ctrl = grp.load_ctrl();
+            for (auto match = match_byte(ctrl, tag); match; match &= match - 1) {
+                const auto i = std::countr_zero(match);
+                if (grp.keys[i].load(std::memory_order_relaxed) == key) {
+                    grp.store_ctrl_byte(i, ctrl_deleted);
+                    --_size;
+                    return true;
+                }
+            }
+            if (match_byte(ctrl, ctrl_empty)) {
+                return false;
+            }
+        }
+    }
+
+    // Заранее выделяет место под capacity ключей, чтобы вставки не перестраивали таблицу
+    void reserve(size_t capacity) {
+        if (groups_for(capacity) > _table.load(std::memory_order_relaxed)->group_mask + 1) {
+            rebuild(groups_for(capacity));
+        }
+    }
+
+    [[nodiscard]] size_t size() const { return _size; }
+    [[nodiscard]] size_t capacity() const { return _table.load(std::memory_order_relaxed)->capacity(); }
+
+private:
+    static constexpr size_t group_size = 16;
+    static constexpr uint8_t ctrl_empty = 0x80;
+    static constexpr uint8_t ctrl_deleted = 0xfe;
+
+    struct alignas(64) group {
+        std::atomic<uint64_t> ctrl[2];
+        std::atomic<uint32_t> keys[group_size];
+        std::atomic<V> values[group_size];
+
+        group() {
+            ctrl[0].store(0x8080808080808080ull, std::memory_order_relaxed);
+            ctrl[1].store(0x8080808080808080ull, std::memory_order_relaxed);
+            for (size_t i = 0; i < group_size; ++i) {
+                keys[i].store(0, std::memory_order_relaxed);
+                values[i].store(V{}, std::memory_order_relaxed);
+            }
+        }
+
+        struct ctrl_bytes {
+            uint64_t lo;
+            uint64_t hi;
+        };
+
+        [[nodiscard]] ctrl_bytes load_ctrl() const {
+            return {ctrl[0].load(std::memory_order_acquire), ctrl[1].load(std::memory_order_acquire)};
+        }
+
+        void store_ctrl_byte(size_t i, uint8_t value) {
+            auto &word = ctrl[i / 8];
+            const auto shift = (i % 8) * 8;
+            auto bits = word.load(std::memory_order_relaxed);
+            bits = (bits & ~(0xffull << shift)) | (static_cast<uint64_t>(value) << shift);
+            word.store(bits, std::memory_order_release);
+        }
+    };
+
+    // Таблицы от 2 МБ лежат в huge pages: случайный поиск по миллионам ключей иначе упирается
+    // в промахи TLB, а заполнение при reserve - в страничные отказы
+    struct table {
+        explicit table(size_t groups) : group_mask(groups - 1) {
+            const auto bytes = groups * sizeof(group);
+            void *memory = bytes >= huge_pages::page_size ? huge_pages::map(bytes) : nullptr;
+            huge = memory != nullptr;
+            if (!huge) {
+                memory = ::operator new(bytes, std::align_val_t{alignof(group)});
+            }
+            this->groups = static_cast<group *>(memory);
+            std::uninitialized_default_construct_n(this->groups, groups);
+        }
+
+        ~table() {
+            std::destroy_n(groups, group_mask + 1);
+            if (huge) {
+                huge_pages::unmap(groups, (group_mask + 1) * sizeof(group));
+            } else {
+                ::operator delete(groups, std::align_val_t{alignof(group)});
+            }
+        }
+
+        table(const table &) = delete;
+        table &operator=(const table &) = delete;
+
+        [[nodiscard]] size_t capacity() const { return (group_mask + 1) * group_size; }
+
+        size_t group_mask;
+        size_t used{};
+        group *groups;
+        bool huge;
+    };
+
+    using ctrl_bytes = typename group::ctrl_bytes;
+
+    // Битовая маска слотов группы, управляющий байт которых равен value
+    static uint32_t match_byte(ctrl_bytes ctrl, uint8_t value) {
+#if defined(__SSE2__)
+        const auto bytes = _mm_set_epi64x(static_cast<long long>(ctrl.hi), static_cast<long long>(ctrl.lo));
+        const auto eq = _mm_cmpeq_epi8(bytes, _mm_set1_epi8(static_cast<char>(value)));
+        return static_cast<uint32_t>(_mm_movemask_epi8(eq));
+#else
+        return match_word(ctrl.lo, value) | (match_word(ctrl.hi, value) << 8);
+#endif
+    }
+
+#if !defined(__SSE2__)
+    static uint32_t match_word(uint64_t word, uint8_t value) {
+        uint32_t mask = 0;
+        for (size_t i = 0; i < 8; ++i) {
+            mask |= static_cast<uint32_t>(((word >> (i * 8)) & 0xff) == value) << i;
+        }
+        return mask;
+    }
+#endif
+
+    static size_t groups_for(size_t size) {
+        // Максимальная загрузка 7/8
+        return std::bit_ceil(std::max<size_t>((size * 8 / 7 + group_size - 1) / group_size, 1));
+    }
+
+    static uint64_t hash(uint32_t key) {
+        uint64_t h = key * 0x9e3779b97f4a7c15ull;
+        return h ^ (h >> 32);
+    }
+
+    void rebuild(size_t groups) {
+        auto *old_table = _table.load(std::memory_order_relaxed);
+        auto new_table = std::make_unique<table>(groups);
+        for (size_t g = 0; g <= old_table->group_mask; ++g) {
+            auto &old_group = old_table->groups[g];
+            const auto ctrl = old_group.load_ctrl();
+            for (size_t i = 0; i < group_size; ++i) {
+                const auto byte = static_cast<uint8_t>((i < 8 ? ctrl.lo >> (i * 8) : ctrl.hi >> ((i - 8) * 8)) & 0xff);
+                if (byte & 0x80) {
+                    continue;
+                }
+                place(*new_table, old_group.keys[i].load(std::memory_order_relaxed),
+                      old_group.values[i].load(std::memory_order_relaxed), byte);
+            }
+        }
+
+        _table.store(new_table.release(), std::memory_order_release);
+        epoch_domain::global().retire(std::unique_ptr<table>(old_table));
+    }
+
+    static void place(table &t, uint32_t key, V value, uint8_t tag) {
+        size_t g = (hash(key) >> 7) & t.group_mask;
+        for (size_t step = 1;; g = (g + step++) & t.group_mask) {
+            auto &grp = t.groups[g];
+            if (auto empty = match_byte(grp.load_ctrl(), ctrl_empty)) {
+                const auto i = std::countr_zero(empty);
+                grp.keys[i].store(key, std::memory_order_relaxed);
+                grp.values[i].store(value, std::memory_order_relaxed);
+                grp.store_ctrl_byte(i, tag);
+                ++t.used;
+                return;
+            }
+        }
+    }
+
+    std::atomic<table *> _table;
+    size_t _size{};
+};
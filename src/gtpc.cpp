@@ -0,0 +1,351 @@
+#include <gtpc.h>
+
+#include <algorithm>
+
+namespace gtpc {
+    namespace {
+        constexpr uint8_t version_2 = 0x40;
+        constexpr uint8_t flag_piggyback = 0x10;
+        constexpr uint8_t flag_teid = 0x08;
+
+        // Тип, длина и spare/instance перед значением IE
+        constexpr size_t ie_header_size = 4;
+
+        constexpr uint8_t fteid_v4 = 0x80;
+        constexpr uint8_t fteid_v6 = 0x40;
+        constexpr uint8_t pdn_type_ipv4 = 1;
+        constexpr uint8_t pdn_type_ipv4v6 = 3;
+        constexpr size_t bearer_qos_size = 22;
+
+        uint16_t load16(const uint8_t *p) { return static_cast<uint16_t>(p[0] << 8 | p[1]); }
+
+        uint32_t load32(const uint8_t *p) {
+            return uint32_t{p[0]} << 24 | uint32_t{p[1]} << 16 | uint32_t{p[2]} << 8 | uint32_t{p[3]};
+        }
+
+        void store16(uint8_t *p, uint16_t value) {
+            p[0] = static_cast<uint8_t>(value >> 8);
+            p[1] = static_cast<uint8_t>(value);
+        }
+
+        void store32(uint8_t *p, uint32_t value) {
+            store16(p, static_cast<uint16_t>(value >> 16));
+            store16(p + 2, static_cast<uint16_t>(value));
+        }
+
+        // Скорости в Bearer QoS 40-битные
+        uint64_t load40(const uint8_t *p) { return uint64_t{p[0]} << 32 | load32(p + 1); }
+
+        void store40(uint8_t *p, uint64_t value) {
+            p[0] = static_cast<uint8_t>(value >> 32);
+            store32(p + 1, static_cast<uint32_t>(value));
+        }
+
+        // Длина первого IE в data вместе с заголовком; 0, если IE обрезан
+        size_t ie_size(std::span<const uint8_t> data) {
+            if (data.size() < ie_header_size) {
+                return 0;
+            }
+            const size_t size = ie_header_size + load16(data.data() + 1);
+            return size <= data.size() ? size : 0;
+        }
+    } // namespace
+
+    ie ie_range::iterator::operator*() const {
+        return {static_cast<ie_type>(_rest[0]), static_cast<uint8_t>(_rest[3] & 0x0f),
+                _rest.subspan(ie_header_size, load16(_rest.data() + 1))};
+    }
+
+    ie_range::iterator &ie_range::iterator::operator++() {
+        const auto size = ie_size(_rest);
+        // Обрезанный IE завершает перебор
+        _rest = _rest.subspan(size ? size : _rest.size());
+        return *this;
+    }
+
+    std::optional<ie> ie_range::find(ie_type type, uint8_t instance) const {
+        for (const auto &element : *this) {
+            if (element.type == type && element.instance == instance) {
+                return element;
+            }
+        }
+        return std::nullopt;
+    }
+
+    bool ie_range::valid() const {
+        for (auto rest = _data; !rest.empty();) {
+            const auto size = ie_size(rest);
+            if (!size) {
+                return false;
+            }
+            rest = rest.subspan(size);
+        }
+        return true;
+    }
+
+    std::optional<header> parse(std::span<const uint8_t> message) {
+        if (message.size() < 8 || (message[0] & 0xe0) != version_2) {
+            return std::nullopt;
+        }
+        // Длина в заголовке считается после первых 4 байт
+        const size_t message_size = 4 + load16(message.data() + 2);
+        const bool has_teid = message[0] & flag_teid;
+        const size_t header_size = has_teid ? 12 : 8;
+        if (message_size < header_size || message_size > message.size()) {
+            return std::nullopt;
+        }
+
+        header result;
+        result.type = static_cast<message_type>(message[1]);
+        const auto *p = message.data() + 4;
+        if (has_teid) {
+            result.teid = load32(p);
+            p += 4;
+        }
+        result.sequence = uint32_t{p[0]} << 16 | uint32_t{p[1]} << 8 | p[2];
+        result.ies = ie_range(message.subspan(header_size, message_size - header_size));
+        result.message_size = message_size;
+        result.piggybacked = message[0] & flag_piggyback;
+        if (!result.ies.valid()) {
+            return std::nullopt;
+        }
+        return result;
+    }
+
+    std::optional<fteid> decode_fteid(std::span<const uint8_t> value) {
+        if (value.size() < 5 || !(value[0] & fteid_v4)) {
+            return std::nullopt;
+        }
+        // IPv4 идет сразу после TEID, IPv6 - за ним
+        if (value.size() < 9 + ((value[0] & fteid_v6) ? 16u : 0u)) {
+            return std::nullopt;
+        }
+        return fteid{static_cast<interface_type>(value[0] & 0x3f), load32(value.data() + 1),
+                     boost::asio::ip::address_v4(load32(value.data() + 5))};
+    }
+
+    std::optional<cause_value> decode_cause(std::span<const uint8_t> value) {
+        if (value.size() < 2) {
+            return std::nullopt;
+        }
+        return static_cast<cause_value>(value[0]);
+    }
+
+    std::optional<uint8_t> decode_ebi(std::span<const uint8_t> value) {
+        if (value.empty()) {
+            return std::nullopt;
+        }
+        return static_cast<uint8_t>(value[0] & 0x0f);
+    }
+
+    std::optional<boost::asio::ip::address_v4> decode_paa(std::span<const uint8_t> value) {
+        if (value.empty()) {
+            return std::nullopt;
+        }
+        // IPv4v6: длина префикса и IPv6 адрес перед IPv4
+        const auto type = value[0] & 0x07;
+        const size_t offset = type == pdn_type_ipv4 ? 1 : type == pdn_type_ipv4v6 ? 18 : value.size();
+        if (offset + 4 > value.size()) {
+            return std::nullopt;
+        }
+        return boost::asio::ip::address_v4(load32(value.data() + offset));
+    }
+
+    std::optional<qos> decode_bearer_qos(std::span<const uint8_t> value) {
+        if (value.size() < bearer_qos_size) {
+            return std::nullopt;
+        }
+        const auto *p = value.data();
+        return qos{p[1], static_cast<uint8_t>(p[0] >> 2 & 0x0f), !(p[0] & 0x40), !(p[0] & 0x01),
+                   load40(p + 2), load40(p + 7), load40(p + 12), load40(p + 17)};
+    }
+
+    std::optional<std::string_view> decode_apn(std::span<const uint8_t> value, std::span<char> out) {
+        size_t size = 0;
+        for (size_t offset = 0; offset < value.size();) {
+            const size_t label = value[offset++];
+            if (label == 0 || offset + label > value.size() || size + label + (size ? 1 : 0) > out.size()) {
+                return std::nullopt;
+            }
+            if (size) {
+                out[size++] = '.';
+            }
+            std::copy_n(value.data() + offset, label, out.data() + size);
+            size += label;
+            offset += label;
+        }
+        return std::string_view(out.data(), size);
+    }
+
+    std::optional<std::string_view> decode_imsi(std::span<const uint8_t> value, std::span<char> out) {
+        size_t size = 0;
+        for (auto byte : value) {
+            // Младшая тетрада - первая цифра; 0xf в старшей добивает нечетное число цифр
+            for (auto digit : {byte & 0x0f, byte >> 4}) {
+                if (digit == 0x0f) {
+                    continue;
+                }
+                if (digit > 9 || size == out.size()) {
+                    return std::nullopt;
+                }
+                out[size++] = static_cast<char>('0' + digit);
+            }
+        }
+        return std::string_view(out.data(), size);
+    }
+
+    std::optional<ie_range> grouped(std::span<const uint8_t> value) {
+        ie_range range(value);
+        if (!range.valid()) {
+            return std::nullopt;
+        }
+        return range;
+    }
+
+    writer::writer(std::span<uint8_t> buffer, message_type type, std::optional<uint32_t> teid, uint32_t sequence) :
+        _buffer(buffer) {
+        auto *p = reserve(teid ? 12 : 8);
+        if (!p) {
+            return;
+        }
+        p[0] = version_2 | (teid ? flag_teid : 0);
+        p[1] = type;
+        p += 4;
+        if (teid) {
+            store32(p, *teid);
+            p += 4;
+        }
+        p[0] = static_cast<uint8_t>(sequence >> 16);
+        p[1] = static_cast<uint8_t>(sequence >> 8);
+        p[2] = static_cast<uint8_t>(sequence);
+        p[3] = 0;
+    }
+
+    uint8_t *writer::reserve(size_t size) {
+        if (_overflow || _buffer.size() - _size < size) {
+            _overflow = true;
+            return nullptr;
+        }
+        auto *p = _buffer.data() + _size;
+        _size += size;
+        return p;
+    }
+
+    writer &writer::add(ie_type type, std::span<const uint8_t> value, uint8_t instance) {
+        if (auto *p = reserve(ie_header_size + value.size())) {
+            p[0] = type;
+            store16(p + 1, static_cast<uint16_t>(value.size()));
+            p[3] = instance & 0x0f;
+            std::copy(value.begin(), value.end(), p + ie_header_size);
+        }
+        return *this;
+    }
+
+    writer &writer::add_cause(cause_value cause) {
+        const uint8_t value[]{cause, 0};
+        return add(gtpc::cause, value);
+    }
+
+    writer &writer::add_recovery(uint8_t restart_counter) {
+        const uint8_t value[]{restart_counter};
+        return add(recovery, value);
+    }
+
+    writer &writer::add_ebi(uint8_t ebi) {
+        const uint8_t value[]{static_cast<uint8_t>(ebi & 0x0f)};
+        return add(gtpc::ebi, value);
+    }
+
+    writer &writer::add_fteid(const fteid &endpoint, uint8_t instance) {
+        uint8_t value[9];
+        value[0] = fteid_v4 | (endpoint.interface & 0x3f);
+        store32(value + 1, endpoint.teid);
+        store32(value + 5, endpoint.ipv4.to_uint());
+        return add(f_teid, value, instance);
+    }
+
+    writer &writer::add_paa(boost::asio::ip::address_v4 address) {
+        uint8_t value[5];
+        value[0] = pdn_type_ipv4;
+        store32(value + 1, address.to_uint());
+        return add(paa, value);
+    }
+
+    writer &writer::add_bearer_qos(const qos &bearer) {
+        // PCI и PVI - запреты: 1 значит "не может вытеснять" и "не может быть вытеснен"
+        uint8_t value[bearer_qos_size];
+        const uint8_t pci = bearer.preemption_capability ? 0 : 0x40;
+        const uint8_t pvi = bearer.preemption_vulnerability ? 0 : 0x01;
+        value[0] = static_cast<uint8_t>(pci | (bearer.priority_level & 0x0f) << 2 | pvi);
+        value[1] = bearer.qci;
+        store40(value + 2, bearer.max_uplink);
+        store40(value + 7, bearer.max_downlink);
+        store40(value + 12, bearer.guaranteed_uplink);
+        store40(value + 17, bearer.guaranteed_downlink);
+        return add(gtpc::bearer_qos, value);
+    }
+
+    writer &writer::add_apn(std::string_view apn) {
+        // Метка на каждую часть между точками, как в DNS
+        auto *p = reserve(ie_header_size + 1 + apn.size());
+        if (!p) {
+            return *this;
+        }
+        p[0] = gtpc::apn;
+        store16(p + 1, static_cast<uint16_t>(1 + apn.size()));
+        p[3] = 0;
+        auto *label = p + ie_header_size;
+        *label = 0;
+        for (size_t i = 0; i < apn.size(); ++i) {
+            if (apn[i] == '.') {
+                label = p + ie_header_size + 1 + i;
+                *label = 0;
+            } else {
+                p[ie_header_size + 1 + i] = static_cast<uint8_t>(apn[i]);
+                ++*label;
+            }
+        }
+        return *this;
+    }
+
+    writer &writer::add_imsi(std::string_view digits) {
+        auto *p = reserve(ie_header_size + (digits.size() + 1) / 2);
+        if (!p) {
+            return *this;
+        }
+        p[0] = gtpc::imsi;
+        store16(p + 1, static_cast<uint16_t>((digits.size() + 1) / 2));
+        p[3] = 0;
+        for (size_t i = 0; i < digits.size(); i += 2) {
+            const auto high = i + 1 < digits.size() ? digits[i + 1] - '0' : 0x0f;
+            p[ie_header_size + i / 2] = static_cast<uint8_t>(high << 4 | (digits[i] - '0'));
+        }
+        return *this;
+    }
+
+    writer &writer::begin_group(ie_type type, uint8_t instance) {
+        const auto position = _size;
+        if (auto *p = reserve(ie_header_size)) {
+            p[0] = type;
+            p[3] = instance & 0x0f;
+            _group = position;
+        }
+        return *this;
+    }
+
+    writer &writer::end_group() {
+        if (!_overflow && _group) {
+            store16(_buffer.data() + *_group + 1, static_cast<uint16_t>(_size - *_group - ie_header_size));
+        }
+        _group.reset();
+        return *this;
+    }
+
+    std::span<const uint8_t> writer::finish() {
+        if (_overflow) {
+            return {};
+        }
+        store16(_buffer.data() + 2, static_cast<uint16_t>(_size - 4));
+        return _buffer.first(_size);
+    }
+} // namespace gtpc
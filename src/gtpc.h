@@ -0,0 +1,201 @@
+#pragma once
+
+#include <boost/asio/ip/address_v4.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <optional>
+#include <span>
+#include <string_view>
+
+// GTPv2-C (TS 29.274) поверх UDP: заголовок и IE разбираются прямо в байтах датаграммы, без
+// выделения памяти; сообщения собираются в буфер вызывающего. Из всех сообщений и IE здесь
+// только то, что нужно PGW для Create Session, Create Bearer, Delete Session и Echo на S5/S8.
+namespace gtpc {
+    constexpr uint16_t port = 2123;
+    constexpr size_t max_header_size = 12;
+    // Значения sequence number 24-битные
+    constexpr uint32_t max_sequence = 0xffffff;
+
+    enum message_type : uint8_t {
+        echo_request = 1,
+        echo_response = 2,
+        create_session_request = 32,
+        create_session_response = 33,
+        delete_session_request = 36,
+        delete_session_response = 37,
+        create_bearer_request = 95,
+        create_bearer_response = 96,
+    };
+
+    enum ie_type : uint8_t {
+        imsi = 1,
+        cause = 2,
+        recovery = 3,
+        apn = 71,
+        ambr = 72,
+        ebi = 73,
+        paa = 79,
+        bearer_qos = 80,
+        f_teid = 87,
+        bearer_context = 93,
+        charging_id = 94,
+        pdn_type = 99,
+    };
+
+    enum cause_value : uint8_t {
+        request_accepted = 16,
+        context_not_found = 64,
+        invalid_message_format = 65,
+        mandatory_ie_incorrect = 69,
+        mandatory_ie_missing = 70,
+        system_failure = 72,
+        no_resources_available = 73,
+        missing_or_unknown_apn = 78,
+    };
+
+    // Тип интерфейса F-TEID (TS 29.274, 8.22)
+    enum interface_type : uint8_t {
+        s5_s8_sgw_gtp_u = 4,
+        s5_s8_pgw_gtp_u = 5,
+        s5_s8_sgw_gtp_c = 6,
+        s5_s8_pgw_gtp_c = 7,
+    };
+
+    // Номера instance F-TEID в сообщениях и Bearer Context, которые мы разбираем и собираем
+    namespace instance {
+        // Create Session Request/Response: F-TEID отправителя для управления
+        constexpr uint8_t sender_f_teid = 0;
+        // Bearer Context в Create Session Request/Response и Create Bearer Response
+        constexpr uint8_t s5_s8_u_sgw_f_teid = 2;
+        constexpr uint8_t s5_s8_u_pgw_f_teid = 2;
+        // Bearer Context в Create Bearer Request
+        constexpr uint8_t create_bearer_s5_s8_u_pgw_f_teid = 1;
+    } // namespace instance
+
+    struct ie {
+        ie_type type{};
+        uint8_t instance{};
+        std::span<const uint8_t> value;
+    };
+
+    // IE, записанные подряд: сообщение целиком или содержимое grouped IE. Сам по себе диапазон
+    // не проверяет длины, перебор останавливается на первом обрезанном IE; parse и grouped()
+    // отдают только диапазоны, которые разбираются целиком
+    class ie_range {
+    public:
+        class iterator {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = ie;
+            using difference_type = std::ptrdiff_t;
+
+            iterator() = default;
+            explicit iterator(std::span<const uint8_t> rest) : _rest(rest) {}
+
+            ie operator*() const;
+            iterator &operator++();
+            iterator operator++(int) {
+                auto previous = *this;
+                ++*this;
+                return previous;
+            }
+            bool operator==(const iterator &other) const { return _rest.data() == other._rest.data(); }
+
+        private:
+            std::span<const uint8_t> _rest;
+        };
+
+        ie_range() = default;
+        explicit ie_range(std::span<const uint8_t> data) : _data(data) {}
+
+        [[nodiscard]] iterator begin() const { return iterator(_data); }
+        [[nodiscard]] iterator end() const { return iterator(_data.subspan(_data.size())); }
+
+        // Первый IE с таким типом и instance
+        [[nodiscard]] std::optional<ie> find(ie_type type, uint8_t instance = 0) const;
+        // Все IE разбираются целиком, без обрезанного хвоста
+        [[nodiscard]] bool valid() const;
+
+    private:
+        std::span<const uint8_t> _data;
+    };
+
+    struct header {
+        message_type type{};
+        std::optional<uint32_t> teid;
+        uint32_t sequence{};
+        ie_range ies;
+        // Сообщение вместе с заголовком; за ним может идти piggybacked сообщение, если выставлен P
+        size_t message_size{};
+        bool piggybacked{};
+    };
+
+    // Разбирает сообщение в начале UDP payload. nullopt, если это не GTPv2, сообщение обрезано
+    // или его IE не разбираются целиком
+    std::optional<header> parse(std::span<const uint8_t> message);
+
+    struct fteid {
+        interface_type interface{};
+        uint32_t teid{};
+        boost::asio::ip::address_v4 ipv4;
+    };
+
+    // Bearer Level QoS (8.15); скорости в кбит/с
+    struct qos {
+        uint8_t qci{};
+        uint8_t priority_level{};
+        bool preemption_capability{};
+        bool preemption_vulnerability{};
+        uint64_t max_uplink{};
+        uint64_t max_downlink{};
+        uint64_t guaranteed_uplink{};
+        uint64_t guaranteed_downlink{};
+    };
+
+    // Разбор значений IE; nullopt, если значение короче положенного. F-TEID и PAA - только с IPv4
+    std::optional<fteid> decode_fteid(std::span<const uint8_t> value);
+    std::optional<cause_value> decode_cause(std::span<const uint8_t> value);
+    std::optional<uint8_t> decode_ebi(std::span<const uint8_t> value);
+    std::optional<boost::asio::ip::address_v4> decode_paa(std::span<const uint8_t> value);
+    std::optional<qos> decode_bearer_qos(std::span<const uint8_t> value);
+    // APN из меток с длинами в точечную запись; IMSI из TBCD в цифры. Результат лежит в out
+    std::optional<std::string_view> decode_apn(std::span<const uint8_t> value, std::span<char> out);
+    std::optional<std::string_view> decode_imsi(std::span<const uint8_t> value, std::span<char> out);
+    // Содержимое grouped IE (Bearer Context); nullopt, если оно не разбирается целиком
+    std::optional<ie_range> grouped(std::span<const uint8_t> value);
+
+    // Сборка сообщения в буфере вызывающего. Переполнение запоминается, finish() тогда вернет
+    // пустой span; проверять каждый add не нужно
+    class writer {
+    public:
+        writer(std::span<uint8_t> buffer, message_type type, std::optional<uint32_t> teid, uint32_t sequence);
+
+        writer &add(ie_type type, std::span<const uint8_t> value, uint8_t instance = 0);
+        writer &add_cause(cause_value cause);
+        writer &add_recovery(uint8_t restart_counter);
+        writer &add_ebi(uint8_t ebi);
+        writer &add_fteid(const fteid &endpoint, uint8_t instance);
+        writer &add_paa(boost::asio::ip::address_v4 address);
+        writer &add_bearer_qos(const qos &bearer);
+        writer &add_apn(std::string_view apn);
+        writer &add_imsi(std::string_view digits);
+
+        // Grouped IE: IE между begin_group и end_group попадают внутрь
+        writer &begin_group(ie_type type, uint8_t instance = 0);
+        writer &end_group();
+
+        // Готовое сообщение с проставленной длиной
+        [[nodiscard]] std::span<const uint8_t> finish();
+
+    private:
+        uint8_t *reserve(size_t size);
+
+        std::span<uint8_t> _buffer;
+        size_t _size = 0;
+        bool _overflow = false;
+        // Начало открытой grouped IE; вложенность не нужна
+        std::optional<size_t> _group;
+    };
+} // namespace gtpc
@@ -0,0 +1,292 @@
+#include <gtpc_engine.h>
+
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/asio/use_awaitable.hpp>
+
+#include <algorithm>
+#include <string>
+
+namespace {
+    // Адрес и порт peer в ключе кэша ответов; у IPv6 peer (транспорты движка их не дают) адрес
+    // не различается
+    uint64_t peer_key(const boost::asio::ip::udp::endpoint &endpoint) {
+        const auto address = endpoint.address();
+        return uint64_t{address.is_v4() ? address.to_v4().to_uint() : 0} << 16 | endpoint.port();
+    }
+
+    // APN в Create Session Request не длиннее 100 октетов (TS 23.003, 9.1)
+    constexpr size_t max_apn_size = 100;
+} // namespace
+
+// Наш запрос, ждущий ответа. Ответ отменяет таймер повтора
+struct gtpc_engine::transaction {
+    transaction(const boost::asio::any_io_executor &executor, const boost::asio::ip::udp::endpoint &sgw,
+                uint32_t cp_teid) :
+        timer(executor), sgw(sgw), cp_teid(cp_teid) {}
+
+    boost::asio::steady_timer timer;
+    // Откуда ждем ответ и какой TEID в его заголовке
+    boost::asio::ip::udp::endpoint sgw;
+    uint32_t cp_teid;
+    bool answered = false;
+    gtpc::cause_value cause{};
+    uint32_t sgw_teid = 0;
+};
+
+size_t gtpc_engine::request_key_hash::operator()(const request_key &key) const {
+    return std::hash<uint64_t>{}(key.peer * 0x9e3779b97f4a7c15 ^ (uint64_t{key.sequence} << 8 | key.type));
+}
+
+gtpc_engine::gtpc_engine(control_plane &control_plane, gtpc_transport &transport, const config &config) :
+    _control_plane(control_plane), _transport(transport), _config(config) {}
+
+boost::asio::awaitable<void> gtpc_engine::run() {
+    // Буфер живет в кадре корутины: одно выделение на весь цикл
+    std::array<uint8_t, max_datagram_size> buffer;
+    boost::asio::ip::udp::endpoint from;
+    while (true) {
+        const auto size = co_await _transport.receive(buffer, from);
+        handle(std::span(buffer).first(size), from);
+    }
+}
+
+void gtpc_engine::handle(std::span<const uint8_t> datagram, const boost::asio::ip::udp::endpoint &from) {
+    const auto message = gtpc::parse(datagram);
+    if (!message) {
+        ++_statistics.dropped;
+        return;
+    }
+    switch (message->type) {
+        case gtpc::echo_request:
+        case gtpc::create_session_request:
+        case gtpc::delete_session_request:
+            break;
+        case gtpc::create_bearer_response:
+            complete(*message, from);
+            return;
+        default:
+            ++_statistics.dropped;
+            return;
+    }
+
+    ++_statistics.requests;
+    if (message->type == gtpc::echo_request) {
+        std::array<uint8_t, max_cached_response_size> buffer;
+        _transport.send(gtpc::writer(buffer, gtpc::echo_response, std::nullopt, message->sequence)
+                            .add_recovery(_config.restart_counter)
+                            .finish(),
+                        from);
+        return;
+    }
+
+    const auto now = clock::now();
+    expire_responses(now);
+    const request_key key{peer_key(from), message->sequence, message->type};
+    if (const auto found = _response_index.find(key); found != _response_index.end()) {
+        ++_statistics.duplicate_requests;
+        _transport.send(std::span(found->second->bytes).first(found->second->size), from);
+        return;
+    }
+
+    if (_responses.size() >= std::max<size_t>(_config.max_cached_responses, 1)) {
+        ++_statistics.evicted_responses;
+        evict_oldest_response();
+    }
+    auto &cached = _responses.emplace_back();
+    const auto response = message->type == gtpc::create_session_request
+                              ? create_session(*message, cached.bytes)
+                              : delete_session(*message, from, cached.bytes);
+    // Ответы движка ограничены по размеру и всегда помещаются; пустой - только если что-то сломано
+    if (response.empty()) {
+        _responses.pop_back();
+        return;
+    }
+    cached.key = key;
+    cached.size = static_cast<uint16_t>(response.size());
+    cached.expires = now + _config.response_lifetime;
+    _response_index.emplace(key, &cached);
+    _transport.send(response, from);
+}
+
+void gtpc_engine::expire_responses(clock::time_point now) {
+    while (!_responses.empty() && _responses.front().expires <= now) {
+        evict_oldest_response();
+    }
+}
+
+void gtpc_engine::evict_oldest_response() {
+    _response_index.erase(_responses.front().key);
+    _responses.pop_front();
+}
+
+std::span<const uint8_t> gtpc_engine::create_session(const gtpc::header &request, std::span<uint8_t> buffer) {
+    const auto sender = request.ies.find(gtpc::f_teid, gtpc::instance::sender_f_teid);
+    const auto sgw_control = sender ? gtpc::decode_fteid(sender->value) : std::nullopt;
+    const uint32_t sgw_cp_teid = sgw_control ? sgw_control->teid : 0;
+    const auto reject = [&](gtpc::cause_value cause) {
+        return gtpc::writer(buffer, gtpc::create_session_response, sgw_cp_teid, request.sequence)
+            .add_cause(cause)
+            .finish();
+    };
+
+    const auto apn = request.ies.find(gtpc::apn);
+    const auto context = request.ies.find(gtpc::bearer_context);
+    if (!sender || !apn || !context) {
+        return reject(gtpc::mandatory_ie_missing);
+    }
+    const auto bearer_ies = gtpc::grouped(context->value);
+    const auto ebi_ie = bearer_ies ? bearer_ies->find(gtpc::ebi) : std::nullopt;
+    const auto user_ie = bearer_ies ? bearer_ies->find(gtpc::f_teid, gtpc::instance::s5_s8_u_sgw_f_teid) : std::nullopt;
+    const auto ebi = ebi_ie ? gtpc::decode_ebi(ebi_ie->value) : std::nullopt;
+    const auto sgw_user = user_ie ? gtpc::decode_fteid(user_ie->value) : std::nullopt;
+    char apn_buffer[max_apn_size];
+    const auto apn_name = gtpc::decode_apn(apn->value, apn_buffer);
+    if (!sgw_control || !ebi || !sgw_user || !apn_name) {
+        return reject(gtpc::mandatory_ie_incorrect);
+    }
+
+    const std::string name(*apn_name);
+    if (!_control_plane.find_apn_id(name)) {
+        return reject(gtpc::missing_or_unknown_apn);
+    }
+    const auto pdn = _control_plane.create_pdn_connection(name, sgw_control->ipv4, sgw_control->teid);
+    if (!pdn) {
+        return reject(gtpc::no_resources_available);
+    }
+    const auto bearer = _control_plane.create_bearer(pdn, sgw_user->teid);
+    if (!bearer) {
+        _control_plane.delete_pdn_connection(pdn->get_cp_teid());
+        return reject(gtpc::no_resources_available);
+    }
+    pdn->set_default_bearer(bearer);
+
+    return gtpc::writer(buffer, gtpc::create_session_response, sgw_control->teid, request.sequence)
+        .add_cause(gtpc::request_accepted)
+        .add_fteid({gtpc::s5_s8_pgw_gtp_c, pdn->get_cp_teid(), _config.control_address},
+                   gtpc::instance::sender_f_teid)
+        .add_paa(pdn->get_ue_ip_addr())
+        .begin_group(gtpc::bearer_context)
+        .add_ebi(*ebi)
+        .add_cause(gtpc::request_accepted)
+        .add_fteid({gtpc::s5_s8_pgw_gtp_u, bearer->get_dp_teid(), _config.user_address},
+                   gtpc::instance::s5_s8_u_pgw_f_teid)
+        .end_group()
+        .finish();
+}
+
+std::span<const uint8_t> gtpc_engine::delete_session(const gtpc::header &request,
+                                                    const boost::asio::ip::udp::endpoint &from,
+                                                    std::span<uint8_t> buffer) {
+    const auto pdn = request.teid ? _control_plane.find_pdn_by_cp_teid(*request.teid) : nullptr;
+    // Сессию удаляет только ее SGW: иначе любой peer, угадавший TEID, снял бы чужую сессию
+    if (!pdn || from.address() != boost::asio::ip::address(pdn->get_sgw_address())) {
+        return gtpc::writer(buffer, gtpc::delete_session_response, 0, request.sequence)
+            .add_cause(gtpc::context_not_found)
+            .finish();
+    }
+    const auto sgw_cp_teid = pdn->get_sgw_cp_teid();
+    _control_plane.delete_pdn_connection(pdn->get_cp_teid());
+    return gtpc::writer(buffer, gtpc::delete_session_response, sgw_cp_teid, request.sequence)
+        .add_cause(gtpc::request_accepted)
+        .finish();
+}
+
+void gtpc_engine::complete(const gtpc::header &response, const boost::asio::ip::udp::endpoint &from) {
+    const auto found = _pending.find(response.sequence);
+    // Ответ на повтор уже завершенного запроса или чужой. Sequence number угадать легко, поэтому
+    // сверяем и отправителя с TEID: иначе кто угодно подменил бы SGW TEID bearer или отказал за SGW
+    if (found == _pending.end() || from != found->second->sgw || response.teid != found->second->cp_teid) {
+        ++_statistics.dropped;
+        return;
+    }
+    ++_statistics.responses;
+    auto &pending = *found->second;
+    _pending.erase(found);
+    pending.answered = true;
+
+    // Успех - только с принятым bearer и его F-TEID; иначе причина из сообщения
+    const auto cause = response.ies.find(gtpc::cause);
+    pending.cause = cause ? gtpc::decode_cause(cause->value).value_or(gtpc::mandatory_ie_incorrect)
+                          : gtpc::mandatory_ie_missing;
+    if (pending.cause == gtpc::request_accepted) {
+        const auto context = response.ies.find(gtpc::bearer_context);
+        const auto bearer_ies = context ? gtpc::grouped(context->value) : std::nullopt;
+        const auto bearer_cause = bearer_ies ? bearer_ies->find(gtpc::cause) : std::nullopt;
+        const auto user_ie = bearer_ies ? bearer_ies->find(gtpc::f_teid, gtpc::instance::s5_s8_u_sgw_f_teid)
+                                        : std::nullopt;
+        const auto sgw_user = user_ie ? gtpc::decode_fteid(user_ie->value) : std::nullopt;
+        if (bearer_cause) {
+            pending.cause = gtpc::decode_cause(bearer_cause->value).value_or(gtpc::mandatory_ie_incorrect);
+        }
+        if (!sgw_user) {
+            pending.cause = gtpc::mandatory_ie_missing;
+        } else {
+            pending.sgw_teid = sgw_user->teid;
+        }
+    }
+    pending.timer.cancel();
+}
+
+uint32_t gtpc_engine::next_sequence() {
+    // Номер еще ждущего ответа запроса пропускаем
+    do {
+        _sequence = (_sequence + 1) & gtpc::max_sequence;
+    } while (_pending.contains(_sequence));
+    return _sequence;
+}
+
+boost::asio::awaitable<std::shared_ptr<bearer>> gtpc_engine::create_bearer(uint32_t cp_teid, uint8_t linked_ebi,
+                                                                           const gtpc::qos &qos) {
+    const auto pdn = _control_plane.find_pdn_by_cp_teid(cp_teid);
+    if (!pdn) {
+        co_return nullptr;
+    }
+    // SGW TEID неизвестен до ответа
+    const auto created = _control_plane.create_bearer(pdn, 0);
+    if (!created) {
+        co_return nullptr;
+    }
+
+    const auto sequence = next_sequence();
+    std::array<uint8_t, max_cached_response_size> buffer;
+    const auto request = gtpc::writer(buffer, gtpc::create_bearer_request, pdn->get_sgw_cp_teid(), sequence)
+                             .add_ebi(linked_ebi)
+                             .begin_group(gtpc::bearer_context)
+                             .add_ebi(0)
+                             .add_fteid({gtpc::s5_s8_pgw_gtp_u, created->get_dp_teid(), _config.user_address},
+                                        gtpc::instance::create_bearer_s5_s8_u_pgw_f_teid)
+                             .add_bearer_qos(qos)
+                             .end_group()
+                             .finish();
+    const boost::asio::ip::udp::endpoint sgw(pdn->get_sgw_address(), gtpc::port);
+
+    transaction pending(co_await boost::asio::this_coro::executor, sgw, cp_teid);
+    _pending.emplace(sequence, &pending);
+    for (unsigned attempt = 0; !pending.answered && attempt <= _config.n3; ++attempt) {
+        if (attempt) {
+            ++_statistics.retransmissions;
+        }
+        _transport.send(request, sgw);
+        pending.timer.expires_after(_config.t3);
+        boost::system::error_code error;
+        co_await pending.timer.async_wait(boost::asio::redirect_error(boost::asio::use_awaitable, error));
+    }
+    if (!pending.answered) {
+        _pending.erase(sequence);
+        ++_statistics.timeouts;
+    }
+
+    // Пока ждали ответа, Delete Session мог удалить сессию вместе с bearer
+    if (_control_plane.find_pdn_by_cp_teid(cp_teid) != pdn ||
+        _control_plane.find_bearer_by_dp_teid(created->get_dp_teid()) != created) {
+        co_return nullptr;
+    }
+    if (!pending.answered || pending.cause != gtpc::request_accepted) {
+        _control_plane.delete_bearer(created->get_dp_teid());
+        co_return nullptr;
+    }
+    created->set_sgw_dp_teid(pending.sgw_teid);
+    co_return created;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <control_plane.h>
+#include <gtpc.h>
+#include <gtpc_transport.h>
+
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/ip/udp.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <span>
+#include <unordered_map>
+
+// Сигнализация S5/S8 поверх control_plane: принимает Create Session и Delete Session Request от
+// SGW, отвечает на Echo и сам отправляет Create Bearer Request для dedicated bearers.
+//
+// Работает в одном потоке io_context, и этот поток - управляющий поток control_plane. Запросы SGW
+// выполняются сразу по приему, поэтому сколько угодно транзакций идут конвейером; исходящие
+// Create Bearer ждут ответа каждая в своей корутине, тоже сколько угодно одновременно.
+//
+// Delete Session принимается только с адреса SGW сессии, ответ на наш запрос - только от SGW,
+// которому запрос ушел, и с нашим TEID в заголовке.
+//
+// Повтор запроса (тот же peer, sequence number и тип: наш ответ потерялся) получает сохраненный
+// ответ и не выполняется второй раз. Ответ хранится response_lifetime, сколько бы запросов ни
+// пришло за это время; общий на всех peer кэш ограничен max_cached_responses, чтобы поток
+// запросов с чужих адресов не исчерпал память. Echo не сохраняется: ответ на него не меняется.
+// Наш запрос без ответа повторяется через t3, не больше n3 раз.
+class gtpc_engine {
+public:
+    using clock = std::chrono::steady_clock;
+
+    struct config {
+        // Адреса PGW для F-TEID: управление и пользовательская плоскость S5/S8
+        boost::asio::ip::address_v4 control_address;
+        boost::asio::ip::address_v4 user_address;
+        uint8_t restart_counter = 0;
+        clock::duration t3 = std::chrono::seconds(3);
+        unsigned n3 = 3;
+        // Сколько ответ хранится для повторов запроса; не меньше, чем SGW повторяет запрос
+        clock::duration response_lifetime = std::chrono::seconds(30);
+        // Сверх этого вытесняется самый старый ответ, даже если его срок не вышел
+        size_t max_cached_responses = 1 << 16;
+    };
+
+    struct statistics {
+        uint64_t requests = 0;
+        // Повторы запросов, на которые ушел сохраненный ответ
+        uint64_t duplicate_requests = 0;
+        // Ответы, вытесненные из полного кэша до конца response_lifetime
+        uint64_t evicted_responses = 0;
+        uint64_t responses = 0;
+        // Не GTPv2, обрезанные, неизвестные типы и ответы без нашего запроса
+        uint64_t dropped = 0;
+        // Наши повторы и запросы, оставшиеся без ответа после n3 повторов
+        uint64_t retransmissions = 0;
+        uint64_t timeouts = 0;
+    };
+
+    static constexpr size_t max_datagram_size = 8192;
+
+    gtpc_engine(control_plane &control_plane, gtpc_transport &transport, const config &config);
+
+    gtpc_engine(const gtpc_engine &) = delete;
+    gtpc_engine &operator=(const gtpc_engine &) = delete;
+
+    // Цикл приема; запускается через co_spawn и живет, пока работает io_context
+    boost::asio::awaitable<void> run();
+
+    // Одна принятая датаграмма: на запрос уходит ответ, ответ на наш запрос будит его корутину
+    void handle(std::span<const uint8_t> datagram, const boost::asio::ip::udp::endpoint &from);
+
+    // Create Bearer Request к SGW сессии. Bearer создается сразу, SGW TEID ставится по ответу.
+    // nullptr, если сессии нет или ее удалили до ответа, SGW отказал или не ответил после n3
+    // повторов; bearer тогда удаляется
+    boost::asio::awaitable<std::shared_ptr<bearer>> create_bearer(uint32_t cp_teid, uint8_t linked_ebi,
+                                                                 const gtpc::qos &qos);
+
+    [[nodiscard]] const statistics &get_statistics() const { return _statistics; }
+
+private:
+    static constexpr size_t max_cached_response_size = 256;
+
+    // Запрос peer; peer - адрес и порт в одном числе
+    struct request_key {
+        uint64_t peer = 0;
+        uint32_t sequence = 0;
+        gtpc::message_type type{};
+
+        bool operator==(const request_key &) const = default;
+    };
+
+    struct request_key_hash {
+        size_t operator()(const request_key &key) const;
+    };
+
+    struct cached_response {
+        request_key key;
+        uint16_t size = 0;
+        clock::time_point expires;
+        std::array<uint8_t, max_cached_response_size> bytes;
+    };
+
+    struct transaction;
+
+    // Ответ собирается прямо в запись кэша
+    std::span<const uint8_t> create_session(const gtpc::header &request, std::span<uint8_t> buffer);
+    std::span<const uint8_t> delete_session(const gtpc::header &request, const boost::asio::ip::udp::endpoint &from,
+                                            std::span<uint8_t> buffer);
+    void complete(const gtpc::header &response, const boost::asio::ip::udp::endpoint &from);
+    uint32_t next_sequence();
+    // Удаляет ответы с истекшим сроком, они в начале очереди
+    void expire_responses(clock::time_point now);
+    void evict_oldest_response();
+
+    control_plane &_control_plane;
+    gtpc_transport &_transport;
+    config _config;
+    statistics _statistics;
+    // Ответы в порядке сохранения; срок у всех один, поэтому это и порядок истечения.
+    // deque не двигает элементы при добавлении в конец и удалении из начала
+    std::deque<cached_response> _responses;
+    std::unordered_map<request_key, const cached_response *, request_key_hash> _response_index;
+    std::unordered_map<uint32_t, transaction *> _pending;
+    uint32_t _sequence = 0;
+};
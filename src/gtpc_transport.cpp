@@ -0,0 +1,52 @@
+#include <gtpc_transport.h>
+
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/use_awaitable.hpp>
+
+#include <algorithm>
+
+udp_transport::udp_transport(const boost::asio::any_io_executor &executor,
+                             const boost::asio::ip::udp::endpoint &local) : _socket(executor, local) {}
+
+boost::asio::awaitable<size_t> udp_transport::receive(std::span<uint8_t> buffer,
+                                                      boost::asio::ip::udp::endpoint &from) {
+    co_return co_await _socket.async_receive_from(boost::asio::buffer(buffer.data(), buffer.size()), from,
+                                                  boost::asio::use_awaitable);
+}
+
+void udp_transport::send(std::span<const uint8_t> datagram, const boost::asio::ip::udp::endpoint &to) {
+    // Ошибку отправки не различаем с потерей в сети
+    boost::system::error_code error;
+    _socket.send_to(boost::asio::buffer(datagram.data(), datagram.size()), to, 0, error);
+}
+
+memory_transport::memory_transport(const boost::asio::any_io_executor &executor,
+                                   const boost::asio::ip::udp::endpoint &local) : _local(local), _ready(executor) {}
+
+void memory_transport::connect(memory_transport &a, memory_transport &b) {
+    a._peer = &b;
+    b._peer = &a;
+}
+
+boost::asio::awaitable<size_t> memory_transport::receive(std::span<uint8_t> buffer,
+                                                         boost::asio::ip::udp::endpoint &from) {
+    while (_inbox.empty()) {
+        _ready.expires_at(boost::asio::steady_timer::time_point::max());
+        boost::system::error_code error;
+        co_await _ready.async_wait(boost::asio::redirect_error(boost::asio::use_awaitable, error));
+    }
+    auto received = std::move(_inbox.front());
+    _inbox.pop_front();
+    from = received.from;
+    const auto size = std::min(buffer.size(), received.bytes.size());
+    std::copy_n(received.bytes.begin(), size, buffer.begin());
+    co_return size;
+}
+
+void memory_transport::send(std::span<const uint8_t> datagram, const boost::asio::ip::udp::endpoint &) {
+    if (!_peer) {
+        return;
+    }
+    _peer->_inbox.push_back({_local, {datagram.begin(), datagram.end()}});
+    _peer->_ready.cancel();
+}
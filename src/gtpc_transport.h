@@ -0,0 +1,63 @@
+#pragma once
+
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/ip/udp.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <cstdint>
+#include <deque>
+#include <span>
+#include <vector>
+
+// Датаграммы для gtpc_engine. Отправка не ждет: как и UDP, транспорт может молча потерять
+// датаграмму, повторы - забота движка
+class gtpc_transport {
+public:
+    virtual ~gtpc_transport() = default;
+
+    // Ждет датаграмму; обрезает ее до размера buffer. Возвращает длину записанного
+    virtual boost::asio::awaitable<size_t> receive(std::span<uint8_t> buffer,
+                                                   boost::asio::ip::udp::endpoint &from) = 0;
+    virtual void send(std::span<const uint8_t> datagram, const boost::asio::ip::udp::endpoint &to) = 0;
+};
+
+// UDP сокет, привязанный к local
+class udp_transport : public gtpc_transport {
+public:
+    udp_transport(const boost::asio::any_io_executor &executor, const boost::asio::ip::udp::endpoint &local);
+
+    boost::asio::awaitable<size_t> receive(std::span<uint8_t> buffer, boost::asio::ip::udp::endpoint &from) override;
+    void send(std::span<const uint8_t> datagram, const boost::asio::ip::udp::endpoint &to) override;
+
+    [[nodiscard]] boost::asio::ip::udp::endpoint local_endpoint() const { return _socket.local_endpoint(); }
+
+private:
+    boost::asio::ip::udp::socket _socket;
+};
+
+// Транспорт в памяти для тестов и бенчмарков: connect связывает два транспорта, датаграммы
+// одного приходят другому от его адреса local. Оба должны работать в одном потоке
+class memory_transport : public gtpc_transport {
+public:
+    memory_transport(const boost::asio::any_io_executor &executor, const boost::asio::ip::udp::endpoint &local);
+
+    static void connect(memory_transport &a, memory_transport &b);
+
+    boost::asio::awaitable<size_t> receive(std::span<uint8_t> buffer, boost::asio::ip::udp::endpoint &from) override;
+    // Адрес to не проверяется: все уходит связанному транспорту
+    void send(std::span<const uint8_t> datagram, const boost::asio::ip::udp::endpoint &to) override;
+
+    [[nodiscard]] const boost::asio::ip::udp::endpoint &local_endpoint() const { return _local; }
+
+private:
+    struct datagram {
+        boost::asio::ip::udp::endpoint from;
+        std::vector<uint8_t> bytes;
+    };
+
+    boost::asio::ip::udp::endpoint _local;
+    memory_transport *_peer{};
+    std::deque<datagram> _inbox;
+    // Ожидающий receive спит на таймере без срока, send будит его отменой
+    boost::asio::steady_timer _ready;
+};
@@ -0,0 +1,225 @@
+#include <gtpu.h>
+
+namespace gtpu {
+    namespace {
+        constexpr uint8_t version_1 = 0x20;
+        constexpr uint8_t protocol_type_gtp = 0x10;
+        constexpr uint8_t flag_extension = 0x04;
+        constexpr uint8_t flag_sequence = 0x02;
+        constexpr uint8_t flag_npdu = 0x01;
+
+        constexpr uint8_t udp_protocol = 17;
+        constexpr uint8_t recovery_ie = 14;
+
+        uint16_t load16(const uint8_t *p) { return static_cast<uint16_t>(p[0] << 8 | p[1]); }
+
+        uint32_t load32(const uint8_t *p) {
+            return uint32_t{p[0]} << 24 | uint32_t{p[1]} << 16 | uint32_t{p[2]} << 8 | uint32_t{p[3]};
+        }
+
+        void store16(uint8_t *p, uint16_t value) {
+            p[0] = static_cast<uint8_t>(value >> 8);
+            p[1] = static_cast<uint8_t>(value);
+        }
+
+        void store32(uint8_t *p, uint32_t value) {
+            store16(p, static_cast<uint16_t>(value >> 16));
+            store16(p + 2, static_cast<uint16_t>(value));
+        }
+
+        uint16_t ipv4_checksum(const uint8_t *header) {
+            uint32_t sum = 0;
+            for (size_t i = 0; i < ipv4_header_size; i += 2) {
+                sum += load16(header + i);
+            }
+            sum = (sum & 0xffff) + (sum >> 16);
+            sum += sum >> 16;
+            return static_cast<uint16_t>(~sum);
+        }
+
+        // Расширения, которые мы пропускаем, не разбирая
+        bool known_extension(uint8_t type) {
+            switch (type) {
+                case 0x20: // Service Class Indicator
+                case 0x40: // UDP Port
+                case 0x81: // RAN Container
+                case 0x82: // Long PDCP PDU Number
+                case 0x84: // NR RAN Container
+                case 0x85: // PDU Session Container
+                case 0xc0: // PDCP PDU Number
+                    return true;
+                default:
+                    return false;
+            }
+        }
+    } // namespace
+
+    std::optional<header> parse(std::span<const uint8_t> datagram) {
+        const auto *ip = datagram.data();
+        if (datagram.size() < ipv4_header_size || ip[0] >> 4 != 4) {
+            return std::nullopt;
+        }
+        const size_t ip_header_size = (ip[0] & 0x0f) * 4u;
+        const size_t total_size = load16(ip + 2);
+        if (ip_header_size < ipv4_header_size || total_size > datagram.size() ||
+            total_size < ip_header_size + udp_header_size) {
+            return std::nullopt;
+        }
+        // Фрагменты (MF или ненулевое смещение) не собираем
+        if ((load16(ip + 6) & 0x3fff) != 0 || ip[9] != udp_protocol) {
+            return std::nullopt;
+        }
+
+        const auto *udp = ip + ip_header_size;
+        const size_t udp_size = load16(udp + 4);
+        if (load16(udp + 2) != port || udp_size < udp_header_size + header_size ||
+            ip_header_size + udp_size > total_size) {
+            return std::nullopt;
+        }
+
+        const auto *gtp = udp + udp_header_size;
+        if ((gtp[0] & 0xf0) != (version_1 | protocol_type_gtp)) {
+            return std::nullopt;
+        }
+        // Длина в заголовке считается после обязательных 8 байт
+        const size_t message_size = header_size + load16(gtp + 2);
+        if (message_size > udp_size - udp_header_size) {
+            return std::nullopt;
+        }
+
+        header result;
+        result.type = static_cast<message_type>(gtp[1]);
+        result.teid = load32(gtp + 4);
+        result.peer = boost::asio::ip::address_v4(load32(ip + 12));
+        result.peer_port = load16(udp);
+
+        size_t offset = header_size;
+        if (gtp[0] & (flag_extension | flag_sequence | flag_npdu)) {
+            if (message_size < header_size + optional_fields_size) {
+                return std::nullopt;
+            }
+            if (gtp[0] & flag_sequence) {
+                result.sequence = load16(gtp + 8);
+            }
+            offset += optional_fields_size;
+
+            // Каждое расширение: длина в 4-байтных словах, содержимое, тип следующего расширения
+            auto next = (gtp[0] & flag_extension) ? gtp[11] : uint8_t{0};
+            while (next) {
+                if (!known_extension(next) && (next & 0x80)) {
+                    return std::nullopt;
+                }
+                if (offset >= message_size) {
+                    return std::nullopt;
+                }
+                const size_t extension_size = gtp[offset] * 4u;
+                if (extension_size == 0 || offset + extension_size > message_size) {
+                    return std::nullopt;
+                }
+                next = gtp[offset + extension_size - 1];
+                offset += extension_size;
+            }
+        }
+
+        result.payload_offset = ip_header_size + udp_header_size + offset;
+        result.payload_size = message_size - offset;
+        return result;
+    }
+
+    bool decapsulate(packet_buffer &datagram, const header &header) {
+        if (header.payload_offset + header.payload_size > datagram.size()) {
+            return false;
+        }
+        datagram.trim_front(header.payload_offset);
+        return datagram.trim_back(datagram.size() - header.payload_size);
+    }
+
+    bool encapsulate(packet_buffer &packet, const tunnel &tunnel, message_type type) {
+        const size_t gtp_size = header_size + (tunnel.sequence ? optional_fields_size : 0);
+        const size_t total_size = ipv4_header_size + udp_header_size + gtp_size + packet.size();
+        if (total_size > UINT16_MAX || packet.headroom() < total_size - packet.size()) {
+            return false;
+        }
+        const size_t payload_size = packet.size();
+
+        auto *gtp = packet.prepend(gtp_size);
+        gtp[0] = version_1 | protocol_type_gtp | (tunnel.sequence ? flag_sequence : 0);
+        gtp[1] = type;
+        store16(gtp + 2, static_cast<uint16_t>(gtp_size - header_size + payload_size));
+        store32(gtp + 4, tunnel.teid);
+        if (tunnel.sequence) {
+            store16(gtp + 8, *tunnel.sequence);
+            gtp[10] = 0;
+            gtp[11] = 0;
+        }
+        return prepend_ip_udp(packet, {tunnel.local, port}, {tunnel.remote, tunnel.remote_port});
+    }
+
+    bool prepend_ip_udp(packet_buffer &datagram, const endpoint &source, const endpoint &destination) {
+        const size_t total_size = ipv4_header_size + udp_header_size + datagram.size();
+        if (total_size > UINT16_MAX) {
+            return false;
+        }
+        auto *ip = datagram.prepend(ipv4_header_size + udp_header_size);
+        if (!ip) {
+            return false;
+        }
+
+        ip[0] = 0x45;
+        ip[1] = 0;
+        store16(ip + 2, static_cast<uint16_t>(total_size));
+        store16(ip + 4, 0);
+        store16(ip + 6, 0x4000); // DF
+        ip[8] = 64;
+        ip[9] = udp_protocol;
+        store16(ip + 10, 0);
+        store32(ip + 12, source.address.to_uint());
+        store32(ip + 16, destination.address.to_uint());
+        store16(ip + 10, ipv4_checksum(ip));
+
+        // Контрольная сумма UDP поверх IPv4 необязательна
+        auto *udp = ip + ipv4_header_size;
+        store16(udp, source.port);
+        store16(udp + 2, destination.port);
+        store16(udp + 4, static_cast<uint16_t>(total_size - ipv4_header_size));
+        store16(udp + 6, 0);
+        return true;
+    }
+
+    std::optional<endpoint> strip_ip_udp(packet_buffer &datagram) {
+        const auto *ip = datagram.data();
+        if (datagram.size() < ipv4_header_size || ip[0] >> 4 != 4) {
+            return std::nullopt;
+        }
+        const size_t ip_header_size = (ip[0] & 0x0f) * 4u;
+        if (ip_header_size < ipv4_header_size || datagram.size() < ip_header_size + udp_header_size) {
+            return std::nullopt;
+        }
+        const endpoint destination{boost::asio::ip::address_v4(load32(ip + 16)), load16(ip + ip_header_size + 2)};
+        datagram.trim_front(ip_header_size + udp_header_size);
+        return destination;
+    }
+
+    bool make_echo_response(packet_buffer &request, const header &header, boost::asio::ip::address_v4 local) {
+        if (header.type != echo_request) {
+            return false;
+        }
+        request.trim_front(request.size());
+        auto *recovery = request.prepend(2);
+        if (!recovery) {
+            return false;
+        }
+        recovery[0] = recovery_ie;
+        recovery[1] = 0;
+        // Sequence number ответа копируется из запроса
+        return encapsulate(request, {local, header.peer, 0, header.sequence.value_or(0), header.peer_port},
+                           echo_response);
+    }
+
+    std::optional<boost::asio::ip::address_v4> destination(std::span<const uint8_t> packet) {
+        if (packet.size() < ipv4_header_size || packet[0] >> 4 != 4) {
+            return std::nullopt;
+        }
+        return boost::asio::ip::address_v4(load32(packet.data() + 16));
+    }
+} // namespace gtpu
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <packet_buffer.h>
+
+#include <boost/asio/ip/address_v4.hpp>
+
+#include <cstdint>
+#include <optional>
+#include <span>
+
+// GTP-U (TS 29.281) поверх IPv4/UDP. Разбор и сборка заголовков работают прямо в буфере:
+// декапсуляция сдвигает начало данных за заголовки, инкапсуляция пишет их в headroom.
+namespace gtpu {
+    constexpr uint16_t port = 2152;
+
+    enum message_type : uint8_t {
+        echo_request = 1,
+        echo_response = 2,
+        error_indication = 26,
+        end_marker = 254,
+        g_pdu = 255,
+    };
+
+    constexpr size_t ipv4_header_size = 20;
+    constexpr size_t udp_header_size = 8;
+    constexpr size_t header_size = 8;
+    // Sequence number, N-PDU number и тип следующего расширения; есть, если выставлен любой из флагов E, S, PN
+    constexpr size_t optional_fields_size = 4;
+    // Внешние заголовки G-PDU без sequence number
+    constexpr size_t encapsulation_size = ipv4_header_size + udp_header_size + header_size;
+
+    struct header {
+        message_type type{};
+        uint32_t teid{};
+        std::optional<uint16_t> sequence;
+        boost::asio::ip::address_v4 peer;
+        uint16_t peer_port{};
+        // Смещение и длина полезной нагрузки от начала датаграммы: после внешних IP и UDP,
+        // GTP-U заголовка, его опциональных полей и цепочки расширений
+        size_t payload_offset{};
+        size_t payload_size{};
+    };
+
+    // Разбирает датаграмму с внешними IPv4 и UDP. nullopt, если это не GTP-U версии 1 на порту
+    // 2152, датаграмма обрезана или фрагментирована, или в ней есть неизвестное расширение,
+    // обязательное для понимания получателем
+    std::optional<header> parse(std::span<const uint8_t> datagram);
+
+    // Оставляет в буфере только полезную нагрузку разобранной датаграммы
+    bool decapsulate(packet_buffer &datagram, const header &header);
+
+    struct tunnel {
+        boost::asio::ip::address_v4 local;
+        boost::asio::ip::address_v4 remote;
+        uint32_t teid{};
+        std::optional<uint16_t> sequence{};
+        uint16_t remote_port = port;
+    };
+
+    // Дописывает GTP-U, UDP и IPv4 заголовки в headroom; false, если места не хватает
+    bool encapsulate(packet_buffer &packet, const tunnel &tunnel, message_type type = g_pdu);
+
+    struct endpoint {
+        boost::asio::ip::address_v4 address;
+        uint16_t port{};
+    };
+
+    // Внешние IPv4 и UDP заголовки для UDP сокетов: ядро снимает их при приеме и пишет само при
+    // отправке, а parse, encapsulate и make_echo_response работают с ними. prepend_ip_udp
+    // дописывает их в headroom, strip_ip_udp отрезает и возвращает адрес назначения
+    bool prepend_ip_udp(packet_buffer &datagram, const endpoint &source, const endpoint &destination);
+    std::optional<endpoint> strip_ip_udp(packet_buffer &datagram);
+
+    // Превращает разобранный Echo Request в Echo Response на месте: меняет адреса местами и
+    // ставит Recovery IE (счетчик рестартов в GTP-U всегда 0)
+    bool make_echo_response(packet_buffer &request, const header &header, boost::asio::ip::address_v4 local);
+
+    // Адрес назначения внутреннего IPv4 пакета
+    std::optional<boost::asio::ip::address_v4> destination(std::span<const uint8_t> packet);
+} // namespace gtpu
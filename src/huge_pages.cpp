@@ -0,0 +1,35 @@
+#include <huge_pages.h>
+
+#include <sys/mman.h>
+
+#include <cstdint>
+
+namespace {
+    size_t round_up(size_t bytes) { return (bytes + huge_pages::page_size - 1) & ~(huge_pages::page_size - 1); }
+} // namespace
+
+void *huge_pages::map(size_t bytes) {
+    const auto size = round_up(bytes);
+    // Берем с запасом на выравнивание и отдаем лишнее по краям
+    auto *raw = ::mmap(nullptr, size + page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+        return nullptr;
+    }
+    const auto address = reinterpret_cast<uintptr_t>(raw);
+    const auto head = round_up(address) - address;
+    auto *aligned = static_cast<std::byte *>(raw) + head;
+    if (head) {
+        ::munmap(raw, head);
+    }
+    if (head != page_size) {
+        ::munmap(aligned + size, page_size - head);
+    }
+    ::madvise(aligned, size, MADV_HUGEPAGE);
+    return aligned;
+}
+
+void huge_pages::unmap(void *memory, size_t bytes) {
+    if (memory) {
+        ::munmap(memory, round_up(bytes));
+    }
+}
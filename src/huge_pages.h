@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+
+// Анонимная память, выровненная по 2 МБ и помеченная для transparent huge pages. Для больших
+// таблиц и арен со случайным доступом: меньше промахов TLB и страничных отказов при заполнении.
+// Без поддержки THP в ядре это обычная память
+namespace huge_pages {
+    constexpr size_t page_size = size_t{2} << 20;
+
+    // Не меньше bytes, округлено до page_size; nullptr, если mmap не удался
+    [[nodiscard]] void *map(size_t bytes);
+    void unmap(void *memory, size_t bytes);
+} // namespace huge_pages
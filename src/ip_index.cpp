@@ -0,0 +1,101 @@
+#include <ip_index.h>
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <new>
+
+namespace {
+    constexpr size_t tbl24_size = size_t{1} << 24;
+    // Адресов пакетного поиска на один проход предвыборки
+    constexpr size_t find_chunk = 32;
+
+    void *map_lazy(size_t bytes) {
+        auto *memory = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                              -1, 0);
+        if (memory == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        return memory;
+    }
+} // namespace
+
+ip_index::ip_index() : _tbl24(static_cast<uint32_t **>(map_lazy(tbl24_size * sizeof(uint32_t *)))) {}
+
+ip_index::~ip_index() {
+    for (const auto &[memory, bytes] : _blocks) {
+        ::munmap(memory, bytes);
+    }
+    ::munmap(_tbl24, tbl24_size * sizeof(uint32_t *));
+}
+
+uint32_t *ip_index::map_blocks(size_t blocks) {
+    const auto bytes = blocks * block_size * sizeof(uint32_t);
+    auto *memory = map_lazy(bytes);
+    _blocks.push_back({memory, bytes});
+    return static_cast<uint32_t *>(memory);
+}
+
+void ip_index::set_block(uint32_t prefix24, uint32_t *block) {
+    // Блок уже обнулен: читатель, увидевший указатель, видит и пустые значения
+    std::atomic_ref(_tbl24[prefix24]).store(block, std::memory_order_release);
+}
+
+void ip_index::find(std::span<const uint32_t> addresses, std::span<uint32_t> values) const {
+    uint32_t *slots[find_chunk];
+    for (size_t offset = 0; offset < addresses.size(); offset += find_chunk) {
+        const auto count = std::min(find_chunk, addresses.size() - offset);
+        for (size_t i = 0; i < count; ++i) {
+            const auto address = addresses[offset + i];
+            auto *block = std::atomic_ref(_tbl24[address >> 8]).load(std::memory_order_acquire);
+            slots[i] = block ? block + (address & 0xff) : nullptr;
+            if (slots[i]) {
+                __builtin_prefetch(slots[i]);
+            }
+        }
+        for (size_t i = 0; i < count; ++i) {
+            values[offset + i] = slots[i] ? std::atomic_ref(*slots[i]).load(std::memory_order_acquire) : 0;
+        }
+    }
+}
+
+void ip_index::add_range(const boost::asio::ip::network_v4 &network) {
+    const auto first = network.network().to_uint() >> 8;
+    if (network.prefix_length() > 24) {
+        if (!_tbl24[first]) {
+            set_block(first, map_blocks(1));
+        }
+        return;
+    }
+    const size_t blocks = size_t{1} << (24 - network.prefix_length());
+    auto *memory = map_blocks(blocks);
+    for (size_t i = 0; i < blocks; ++i) {
+        const auto prefix24 = static_cast<uint32_t>(first + i);
+        if (!_tbl24[prefix24]) {
+            set_block(prefix24, memory + i * block_size);
+        }
+    }
+}
+
+void ip_index::insert_or_assign(uint32_t address, uint32_t value) {
+    auto *block = _tbl24[address >> 8];
+    if (!block) {
+        block = map_blocks(1);
+        set_block(address >> 8, block);
+    }
+    auto &slot = block[address & 0xff];
+    if (!slot) {
+        ++_size;
+    }
+    std::atomic_ref(slot).store(value, std::memory_order_release);
+}
+
+bool ip_index::erase(uint32_t address) {
+    auto *block = _tbl24[address >> 8];
+    if (!block || !block[address & 0xff]) {
+        return false;
+    }
+    std::atomic_ref(block[address & 0xff]).store(0, std::memory_order_release);
+    --_size;
+    return true;
+}
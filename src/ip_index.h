@@ -0,0 +1,73 @@
+#pragma once
+
+#include <boost/asio/ip/network_v4.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Индекс адрес IPv4 -> 32-битное значение (дескриптор сессии) прямой адресацией в стиле DIR-24-8.
+// Старшие 24 бита адреса индексируют tbl24 - указатели на блоки из 256 значений, младшие 8 бит -
+// значение в блоке. Поиск - два чтения без хеширования и проб, причем tbl24 для занятых подсетей
+// маленькая и лежит в кэше, так что в память обычно уходит одно чтение.
+//
+// Подсети пулов адресов регистрируются через add_range: блоки подсети лежат одним массивом,
+// поэтому соседние адреса соседствуют и в памяти. Пулы могут не быть смежными и пересекаться;
+// /24, уже покрытая другим пулом, остается за ним. Адрес вне зарегистрированных подсетей тоже
+// можно вставить - под его /24 выделяется отдельный блок.
+//
+// Вся память резервируется через mmap без подкачки и занимает физические страницы только там,
+// куда писали: пул /8 стоит 64 МБ адресного пространства и по 4 КБ на каждые 1024 адреса, где
+// есть сессии. Блоки не освобождаются до разрушения индекса.
+//
+// find() не блокируется и вызывается из любого числа потоков одновременно с изменениями;
+// add_range, insert_or_assign и erase - из одного потока-писателя.
+class ip_index {
+public:
+    ip_index();
+    ~ip_index();
+
+    ip_index(const ip_index &) = delete;
+    ip_index &operator=(const ip_index &) = delete;
+
+    // 0, если адреса нет
+    [[nodiscard]] uint32_t find(uint32_t address) const {
+        auto *block = std::atomic_ref(_tbl24[address >> 8]).load(std::memory_order_acquire);
+        return block ? std::atomic_ref(block[address & 0xff]).load(std::memory_order_acquire) : 0;
+    }
+
+    // Пакетный поиск: сначала для всех адресов читаются указатели tbl24 и запрашиваются строки
+    // значений, затем значения читаются - промахи кэша перекрываются
+    void find(std::span<const uint32_t> addresses, std::span<uint32_t> values) const;
+
+    // Подгружает в кэш строку tbl24 адреса
+    void prefetch(uint32_t address) const { __builtin_prefetch(&_tbl24[address >> 8]); }
+
+    // Дальше - только для писателя
+
+    void add_range(const boost::asio::ip::network_v4 &network);
+
+    // value не 0
+    void insert_or_assign(uint32_t address, uint32_t value);
+    bool erase(uint32_t address);
+
+    [[nodiscard]] size_t size() const { return _size; }
+
+private:
+    static constexpr size_t block_size = 256;
+
+    struct mapping {
+        void *memory;
+        size_t bytes;
+    };
+
+    // Обнуленная память без резерва в swap; страницы выделяются при первой записи
+    uint32_t *map_blocks(size_t blocks);
+    void set_block(uint32_t prefix24, uint32_t *block);
+
+    uint32_t **_tbl24;
+    std::vector<mapping> _blocks;
+    size_t _size{};
+};
@@ -0,0 +1,200 @@
+#include <ip_pool.h>
+
+#include <algorithm>
+#include <bit>
+
+ip_pool::ip_pool(const config &config) :
+    _network(config.network.canonical()), _first(_network.network().to_uint()),
+    _size(size_t{1} << (32 - _network.prefix_length())) {
+    // Строим уровни снизу вверх, пока не останется одно слово
+    size_t bits = _size;
+    do {
+        _levels.emplace_back((bits + 63) / 64, 0);
+        bits = _levels.back().size();
+    } while (bits > 1);
+
+    auto &leaves = _levels[0];
+    std::fill(leaves.begin(), leaves.begin() + _size / 64, ~uint64_t{0});
+    if (_size % 64) {
+        leaves.back() = (uint64_t{1} << (_size % 64)) - 1;
+    }
+    _available = _size;
+
+    const auto exclude = [&](uint32_t offset) {
+        auto &word = leaves[offset / 64];
+        const auto bit = uint64_t{1} << (offset % 64);
+        if (word & bit) {
+            word &= ~bit;
+            --_available;
+        }
+    };
+
+    // Адрес сети и широковещательный адрес не выдаются, кроме /31 и /32
+    if (_network.prefix_length() < 31) {
+        exclude(0);
+        exclude(static_cast<uint32_t>(_size - 1));
+    }
+    for (const auto &excluded : config.excluded) {
+        const auto range = excluded.canonical();
+        _excluded.push_back(range);
+        for (uint64_t ip = range.network().to_uint(); ip <= range.broadcast().to_uint(); ++ip) {
+            if (contains(boost::asio::ip::address_v4(static_cast<uint32_t>(ip)))) {
+                exclude(static_cast<uint32_t>(ip) - _first);
+            }
+        }
+    }
+
+    // Верхние уровни отражают заполненность нижних
+    for (size_t level = 1; level < _levels.size(); ++level) {
+        for (size_t word = 0; word < _levels[level - 1].size(); ++word) {
+            if (_levels[level - 1][word]) {
+                _levels[level][word / 64] |= uint64_t{1} << (word % 64);
+            }
+        }
+    }
+    _capacity = _available;
+}
+
+std::optional<boost::asio::ip::address_v4> ip_pool::allocate() {
+    if (_available == 0) {
+        return std::nullopt;
+    }
+
+    size_t offset = 0;
+    for (size_t level = _levels.size(); level-- > 0;) {
+        offset = offset * 64 + std::countr_zero(_levels[level][offset]);
+    }
+    mark_used(offset);
+    return boost::asio::ip::address_v4(_first + static_cast<uint32_t>(offset));
+}
+
+size_t ip_pool::allocate(std::span<boost::asio::ip::address_v4> addresses) {
+    size_t count = 0;
+    while (count < addresses.size() && _available) {
+        // Спускаемся к первому непустому слову нижнего уровня
+        size_t word = 0;
+        for (size_t level = _levels.size(); level-- > 1;) {
+            word = word * 64 + std::countr_zero(_levels[level][word]);
+        }
+        auto &bits = _levels[0][word];
+        while (bits && count < addresses.size()) {
+            const auto offset = word * 64 + std::countr_zero(bits);
+            bits &= bits - 1;
+            addresses[count++] = boost::asio::ip::address_v4(_first + static_cast<uint32_t>(offset));
+            --_available;
+        }
+
+        // Опустевшее слово снимается с верхних уровней, как в mark_used
+        for (size_t level = 1; !bits && level < _levels.size(); ++level) {
+            auto &upper = _levels[level][word / 64];
+            upper &= ~(uint64_t{1} << (word % 64));
+            if (upper) {
+                break;
+            }
+            word /= 64;
+        }
+    }
+    return count;
+}
+
+bool ip_pool::release(boost::asio::ip::address_v4 address) {
+    if (!contains(address)) {
+        return false;
+    }
+    const auto offset = address.to_uint() - _first;
+    // Бит исключенного адреса тоже снят: освободив его, пул выдал бы адрес сети или чужого пула
+    if ((_levels[0][offset / 64] & (uint64_t{1} << (offset % 64))) || is_excluded(offset)) {
+        return false;
+    }
+    mark_free(offset);
+    return true;
+}
+
+bool ip_pool::take(boost::asio::ip::address_v4 address) {
+    if (!contains(address)) {
+        return false;
+    }
+    const auto offset = address.to_uint() - _first;
+    if (!(_levels[0][offset / 64] & (uint64_t{1} << (offset % 64)))) {
+        return false;
+    }
+    mark_used(offset);
+    return true;
+}
+
+bool ip_pool::exclude(const boost::asio::ip::network_v4 &network) {
+    const auto range = network.canonical();
+    const auto first = std::max<uint64_t>(range.network().to_uint(), _first);
+    const auto last = std::min<uint64_t>(range.broadcast().to_uint(), uint64_t{_first} + _size - 1);
+    if (first > last) {
+        return true;
+    }
+
+    // Занятый бит - либо выданный адрес, либо уже исключенный
+    const auto is_free = [this](size_t offset) {
+        return (_levels[0][offset / 64] & (uint64_t{1} << (offset % 64))) != 0;
+    };
+    for (auto ip = first; ip <= last; ++ip) {
+        const auto offset = static_cast<uint32_t>(ip - _first);
+        if (!is_free(offset) && !is_excluded(offset)) {
+            return false;
+        }
+    }
+    for (auto ip = first; ip <= last; ++ip) {
+        const auto offset = static_cast<size_t>(ip - _first);
+        if (is_free(offset)) {
+            mark_used(offset);
+            --_capacity;
+        }
+    }
+    _excluded.push_back(range);
+    return true;
+}
+
+bool ip_pool::contains(boost::asio::ip::address_v4 address) const {
+    return static_cast<uint64_t>(address.to_uint() - _first) < _size;
+}
+
+bool ip_pool::overlaps(const boost::asio::ip::network_v4 &network) const {
+    // Подсети пересекаются, только если одна содержит другую
+    const auto prefix = std::min(network.prefix_length(), _network.prefix_length());
+    const auto mask = prefix ? ~uint32_t{0} << (32 - prefix) : 0;
+    return ((network.address().to_uint() ^ _first) & mask) == 0;
+}
+
+bool ip_pool::is_excluded(uint32_t offset) const {
+    if (_network.prefix_length() < 31 && (offset == 0 || offset == _size - 1)) {
+        return true;
+    }
+    const boost::asio::ip::address_v4 address(_first + offset);
+    return std::any_of(_excluded.begin(), _excluded.end(), [&](const auto &range) {
+        return ((address.to_uint() ^ range.network().to_uint()) & range.netmask().to_uint()) == 0;
+    });
+}
+
+void ip_pool::mark_used(size_t offset) {
+    --_available;
+    // Поднимаемся, пока слово становится пустым
+    for (auto &level : _levels) {
+        auto &word = level[offset / 64];
+        word &= ~(uint64_t{1} << (offset % 64));
+        if (word) {
+            break;
+        }
+        offset /= 64;
+    }
+}
+
+void ip_pool::mark_free(size_t offset) {
+    ++_available;
+    // Поднимаемся, пока слово было пустым
+    for (auto &level : _levels) {
+        auto &word = level[offset / 64];
+        const bool was_empty = word == 0;
+        word |= uint64_t{1} << (offset % 64);
+        if (!was_empty) {
+            break;
+        }
+        offset /= 64;
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <boost/asio/ip/address_v4.hpp>
+#include <boost/asio/ip/network_v4.hpp>
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+// Пул адресов UE внутри одной подсети. Свободные адреса отмечены в иерархической битовой карте:
+// бит уровня k установлен, если в соответствующем 64-битном слове уровня k - 1 есть свободный
+// адрес. Выделение спускается от корня по countr_zero, освобождение поднимается к корню, поэтому
+// обе операции занимают не больше четырех слов на уровень для /8 и не зависят от заполненности.
+//
+// Вся память выделяется в конструкторе. Выдается наименьший свободный адрес.
+class ip_pool {
+public:
+    struct config {
+        boost::asio::ip::network_v4 network;
+        // Подсети, адреса которых не выдаются; отдельный адрес задается как /32
+        std::vector<boost::asio::ip::network_v4> excluded;
+    };
+
+    explicit ip_pool(const config &config);
+
+    [[nodiscard]] std::optional<boost::asio::ip::address_v4> allocate();
+    // Заполняет addresses наименьшими свободными адресами, забирая их из битовой карты по слову
+    // за раз; возвращает, сколько выдано
+    size_t allocate(std::span<boost::asio::ip::address_v4> addresses);
+
+    // false, если адрес не из пула, исключен или уже свободен
+    bool release(boost::asio::ip::address_v4 address);
+    // Выдает конкретный адрес, например сессии, восстановленной после перезапуска; false, если
+    // адрес не из пула или уже занят
+    bool take(boost::asio::ip::address_v4 address);
+
+    // Исключает подсеть из выдачи после создания пула, например под пул другого APN внутри этого.
+    // false и пул без изменений, если какой-то адрес подсети уже выдан
+    bool exclude(const boost::asio::ip::network_v4 &network);
+
+    [[nodiscard]] bool contains(boost::asio::ip::address_v4 address) const;
+    [[nodiscard]] bool overlaps(const boost::asio::ip::network_v4 &network) const;
+
+    [[nodiscard]] const boost::asio::ip::network_v4 &network() const { return _network; }
+    [[nodiscard]] size_t available() const { return _available; }
+    [[nodiscard]] size_t capacity() const { return _capacity; }
+
+private:
+    void mark_used(size_t offset);
+    void mark_free(size_t offset);
+    [[nodiscard]] bool is_excluded(uint32_t offset) const;
+
+    boost::asio::ip::network_v4 _network;
+    uint32_t _first{};
+    size_t _size{};
+    size_t _capacity{};
+    size_t _available{};
+    std::vector<boost::asio::ip::network_v4> _excluded;
+    // _levels[0] - по биту на адрес, последний уровень - одно слово
+    std::vector<std::vector<uint64_t>> _levels;
+};
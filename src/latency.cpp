@@ -0,0 +1,178 @@
+#include <latency.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace latency {
+    namespace {
+        struct thread_histograms {
+            std::array<histogram, operation_count> histograms;
+            bool in_use = false;
+        };
+
+        // Гистограммы потоков. Завершившийся поток возвращает свои, и их продолжает новый поток:
+        // суммы не теряются, а память не растет с числом когда-либо запущенных потоков
+        class registry {
+        public:
+            thread_histograms *acquire() {
+                std::lock_guard lock(_mutex);
+                auto it = std::find_if(_threads.begin(), _threads.end(), [](const auto &t) { return !t->in_use; });
+                if (it == _threads.end()) {
+                    it = _threads.insert(_threads.end(), std::make_unique<thread_histograms>());
+                }
+                (*it)->in_use = true;
+                return it->get();
+            }
+
+            void release(thread_histograms *histograms) {
+                std::lock_guard lock(_mutex);
+                histograms->in_use = false;
+            }
+
+            histogram merged(operation op) {
+                std::lock_guard lock(_mutex);
+                histogram result;
+                for (const auto &t : _threads) {
+                    result.merge(t->histograms[op]);
+                }
+                return result;
+            }
+
+        private:
+            std::mutex _mutex;
+            std::vector<std::unique_ptr<thread_histograms>> _threads;
+        };
+
+        registry &global_registry() {
+            static registry r;
+            return r;
+        }
+
+        struct thread_registration {
+            thread_histograms *histograms{};
+
+            ~thread_registration() {
+                if (histograms) {
+                    global_registry().release(histograms);
+                }
+            }
+        };
+
+        thread_local thread_registration registration;
+    } // namespace
+
+    const char *name(operation op) {
+        switch (op) {
+            case uplink:
+                return "uplink";
+            case downlink:
+                return "downlink";
+            case create_pdn_connection:
+                return "create_pdn_connection";
+            case delete_pdn_connection:
+                return "delete_pdn_connection";
+            case create_bearer:
+                return "create_bearer";
+            case delete_bearer:
+                return "delete_bearer";
+            default:
+                return "unknown";
+        }
+    }
+
+    double ticks_per_ns() {
+        static const double ratio = [] {
+#if defined(__x86_64__) || defined(__i386__)
+            const auto clock_start = std::chrono::steady_clock::now();
+            const auto ticks_start = now();
+            auto elapsed = std::chrono::steady_clock::duration{};
+            while (elapsed < std::chrono::milliseconds(10)) {
+                elapsed = std::chrono::steady_clock::now() - clock_start;
+            }
+            const auto ticks = now() - ticks_start;
+            return static_cast<double>(ticks) /
+                   static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+#else
+            return 1.0;
+#endif
+        }();
+        return ratio;
+    }
+
+    void histogram::merge(const histogram &other) {
+        for (size_t i = 0; i < bucket_count; ++i) {
+            if (const auto n = other._counts[i].load(std::memory_order_relaxed)) {
+                add(_counts[i], n);
+            }
+        }
+        add(_total, other.count());
+        if (other.max() > max()) {
+            _max.store(other.max(), std::memory_order_relaxed);
+        }
+    }
+
+    uint64_t histogram::percentile(double p) const {
+        // Писатель может добавить значения во время обхода, поэтому ранг считается от суммы корзин
+        std::array<uint64_t, bucket_count> counts;
+        uint64_t total = 0;
+        for (size_t i = 0; i < bucket_count; ++i) {
+            counts[i] = _counts[i].load(std::memory_order_relaxed);
+            total += counts[i];
+        }
+        if (total == 0) {
+            return 0;
+        }
+
+        const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::clamp(p, 0.0, 100.0) / 100.0 *
+                                                                      static_cast<double>(total) + 0.5));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < bucket_count; ++i) {
+            seen += counts[i];
+            if (seen >= rank) {
+                const auto highest = i + 1 < bucket_count ? lowest_value(i + 1) - 1 : UINT64_MAX;
+                return std::min(highest, std::max(max(), lowest_value(i)));
+            }
+        }
+        return max();
+    }
+
+    uint64_t histogram::lowest_value(size_t bucket) {
+        const auto shift = std::max<size_t>(bucket >> sub_bucket_bits, 1) - 1;
+        return static_cast<uint64_t>(bucket - (shift << sub_bucket_bits)) << shift;
+    }
+
+    void record(operation op, uint64_t ticks) {
+        auto &r = registration;
+        if (!r.histograms) {
+            r.histograms = global_registry().acquire();
+        }
+        r.histograms->histograms[op].record(ticks);
+    }
+
+    histogram merged(operation op) { return global_registry().merged(op); }
+
+    void dump(std::ostream &out) {
+        const auto ns = [scale = 1.0 / ticks_per_ns()](uint64_t ticks) {
+            return static_cast<uint64_t>(static_cast<double>(ticks) * scale + 0.5);
+        };
+
+        out << std::left << std::setw(24) << "operation" << std::right << std::setw(12) << "count"
+            << std::setw(12) << "p50_ns" << std::setw(12) << "p99_ns" << std::setw(12) << "p99.9_ns"
+            << std::setw(12) << "max_ns" << '\n';
+        for (size_t i = 0; i < operation_count; ++i) {
+            const auto op = static_cast<operation>(i);
+            const auto h = merged(op);
+            if (h.count() == 0) {
+                continue;
+            }
+            out << std::left << std::setw(24) << name(op) << std::right << std::setw(12) << h.count()
+                << std::setw(12) << ns(h.percentile(50)) << std::setw(12) << ns(h.percentile(99))
+                << std::setw(12) << ns(h.percentile(99.9)) << std::setw(12) << ns(h.max()) << '\n';
+        }
+    }
+} // namespace latency
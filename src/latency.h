@@ -0,0 +1,132 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+// Задержки операций data plane и control plane. Каждый поток пишет в свои гистограммы без
+// блокировок и атомарных read-modify-write; merged() и dump() собирают их из любого потока.
+//
+// Замеры в коде - latency::scope, они включаются опцией CMake SIMPLE_PGW_LATENCY. Без нее scope
+// пустой и компилятор убирает его целиком, вместе с чтением TSC.
+namespace latency {
+#if defined(SIMPLE_PGW_LATENCY)
+    constexpr bool enabled = true;
+#else
+    constexpr bool enabled = false;
+#endif
+
+    enum operation : size_t {
+        uplink,    // Поштучные handle_uplink и handle_uplink_buffer; burst'ы не замеряются
+        downlink,  // То же для downlink
+        create_pdn_connection,
+        delete_pdn_connection,
+        create_bearer,
+        delete_bearer,
+        operation_count
+    };
+
+    [[nodiscard]] const char *name(operation op);
+
+    // Такты TSC; там, где его нет, - наносекунды steady_clock
+    inline uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+    }
+
+    // Частота now() в тактах на наносекунду; калибруется при первом вызове, около 10 мс
+    [[nodiscard]] double ticks_per_ns();
+
+    // Лог-линейная гистограмма в духе HdrHistogram: значения меньше 2^sub_bucket_bits хранятся
+    // точно, дальше каждая степень двойки делится на 2^sub_bucket_bits корзин. Относительная
+    // ошибка не больше 1/32 на всем диапазоне uint64_t, размер постоянный - 15 КБ.
+    //
+    // record() вызывает только один поток-владелец; остальное можно вызывать из любого потока
+    class histogram {
+    public:
+        static constexpr unsigned sub_bucket_bits = 5;
+        static constexpr size_t bucket_count = (64 - sub_bucket_bits + 1) << sub_bucket_bits;
+
+        histogram() = default;
+        histogram(const histogram &other) { merge(other); }
+        histogram &operator=(const histogram &) = delete;
+
+        void record(uint64_t value, uint64_t count = 1) {
+            add(_counts[bucket_of(value)], count);
+            add(_total, count);
+            if (value > _max.load(std::memory_order_relaxed)) {
+                _max.store(value, std::memory_order_relaxed);
+            }
+        }
+
+        // Значения other добавляются к этой гистограмме; писать в нее в это время нельзя
+        void merge(const histogram &other);
+
+        [[nodiscard]] uint64_t count() const { return _total.load(std::memory_order_relaxed); }
+        [[nodiscard]] uint64_t max() const { return _max.load(std::memory_order_relaxed); }
+        // Верхняя граница корзины, в которую попал перцентиль p (0-100); 0 для пустой гистограммы
+        [[nodiscard]] uint64_t percentile(double p) const;
+
+        static size_t bucket_of(uint64_t value) {
+            const auto top = std::bit_width(value | (uint64_t{1} << sub_bucket_bits)) - 1;
+            const auto shift = static_cast<unsigned>(top) - sub_bucket_bits;
+            return (size_t{shift} << sub_bucket_bits) + static_cast<size_t>(value >> shift);
+        }
+        // Наименьшее значение корзины
+        static uint64_t lowest_value(size_t bucket);
+
+    private:
+        static void add(std::atomic<uint64_t> &counter, uint64_t n) {
+            counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+
+        std::array<std::atomic<uint64_t>, bucket_count> _counts{};
+        std::atomic<uint64_t> _total{0};
+        std::atomic<uint64_t> _max{0};
+    };
+
+    // В гистограмму операции для текущего потока; значение - в тактах now()
+    void record(operation op, uint64_t ticks);
+
+    // Сумма гистограмм операции по всем потокам, в том числе завершившимся
+    [[nodiscard]] histogram merged(operation op);
+
+    // Таблица count и p50/p99/p99.9/max в наносекундах по всем операциям, у которых есть замеры
+    void dump(std::ostream &out);
+
+    // Замер от конструктора до деструктора
+    class scope {
+    public:
+        explicit scope(operation op) {
+            if constexpr (enabled) {
+                _op = op;
+                _start = now();
+            }
+        }
+
+        ~scope() {
+            if constexpr (enabled) {
+                record(_op, now() - _start);
+            }
+        }
+
+        scope(const scope &) = delete;
+        scope &operator=(const scope &) = delete;
+
+    private:
+        operation _op{};
+        uint64_t _start{};
+    };
+} // namespace latency
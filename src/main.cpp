@@ -1 +1,138 @@
-int main() { return 0; }
+#include <control_plane.h>
+#include <gtpc_engine.h>
+#include <gtpc_transport.h>
+#include <udp_data_plane.h>
+
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/signal_set.hpp>
+
+#include <atomic>
+#include <csignal>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+    struct options {
+        boost::asio::ip::address_v4 control_address;
+        udp_data_plane::config data_plane;
+        std::vector<std::pair<std::string, boost::asio::ip::address_v4>> apns;
+    };
+
+    constexpr std::string_view usage =
+        "usage: simple_pgw --apn NAME=GATEWAY... [--control ADDR] [--gtpu ADDR] [--sgi ADDR[:PORT]]\n"
+        "                  [--apn-port PORT] [--batch N]\n"
+        "  --control   S5/S8-C address, GTP-C on port 2123 (default 127.0.0.1)\n"
+        "  --gtpu      S5/S8-U address, GTP-U on port 2152 (default: control address)\n"
+        "  --sgi       SGi address and port for IP-in-UDP from APN gateways (default: control address, 2153)\n"
+        "  --apn-port  UDP port of APN gateways on SGi (default 2153)\n"
+        "  --batch     datagrams per recvmmsg/sendmmsg (default 32)\n";
+
+    uint16_t parse_port(std::string_view text) {
+        const auto port = std::stoul(std::string(text));
+        if (port > UINT16_MAX) {
+            throw std::out_of_range("port");
+        }
+        return static_cast<uint16_t>(port);
+    }
+
+    // Бросает исключение на неизвестном или неполном аргументе
+    options parse_options(int argc, char **argv) {
+        options result;
+        result.control_address = boost::asio::ip::make_address_v4("127.0.0.1");
+        std::optional<boost::asio::ip::address_v4> gtpu, sgi;
+        for (int i = 1; i < argc; ++i) {
+            const std::string_view name = argv[i];
+            if (i + 1 == argc) {
+                throw std::invalid_argument(std::string(name));
+            }
+            const std::string_view value = argv[++i];
+            if (name == "--control") {
+                result.control_address = boost::asio::ip::make_address_v4(value);
+            } else if (name == "--gtpu") {
+                gtpu = boost::asio::ip::make_address_v4(value);
+            } else if (name == "--sgi") {
+                const auto colon = value.find(':');
+                sgi = boost::asio::ip::make_address_v4(value.substr(0, colon));
+                if (colon != std::string_view::npos) {
+                    result.data_plane.sgi_port = parse_port(value.substr(colon + 1));
+                }
+            } else if (name == "--apn-port") {
+                result.data_plane.apn_gateway_port = parse_port(value);
+            } else if (name == "--batch") {
+                result.data_plane.batch_size = std::stoul(std::string(value));
+            } else if (name == "--apn") {
+                const auto equals = value.find('=');
+                if (equals == std::string_view::npos) {
+                    throw std::invalid_argument(std::string(value));
+                }
+                result.apns.emplace_back(value.substr(0, equals),
+                                         boost::asio::ip::make_address_v4(value.substr(equals + 1)));
+            } else {
+                throw std::invalid_argument(std::string(name));
+            }
+        }
+        if (result.apns.empty() || !result.data_plane.batch_size) {
+            throw std::invalid_argument("--apn");
+        }
+        result.data_plane.gtpu_address = gtpu.value_or(result.control_address);
+        result.data_plane.sgi_address = sgi.value_or(result.control_address);
+        return result;
+    }
+} // namespace
+
+// Управляющий поток - io_context с GTP-C, data plane - свой поток с циклом recvmmsg. SIGINT и
+// SIGTERM останавливают оба
+int main(int argc, char **argv) {
+    options config;
+    try {
+        config = parse_options(argc, argv);
+    } catch (const std::exception &error) {
+        std::cerr << "simple_pgw: bad argument " << error.what() << "\n" << usage;
+        return 2;
+    }
+
+    try {
+        control_plane cp;
+        for (const auto &[name, gateway] : config.apns) {
+            cp.add_apn(name, gateway);
+        }
+
+        udp_data_plane data_plane(cp, config.data_plane);
+        boost::asio::io_context io;
+        udp_transport transport(io.get_executor(), {config.control_address, gtpc::port});
+        gtpc_engine engine(cp, transport,
+                           {.control_address = config.control_address, .user_address = config.data_plane.gtpu_address});
+        boost::asio::co_spawn(io, engine.run(), boost::asio::detached);
+
+        std::atomic<bool> stop{false};
+        boost::asio::signal_set signals(io, SIGINT, SIGTERM);
+        signals.async_wait([&](const boost::system::error_code &, int) {
+            stop = true;
+            io.stop();
+        });
+
+        std::thread forwarding([&] { data_plane.run(stop); });
+        try {
+            io.run();
+        } catch (...) {
+            stop = true;
+            forwarding.join();
+            throw;
+        }
+        stop = true;
+        forwarding.join();
+    } catch (const std::exception &error) {
+        std::cerr << "simple_pgw: " << error.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,52 @@
+#include <object_arena.h>
+
+#include <huge_pages.h>
+
+object_arena::~object_arena() {
+    for (auto *region : _regions) {
+        huge_pages::unmap(region, region_size);
+    }
+}
+
+void *object_arena::allocate(size_t size) {
+    if (size == 0 || size > max_block_size) {
+        return ::operator new(size);
+    }
+    const auto index = (size - 1) / block_alignment;
+    auto &c = _classes[index];
+
+    if (!c.local) {
+        c.local = c.remote.exchange(nullptr, std::memory_order_acquire);
+    }
+    if (auto *block = c.local) {
+        c.local = block->next;
+        return block;
+    }
+
+    const auto block_size = (index + 1) * block_alignment;
+    if (static_cast<size_t>(_end - _cursor) < block_size) {
+        // Остаток старого участка пропадает: он меньше max_block_size
+        auto *region = static_cast<std::byte *>(huge_pages::map(region_size));
+        if (!region) {
+            throw std::bad_alloc();
+        }
+        _regions.push_back(region);
+        _cursor = region;
+        _end = region + region_size;
+    }
+    auto *block = _cursor;
+    _cursor += block_size;
+    return block;
+}
+
+void object_arena::deallocate(void *block, size_t size) noexcept {
+    if (size == 0 || size > max_block_size) {
+        ::operator delete(block);
+        return;
+    }
+    auto &c = _classes[(size - 1) / block_alignment];
+    auto *node = static_cast<free_block *>(block);
+    node->next = c.remote.load(std::memory_order_relaxed);
+    while (!c.remote.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Память для объектов сессий. Блоки нарезаются из участков в huge pages, поэтому миллион
+// сессий - сотни страничных отказов вместо сотен тысяч, а объекты одной пачки лежат рядом.
+// Освобожденный блок возвращается в список своего размера и выдается снова; сами участки
+// возвращаются системе только вместе с ареной.
+//
+// Выделяет один поток (управляющий), освобождать можно из любого: последний shared_ptr может
+// умереть в data plane потоке или при reclaim. Такие блоки попадают в lock-free стек и
+// забираются выделяющим потоком целиком, поэтому ABA не возникает.
+//
+// allocator<T> владеет ареной через shared_ptr: объекты, созданные через std::allocate_shared,
+// держат арену, пока живы, даже если control plane уже разрушен.
+class object_arena {
+public:
+    static constexpr size_t block_alignment = 64;
+    static constexpr size_t max_block_size = 1024;
+    static constexpr size_t region_size = size_t{16} << 20;
+
+    object_arena() = default;
+    ~object_arena();
+
+    object_arena(const object_arena &) = delete;
+    object_arena &operator=(const object_arena &) = delete;
+
+    // Блоки больше max_block_size берутся из ::operator new
+    [[nodiscard]] void *allocate(size_t size);
+    void deallocate(void *block, size_t size) noexcept;
+
+    template<class T>
+    class allocator {
+    public:
+        using value_type = T;
+
+        explicit allocator(std::shared_ptr<object_arena> arena) : _arena(std::move(arena)) {}
+        template<class U>
+        allocator(const allocator<U> &other) : _arena(other._arena) {}
+
+        T *allocate(size_t n) {
+            static_assert(alignof(T) <= block_alignment);
+            return static_cast<T *>(_arena->allocate(n * sizeof(T)));
+        }
+        void deallocate(T *p, size_t n) noexcept { _arena->deallocate(p, n * sizeof(T)); }
+
+        template<class U>
+        bool operator==(const allocator<U> &other) const {
+            return _arena == other._arena;
+        }
+
+    private:
+        template<class>
+        friend class allocator;
+
+        std::shared_ptr<object_arena> _arena;
+    };
+
+private:
+    static constexpr size_t size_classes = max_block_size / block_alignment;
+
+    struct free_block {
+        free_block *next;
+    };
+
+    struct size_class {
+        free_block *local = nullptr;
+        std::atomic<free_block *> remote{nullptr};
+    };
+
+    std::array<size_class, size_classes> _classes;
+    std::byte *_cursor = nullptr;
+    std::byte *_end = nullptr;
+    std::vector<std::byte *> _regions;
+};
@@ -0,0 +1,260 @@
+#include <packet_buffer.h>
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+// Номера слотов для кэшей потоков. Номер освобождается при завершении потока, а содержимое
+// кэшей этого слота сбрасывается в общие стеки живых пулов.
+class packet_pool_registry {
+public:
+    static packet_pool_registry &instance() {
+        static packet_pool_registry registry;
+        return registry;
+    }
+
+    size_t acquire_slot() {
+        std::lock_guard lock(_mutex);
+        if (!_free_slots.empty()) {
+            auto id = _free_slots.back();
+            _free_slots.pop_back();
+            return id;
+        }
+        return _next_slot++;
+    }
+
+    void release_slot(size_t id) {
+        std::lock_guard lock(_mutex);
+        if (id < packet_pool::max_thread_caches) {
+            for (auto *pool : _pools) {
+                pool->flush_cache(id);
+            }
+        }
+        _free_slots.push_back(id);
+    }
+
+    void add(packet_pool *pool) {
+        std::lock_guard lock(_mutex);
+        _pools.push_back(pool);
+    }
+
+    void remove(packet_pool *pool) {
+        std::lock_guard lock(_mutex);
+        std::erase(_pools, pool);
+    }
+
+private:
+    std::mutex _mutex;
+    std::vector<packet_pool *> _pools;
+    std::vector<size_t> _free_slots;
+    size_t _next_slot{};
+};
+
+namespace {
+    constexpr size_t cache_line = 64;
+    constexpr size_t hugepage_size = 2 * 1024 * 1024;
+
+    struct thread_slot {
+        thread_slot() : id(packet_pool_registry::instance().acquire_slot()) {}
+        ~thread_slot() { packet_pool_registry::instance().release_slot(id); }
+
+        size_t id;
+    };
+
+    size_t current_thread_slot() {
+        thread_local thread_slot slot;
+        return slot.id;
+    }
+
+    size_t round_up(size_t value, size_t align) { return (value + align - 1) / align * align; }
+} // namespace
+
+packet_buffer::packet_buffer(packet_pool *pool, uint8_t *buffer, uint32_t offset, uint32_t length) :
+    _pool(pool), _buffer(buffer), _offset(offset), _length(length) {}
+
+packet_buffer::packet_buffer(packet_buffer &&other) noexcept :
+    _pool(std::exchange(other._pool, nullptr)), _buffer(std::exchange(other._buffer, nullptr)),
+    _offset(std::exchange(other._offset, 0)), _length(std::exchange(other._length, 0)) {}
+
+packet_buffer &packet_buffer::operator=(packet_buffer &&other) noexcept {
+    if (this != &other) {
+        reset();
+        _pool = std::exchange(other._pool, nullptr);
+        _buffer = std::exchange(other._buffer, nullptr);
+        _offset = std::exchange(other._offset, 0);
+        _length = std::exchange(other._length, 0);
+    }
+    return *this;
+}
+
+packet_buffer::~packet_buffer() { reset(); }
+
+size_t packet_buffer::tailroom() const { return _buffer ? _pool->buffer_size() - _offset - _length : 0; }
+
+uint8_t *packet_buffer::prepend(size_t len) {
+    if (!_buffer || len > _offset) {
+        return nullptr;
+    }
+    _offset -= len;
+    _length += len;
+    return data();
+}
+
+uint8_t *packet_buffer::append(size_t len) {
+    if (!_buffer || len > tailroom()) {
+        return nullptr;
+    }
+    auto *tail = data() + _length;
+    _length += len;
+    return tail;
+}
+
+bool packet_buffer::trim_front(size_t len) {
+    if (len > _length) {
+        return false;
+    }
+    _offset += len;
+    _length -= len;
+    return true;
+}
+
+bool packet_buffer::trim_back(size_t len) {
+    if (len > _length) {
+        return false;
+    }
+    _length -= len;
+    return true;
+}
+
+void packet_buffer::reset() {
+    if (_buffer) {
+        _pool->give(_buffer);
+    }
+    _pool = nullptr;
+    _buffer = nullptr;
+    _offset = 0;
+    _length = 0;
+}
+
+packet_pool::packet_pool(const config &config) :
+    _config(config), _caches(std::make_unique<thread_cache[]>(max_thread_caches)) {
+    if (_config.buffer_size > UINT32_MAX || _config.headroom + _config.tailroom > _config.buffer_size) {
+        throw std::invalid_argument("packet_pool: headroom and tailroom exceed buffer size");
+    }
+
+    // Буферы выравниваем по кэш-линии, чтобы соседние пакеты не делили линию
+    const size_t stride = round_up(_config.buffer_size, cache_line);
+    const size_t total = std::max<size_t>(stride * _config.buffer_count, 1);
+
+    void *memory = MAP_FAILED;
+    if (_config.use_hugepages) {
+        _mapped_size = round_up(total, hugepage_size);
+        memory = mmap(nullptr, _mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1,
+                      0);
+        _hugepages = memory != MAP_FAILED;
+    }
+    if (memory == MAP_FAILED) {
+        // Нет зарезервированных hugepages - просим transparent hugepages у ядра
+        _mapped_size = round_up(total, hugepage_size);
+        memory = mmap(nullptr, _mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        if (_config.use_hugepages) {
+            madvise(memory, _mapped_size, MADV_HUGEPAGE);
+        }
+    }
+    _memory = static_cast<uint8_t *>(memory);
+
+    _free.reserve(_config.buffer_count);
+    for (size_t i = _config.buffer_count; i > 0; --i) {
+        _free.push_back(_memory + (i - 1) * stride);
+    }
+
+    packet_pool_registry::instance().add(this);
+}
+
+packet_pool::~packet_pool() {
+    packet_pool_registry::instance().remove(this);
+    munmap(_memory, _mapped_size);
+}
+
+packet_buffer packet_pool::allocate() {
+    auto *buffer = take();
+    if (!buffer) {
+        return {};
+    }
+    return {this, buffer, static_cast<uint32_t>(_config.headroom), 0};
+}
+
+packet_buffer packet_pool::allocate(std::span<const uint8_t> data) {
+    if (data.size() > max_data_size()) {
+        return {};
+    }
+    auto packet = allocate();
+    if (packet) {
+        // Не memcpy: у пустого span data() бывает nullptr
+        std::copy_n(data.data(), data.size(), packet.append(data.size()));
+    }
+    return packet;
+}
+
+size_t packet_pool::available() const {
+    std::lock_guard lock(_mutex);
+    return _free.size();
+}
+
+uint8_t *packet_pool::take() {
+    auto slot = current_thread_slot();
+    if (slot >= max_thread_caches) {
+        std::lock_guard lock(_mutex);
+        if (_free.empty()) {
+            return nullptr;
+        }
+        auto *buffer = _free.back();
+        _free.pop_back();
+        return buffer;
+    }
+
+    auto &cache = _caches[slot];
+    if (cache.count == 0) {
+        // Забираем из общего стека сразу половину кэша
+        std::lock_guard lock(_mutex);
+        auto n = std::min(thread_cache_size / 2, _free.size());
+        std::copy(_free.end() - n, _free.end(), cache.buffers.begin());
+        _free.resize(_free.size() - n);
+        cache.count = n;
+        if (n == 0) {
+            return nullptr;
+        }
+    }
+    return cache.buffers[--cache.count];
+}
+
+void packet_pool::give(uint8_t *buffer) {
+    auto slot = current_thread_slot();
+    if (slot >= max_thread_caches) {
+        std::lock_guard lock(_mutex);
+        _free.push_back(buffer);
+        return;
+    }
+
+    auto &cache = _caches[slot];
+    if (cache.count == thread_cache_size) {
+        std::lock_guard lock(_mutex);
+        const auto n = thread_cache_size / 2;
+        _free.insert(_free.end(), cache.buffers.begin() + (thread_cache_size - n), cache.buffers.end());
+        cache.count -= n;
+    }
+    cache.buffers[cache.count++] = buffer;
+}
+
+void packet_pool::flush_cache(size_t slot) {
+    auto &cache = _caches[slot];
+    std::lock_guard lock(_mutex);
+    _free.insert(_free.end(), cache.buffers.begin(), cache.buffers.begin() + cache.count);
+    cache.count = 0;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+class packet_pool;
+class packet_pool_registry;
+
+// Move-only дескриптор буфера из packet_pool. Данные лежат в [data(), data() + size()),
+// перед ними headroom под заголовки, после них tailroom.
+class packet_buffer {
+public:
+    packet_buffer() = default;
+    packet_buffer(packet_buffer &&other) noexcept;
+    packet_buffer &operator=(packet_buffer &&other) noexcept;
+    packet_buffer(const packet_buffer &) = delete;
+    packet_buffer &operator=(const packet_buffer &) = delete;
+    ~packet_buffer();
+
+    [[nodiscard]] explicit operator bool() const { return _buffer != nullptr; }
+
+    [[nodiscard]] uint8_t *data() { return _buffer + _offset; }
+    [[nodiscard]] const uint8_t *data() const { return _buffer + _offset; }
+    [[nodiscard]] size_t size() const { return _length; }
+    [[nodiscard]] bool empty() const { return _length == 0; }
+
+    [[nodiscard]] size_t headroom() const { return _offset; }
+    [[nodiscard]] size_t tailroom() const;
+
+    [[nodiscard]] std::span<uint8_t> bytes() { return {data(), size()}; }
+    [[nodiscard]] std::span<const uint8_t> bytes() const { return {data(), size()}; }
+
+    // Возвращают nullptr, если места не хватает
+    uint8_t *prepend(size_t len);
+    uint8_t *append(size_t len);
+
+    // Отрезают данные с начала или с конца без копирования
+    bool trim_front(size_t len);
+    bool trim_back(size_t len);
+
+    void reset();
+
+private:
+    friend packet_pool;
+
+    packet_buffer(packet_pool *pool, uint8_t *buffer, uint32_t offset, uint32_t length);
+
+    packet_pool *_pool{};
+    uint8_t *_buffer{};
+    uint32_t _offset{};
+    uint32_t _length{};
+};
+
+// Пул буферов фиксированного размера с резервом под заголовки (аналог mbuf pool).
+// Свободные буферы кэшируются по потокам, общий стек защищен мьютексом. При завершении
+// потока его кэши возвращаются в общие стеки всех пулов.
+class packet_pool {
+public:
+    struct config {
+        size_t buffer_count = 8192;
+        size_t buffer_size = 2048;
+        size_t headroom = 128;
+        size_t tailroom = 0;
+        bool use_hugepages = false;
+    };
+
+    static constexpr size_t thread_cache_size = 64;
+    static constexpr size_t max_thread_caches = 64;
+
+    explicit packet_pool(const config &config);
+    ~packet_pool();
+
+    packet_pool(const packet_pool &) = delete;
+    packet_pool &operator=(const packet_pool &) = delete;
+
+    // Пустой дескриптор, если пул исчерпан или данные не помещаются
+    packet_buffer allocate();
+    packet_buffer allocate(std::span<const uint8_t> data);
+
+    [[nodiscard]] size_t buffer_count() const { return _config.buffer_count; }
+    [[nodiscard]] size_t buffer_size() const { return _config.buffer_size; }
+    [[nodiscard]] size_t headroom() const { return _config.headroom; }
+    [[nodiscard]] size_t max_data_size() const { return _config.buffer_size - _config.headroom - _config.tailroom; }
+    [[nodiscard]] bool uses_hugepages() const { return _hugepages; }
+
+    // Число буферов в общем стеке; буферы в кэшах потоков не учитываются
+    [[nodiscard]] size_t available() const;
+
+private:
+    friend packet_buffer;
+    friend packet_pool_registry;
+
+    struct alignas(64) thread_cache {
+        size_t count{};
+        std::array<uint8_t *, thread_cache_size> buffers{};
+    };
+
+    uint8_t *take();
+    void give(uint8_t *buffer);
+    void flush_cache(size_t slot);
+
+    config _config;
+    uint8_t *_memory{};
+    size_t _mapped_size{};
+    bool _hugepages{};
+
+    mutable std::mutex _mutex;
+    std::vector<uint8_t *> _free;
+    std::unique_ptr<thread_cache[]> _caches;
+};
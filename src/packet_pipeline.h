@@ -0,0 +1,234 @@
+#pragma once
+
+#include <control_plane.h>
+#include <data_plane.h>
+#include <epoch.h>
+#include <policer.h>
+#include <tft.h>
+#include <token_bucket.h>
+#include <traffic_counters.h>
+
+#include <boost/asio/ip/address_v4.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <span>
+#include <utility>
+
+// Data plane, собранный из политик на этапе компиляции: поиск сессий, лимиты и сток пакетов -
+// параметры шаблона, поэтому burst проходит одним циклом без виртуальных вызовов, а с no_policer
+// проверка лимитов и чтение часов исчезают совсем. Путь burst'а: поиск пачкой с предвыборкой,
+// выбор bearer по TFT для downlink, лимиты, счетчики, пересылка. data_plane::handle_*_burst -
+// этот же пайплайн с политиками над виртуальными хуками.
+//
+// Lookup:
+//   void find_bearers(std::span<const uint32_t> dp_teids, std::span<bearer *> bearers);
+//   void find_pdns(std::span<const address_v4> ips, std::span<pdn_connection *> pdns);
+// Policer - см. policer.h. Sink:
+//   void forward_to_apn(address_v4 apn_gateway, data_plane::Packet &&packet);
+//   void forward_to_sgw(address_v4 sgw_addr, uint32_t sgw_dp_teid, data_plane::Packet &&packet);
+//   void flush();  // необязательно: зовется в конце каждого куска burst'а, например чтобы
+//                  // отправить накопленные группы пакетов
+// Burst'ы из packet_buffer (data_plane::uplink_buffer, downlink_buffer) идут тем же путем, и тогда
+// Sink и reject политики принимают packet_buffer.
+//
+// Как и data_plane, один экземпляр обслуживает один поток и пишет в счетчики, переданные в
+// конструктор.
+
+// Поиск в control_plane, тот же, что у data_plane
+class session_lookup {
+public:
+    explicit session_lookup(const control_plane &control_plane) : _control_plane(control_plane) {}
+
+    void find_bearers(std::span<const uint32_t> dp_teids, std::span<bearer *> bearers) const {
+        _control_plane.find_bearers_by_dp_teid(dp_teids, bearers);
+    }
+
+    void find_pdns(std::span<const boost::asio::ip::address_v4> ips, std::span<pdn_connection *> pdns) const {
+        _control_plane.find_pdns_by_ip_address(ips, pdns);
+    }
+
+private:
+    const control_plane &_control_plane;
+};
+
+template<class Lookup, class Policer, class Sink>
+class packet_pipeline {
+public:
+    using Packet = data_plane::Packet;
+
+    packet_pipeline(Lookup lookup, Policer policer, Sink sink, traffic_counters &counters)
+        : _lookup(std::move(lookup)), _policer(std::move(policer)), _sink(std::move(sink)), _counters(counters) {}
+
+    packet_pipeline(const packet_pipeline &) = delete;
+    packet_pipeline &operator=(const packet_pipeline &) = delete;
+
+    // Пакеты из burst перемещаются в Sink в порядке burst'а
+    void handle_uplink_burst(std::span<data_plane::uplink_packet> burst) { uplink(burst); }
+    void handle_uplink_burst(std::span<data_plane::uplink_buffer> burst) { uplink(burst); }
+
+    void handle_downlink_burst(std::span<data_plane::downlink_packet> burst) { downlink(burst); }
+    void handle_downlink_burst(std::span<data_plane::downlink_buffer> burst) { downlink(burst); }
+
+    [[nodiscard]] Policer &policer() { return _policer; }
+    [[nodiscard]] Sink &sink() { return _sink; }
+    [[nodiscard]] const traffic_counters &get_counters() const { return _counters; }
+
+private:
+    template<class Entry>
+    void uplink(std::span<Entry> burst) {
+        while (!burst.empty()) {
+            const auto chunk = std::min(burst.size(), data_plane::max_burst_size);
+            uplink_chunk(burst.first(chunk));
+            burst = burst.subspan(chunk);
+        }
+    }
+
+    template<class Entry>
+    void downlink(std::span<Entry> burst) {
+        while (!burst.empty()) {
+            const auto chunk = std::min(burst.size(), data_plane::max_burst_size);
+            downlink_chunk(burst.first(chunk));
+            burst = burst.subspan(chunk);
+        }
+    }
+
+    template<class Entry>
+    void uplink_chunk(std::span<Entry> burst) {
+        epoch_guard guard;
+
+        const auto n = burst.size();
+        for (size_t i = 0; i < n; ++i) {
+            _teids[i] = burst[i].dp_teid;
+        }
+        _lookup.find_bearers(std::span(_teids).first(n), std::span(_bearers).first(n));
+        for (size_t i = 0; i < n; ++i) {
+            if (_bearers[i]) {
+                __builtin_prefetch(_bearers[i]);
+            }
+        }
+        for (size_t i = 0; i < n; ++i) {
+            _pdns[i] = _bearers[i] ? &_bearers[i]->get_pdn_view() : nullptr;
+            if (_pdns[i]) {
+                __builtin_prefetch(_pdns[i]);
+                _counters.prefetch(*_bearers[i], *_pdns[i]);
+            }
+        }
+
+        police(uplink_direction, burst);
+        for (size_t i = 0; i < n; ++i) {
+            auto *pdn = _pdns[i];
+            if (!pdn) {
+                if (_bearers[i]) {
+                    reject(uplink_direction, *_bearers[i], std::move(burst[i].packet));
+                } else {
+                    _counters.count_drop(traffic_counters::no_session);
+                }
+                continue;
+            }
+            _counters.count_uplink(*_bearers[i], *pdn, burst[i].packet.size());
+            _sink.forward_to_apn(pdn->get_apn_gw(), std::move(burst[i].packet));
+        }
+        flush();
+    }
+
+    template<class Entry>
+    void downlink_chunk(std::span<Entry> burst) {
+        epoch_guard guard;
+
+        const auto n = burst.size();
+        for (size_t i = 0; i < n; ++i) {
+            _ips[i] = burst[i].ue_ip;
+        }
+        _lookup.find_pdns(std::span(_ips).first(n), std::span(_pdns).first(n));
+        for (size_t i = 0; i < n; ++i) {
+            if (_pdns[i]) {
+                __builtin_prefetch(_pdns[i]);
+            }
+        }
+        for (size_t i = 0; i < n; ++i) {
+            auto *pdn = _pdns[i];
+            const auto &packet = burst[i].packet;
+            _bearers[i] = pdn ? pdn->find_downlink_bearer_view(tft::downlink_key({packet.data(), packet.size()}))
+                              : nullptr;
+            if (_bearers[i]) {
+                _counters.prefetch(*_bearers[i], *pdn);
+            } else {
+                _counters.count_drop(pdn ? traffic_counters::no_bearer : traffic_counters::no_session);
+                _pdns[i] = nullptr;
+            }
+        }
+
+        police(downlink_direction, burst);
+        for (size_t i = 0; i < n; ++i) {
+            auto *pdn = _pdns[i];
+            auto *bearer = _bearers[i];
+            if (!pdn) {
+                if (bearer) {
+                    reject(downlink_direction, *bearer, std::move(burst[i].packet));
+                }
+                continue;
+            }
+            _counters.count_downlink(*bearer, *pdn, burst[i].packet.size());
+            _sink.forward_to_sgw(pdn->get_sgw_address(), bearer->get_sgw_dp_teid(), std::move(burst[i].packet));
+        }
+        flush();
+    }
+
+    // Отдельным проходом, чтобы промахи по лимитам разных пакетов перекрывались. Отклоненный
+    // пакет отмечается обнулением _pdns[i]
+    template<class Burst>
+    void police(policer_direction dir, std::span<Burst> burst) {
+        if constexpr (Policer::enabled) {
+            const auto n = burst.size();
+            if constexpr (burst_policer) {
+                for (size_t i = 0; i < n; ++i) {
+                    _sizes[i] = burst[i].packet.size();
+                }
+                _policer.police(dir, std::span<bearer *const>(_bearers).first(n), std::span(_pdns).first(n),
+                                std::span<const size_t>(_sizes).first(n));
+            } else {
+                const auto now = token_bucket::now();
+                for (size_t i = 0; i < n; ++i) {
+                    if (_pdns[i] && !_policer.admit(dir, *_bearers[i], *_pdns[i], burst[i].packet.size(), now)) {
+                        _pdns[i] = nullptr;
+                    }
+                }
+            }
+        }
+    }
+
+    // Пакет, который политика не забрала, отброшен
+    template<class P>
+    void reject(policer_direction dir, bearer &bearer, P &&packet) {
+        if constexpr (requires { _policer.reject(dir, bearer, std::move(packet)); }) {
+            if (_policer.reject(dir, bearer, std::move(packet))) {
+                return;
+            }
+        }
+        _counters.count_drop(traffic_counters::policed);
+    }
+
+    void flush() {
+        if constexpr (requires { _sink.flush(); }) {
+            _sink.flush();
+        }
+    }
+
+    static constexpr bool burst_policer =
+        requires(Policer &policer, std::span<bearer *const> bearers, std::span<pdn_connection *> pdns,
+                 std::span<const size_t> sizes) { policer.police(uplink_direction, bearers, pdns, sizes); };
+
+    Lookup _lookup;
+    Policer _policer;
+    Sink _sink;
+    traffic_counters &_counters;
+
+    // Рабочие массивы одного куска burst'а
+    std::array<uint32_t, data_plane::max_burst_size> _teids{};
+    std::array<boost::asio::ip::address_v4, data_plane::max_burst_size> _ips{};
+    std::array<bearer *, data_plane::max_burst_size> _bearers{};
+    std::array<pdn_connection *, data_plane::max_burst_size> _pdns{};
+    std::array<size_t, data_plane::max_burst_size> _sizes{};
+};
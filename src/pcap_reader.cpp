@@ -0,0 +1,283 @@
+#include <pcap_reader.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <stdexcept>
+#include <system_error>
+
+namespace {
+    constexpr uint32_t pcap_magic_us = 0xa1b2c3d4;
+    constexpr uint32_t pcap_magic_ns = 0xa1b23c4d;
+    constexpr size_t pcap_header_size = 24;
+    constexpr size_t pcap_record_header_size = 16;
+
+    constexpr uint32_t block_section_header = 0x0a0d0d0a;
+    constexpr uint32_t block_interface = 1;
+    constexpr uint32_t block_simple_packet = 3;
+    constexpr uint32_t block_enhanced_packet = 6;
+    constexpr uint32_t byte_order_magic = 0x1a2b3c4d;
+    constexpr uint16_t option_end = 0;
+    constexpr uint16_t option_tsresol = 9;
+
+    // Прочитанное отпускается кусками, чтобы не звать madvise на каждую запись
+    constexpr size_t release_step = 64 << 20;
+
+    uint32_t native32(const uint8_t *p) {
+        uint32_t value;
+        __builtin_memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    uint16_t big16(const uint8_t *p) { return static_cast<uint16_t>(p[0] << 8 | p[1]); }
+
+    size_t align4(size_t size) { return (size + 3) & ~size_t{3}; }
+} // namespace
+
+pcap_reader::pcap_reader(const std::string &path) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "pcap_reader: open " + path);
+    }
+    struct stat info{};
+    if (fstat(fd, &info) != 0) {
+        const auto error = errno;
+        ::close(fd);
+        throw std::system_error(error, std::generic_category(), "pcap_reader: fstat");
+    }
+    _size = static_cast<size_t>(info.st_size);
+    if (_size < pcap_header_size) {
+        ::close(fd);
+        throw std::runtime_error("pcap_reader: file is too short");
+    }
+    auto *mapped = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    const auto error = errno;
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        throw std::system_error(error, std::generic_category(), "pcap_reader: mmap");
+    }
+    _data = static_cast<const uint8_t *>(mapped);
+    madvise(mapped, _size, MADV_SEQUENTIAL);
+
+    const auto magic = native32(_data);
+    if (magic == pcap_magic_us || magic == pcap_magic_ns ||
+        std::byteswap(magic) == pcap_magic_us || std::byteswap(magic) == pcap_magic_ns) {
+        _swapped = magic != pcap_magic_us && magic != pcap_magic_ns;
+        _pcap_interface.link_type = load32(_data + 20) & 0x0fffffff;
+        _pcap_interface.exponent = load32(_data) == pcap_magic_ns ? 9 : 6;
+        _position = pcap_header_size;
+    } else if (magic == block_section_header) {
+        _pcapng = true;
+    } else {
+        munmap(mapped, _size);
+        throw std::runtime_error("pcap_reader: not a pcap or pcapng file");
+    }
+}
+
+pcap_reader::~pcap_reader() { munmap(const_cast<uint8_t *>(_data), _size); }
+
+uint16_t pcap_reader::load16(const uint8_t *p) const {
+    uint16_t value;
+    __builtin_memcpy(&value, p, sizeof(value));
+    return _swapped ? std::byteswap(value) : value;
+}
+
+uint32_t pcap_reader::load32(const uint8_t *p) const {
+    const auto value = native32(p);
+    return _swapped ? std::byteswap(value) : value;
+}
+
+std::optional<pcap_reader::record> pcap_reader::next() {
+    release_consumed();
+    return _pcapng ? next_pcapng() : next_pcap();
+}
+
+std::optional<pcap_reader::record> pcap_reader::next_pcap() {
+    if (_size - _position < pcap_record_header_size) {
+        return std::nullopt;
+    }
+    const auto *header = _data + _position;
+    const size_t captured = load32(header + 8);
+    if (_size - _position - pcap_record_header_size < captured) {
+        return std::nullopt;
+    }
+    record result;
+    result.timestamp = std::chrono::seconds(load32(header)) + to_time(_pcap_interface, load32(header + 4));
+    result.link_type = _pcap_interface.link_type;
+    result.data = {header + pcap_record_header_size, captured};
+    result.original_size = load32(header + 12);
+    _position += pcap_record_header_size + captured;
+    return result;
+}
+
+std::optional<pcap_reader::record> pcap_reader::next_pcapng() {
+    while (_size - _position >= 12) {
+        const auto *block = _data + _position;
+        // Порядок байт задает заголовок секции, по нему читается и длина самого SHB
+        const bool section = native32(block) == block_section_header;
+        if (section) {
+            const auto magic = native32(block + 8);
+            if (magic != byte_order_magic && std::byteswap(magic) != byte_order_magic) {
+                return std::nullopt;
+            }
+            _swapped = magic != byte_order_magic;
+        }
+        const size_t length = load32(block + 4);
+        if (length < 12 || length % 4 || length > _size - _position) {
+            return std::nullopt;
+        }
+        const std::span<const uint8_t> body(block + 8, length - 12);
+        _position += length;
+
+        if (section) {
+            if (!read_section_header(body)) {
+                return std::nullopt;
+            }
+            continue;
+        }
+        switch (load32(block)) {
+            case block_interface:
+                if (!read_interface(body)) {
+                    return std::nullopt;
+                }
+                break;
+            case block_enhanced_packet: {
+                if (body.size() < 20) {
+                    return std::nullopt;
+                }
+                const auto interface_id = load32(body.data());
+                const size_t captured = load32(body.data() + 12);
+                if (interface_id >= _interfaces.size() || 20 + captured > body.size()) {
+                    return std::nullopt;
+                }
+                const auto &interface = _interfaces[interface_id];
+                const uint64_t units = uint64_t{load32(body.data() + 4)} << 32 | load32(body.data() + 8);
+                _last_timestamp = to_time(interface, units);
+                return record{_last_timestamp, interface.link_type, body.subspan(20, captured),
+                              load32(body.data() + 16)};
+            }
+            case block_simple_packet: {
+                if (body.size() < 4 || _interfaces.empty()) {
+                    return std::nullopt;
+                }
+                const auto original = load32(body.data());
+                const auto captured = std::min<size_t>(original, body.size() - 4);
+                return record{_last_timestamp, _interfaces.front().link_type, body.subspan(4, captured), original};
+            }
+            default:
+                // Статистика, резолвинг имен и прочие блоки не нужны
+                break;
+        }
+    }
+    return std::nullopt;
+}
+
+bool pcap_reader::read_section_header(std::span<const uint8_t> body) {
+    // Интерфейсы нумеруются заново в каждой секции
+    _interfaces.clear();
+    return body.size() >= 16;
+}
+
+bool pcap_reader::read_interface(std::span<const uint8_t> body) {
+    if (body.size() < 8) {
+        return false;
+    }
+    interface added;
+    added.link_type = load16(body.data());
+    for (size_t offset = 8; offset + 4 <= body.size();) {
+        const auto code = load16(body.data() + offset);
+        const size_t length = load16(body.data() + offset + 2);
+        if (code == option_end || offset + 4 + length > body.size()) {
+            break;
+        }
+        if (code == option_tsresol && length >= 1) {
+            const auto value = body[offset + 4];
+            added.binary = value & 0x80;
+            added.exponent = value & 0x7f;
+        }
+        offset += 4 + align4(length);
+    }
+    _interfaces.push_back(added);
+    return true;
+}
+
+std::chrono::nanoseconds pcap_reader::to_time(const interface &interface, uint64_t units) const {
+    if (interface.binary) {
+        const auto divisor = static_cast<long double>(uint64_t{1} << std::min<uint8_t>(interface.exponent, 63));
+        return std::chrono::nanoseconds(static_cast<int64_t>(static_cast<long double>(units) * 1e9L / divisor));
+    }
+    auto value = units;
+    for (auto exponent = interface.exponent; exponent < 9; ++exponent) {
+        value *= 10;
+    }
+    for (auto exponent = interface.exponent; exponent > 9; --exponent) {
+        value /= 10;
+    }
+    return std::chrono::nanoseconds(static_cast<int64_t>(value));
+}
+
+void pcap_reader::release_consumed() {
+    const auto page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const auto consumed = _position / page * page;
+    if (consumed - _released < release_step) {
+        return;
+    }
+    // Страницы файла снова прочитаются с диска, если к ним вернуться; мы не возвращаемся
+    madvise(const_cast<uint8_t *>(_data) + _released, consumed - _released, MADV_DONTNEED);
+    _released = consumed;
+}
+
+std::optional<std::span<const uint8_t>> pcap_reader::ipv4_packet(const record &record) {
+    auto data = record.data;
+    uint16_t protocol = 0x0800;
+    switch (record.link_type) {
+        case ethernet: {
+            constexpr uint16_t vlan = 0x8100;
+            constexpr uint16_t qinq = 0x88a8;
+            size_t offset = 12;
+            if (data.size() < offset + 2) {
+                return std::nullopt;
+            }
+            protocol = big16(data.data() + offset);
+            while ((protocol == vlan || protocol == qinq) && data.size() >= offset + 6) {
+                offset += 4;
+                protocol = big16(data.data() + offset);
+            }
+            data = data.subspan(offset + 2);
+            break;
+        }
+        case linux_sll:
+            if (data.size() < 16) {
+                return std::nullopt;
+            }
+            protocol = big16(data.data() + 14);
+            data = data.subspan(16);
+            break;
+        case linux_sll2:
+            if (data.size() < 20) {
+                return std::nullopt;
+            }
+            protocol = big16(data.data());
+            data = data.subspan(20);
+            break;
+        case raw:
+        case ipv4:
+            break;
+        default:
+            return std::nullopt;
+    }
+    if (protocol != 0x0800 || data.size() < 20 || data[0] >> 4 != 4) {
+        return std::nullopt;
+    }
+    // Добивка Ethernet до 60 байт не часть пакета
+    const size_t total = big16(data.data() + 2);
+    if (total >= 20 && total < data.size()) {
+        data = data.first(total);
+    }
+    return data;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+// Чтение pcap и pcapng через mmap: записи отдаются как span прямо в отображенный файл, без
+// копирования. Прочитанная часть файла регулярно отпускается (MADV_DONTNEED), поэтому память
+// процесса не растет с размером файла и многогигабайтные захваты читаются в постоянной памяти.
+//
+// Формат определяется по первым байтам. Поддерживаются оба порядка байт, микро- и наносекундный
+// pcap, в pcapng - секции, интерфейсы с разными link type и if_tsresol, блоки EPB и SPB.
+class pcap_reader {
+public:
+    // Значения LINKTYPE_*, из которых умеем доставать IPv4
+    enum link_type : uint32_t {
+        ethernet = 1,
+        raw = 101,
+        linux_sll = 113,
+        ipv4 = 228,
+        linux_sll2 = 276,
+    };
+
+    struct record {
+        // От эпохи Unix; у SPB без времени - время предыдущей записи
+        std::chrono::nanoseconds timestamp{};
+        uint32_t link_type{};
+        std::span<const uint8_t> data;
+        // Длина пакета в сети; больше data.size(), если захват обрезал пакет
+        uint32_t original_size{};
+    };
+
+    // std::system_error, если файл не открывается; std::runtime_error, если это не pcap/pcapng
+    explicit pcap_reader(const std::string &path);
+    ~pcap_reader();
+
+    pcap_reader(const pcap_reader &) = delete;
+    pcap_reader &operator=(const pcap_reader &) = delete;
+
+    // Следующая запись; span действителен до следующего вызова. nullopt в конце файла и на
+    // обрезанном или испорченном хвосте
+    std::optional<record> next();
+
+    [[nodiscard]] size_t position() const { return _position; }
+    [[nodiscard]] size_t size() const { return _size; }
+
+    // IPv4 пакет записи без заголовка канального уровня (VLAN теги пропускаются) и без добивки
+    // Ethernet до минимальной длины. nullopt, если это не IPv4 или link type неизвестен
+    static std::optional<std::span<const uint8_t>> ipv4_packet(const record &record);
+
+private:
+    struct interface {
+        uint32_t link_type{};
+        // Время в единицах 10^-exponent или 2^-exponent секунды
+        uint8_t exponent = 6;
+        bool binary = false;
+    };
+
+    std::optional<record> next_pcap();
+    std::optional<record> next_pcapng();
+    // Разбор SHB и IDB; false, если блок испорчен
+    bool read_section_header(std::span<const uint8_t> block);
+    bool read_interface(std::span<const uint8_t> body);
+    [[nodiscard]] std::chrono::nanoseconds to_time(const interface &interface, uint64_t units) const;
+    void release_consumed();
+
+    [[nodiscard]] uint16_t load16(const uint8_t *p) const;
+    [[nodiscard]] uint32_t load32(const uint8_t *p) const;
+
+    const uint8_t *_data{};
+    size_t _size{};
+    size_t _position{};
+    size_t _released{};
+    bool _pcapng{};
+    bool _swapped{};
+    // Классический pcap: один link type и точность времени на файл
+    interface _pcap_interface;
+    std::vector<interface> _interfaces;
+    std::chrono::nanoseconds _last_timestamp{};
+};
@@ -0,0 +1,213 @@
+#include <pcap_replay.h>
+
+#include <gtpu.h>
+
+#include <thread>
+
+namespace {
+    constexpr uint8_t protocol_udp = 17;
+    // Между вызовами poll() data plane; очередям шейперов нужен регулярный poll
+    constexpr uint64_t poll_interval = 64;
+    // Паузы короче этой выжидаются в цикле: sleep_until просыпается слишком поздно
+    constexpr std::chrono::microseconds spin_threshold{100};
+
+    uint16_t load16(const uint8_t *p) { return static_cast<uint16_t>(p[0] << 8 | p[1]); }
+    uint32_t load32(const uint8_t *p) { return uint32_t{load16(p)} << 16 | load16(p + 2); }
+
+    void store16(uint8_t *p, uint16_t value) {
+        p[0] = static_cast<uint8_t>(value >> 8);
+        p[1] = static_cast<uint8_t>(value);
+    }
+
+    void store32(uint8_t *p, uint32_t value) {
+        store16(p, static_cast<uint16_t>(value >> 16));
+        store16(p + 2, static_cast<uint16_t>(value));
+    }
+
+    // Поправка контрольной суммы IPv4 при замене 32-битного поля, RFC 1624
+    void update_checksum(uint8_t *ip, uint32_t from, uint32_t to) {
+        uint32_t sum = static_cast<uint16_t>(~load16(ip + 10));
+        sum += static_cast<uint16_t>(~(from >> 16)) + static_cast<uint16_t>(~from);
+        sum += (to >> 16) + (to & 0xffff);
+        while (sum >> 16) {
+            sum = (sum & 0xffff) + (sum >> 16);
+        }
+        store16(ip + 10, static_cast<uint16_t>(~sum));
+    }
+
+    bool is_gtpu(std::span<const uint8_t> packet) {
+        const size_t ihl = (packet[0] & 0x0f) * 4u;
+        return packet[9] == protocol_udp && packet.size() >= ihl + 8 && load16(packet.data() + ihl + 2) == gtpu::port;
+    }
+} // namespace
+
+pcap_replay::pcap_replay(control_plane &control_plane, data_plane &data_plane, const config &config)
+    : _control_plane(control_plane), _data_plane(data_plane), _config(config), _pool(config.pool) {}
+
+void pcap_replay::run(pcap_reader &reader) {
+    const auto started = std::chrono::steady_clock::now();
+    _start = started;
+    _first_timestamp.reset();
+    while (const auto record = reader.next()) {
+        ++_report.records;
+        const auto packet = pcap_reader::ipv4_packet(*record);
+        if (!packet) {
+            ++_report.skipped;
+            continue;
+        }
+        if (_config.speed > 0) {
+            pace(record->timestamp);
+        }
+        if (is_gtpu(*packet)) {
+            replay_gtpu(*packet);
+        } else {
+            replay_sgi(*packet);
+        }
+        if (_report.records % poll_interval == 0) {
+            _data_plane.poll();
+        }
+    }
+    _data_plane.poll();
+    _report.elapsed += std::chrono::steady_clock::now() - started;
+}
+
+void pcap_replay::replay_gtpu(std::span<const uint8_t> datagram) {
+    const auto header = gtpu::parse(datagram);
+    const boost::asio::ip::address_v4 destination(load32(datagram.data() + 16));
+    if (!header || (_config.pgw_address && destination != *_config.pgw_address)) {
+        ++_report.skipped;
+        return;
+    }
+
+    auto buffer = _pool.allocate(datagram);
+    if (!buffer) {
+        ++_report.skipped;
+        return;
+    }
+    if (header->type == gtpu::g_pdu) {
+        const auto inner = datagram.subspan(header->payload_offset, header->payload_size);
+        if (inner.size() < 20 || inner[0] >> 4 != 4) {
+            ++_report.skipped;
+            return;
+        }
+        const auto source = load32(inner.data() + 12);
+        // Без адреса PGW G-PDU к SGW узнается по известному UE в получателе
+        if (!_config.pgw_address && !_sessions.contains(source) && _sessions.contains(load32(inner.data() + 16))) {
+            ++_report.skipped;
+            return;
+        }
+        const auto dp_teid = map_teid(header->teid, source, header->peer);
+        if (!dp_teid) {
+            ++_report.skipped;
+            return;
+        }
+        // TEID в GTP-U заголовке: после внешних IPv4 и UDP и 4 байт флагов, типа и длины
+        store32(buffer.data() + (datagram[0] & 0x0f) * 4 + 8 + 4, dp_teid);
+        ++_report.uplink;
+    }
+    _report.bytes += datagram.size();
+
+    const auto begin = latency::now();
+    _data_plane.handle_gtpu_datagram(std::move(buffer));
+    _report.processing.record(latency::now() - begin);
+}
+
+void pcap_replay::replay_sgi(std::span<const uint8_t> packet) {
+    const auto source = load32(packet.data() + 12);
+    const auto destination = load32(packet.data() + 16);
+    const bool to_ue = _config.ue_network ? (destination & _config.ue_network->netmask().to_uint()) ==
+                                                _config.ue_network->network().to_uint()
+                                          : !_sessions.contains(source);
+    if (!to_ue) {
+        ++_report.skipped;
+        return;
+    }
+    const auto *session = find_or_create_session(destination, {});
+    if (!session) {
+        ++_report.skipped;
+        return;
+    }
+
+    auto buffer = _pool.allocate(packet);
+    if (!buffer) {
+        ++_report.skipped;
+        return;
+    }
+    const auto ue_ip = session->ue_ip.to_uint();
+    store32(buffer.data() + 16, ue_ip);
+    update_checksum(buffer.data(), destination, ue_ip);
+    _report.bytes += packet.size();
+    ++_report.downlink;
+
+    const auto begin = latency::now();
+    _data_plane.handle_ip_packet(std::move(buffer));
+    _report.processing.record(latency::now() - begin);
+}
+
+pcap_replay::session *pcap_replay::find_or_create_session(uint32_t captured_ue_ip,
+                                                          boost::asio::ip::address_v4 sgw_addr) {
+    if (const auto it = _sessions.find(captured_ue_ip); it != _sessions.end()) {
+        // Сессия заведена по downlink, SGW стал известен только сейчас
+        if (!sgw_addr.is_unspecified() && it->second.sgw_addr != sgw_addr) {
+            _control_plane.set_sgw_address(it->second.cp_teid, sgw_addr);
+            it->second.sgw_addr = sgw_addr;
+        }
+        return &it->second;
+    }
+
+    const auto pdn = _control_plane.create_pdn_connection(_config.apn, sgw_addr, 0);
+    if (!pdn) {
+        ++_report.provisioning_failures;
+        return nullptr;
+    }
+    const auto bearer = _control_plane.create_bearer(pdn, 0);
+    if (!bearer) {
+        _control_plane.delete_pdn_connection(pdn->get_cp_teid());
+        ++_report.provisioning_failures;
+        return nullptr;
+    }
+    pdn->set_default_bearer(bearer);
+    if (_config.on_session) {
+        _config.on_session(*pdn);
+    }
+    ++_report.sessions;
+    return &(_sessions[captured_ue_ip] = {pdn->get_cp_teid(), pdn->get_ue_ip_addr(), sgw_addr, false});
+}
+
+uint32_t pcap_replay::map_teid(uint32_t captured_teid, uint32_t captured_ue_ip, boost::asio::ip::address_v4 sgw_addr) {
+    if (const auto it = _teids.find(captured_teid); it != _teids.end()) {
+        return it->second;
+    }
+    auto *session = find_or_create_session(captured_ue_ip, sgw_addr);
+    if (!session) {
+        return 0;
+    }
+    const auto pdn = _control_plane.find_pdn_by_cp_teid(session->cp_teid);
+    uint32_t dp_teid = 0;
+    if (!session->default_bearer_mapped) {
+        dp_teid = pdn->get_default_bearer()->get_dp_teid();
+        session->default_bearer_mapped = true;
+    } else if (const auto bearer = _control_plane.create_bearer(pdn, captured_teid)) {
+        // Второй TEID того же UE - dedicated bearer
+        dp_teid = bearer->get_dp_teid();
+    } else {
+        ++_report.provisioning_failures;
+        return 0;
+    }
+    _teids.emplace(captured_teid, dp_teid);
+    return dp_teid;
+}
+
+void pcap_replay::pace(std::chrono::nanoseconds timestamp) {
+    if (!_first_timestamp) {
+        _first_timestamp = timestamp;
+    }
+    const auto offset = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double, std::nano>((timestamp - *_first_timestamp).count() / _config.speed));
+    const auto due = _start + offset;
+    if (due - std::chrono::steady_clock::now() > spin_threshold) {
+        std::this_thread::sleep_until(due - spin_threshold);
+    }
+    while (std::chrono::steady_clock::now() < due) {
+    }
+}
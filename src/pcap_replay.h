@@ -0,0 +1,91 @@
+#pragma once
+
+#include <control_plane.h>
+#include <data_plane.h>
+#include <latency.h>
+#include <packet_buffer.h>
+#include <pcap_reader.h>
+
+#include <boost/asio/ip/network_v4.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+// Прогон захваченного трафика S5/S8-U и SGi через data_plane без сети, для оценки емкости.
+//
+// Сессии заводятся в control_plane по ходу: первый G-PDU с новым TEID или пакет SGi к новому
+// адресу UE создают PDN с default bearer. control_plane сам выбирает TEID и адреса UE, поэтому
+// пакеты переписываются: в G-PDU ставится выданный DP TEID, в пакете SGi - выданный адрес UE.
+// Переписывается копия записи в буфере packet_pool, сам файл только читается.
+//
+// Пакеты, которые PGW сам отправил бы (G-PDU к SGW, декапсулированный uplink в SGi), в захвате
+// тоже есть; они пропускаются по pgw_address и ue_network, а без них - по адресу источника,
+// если это уже известный UE.
+class pcap_replay {
+public:
+    struct config {
+        std::string apn;
+        // S5/S8-U адрес PGW в захвате: GTP-U к другим адресам пропускается
+        std::optional<boost::asio::ip::address_v4> pgw_address{};
+        // Адреса UE в захвате: пакеты SGi к другим адресам пропускаются
+        std::optional<boost::asio::ip::network_v4> ue_network{};
+        // Темп относительно записанного: 1 - как в захвате, 2 - вдвое быстрее; 0 - без пауз
+        double speed = 0;
+        packet_pool::config pool{.buffer_count = 4096, .buffer_size = 2048, .headroom = 128};
+        // Вызывается для каждой новой сессии, например чтобы поставить лимиты
+        std::function<void(pdn_connection &)> on_session{};
+    };
+
+    struct report {
+        uint64_t records = 0;
+        uint64_t bytes = 0;
+        uint64_t uplink = 0;
+        uint64_t downlink = 0;
+        // Не IPv4, неизвестный канальный уровень или исходящий от PGW трафик
+        uint64_t skipped = 0;
+        uint64_t sessions = 0;
+        // control_plane не смог создать сессию: кончились адреса или TEID
+        uint64_t provisioning_failures = 0;
+        std::chrono::nanoseconds elapsed{};
+        // Время обработки одного пакета в data_plane, в тактах latency::now()
+        latency::histogram processing;
+    };
+
+    pcap_replay(control_plane &control_plane, data_plane &data_plane, const config &config);
+
+    // Прогоняет все записи; report накапливается между вызовами
+    void run(pcap_reader &reader);
+
+    [[nodiscard]] const report &get_report() const { return _report; }
+
+private:
+    struct session {
+        uint32_t cp_teid = 0;
+        boost::asio::ip::address_v4 ue_ip;
+        // Не задан, пока UE видели только в downlink
+        boost::asio::ip::address_v4 sgw_addr;
+        // Default bearer уже отдан TEID из захвата
+        bool default_bearer_mapped = false;
+    };
+
+    void replay_gtpu(std::span<const uint8_t> datagram);
+    void replay_sgi(std::span<const uint8_t> packet);
+    session *find_or_create_session(uint32_t captured_ue_ip, boost::asio::ip::address_v4 sgw_addr);
+    // DP TEID для TEID из захвата; 0, если сессию завести не удалось
+    uint32_t map_teid(uint32_t captured_teid, uint32_t captured_ue_ip, boost::asio::ip::address_v4 sgw_addr);
+    void pace(std::chrono::nanoseconds timestamp);
+
+    control_plane &_control_plane;
+    data_plane &_data_plane;
+    config _config;
+    packet_pool _pool;
+    report _report;
+    std::unordered_map<uint32_t, session> _sessions;
+    std::unordered_map<uint32_t, uint32_t> _teids;
+    std::optional<std::chrono::nanoseconds> _first_timestamp;
+    std::chrono::steady_clock::time_point _start;
+};
@@ -1,21 +1,58 @@
 #include <pdn_connection.h>
 
+#include <epoch.h>
+
+#include <algorithm>
+#include <utility>
+
 std::shared_ptr<pdn_connection> pdn_connection::create(uint32_t cp_teid, boost::asio::ip::address_v4 apn_gw,
                                                        boost::asio::ip::address_v4 ue_ip_addr) {
-    return std::shared_ptr<pdn_connection>(new pdn_connection(cp_teid, std::move(apn_gw), std::move(ue_ip_addr)));
+    return std::make_shared<pdn_connection>(private_key{}, cp_teid, apn_gw, ue_ip_addr);
 }
 
-uint32_t pdn_connection::get_sgw_cp_teid() const { return _sgw_cp_teid; }
+std::shared_ptr<pdn_connection> pdn_connection::create(const object_arena::allocator<pdn_connection> &allocator,
+                                                       uint32_t cp_teid, boost::asio::ip::address_v4 apn_gw,
+                                                       boost::asio::ip::address_v4 ue_ip_addr) {
+    return std::allocate_shared<pdn_connection>(allocator, private_key{}, cp_teid, apn_gw, ue_ip_addr);
+}
 
-void pdn_connection::set_sgw_cp_teid(uint32_t sgw_cp_teid) { _sgw_cp_teid = sgw_cp_teid; }
+uint32_t pdn_connection::get_sgw_cp_teid() const { return _sgw_cp_teid.load(std::memory_order_relaxed); }
 
-std::shared_ptr<bearer> pdn_connection::get_default_bearer() const { return _default_bearer; }
+void pdn_connection::set_sgw_cp_teid(uint32_t sgw_cp_teid) {
+    _sgw_cp_teid.store(sgw_cp_teid, std::memory_order_relaxed);
+    persist();
+}
 
-void pdn_connection::set_default_bearer(std::shared_ptr<bearer> bearer) { _default_bearer = std::move(bearer); }
+std::shared_ptr<bearer> pdn_connection::get_default_bearer() const {
+    epoch_guard guard;
+    auto *default_bearer = _default_bearer_ptr.load(std::memory_order_acquire);
+    return default_bearer ? default_bearer->shared_from_this() : nullptr;
+}
 
-boost::asio::ip::address_v4 pdn_connection::get_sgw_address() const { return _sgw_address; }
+bearer *pdn_connection::get_default_bearer_view() const {
+    return _default_bearer_ptr.load(std::memory_order_acquire);
+}
 
-void pdn_connection::set_sgw_addr(boost::asio::ip::address_v4 sgw_addr) { _sgw_address = std::move(sgw_addr); }
+bearer *pdn_connection::find_downlink_bearer_view(const tft::flow_key &key) const {
+    if (auto *classifier = _classifier_ptr.load(std::memory_order_acquire)) {
+        if (auto *found = classifier->classify(key)) {
+            return found;
+        }
+    }
+    return get_default_bearer_view();
+}
+
+void pdn_connection::set_default_bearer(std::shared_ptr<bearer> bearer) {
+    _default_bearer_ptr.store(bearer.get(), std::memory_order_release);
+    // Старый bearer мог быть только что прочитан другим потоком
+    epoch_domain::global().retire(std::exchange(_default_bearer, std::move(bearer)));
+    persist();
+}
+
+boost::asio::ip::address_v4 pdn_connection::get_sgw_address() const {
+    const auto *peer = _sgw_peer_ptr.load(std::memory_order_acquire);
+    return peer ? peer->get_address() : boost::asio::ip::address_v4();
+}
 
 uint32_t pdn_connection::get_cp_teid() const { return _cp_teid; }
 
@@ -23,21 +60,101 @@ boost::asio::ip::address_v4 pdn_connection::get_apn_gw() const { return _apn_gat
 
 boost::asio::ip::address_v4 pdn_connection::get_ue_ip_addr() const { return _ue_ip_addr; }
 
-pdn_connection::pdn_connection(uint32_t cp_teid, boost::asio::ip::address_v4 apn_gw,
+uint32_t pdn_connection::get_apn_id() const { return _apn_id; }
+
+uint32_t pdn_connection::get_handle() const { return _handle; }
+
+const std::vector<std::shared_ptr<bearer>> &pdn_connection::get_bearers() const { return _bearers; }
+
+pdn_connection::qos_limits *pdn_connection::get_qos_limits_view() const {
+    return _qos_limits_ptr.load(std::memory_order_acquire);
+}
+
+void pdn_connection::set_qos_limits(std::unique_ptr<qos_limits> limits) {
+    _qos_limits_ptr.store(limits.get(), std::memory_order_release);
+    epoch_domain::global().retire(std::exchange(_qos_limits, std::move(limits)));
+}
+
+uint32_t pdn_connection::get_store_slot() const { return _store_slot; }
+
+pdn_connection::pdn_connection(private_key, uint32_t cp_teid, boost::asio::ip::address_v4 apn_gw,
                                boost::asio::ip::address_v4 ue_ip_addr) :
     _apn_gateway(std::move(apn_gw)), _ue_ip_addr(std::move(ue_ip_addr)), _cp_teid(cp_teid) {}
 
 void pdn_connection::add_bearer(std::shared_ptr<bearer> bearer) {
-    if (bearer) {
-        _bearers[bearer->get_dp_teid()] = bearer;
+    if (!bearer) {
+        return;
+    }
+    auto it = std::find_if(_bearers.begin(), _bearers.end(),
+                           [&bearer](const auto &b) { return b->get_dp_teid() == bearer->get_dp_teid(); });
+    if (it != _bearers.end()) {
+        *it = std::move(bearer);
+    } else {
+        _bearers.push_back(std::move(bearer));
     }
 }
 
 void pdn_connection::remove_bearer(uint32_t dp_teid) {
-    _bearers.erase(dp_teid);
+    std::erase_if(_bearers, [dp_teid](const auto &b) { return b->get_dp_teid() == dp_teid; });
+    if (_tfts.erase(dp_teid)) {
+        rebuild_classifier();
+    }
 
     // Если удаляемый bearer был default bearer, сбрасываем указатель
     if (_default_bearer && _default_bearer->get_dp_teid() == dp_teid) {
-        _default_bearer.reset();
+        set_default_bearer(nullptr);
+    }
+}
+bool pdn_connection::set_bearer_tft(uint32_t dp_teid, std::vector<tft::packet_filter> filters) {
+    if (!find_bearer(dp_teid)) {
+        return false;
+    }
+    size_t total = filters.size();
+    for (const auto &[teid, tft] : _tfts) {
+        total += teid == dp_teid ? 0 : tft.size();
+    }
+    if (total > tft_classifier::max_filters) {
+        return false;
+    }
+
+    if (filters.empty()) {
+        _tfts.erase(dp_teid);
+    } else {
+        _tfts[dp_teid] = std::move(filters);
     }
-}
\ No newline at end of file
+    rebuild_classifier();
+    return true;
+}
+
+void pdn_connection::rebuild_classifier() {
+    std::unique_ptr<tft_classifier> classifier;
+    if (!_tfts.empty()) {
+        // При равном приоритете порядок фильтров задает DP TEID, а не порядок в хеш-таблице
+        std::vector<tft_classifier::bearer_filters> bearers;
+        for (const auto &[dp_teid, filters] : _tfts) {
+            bearers.push_back({find_bearer(dp_teid), filters});
+        }
+        std::sort(bearers.begin(), bearers.end(),
+                  [](const auto &a, const auto &b) { return a.owner->get_dp_teid() < b.owner->get_dp_teid(); });
+        classifier = std::make_unique<tft_classifier>(bearers);
+    }
+    _classifier_ptr.store(classifier.get(), std::memory_order_release);
+    epoch_domain::global().retire(std::exchange(_classifier, std::move(classifier)));
+}
+
+bearer *pdn_connection::find_bearer(uint32_t dp_teid) const {
+    auto it = std::find_if(_bearers.begin(), _bearers.end(),
+                           [dp_teid](const auto &b) { return b->get_dp_teid() == dp_teid; });
+    return it != _bearers.end() ? it->get() : nullptr;
+}
+
+void pdn_connection::persist() const {
+    if (!_store) {
+        return;
+    }
+    _store->modify<session_store::pdn_record>(_store_slot, [this](session_store::pdn_record &record) {
+        record.sgw_cp_teid = get_sgw_cp_teid();
+        record.sgw_address = get_sgw_address().to_uint();
+        record.default_bearer_dp_teid = _default_bearer ? _default_bearer->get_dp_teid() : 0;
+    });
+}
@@ -1,43 +1,106 @@
 #pragma once
 
 #include <bearer.h>
+#include <object_arena.h>
+#include <session_store.h>
+#include <sgw_peer.h>
+#include <tft.h>
 
+#include <atomic>
 #include <memory>
 #include <unordered_map>
+#include <vector>
 
 class control_plane;
 
 class pdn_connection : public std::enable_shared_from_this<pdn_connection> {
+    // Конструктор открыт для make_shared и allocate_shared, но вызвать его можно только через create
+    struct private_key {
+        explicit private_key() = default;
+    };
+
 public:
+    struct qos_limits {
+        token_bucket_pair ambr;
+    };
+
     static std::shared_ptr<pdn_connection> create(uint32_t cp_teid, boost::asio::ip::address_v4 apn_gw,
                                                   boost::asio::ip::address_v4 ue_ip_addr);
+    // Объект вместе со счетчиком ссылок в памяти арены
+    static std::shared_ptr<pdn_connection> create(const object_arena::allocator<pdn_connection> &allocator,
+                                                  uint32_t cp_teid, boost::asio::ip::address_v4 apn_gw,
+                                                  boost::asio::ip::address_v4 ue_ip_addr);
+
+    pdn_connection(private_key, uint32_t cp_teid, boost::asio::ip::address_v4 apn_gw,
+                   boost::asio::ip::address_v4 ue_ip_addr);
 
     [[nodiscard]] uint32_t get_sgw_cp_teid() const;
     void set_sgw_cp_teid(uint32_t sgw_cp_teid);
 
+    // Читается data plane потоками; предыдущий default bearer освобождается через epoch_domain
     [[nodiscard]] std::shared_ptr<bearer> get_default_bearer() const;
     void set_default_bearer(std::shared_ptr<bearer> bearer);
 
+    // Без подсчета ссылок; вызывающий держит epoch_guard
+    [[nodiscard]] bearer *get_default_bearer_view() const;
+    // Bearer для downlink пакета: dedicated bearer первого по приоритету совпавшего фильтра TFT,
+    // иначе default bearer. Тоже внутри epoch_guard
+    [[nodiscard]] bearer *find_downlink_bearer_view(const tft::flow_key &key) const;
+
+    // Адрес SGW peer сессии; меняется через control_plane::set_sgw_address и relocate_sgw
     [[nodiscard]] boost::asio::ip::address_v4 get_sgw_address() const;
-    void set_sgw_addr(boost::asio::ip::address_v4 sgw_addr);
 
     [[nodiscard]] uint32_t get_cp_teid() const;
     [[nodiscard]] boost::asio::ip::address_v4 get_apn_gw() const;
     [[nodiscard]] boost::asio::ip::address_v4 get_ue_ip_addr() const;
+    [[nodiscard]] uint32_t get_apn_id() const;
+    // Дескриптор в slot_map control plane: уникален среди живых PDN, с поколением
+    [[nodiscard]] uint32_t get_handle() const;
+
+    // Только для потока control plane. Bearers у PDN единицы, поэтому вектор, а не хеш-таблица:
+    // без выделения памяти на узлы и корзины при создании каждой сессии
+    [[nodiscard]] const std::vector<std::shared_ptr<bearer>> &get_bearers() const;
+
+    // Session AMBR; живет и заменяется так же, как bearer::qos_limits
+    [[nodiscard]] qos_limits *get_qos_limits_view() const;
+    void set_qos_limits(std::unique_ptr<qos_limits> limits);
+
+    // Слот записи в session_store control plane; session_store::no_slot без хранилища
+    [[nodiscard]] uint32_t get_store_slot() const;
 
 private:
     friend control_plane;
 
-    pdn_connection(uint32_t cp_teid, boost::asio::ip::address_v4 apn_gw, boost::asio::ip::address_v4 ue_ip_addr);
-
     void add_bearer(std::shared_ptr<bearer> bearer);
     void remove_bearer(uint32_t dp_teid);
+    [[nodiscard]] bearer *find_bearer(uint32_t dp_teid) const;
+
+    // false, если фильтров всех bearers больше tft_classifier::max_filters
+    bool set_bearer_tft(uint32_t dp_teid, std::vector<tft::packet_filter> filters);
+    void rebuild_classifier();
+    // Переписывает в хранилище поля, которые меняются после создания
+    void persist() const;
 
     boost::asio::ip::address_v4 _apn_gateway;
     boost::asio::ip::address_v4 _ue_ip_addr;
     uint32_t _cp_teid{};
-    uint32_t _sgw_cp_teid{};
-    boost::asio::ip::address_v4 _sgw_address;
-    std::unordered_map<uint32_t, std::shared_ptr<bearer>> _bearers;
+    uint32_t _apn_id{};
+    uint32_t _handle{};
+    std::atomic<uint32_t> _sgw_cp_teid{};
+    // SGW peer заменяется так же, как default bearer; позиция PDN в его списке сессий
+    std::shared_ptr<sgw_peer> _sgw_peer;
+    std::atomic<sgw_peer *> _sgw_peer_ptr{};
+    uint32_t _sgw_peer_slot{};
+    std::vector<std::shared_ptr<bearer>> _bearers;
     std::shared_ptr<bearer> _default_bearer;
+    std::atomic<bearer *> _default_bearer_ptr{};
+    // TFT по DP TEID bearer; классификатор собирается заново при каждом изменении и заменяется
+    // так же, как default bearer
+    std::unordered_map<uint32_t, std::vector<tft::packet_filter>> _tfts;
+    std::unique_ptr<tft_classifier> _classifier;
+    std::atomic<tft_classifier *> _classifier_ptr{};
+    std::unique_ptr<qos_limits> _qos_limits;
+    std::atomic<qos_limits *> _qos_limits_ptr{};
+    session_store *_store{};
+    uint32_t _store_slot = session_store::no_slot;
 };
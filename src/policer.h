@@ -0,0 +1,138 @@
+#pragma once
+
+#include <bearer.h>
+#include <pdn_connection.h>
+#include <token_bucket.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Политики проверки лимитов для packet_pipeline; hierarchical_policer использует и
+// rate_limited_data_plane. Интерфейс политики:
+//
+//   static constexpr bool enabled;  // false - пайплайн не читает часы и не зовет admit
+//   bool admit(policer_direction dir, const bearer &bearer, const pdn_connection &pdn, size_t size, uint64_t now);
+//
+// admit списывает токены пакета и возвращает false, если пакет лимит превышает. now - время
+// token_bucket::now(), одно на burst. Вместо admit политика может проверять весь кусок burst'а
+// сразу, как data_plane::police_*_burst, и тогда сама читает часы:
+//
+//   void police(policer_direction dir, std::span<bearer *const> bearers, std::span<pdn_connection *> pdns,
+//               std::span<const size_t> sizes);  // отклоненный пакет - обнуленный pdns[i]
+//
+// Необязательный bool reject(policer_direction dir, bearer &bearer, data_plane::Packet &&packet)
+// получает отклоненные пакеты, например для шейпинга, и возвращает false, если пакет отброшен.
+// Без него пакет отбрасывается; отброшенные пакеты учитываются в drops(policed).
+enum policer_direction : size_t { uplink_direction, downlink_direction };
+
+// Без лимитов
+struct no_policer {
+    static constexpr bool enabled = false;
+
+    bool admit(policer_direction, const bearer &, const pdn_connection &, size_t, uint64_t) { return true; }
+};
+
+// Один token bucket на сессию: session AMBR из pdn_connection::qos_limits
+struct session_ambr_policer {
+    static constexpr bool enabled = true;
+
+    bool admit(policer_direction dir, const bearer &, const pdn_connection &pdn, size_t size, uint64_t now) {
+        auto *limits = pdn.get_qos_limits_view();
+        return !limits || !limits->ambr[dir] || limits->ambr[dir]->spend_tokens(size, now);
+    }
+};
+
+// Иерархия 3GPP: MBR/GBR bearer, session AMBR и APN-AMBR, см. rate_limited_data_plane.
+// Лимиты bearer и сессии лежат в их записях, APN-AMBR - здесь, по номеру APN. Записи задаются
+// из управляющего потока, поэтому admit проверяет их на каждом пакете, а не по флагу политики
+class hierarchical_policer {
+public:
+    static constexpr bool enabled = true;
+
+    // Лимиты одного пакета, от нижнего уровня к верхнему
+    struct limiter_chain {
+        token_bucket *mbr = nullptr;
+        token_bucket *gbr = nullptr;
+        token_bucket *session_ambr = nullptr;
+        token_bucket *apn_ambr = nullptr;
+    };
+
+    bool admit(policer_direction dir, const bearer &bearer, const pdn_connection &pdn, size_t size, uint64_t now) {
+        return conforms(find_limiters(dir, bearer, pdn), size, now);
+    }
+
+    void set_apn_limits(uint32_t apn_id, const token_bucket_pair &limits) {
+        if (apn_id >= _apn_limiters.size()) {
+            _apn_limiters.resize(apn_id + 1);
+        }
+        _apn_limiters[apn_id] = limits;
+    }
+
+    void delete_apn_limits(uint32_t apn_id) {
+        if (apn_id < _apn_limiters.size()) {
+            _apn_limiters[apn_id] = {};
+        }
+    }
+
+    [[nodiscard]] limiter_chain find_limiters(policer_direction dir, const bearer &bearer,
+                                              const pdn_connection &pdn) {
+        limiter_chain chain;
+        if (auto *limits = bearer.get_qos_limits_view()) {
+            chain.mbr = limits->mbr[dir] ? &*limits->mbr[dir] : nullptr;
+            chain.gbr = limits->gbr[dir] ? &*limits->gbr[dir] : nullptr;
+        }
+        if (auto *limits = pdn.get_qos_limits_view()) {
+            chain.session_ambr = limits->ambr[dir] ? &*limits->ambr[dir] : nullptr;
+        }
+        if (pdn.get_apn_id() < _apn_limiters.size() && _apn_limiters[pdn.get_apn_id()][dir]) {
+            chain.apn_ambr = &*_apn_limiters[pdn.get_apn_id()][dir];
+        }
+        return chain;
+    }
+
+    static bool conforms(const limiter_chain &chain, size_t size, uint64_t now) {
+        // MBR ограничивает весь трафик bearer
+        if (chain.mbr && !chain.mbr->spend_tokens(size, now)) {
+            return false;
+        }
+
+        // Гарантированная часть GBR bearer не расходует AMBR
+        if (chain.gbr && chain.gbr->spend_tokens(size, now)) {
+            return true;
+        }
+
+        if (chain.session_ambr && !chain.session_ambr->spend_tokens(size, now)) {
+            if (chain.mbr) {
+                chain.mbr->refund_tokens(size);
+            }
+            return false;
+        }
+
+        if (chain.apn_ambr && !chain.apn_ambr->spend_tokens(size, now)) {
+            if (chain.session_ambr) {
+                chain.session_ambr->refund_tokens(size);
+            }
+            if (chain.mbr) {
+                chain.mbr->refund_tokens(size);
+            }
+            return false;
+        }
+        return true;
+    }
+
+    // Через сколько тактов пакет пройдет; UINT64_MAX, если никогда
+    static uint64_t wait_time(const limiter_chain &chain, size_t size, uint64_t now) {
+        // Оценка сверху: GBR может пропустить пакет раньше, тогда очередь просто проверится позже
+        uint64_t wait = 0;
+        for (auto *limiter : {chain.mbr, chain.session_ambr, chain.apn_ambr}) {
+            if (limiter) {
+                wait = std::max(wait, limiter->wait_time(size, now));
+            }
+        }
+        return wait;
+    }
+
+private:
+    std::vector<token_bucket_pair> _apn_limiters;
+};
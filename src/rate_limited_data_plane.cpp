@@ -4,29 +4,15 @@
 
 #include "rate_limited_data_plane.h"
 
-token_bucket::token_bucket(double rate_, double capacity_)
-    : rate(rate_), capacity(capacity_), tokens(capacity_), last_update(std::chrono::steady_clock::now()) {}
-
-// Пытаемся потратить токены
-bool token_bucket::spend_tokens(double tokens_) {
-    std::lock_guard<std::mutex> lock(mutex);
-
-    // Вычисляем сколько времени прошло
-    auto now = std::chrono::steady_clock::now();
-    std::chrono::duration<double> passed_time = now - last_update;
-
-    // Добавляем новые токены пропорционально прошедшему времени
-    double new_tokens = passed_time.count() * rate;
-    tokens = std::min(tokens + new_tokens, capacity);
-    last_update = now;
+namespace {
+    session_store::rate_limit to_stored(const rate_limited_data_plane::rate_limit_config &config) {
+        return {config.uplink_rate, config.uplink_capacity, config.downlink_rate, config.downlink_capacity};
+    }
 
-    // Проверяем, достаточно ли токенов
-    if (tokens >= tokens_) {
-        tokens -= tokens_;
-        return true;
+    rate_limited_data_plane::rate_limit_config from_stored(const session_store::rate_limit &limit) {
+        return {limit.uplink_rate, limit.uplink_capacity, limit.downlink_rate, limit.downlink_capacity};
     }
-    return false;
-}
+} // namespace
 
 rate_limited_data_plane::rate_limited_data_plane(control_plane& cp) : data_plane(cp) {}
 
@@ -37,71 +23,304 @@ void rate_limited_data_plane::set_rate_limits(uint32_t cp_teid, rate_limit_confi
         return;
     }
 
-    // Получаем ip адресс UE
-    boost::asio::ip::address_v4 ue_ip = pdn->get_ue_ip_addr();
-
     // Устанавливаем лимиты для PDN соединения
-    uplink_limiters[cp_teid] = std::make_unique<token_bucket>(config.uplink_rate, config.uplink_capacity);
-    downlink_limiters[ue_ip] = std::make_unique<token_bucket>(config.downlink_rate, config.downlink_capacity);
+    pdn->set_qos_limits(std::make_unique<pdn_connection::qos_limits>(make_limiters(config, false)));
+
+    if (auto *store = _control_plane.get_session_store()) {
+        store->modify<session_store::pdn_record>(pdn->get_store_slot(), [&config](session_store::pdn_record &record) {
+            record.has_ambr = true;
+            record.ambr = to_stored(config);
+        });
+    }
 }
 
 void rate_limited_data_plane::delete_rate_limits(uint32_t cp_teid) {
-    // Находим PDN
-    auto pdn = _control_plane.find_pdn_by_cp_teid(cp_teid);
-    if (!pdn) {
-        return;
+    if (auto pdn = _control_plane.find_pdn_by_cp_teid(cp_teid)) {
+        auto *store = _control_plane.get_session_store();
+        pdn->set_qos_limits(nullptr);
+        if (store) {
+            store->modify<session_store::pdn_record>(
+                    pdn->get_store_slot(), [](session_store::pdn_record &record) { record.has_ambr = false; });
+        }
+        for (const auto &bearer : pdn->get_bearers()) {
+            bearer->set_qos_limits(nullptr);
+            if (store) {
+                store->modify<session_store::bearer_record>(bearer->get_store_slot(),
+                                                            [](session_store::bearer_record &record) {
+                                                                record.has_limits = false;
+                                                            });
+            }
+        }
     }
+}
 
-    // Получаем ip адресс UE
-    boost::asio::ip::address_v4 ue_ip = pdn->get_ue_ip_addr();
+bool rate_limited_data_plane::set_apn_rate_limits(const std::string &apn, const rate_limit_config &config) {
+    auto apn_id = _control_plane.find_apn_id(apn);
+    if (!apn_id) {
+        return false;
+    }
+    policer.set_apn_limits(*apn_id, make_limiters(config, false));
 
-    // Удаляем лимиты для PDN соединения
-    uplink_limiters.erase(cp_teid);
-    downlink_limiters.erase(ue_ip);
+    auto *store = _control_plane.get_session_store();
+    if (auto slot = store ? store->find_apn(apn) : std::nullopt) {
+        store->modify<session_store::apn_record>(*slot, [&config](session_store::apn_record &record) {
+            record.has_ambr = true;
+            record.ambr = to_stored(config);
+        });
+    }
+    return true;
 }
 
-void rate_limited_data_plane::handle_uplink(uint32_t dp_teid, Packet &&packet) {
-    auto bearer = _control_plane.find_bearer_by_dp_teid(dp_teid);
-    if (!bearer) {
-        return;
+void rate_limited_data_plane::delete_apn_rate_limits(const std::string &apn) {
+    auto apn_id = _control_plane.find_apn_id(apn);
+    if (apn_id) {
+        policer.delete_apn_limits(*apn_id);
     }
 
-    auto pdn = bearer->get_pdn_connection();
-    if (!pdn) {
-        return;
+    auto *store = _control_plane.get_session_store();
+    if (auto slot = store ? store->find_apn(apn) : std::nullopt) {
+        store->modify<session_store::apn_record>(*slot,
+                                                 [](session_store::apn_record &record) { record.has_ambr = false; });
     }
+}
 
-    // Проверяем rate limit
-    auto it = uplink_limiters.find(pdn->get_cp_teid());
-    if (it != uplink_limiters.end()) {
-        if (!it->second->spend_tokens(packet.size())) {
-            return;
+bool rate_limited_data_plane::set_bearer_rate_limits(uint32_t dp_teid, const bearer_rate_limit_config &config) {
+    auto found = _control_plane.find_bearer_by_dp_teid(dp_teid);
+    if (!found || !found->get_pdn_connection()) {
+        return false;
+    }
+
+    found->set_qos_limits(std::make_unique<bearer::qos_limits>(make_limiters(config.mbr, true),
+                                                               make_limiters(config.gbr, true)));
+
+    if (auto *store = _control_plane.get_session_store()) {
+        store->modify<session_store::bearer_record>(
+                found->get_store_slot(), [&config](session_store::bearer_record &record) {
+                    record.has_limits = true;
+                    record.mbr = to_stored(config.mbr);
+                    record.gbr = to_stored(config.gbr);
+                });
+    }
+    return true;
+}
+
+void rate_limited_data_plane::delete_bearer_rate_limits(uint32_t dp_teid) {
+    if (auto found = _control_plane.find_bearer_by_dp_teid(dp_teid)) {
+        found->set_qos_limits(nullptr);
+        if (auto *store = _control_plane.get_session_store()) {
+            store->modify<session_store::bearer_record>(
+                    found->get_store_slot(), [](session_store::bearer_record &record) { record.has_limits = false; });
         }
     }
+}
 
-    forward_packet_to_apn(pdn->get_apn_gw(), std::move(packet));
+void rate_limited_data_plane::restore_rate_limits() {
+    restore_apn_rate_limits();
+    restore_session_rate_limits();
 }
 
-void rate_limited_data_plane::handle_downlink(const boost::asio::ip::address_v4 &ue_ip, Packet &&packet) {
-    auto pdn = _control_plane.find_pdn_by_ip_address(ue_ip);
-    if (!pdn) {
+void rate_limited_data_plane::restore_session_rate_limits() {
+    auto *store = _control_plane.get_session_store();
+    if (!store) {
         return;
     }
 
-    auto default_bearer = pdn->get_default_bearer();
-    if (!default_bearer) {
+    // Сначала читаем все: set_* пишут в хранилище, а из for_each к нему обращаться нельзя
+    std::vector<std::pair<uint32_t, rate_limit_config>> sessions;
+    std::vector<std::pair<uint32_t, bearer_rate_limit_config>> bearers;
+    store->for_each<session_store::pdn_record>([&sessions](uint32_t, const session_store::pdn_record &record) {
+        if (record.has_ambr) {
+            sessions.emplace_back(record.cp_teid, from_stored(record.ambr));
+        }
+    });
+    store->for_each<session_store::bearer_record>([&bearers](uint32_t, const session_store::bearer_record &record) {
+        if (record.has_limits) {
+            bearers.emplace_back(record.dp_teid,
+                                 bearer_rate_limit_config{from_stored(record.mbr), from_stored(record.gbr)});
+        }
+    });
+
+    for (auto &[cp_teid, config] : sessions) {
+        set_rate_limits(cp_teid, config);
+    }
+    for (const auto &[dp_teid, config] : bearers) {
+        set_bearer_rate_limits(dp_teid, config);
+    }
+}
+
+void rate_limited_data_plane::restore_apn_rate_limits() {
+    auto *store = _control_plane.get_session_store();
+    if (!store) {
         return;
     }
 
-    // Проверяем rate limit
-    auto it = downlink_limiters.find(ue_ip);
-    if (it != downlink_limiters.end()) {
-        if (!it->second->spend_tokens(packet.size())) {
-            return;
+    std::vector<std::pair<std::string, rate_limit_config>> apns;
+    store->for_each<session_store::apn_record>([&apns](uint32_t, const session_store::apn_record &record) {
+        if (record.has_ambr) {
+            apns.emplace_back(std::string(record.name, strnlen(record.name, sizeof(record.name))),
+                              from_stored(record.ambr));
         }
+    });
+    for (const auto &[apn, config] : apns) {
+        set_apn_rate_limits(apn, config);
     }
+}
 
-    forward_packet_to_sgw(pdn->get_sgw_address(), default_bearer->get_sgw_dp_teid(), std::move(packet));
+void rate_limited_data_plane::police_uplink_burst(std::span<bearer *const> bearers, std::span<pdn_connection *> pdns,
+                                                  std::span<const size_t> sizes) {
+    police(uplink, bearers, pdns, sizes);
 }
 
+void rate_limited_data_plane::police_downlink_burst(std::span<bearer *const> bearers,
+                                                    std::span<pdn_connection *> pdns, std::span<const size_t> sizes) {
+    police(downlink, bearers, pdns, sizes);
+}
 
+token_bucket_pair rate_limited_data_plane::make_limiters(const rate_limit_config &config, bool optional) {
+    token_bucket_pair limiters;
+    if (!optional || config.uplink_rate || config.uplink_capacity) {
+        limiters[uplink].emplace(config.uplink_rate, config.uplink_capacity);
+    }
+    if (!optional || config.downlink_rate || config.downlink_capacity) {
+        limiters[downlink].emplace(config.downlink_rate, config.downlink_capacity);
+    }
+    return limiters;
+}
+
+void rate_limited_data_plane::police(direction dir, std::span<bearer *const> bearers,
+                                     std::span<pdn_connection *> pdns, std::span<const size_t> sizes) {
+    // Токены списываются в порядке пакетов, как при поштучной обработке; часы читаем раз на burst
+    const auto now = token_bucket::now();
+    for (size_t i = 0; i < pdns.size(); ++i) {
+        if (!pdns[i]) {
+            continue;
+        }
+        // Пока очередь сессии не пуста, пакет встает за ней
+        if (!shaping_queues.empty() && shaping_queues.contains(queue_key(pdns[i]->get_cp_teid(), dir))) {
+            pdns[i] = nullptr;
+            continue;
+        }
+        if (!policer.admit(static_cast<policer_direction>(dir), *bearers[i], *pdns[i], sizes[i], now)) {
+            pdns[i] = nullptr;
+        }
+    }
+}
+
+void rate_limited_data_plane::set_shaping(const shaping_config &config) {
+    shaping = config;
+    shaping_tick = std::max<uint64_t>(static_cast<uint64_t>(config.tick.count()) << token_bucket::tick_shift, 1);
+    shaping_timers = timer_wheel<uint64_t>(token_bucket::now() / shaping_tick);
+    if (!shaping.queue_depth) {
+        // Пакеты из очередей отбрасываются вместе с режимом
+        for (auto &[key, queue] : shaping_queues) {
+            counters.dropped += queue.packets.size();
+            _counters.count_drop(traffic_counters::policed, queue.packets.size());
+        }
+        shaping_queues.clear();
+    }
+}
+
+bool rate_limited_data_plane::shape_uplink(bearer &bearer, Packet &&packet) {
+    return shape(uplink, bearer, std::move(packet));
+}
+
+bool rate_limited_data_plane::shape_downlink(bearer &bearer, Packet &&packet) {
+    return shape(downlink, bearer, std::move(packet));
+}
+
+bool rate_limited_data_plane::shape(direction dir, bearer &bearer, Packet &&packet) {
+    if (!shaping.queue_depth) {
+        return false;
+    }
+
+    const auto key = queue_key(bearer.get_pdn_view().get_cp_teid(), dir);
+    auto &queue = shaping_queues[key];
+    if (queue.packets.size() >= shaping.queue_depth) {
+        ++counters.dropped;
+        return false;
+    }
+
+    const auto now = token_bucket::now();
+    queue.packets.push_back({bearer.get_dp_teid(), now, std::move(packet)});
+    ++counters.queued;
+    if (!queue.scheduled) {
+        schedule(key, queue, now);
+    }
+    return true;
+}
+
+void rate_limited_data_plane::schedule(uint64_t key, shaping_queue &queue, uint64_t now) {
+    const auto &head = queue.packets.front();
+    uint64_t wait = 0;
+    {
+        epoch_guard guard;
+        if (auto *found = _control_plane.find_bearer_view(head.dp_teid)) {
+            const auto chain = policer.find_limiters(static_cast<policer_direction>(key & 1), *found,
+                                                     found->get_pdn_view());
+            wait = hierarchical_policer::wait_time(chain, head.packet.size(), now);
+        }
+    }
+    // Пакет, который никогда не пройдет, выпускается сразу и отбрасывается в release
+    if (wait == UINT64_MAX) {
+        wait = 0;
+    }
+    shaping_timers.schedule(key, (now + wait + shaping_tick - 1) / shaping_tick);
+    queue.scheduled = true;
+}
+
+void rate_limited_data_plane::poll() {
+    if (shaping_timers.empty()) {
+        return;
+    }
+    const auto now = token_bucket::now();
+    shaping_timers.advance(now / shaping_tick, [&](uint64_t key) { release(key, now); });
+}
+
+void rate_limited_data_plane::release(uint64_t key, uint64_t now) {
+    auto it = shaping_queues.find(key);
+    if (it == shaping_queues.end()) {
+        return;
+    }
+    auto &queue = it->second;
+    queue.scheduled = false;
+    const auto dir = static_cast<direction>(key & 1);
+
+    epoch_guard guard;
+    while (!queue.packets.empty()) {
+        auto &head = queue.packets.front();
+        auto *found = _control_plane.find_bearer_view(head.dp_teid);
+        if (!found) {
+            ++counters.dropped;
+            _counters.count_drop(traffic_counters::policed);
+            queue.packets.pop_front();
+            continue;
+        }
+
+        auto &pdn = found->get_pdn_view();
+        const auto chain = policer.find_limiters(static_cast<policer_direction>(dir), *found, pdn);
+        if (!hierarchical_policer::conforms(chain, head.packet.size(), now)) {
+            if (hierarchical_policer::wait_time(chain, head.packet.size(), now) == UINT64_MAX) {
+                ++counters.dropped;
+                _counters.count_drop(traffic_counters::policed);
+                queue.packets.pop_front();
+                continue;
+            }
+            schedule(key, queue, now);
+            return;
+        }
+
+        const auto delay_ns = (now - head.enqueued) >> token_bucket::tick_shift;
+        counters.total_delay_ns += delay_ns;
+        counters.max_delay_ns = std::max(counters.max_delay_ns, delay_ns);
+        ++counters.released;
+        if (dir == uplink) {
+            _counters.count_uplink(*found, pdn, head.packet.size());
+            forward_packet_to_apn(pdn.get_apn_gw(), std::move(head.packet));
+        } else {
+            _counters.count_downlink(*found, pdn, head.packet.size());
+            forward_packet_to_sgw(pdn.get_sgw_address(), found->get_sgw_dp_teid(), std::move(head.packet));
+        }
+        queue.packets.pop_front();
+    }
+    shaping_queues.erase(it);
+}
@@ -1,38 +1,131 @@
 #pragma once
 
 #include <data_plane.h>
+#include <policer.h>
+#include <timer_wheel.h>
+#include <token_bucket.h>
+
 #include <chrono>
-#include <mutex>
+#include <deque>
 #include <unordered_map>
 
-class token_bucket {
-    double rate;
-    double capacity;
-    double tokens;
-    std::chrono::steady_clock::time_point last_update;
-    mutable std::mutex mutex;
+// Иерархические лимиты в духе 3GPP: APN-AMBR на все сессии APN, session AMBR на PDN connection
+// и MBR/GBR на bearer. Лимиты сессии и bearer хранятся в их записях (pdn_connection::qos_limits,
+// bearer::qos_limits) и удаляются вместе с ними, APN-AMBR - в массиве по номеру APN, поэтому
+// поиск, который нашел bearer для пересылки, находит и все его лимиты. Все уровни пакета
+// проверяются за один проход; если верхний уровень отказывает, токены, уже списанные на нижних,
+// возвращаются.
+//
+// Трафик GBR bearer в пределах GBR не учитывается в AMBR; сверх GBR, до MBR, он делит AMBR
+// с остальными bearers. В sharded_data_plane у каждого рабочего потока свой APN-AMBR, поэтому
+// он делится между потоками: задавайте каждому долю через broadcast. Лимиты сессии и bearer
+// лежат в общих записях и задаются один раз из управляющего потока через любой экземпляр;
+// token_bucket не атомарный, но sharded_data_plane отдает все пакеты сессии одного направления
+// одному потоку.
+//
+// В режиме шейпинга пакет сверх лимита не отбрасывается, а встает в ограниченную очередь своей
+// сессии и направления. Очереди выпускает poll() по колесу таймеров: каждая непустая очередь
+// стоит в колесе один раз, на момент, когда ее первому пакету хватит токенов. Пока очередь сессии
+// не пуста, новые пакеты встают за ней, чтобы не нарушать порядок. Без шейпинга и без очередей
+// быстрый путь не меняется.
+class rate_limited_data_plane : public data_plane {
+    enum direction : size_t { uplink = uplink_direction, downlink = downlink_direction };
 
-public:
-    token_bucket(double rate, double capacity);
-    bool spend_tokens(double tokens);
-};
+    hierarchical_policer policer;  // APN-AMBR и проверка цепочки лимитов; без лимитов ничего не делает
 
-class rate_limited_data_plane : public data_plane {
-    std::unordered_map<uint32_t, std::unique_ptr<token_bucket>> uplink_limiters;
-    std::unordered_map<boost::asio::ip::address_v4, std::unique_ptr<token_bucket>> downlink_limiters;
+    struct shaped_packet {
+        uint32_t dp_teid;
+        uint64_t enqueued;
+        Packet packet;
+    };
+
+    struct shaping_queue {
+        std::deque<shaped_packet> packets;
+        bool scheduled = false;
+    };
 
 public:
     explicit rate_limited_data_plane(control_plane& cp);
 
     struct rate_limit_config {
-        size_t uplink_rate;
-        size_t uplink_capacity;
-        size_t downlink_rate;
-        size_t downlink_capacity;
+        size_t uplink_rate{};
+        size_t uplink_capacity{};
+        size_t downlink_rate{};
+        size_t downlink_capacity{};
+    };
+
+    // Направление с нулевыми rate и capacity не ограничивается
+    struct bearer_rate_limit_config {
+        rate_limit_config mbr{};
+        rate_limit_config gbr{};
     };
 
+    // Session AMBR. Как и лимиты bearer, меняет только записи сессии и хранилище, поэтому
+    // вызывается из управляющего потока
     void set_rate_limits(uint32_t cp_teid, rate_limit_config& config);
-    void handle_uplink(uint32_t dp_teid, Packet&& packet) override;
-    void handle_downlink(const boost::asio::ip::address_v4& ue_ip, Packet&& packet) override;
+    // Удаляет все лимиты сессии, включая лимиты ее bearers. Пакеты из очередей шейпинга сессии
+    // выпускаются при следующем poll()
     void delete_rate_limits(uint32_t cp_teid);
-};
\ No newline at end of file
+
+    bool set_apn_rate_limits(const std::string &apn, const rate_limit_config &config);
+    void delete_apn_rate_limits(const std::string &apn);
+
+    bool set_bearer_rate_limits(uint32_t dp_teid, const bearer_rate_limit_config &config);
+    void delete_bearer_rate_limits(uint32_t dp_teid);
+
+    // Если у control plane есть session_store, лимиты всех уровней записываются и в него.
+    // Задает лимиты из хранилища, например после перезапуска; вызывается после
+    // control_plane::attach_store. В sharded_data_plane лимиты сессий и bearers восстанавливаются
+    // один раз из управляющего потока, а APN-AMBR - в каждом потоке через broadcast: хранилище
+    // помнит последнюю заданную долю
+    void restore_rate_limits();
+    void restore_session_rate_limits();
+    void restore_apn_rate_limits();
+
+    struct shaping_config {
+        // 0 - шейпинг выключен, пакеты сверх лимита отбрасываются
+        size_t queue_depth = 0;
+        std::chrono::nanoseconds tick = std::chrono::microseconds(100);
+    };
+
+    struct shaping_counters {
+        uint64_t queued = 0;
+        uint64_t released = 0;
+        // Переполнение очереди, удаленная сессия или пакет больше емкости лимита; все они есть и
+        // в drops(policed)
+        uint64_t dropped = 0;
+        uint64_t total_delay_ns = 0;
+        uint64_t max_delay_ns = 0;
+    };
+
+    void set_shaping(const shaping_config &config);
+    [[nodiscard]] const shaping_counters &get_shaping_counters() const { return counters; }
+
+    void poll() override;
+
+protected:
+    void police_uplink_burst(std::span<bearer *const> bearers, std::span<pdn_connection *> pdns,
+                             std::span<const size_t> sizes) override;
+    void police_downlink_burst(std::span<bearer *const> bearers, std::span<pdn_connection *> pdns,
+                               std::span<const size_t> sizes) override;
+
+    bool shape_uplink(bearer &bearer, Packet &&packet) override;
+    bool shape_downlink(bearer &bearer, Packet &&packet) override;
+
+private:
+    static token_bucket_pair make_limiters(const rate_limit_config &config, bool optional);
+    static uint64_t queue_key(uint32_t cp_teid, direction dir) { return uint64_t{cp_teid} << 1 | dir; }
+
+    void police(direction dir, std::span<bearer *const> bearers, std::span<pdn_connection *> pdns,
+                std::span<const size_t> sizes);
+
+    bool shape(direction dir, bearer &bearer, Packet &&packet);
+    void schedule(uint64_t key, shaping_queue &queue, uint64_t now);
+    void release(uint64_t key, uint64_t now);
+
+    shaping_config shaping;
+    shaping_counters counters;
+    uint64_t shaping_tick = 1;  // shaping.tick в единицах token_bucket
+    std::unordered_map<uint64_t, shaping_queue> shaping_queues;  // По queue_key
+    timer_wheel<uint64_t> shaping_timers;
+};
@@ -0,0 +1,274 @@
+#include <session_store.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+namespace {
+    constexpr char magic[8] = {'S', 'P', 'G', 'W', 'S', 'E', 'S', 'S'};
+
+    struct file_header {
+        char magic[8];
+        uint32_t version;
+        uint32_t record_size;
+    };
+
+    [[noreturn]] void throw_errno(const char *what) { throw std::system_error(errno, std::generic_category(), what); }
+} // namespace
+
+// Счетчик и сумма в начале, затем тип и данные. Сумма считается по типу и данным
+struct session_store::record {
+    uint32_t sequence;
+    uint32_t checksum;
+    uint32_t kind;
+    uint32_t reserved;
+    std::byte payload[record_size - 16];
+
+    [[nodiscard]] uint32_t compute_checksum() const {
+        // FNV-1a по 64-битным словам
+        uint64_t hash = 0xcbf29ce484222325ull;
+        const auto *bytes = reinterpret_cast<const std::byte *>(&kind);
+        for (size_t offset = 0; offset < record_size - 8; offset += 8) {
+            uint64_t word;
+            std::memcpy(&word, bytes + offset, sizeof(word));
+            hash = (hash ^ word) * 0x100000001b3ull;
+        }
+        return static_cast<uint32_t>(hash ^ (hash >> 32));
+    }
+};
+
+static_assert(sizeof(session_store::apn_record) <= session_store::record_size - 16);
+static_assert(sizeof(session_store::pdn_record) <= session_store::record_size - 16);
+static_assert(sizeof(session_store::bearer_record) <= session_store::record_size - 16);
+
+session_store::session_store(const std::string &path) : session_store(path, config{}) {}
+
+session_store::session_store(const std::string &path, const config &config) {
+    _fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (_fd < 0) {
+        throw_errno("session_store: open");
+    }
+
+    try {
+        struct stat st{};
+        if (::fstat(_fd, &st) < 0) {
+            throw_errno("session_store: fstat");
+        }
+
+        if (st.st_size == 0) {
+            // Новый файл: сначала место под записи, затем заголовок, чтобы файл с заголовком был целым
+            const auto capacity = std::max<size_t>(config.initial_records, 1);
+            if (::ftruncate(_fd, static_cast<off_t>(header_size + capacity * slot_size)) < 0) {
+                throw_errno("session_store: ftruncate");
+            }
+            map(capacity);
+            file_header header{};
+            std::memcpy(header.magic, magic, sizeof(magic));
+            header.version = format_version;
+            header.record_size = record_size;
+            std::memcpy(_data, &header, sizeof(header));
+        } else {
+            if (static_cast<size_t>(st.st_size) < header_size + slot_size) {
+                throw std::runtime_error("session_store: file is too short");
+            }
+            map((static_cast<size_t>(st.st_size) - header_size) / slot_size);
+            file_header header;
+            std::memcpy(&header, _data, sizeof(header));
+            if (std::memcmp(header.magic, magic, sizeof(magic)) != 0) {
+                throw std::runtime_error("session_store: not a session store file");
+            }
+            if (header.version != format_version || header.record_size != record_size) {
+                throw std::runtime_error("session_store: unsupported format version");
+            }
+        }
+        recover();
+    } catch (...) {
+        if (_data) {
+            ::munmap(_data, _mapped_size);
+        }
+        ::close(_fd);
+        throw;
+    }
+}
+
+session_store::~session_store() {
+    ::munmap(_data, _mapped_size);
+    ::close(_fd);
+}
+
+void session_store::erase(uint32_t slot) {
+    std::lock_guard lock(_mutex);
+    if (slot >= _capacity || record_at(slot).kind == free_kind) {
+        return;
+    }
+    write(slot, free_kind, nullptr, 0);
+    _free.push_back(slot);
+}
+
+std::optional<uint32_t> session_store::find_apn(std::string_view name) const {
+    std::lock_guard lock(_mutex);
+    auto it = _apns.find(std::string(name));
+    if (it == _apns.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+size_t session_store::size() const {
+    std::lock_guard lock(_mutex);
+    return _sizes[apn_kind] + _sizes[pdn_kind] + _sizes[bearer_kind];
+}
+
+void session_store::flush() {
+    std::lock_guard lock(_mutex);
+    if (::msync(_data, _mapped_size, MS_SYNC) < 0) {
+        throw_errno("session_store: msync");
+    }
+}
+
+void session_store::map(size_t capacity) {
+    const auto size = header_size + capacity * slot_size;
+    void *data;
+    if (_data) {
+        data = ::mremap(_data, _mapped_size, size, MREMAP_MAYMOVE);
+    } else {
+        data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    }
+    if (data == MAP_FAILED) {
+        throw_errno("session_store: mmap");
+    }
+    _data = static_cast<std::byte *>(data);
+    _mapped_size = size;
+    _capacity = static_cast<uint32_t>(std::min<size_t>(capacity, no_slot));
+    // Пока в слот не писали, первая версия ляжет в копию 0
+    _current.resize(_capacity, 1);
+}
+
+void session_store::recover() {
+    const auto committed = [](const record &r) {
+        return r.sequence != 0 && r.sequence % 2 == 0 && r.checksum == r.compute_checksum() && r.kind <= bearer_kind;
+    };
+
+    // Слоты кладутся в стек с конца, чтобы младшие выдавались первыми
+    for (uint32_t slot = _capacity; slot-- > 0;) {
+        // Копия со счетчиком 0 еще не писалась. Незавершенная копия новее завершенной - оборванная запись
+        const record *newest = nullptr;
+        uint32_t latest = 0;
+        for (uint8_t copy = 0; copy < 2; ++copy) {
+            const auto &r = record_at(slot, copy);
+            latest = std::max(latest, r.sequence);
+            if (committed(r) && (!newest || r.sequence > newest->sequence)) {
+                newest = &r;
+                _current[slot] = copy;
+            }
+        }
+        if (latest > (newest ? newest->sequence : 0)) {
+            // Оборванная версия затирается последней завершенной, чтобы не считать ее при следующем открытии
+            ++_discarded;
+            if (newest) {
+                const auto kept = *newest;
+                commit(slot, static_cast<record_kind>(kept.kind), kept.payload, sizeof(kept.payload));
+            } else {
+                commit(slot, free_kind, nullptr, 0);
+            }
+        }
+
+        const auto &r = record_at(slot);
+        if (!newest || r.kind == free_kind) {
+            _free.push_back(slot);
+            continue;
+        }
+        if (r.kind == apn_kind) {
+            apn_record apn;
+            std::memcpy(&apn, r.payload, sizeof(apn));
+            _apns[std::string(apn.name, strnlen(apn.name, sizeof(apn.name)))] = slot;
+        }
+        ++_sizes[r.kind];
+    }
+}
+
+uint32_t session_store::allocate() {
+    if (_free.empty()) {
+        const auto capacity = _capacity;
+        const auto grown = std::min<size_t>(size_t{capacity} * 2, no_slot);
+        if (grown == capacity) {
+            throw std::length_error("session_store: too many records");
+        }
+        if (::ftruncate(_fd, static_cast<off_t>(header_size + grown * slot_size)) < 0) {
+            throw_errno("session_store: ftruncate");
+        }
+        map(grown);
+        for (auto slot = _capacity; slot-- > capacity;) {
+            _free.push_back(slot);
+        }
+    }
+    const auto slot = _free.back();
+    _free.pop_back();
+    return slot;
+}
+
+session_store::record &session_store::record_at(uint32_t slot, uint8_t copy) const {
+    return *reinterpret_cast<record *>(_data + header_size + size_t{slot} * slot_size + copy * record_size);
+}
+
+bool session_store::read(uint32_t slot, record_kind kind, void *payload, size_t size) const {
+    if (slot >= _capacity) {
+        return false;
+    }
+    const auto &r = record_at(slot);
+    if (r.kind != kind) {
+        return false;
+    }
+    std::memcpy(payload, r.payload, size);
+    return true;
+}
+
+void session_store::write(uint32_t slot, record_kind kind, const void *payload, size_t size) {
+    const auto &current = record_at(slot);
+    if (current.kind == apn_kind) {
+        std::erase_if(_apns, [slot](const auto &entry) { return entry.second == slot; });
+    }
+    if (current.kind != free_kind) {
+        --_sizes[current.kind];
+    }
+    if (kind != free_kind) {
+        ++_sizes[kind];
+    }
+
+    commit(slot, kind, payload, size);
+
+    if (kind == apn_kind) {
+        const auto *apn = static_cast<const apn_record *>(payload);
+        _apns[std::string(apn->name, strnlen(apn->name, sizeof(apn->name)))] = slot;
+    }
+}
+
+void session_store::commit(uint32_t slot, record_kind kind, const void *payload, size_t size) {
+    // Текущая версия не меняется, пока новая не завершена
+    const auto &current = record_at(slot);
+    auto &r = record_at(slot, _current[slot] ^ 1);
+
+    // Нечетный счетчик виден раньше любого из полей, четный - позже всех
+    std::atomic_ref sequence(r.sequence);
+    const auto next = (std::max(current.sequence, sequence.load(std::memory_order_relaxed)) | 1) + 1;
+    sequence.store(next - 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    r.kind = kind;
+    r.reserved = 0;
+    std::memset(r.payload, 0, sizeof(r.payload));
+    if (size) {
+        std::memcpy(r.payload, payload, size);
+    }
+    r.checksum = r.compute_checksum();
+    sequence.store(next, std::memory_order_release);
+    _current[slot] ^= 1;
+}
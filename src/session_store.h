@@ -0,0 +1,177 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// Состояние сессий в файле, отображенном в память: после перезапуска control_plane::attach_store
+// поднимает PDN connections, bearers и APN из файла, не дожидаясь повторных attach от UE.
+//
+// Файл - заголовок с версией формата и массив слотов фиксированного размера, в слоте две копии
+// записи. Новая версия пишется в копию, где лежит предыдущая: счетчик копии становится нечетным,
+// затем пишутся поля и контрольная сумма, затем счетчик четный и больше счетчика другой копии.
+// Если процесс упал посреди записи, при открытии оборванная копия нечетная или с чужой суммой и
+// отбрасывается, а слот читается из другой копии - последней завершенной версии; остальные слоты
+// целы: страницы MAP_SHARED переживают процесс. От отключения питания защищает только flush().
+//
+// Методы можно вызывать из разных потоков, они берут общий мьютекс. Пишет в основном
+// управляющий поток; data plane файл не читает.
+class session_store {
+public:
+    static constexpr uint32_t format_version = 2;
+    static constexpr size_t header_size = 4096;
+    static constexpr size_t record_size = 128;
+    // Копия i слота лежит по смещению header_size + slot * slot_size + i * record_size
+    static constexpr size_t slot_size = 2 * record_size;
+    static constexpr uint32_t no_slot = UINT32_MAX;
+
+    // Лимит одного уровня в единицах rate_limited_data_plane::rate_limit_config
+    struct rate_limit {
+        uint64_t uplink_rate = 0;
+        uint64_t uplink_capacity = 0;
+        uint64_t downlink_rate = 0;
+        uint64_t downlink_capacity = 0;
+    };
+
+    struct apn_record {
+        char name[64]{};  // Имена длиннее 63 символов не сохраняются
+        uint32_t gateway = 0;
+        // Собственный пул APN; префикс 0 - общий пул
+        uint32_t pool_network = 0;
+        uint8_t pool_prefix = 0;
+        bool has_ambr = false;
+        rate_limit ambr{};
+    };
+
+    struct pdn_record {
+        uint32_t cp_teid = 0;
+        uint32_t sgw_cp_teid = 0;
+        uint32_t sgw_address = 0;
+        uint32_t ue_ip = 0;
+        uint32_t apn_slot = no_slot;
+        uint32_t default_bearer_dp_teid = 0;
+        bool has_ambr = false;
+        rate_limit ambr{};
+    };
+
+    struct bearer_record {
+        uint32_t dp_teid = 0;
+        uint32_t sgw_dp_teid = 0;
+        uint32_t pdn_cp_teid = 0;
+        bool has_limits = false;  // MBR и GBR задаются вместе
+        rate_limit mbr{};
+        rate_limit gbr{};
+    };
+
+    struct config {
+        // Размер нового файла в записях; дальше файл растет вдвое
+        size_t initial_records = 65536;
+    };
+
+    // Открывает файл или создает новый. std::system_error при ошибке ввода-вывода,
+    // std::runtime_error, если это файл другого формата или версии
+    explicit session_store(const std::string &path);
+    session_store(const std::string &path, const config &config);
+    ~session_store();
+
+    session_store(const session_store &) = delete;
+    session_store &operator=(const session_store &) = delete;
+
+    // Номер слота новой записи
+    template<class Record>
+    uint32_t insert(const Record &record) {
+        std::lock_guard lock(_mutex);
+        const auto slot = allocate();
+        write(slot, kind_of<Record>(), &record, sizeof(record));
+        return slot;
+    }
+
+    // fn меняет копию записи, результат записывается целиком. Слоты другого типа не трогаются
+    template<class Record, class F>
+    void modify(uint32_t slot, F &&fn) {
+        std::lock_guard lock(_mutex);
+        Record record;
+        if (read(slot, kind_of<Record>(), &record, sizeof(record))) {
+            fn(record);
+            write(slot, kind_of<Record>(), &record, sizeof(record));
+        }
+    }
+
+    void erase(uint32_t slot);
+
+    // fn(slot, const Record &) для всех записей типа; из fn нельзя обращаться к хранилищу
+    template<class Record, class F>
+    void for_each(F &&fn) const {
+        std::lock_guard lock(_mutex);
+        Record record;
+        for (uint32_t slot = 0; slot < _capacity; ++slot) {
+            if (read(slot, kind_of<Record>(), &record, sizeof(record))) {
+                fn(slot, static_cast<const Record &>(record));
+            }
+        }
+    }
+
+    [[nodiscard]] std::optional<uint32_t> find_apn(std::string_view name) const;
+
+    // Живые записи всех типов или одного типа
+    [[nodiscard]] size_t size() const;
+    template<class Record>
+    [[nodiscard]] size_t size() const {
+        std::lock_guard lock(_mutex);
+        return _sizes[kind_of<Record>()];
+    }
+    // Сколько оборванных версий записей отброшено при открытии
+    [[nodiscard]] size_t discarded() const { return _discarded; }
+
+    // Сбрасывает страницы на диск (msync); нужно только для защиты от отключения питания
+    void flush();
+
+private:
+    enum record_kind : uint32_t { free_kind, apn_kind, pdn_kind, bearer_kind };
+
+    struct record;
+
+    template<class Record>
+    static constexpr record_kind kind_of() {
+        static_assert(std::is_trivially_copyable_v<Record>);
+        if constexpr (std::is_same_v<Record, apn_record>) {
+            return apn_kind;
+        } else if constexpr (std::is_same_v<Record, pdn_record>) {
+            return pdn_kind;
+        } else {
+            static_assert(std::is_same_v<Record, bearer_record>);
+            return bearer_kind;
+        }
+    }
+
+    void map(size_t capacity);
+    void recover();
+    uint32_t allocate();
+    record &record_at(uint32_t slot, uint8_t copy) const;
+    // Последняя завершенная версия
+    record &record_at(uint32_t slot) const { return record_at(slot, _current[slot]); }
+    bool read(uint32_t slot, record_kind kind, void *payload, size_t size) const;
+    void write(uint32_t slot, record_kind kind, const void *payload, size_t size);
+    // Пишет новую версию в другую копию слота, без учета размеров и имен APN
+    void commit(uint32_t slot, record_kind kind, const void *payload, size_t size);
+
+    mutable std::mutex _mutex;
+    int _fd = -1;
+    std::byte *_data = nullptr;
+    size_t _mapped_size = 0;
+    uint32_t _capacity = 0;
+    std::array<size_t, bearer_kind + 1> _sizes{};  // По типу записи
+    size_t _discarded = 0;
+    // Номер копии с последней завершенной версией, по слоту
+    std::vector<uint8_t> _current;
+    // Свободные слоты; младшие выдаются первыми
+    std::vector<uint32_t> _free;
+    std::unordered_map<std::string, uint32_t> _apns;
+};
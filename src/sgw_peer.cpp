@@ -0,0 +1,9 @@
+#include <sgw_peer.h>
+
+sgw_peer::sgw_peer(boost::asio::ip::address_v4 address) : _address(address.to_uint()) {}
+
+boost::asio::ip::address_v4 sgw_peer::get_address() const {
+    return boost::asio::ip::address_v4(_address.load(std::memory_order_relaxed));
+}
+
+const std::vector<uint32_t> &sgw_peer::get_sessions() const { return _sessions; }
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <boost/asio/ip/address_v4.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+class control_plane;
+
+// SGW, за которым стоят сессии. Один объект на адрес, его делят все PDN connections этого SGW:
+// переезд SGW на новый адрес - одна запись, которую data plane сразу видит у всех сессий.
+// Адрес читается из любых потоков, список сессий ведет только управляющий поток
+class sgw_peer {
+public:
+    explicit sgw_peer(boost::asio::ip::address_v4 address);
+
+    [[nodiscard]] boost::asio::ip::address_v4 get_address() const;
+
+    // Дескрипторы PDN connections в slot_map control plane, в произвольном порядке
+    [[nodiscard]] const std::vector<uint32_t> &get_sessions() const;
+
+private:
+    friend control_plane;
+
+    std::atomic<uint32_t> _address;
+    // PDN знает свою позицию в списке, удаление переносит на нее последний элемент
+    std::vector<uint32_t> _sessions;
+};
@@ -0,0 +1,255 @@
+#include <sharded_data_plane.h>
+#include <bearer.h>
+
+#include <pthread.h>
+
+#include <algorithm>
+#include <chrono>
+#include <type_traits>
+
+sharded_data_plane::sharded_data_plane(control_plane &control_plane, const config &config,
+                                       const factory &make_data_plane) :
+    _control_plane(control_plane), _config(config), _staging(std::max<size_t>(config.workers, 1)) {
+    const auto count = std::max<size_t>(config.workers, 1);
+    _workers.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        _workers.push_back(std::make_unique<worker>(config.ring_size, make_data_plane(control_plane, i)));
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        auto &w = *_workers[i];
+        w.thread = std::thread([this, &w, i] { run(w, i); });
+
+        if (_config.pin_threads) {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(_config.first_cpu + i, &cpus);
+            pthread_setaffinity_np(w.thread.native_handle(), sizeof(cpus), &cpus);
+        }
+    }
+}
+
+sharded_data_plane::~sharded_data_plane() { stop(); }
+
+bool sharded_data_plane::handle_uplink(uint32_t dp_teid, data_plane::Packet &&packet) {
+    auto &w = *_workers[worker_for_dp_teid(dp_teid)];
+    if (!w.ring.try_push({direction::uplink, dp_teid, std::move(packet)})) {
+        ++_dropped;
+        return false;
+    }
+    ++w.enqueued;
+    return true;
+}
+
+bool sharded_data_plane::handle_downlink(const boost::asio::ip::address_v4 &ue_ip, data_plane::Packet &&packet) {
+    auto &w = *_workers[worker_for_ue_ip(ue_ip)];
+    if (!w.ring.try_push({direction::downlink, ue_ip.to_uint(), std::move(packet)})) {
+        ++_dropped;
+        return false;
+    }
+    ++w.enqueued;
+    return true;
+}
+
+size_t sharded_data_plane::handle_uplink_burst(std::span<data_plane::uplink_packet> burst) {
+    return dispatch_burst(burst, direction::uplink);
+}
+
+size_t sharded_data_plane::handle_downlink_burst(std::span<data_plane::downlink_packet> burst) {
+    return dispatch_burst(burst, direction::downlink);
+}
+
+template<class Burst>
+size_t sharded_data_plane::dispatch_burst(std::span<Burst> burst, direction dir) {
+    // Раскладываем пакеты по рабочим потокам и отправляем каждому одной порцией
+    if constexpr (std::is_same_v<Burst, data_plane::uplink_packet>) {
+        epoch_guard guard;
+        uint32_t dp_teids[lookup_batch];
+        bearer *bearers[lookup_batch];
+        for (size_t offset = 0; offset < burst.size(); offset += lookup_batch) {
+            const auto count = std::min(lookup_batch, burst.size() - offset);
+            if (!_config.teid_shard_bits) {
+                for (size_t i = 0; i < count; ++i) {
+                    dp_teids[i] = burst[offset + i].dp_teid;
+                }
+                _control_plane.find_bearers_by_dp_teid({dp_teids, count}, {bearers, count});
+            }
+            for (size_t i = 0; i < count; ++i) {
+                auto &item = burst[offset + i];
+                const auto worker = _config.teid_shard_bits ? worker_for_dp_teid(item.dp_teid)
+                                                            : worker_for_bearer(bearers[i], item.dp_teid);
+                _staging[worker].push_back({dir, item.dp_teid, std::move(item.packet)});
+            }
+        }
+    } else {
+        for (auto &item : burst) {
+            _staging[worker_for_ue_ip(item.ue_ip)].push_back({dir, item.ue_ip.to_uint(), std::move(item.packet)});
+        }
+    }
+
+    size_t accepted = 0;
+    for (size_t i = 0; i < _workers.size(); ++i) {
+        auto &staged = _staging[i];
+        if (staged.empty()) {
+            continue;
+        }
+        auto pushed = _workers[i]->ring.push_burst(staged);
+        _workers[i]->enqueued += pushed;
+        _dropped += staged.size() - pushed;
+        accepted += pushed;
+        staged.clear();
+    }
+    return accepted;
+}
+
+size_t sharded_data_plane::worker_for_dp_teid(uint32_t dp_teid) const {
+    if (_config.teid_shard_bits) {
+        return (dp_teid >> (32 - _config.teid_shard_bits)) % _workers.size();
+    }
+    epoch_guard guard;
+    return worker_for_bearer(_control_plane.find_bearer_view(dp_teid), dp_teid);
+}
+
+size_t sharded_data_plane::worker_for_bearer(const bearer *found, uint32_t dp_teid) const {
+    // Пакет неизвестного bearer все равно будет отброшен, поток для него не важен
+    return worker_for(found ? found->get_pdn_view().get_cp_teid() : dp_teid);
+}
+
+size_t sharded_data_plane::worker_for_ue_ip(const boost::asio::ip::address_v4 &ue_ip) const {
+    return worker_for(ue_ip.to_uint());
+}
+
+size_t sharded_data_plane::worker_for(uint32_t key) const {
+    // Перемешиваем ключ и отображаем на [0, workers) умножением вместо деления
+    const uint32_t hash = key * 0x9e3779b1u;
+    return static_cast<size_t>((static_cast<uint64_t>(hash) * _workers.size()) >> 32);
+}
+
+traffic_counters::usage sharded_data_plane::bearer_usage(uint32_t bearer_handle) const {
+    traffic_counters::usage total;
+    for (const auto &w : _workers) {
+        total += w->plane->get_counters().bearer_usage(bearer_handle);
+    }
+    return total;
+}
+
+traffic_counters::usage sharded_data_plane::pdn_usage(uint32_t pdn_handle) const {
+    traffic_counters::usage total;
+    for (const auto &w : _workers) {
+        total += w->plane->get_counters().pdn_usage(pdn_handle);
+    }
+    return total;
+}
+
+traffic_counters::usage sharded_data_plane::apn_usage(uint32_t apn_id) const {
+    traffic_counters::usage total;
+    for (const auto &w : _workers) {
+        total += w->plane->get_counters().apn_usage(apn_id);
+    }
+    return total;
+}
+
+uint64_t sharded_data_plane::drops(traffic_counters::drop_reason reason) const {
+    uint64_t total = 0;
+    for (const auto &w : _workers) {
+        total += w->plane->get_counters().drops(reason);
+    }
+    return total;
+}
+
+void sharded_data_plane::post(size_t worker_index, std::function<void(data_plane &)> task) {
+    auto &w = *_workers[worker_index];
+    {
+        std::lock_guard lock(w.tasks_mutex);
+        w.tasks.push_back(std::move(task));
+    }
+    w.tasks_posted.fetch_add(1, std::memory_order_release);
+}
+
+void sharded_data_plane::broadcast(const std::function<void(data_plane &)> &task) {
+    for (size_t i = 0; i < _workers.size(); ++i) {
+        post(i, task);
+    }
+}
+
+void sharded_data_plane::drain() {
+    for (auto &w : _workers) {
+        while (w->processed.load(std::memory_order_acquire) != w->enqueued ||
+               w->tasks_done.load(std::memory_order_acquire) != w->tasks_posted.load(std::memory_order_relaxed)) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void sharded_data_plane::stop() {
+    _stop.store(true, std::memory_order_release);
+    for (auto &w : _workers) {
+        if (w->thread.joinable()) {
+            w->thread.join();
+        }
+    }
+}
+
+void sharded_data_plane::run(worker &w, size_t) {
+    std::vector<job> jobs(std::max<size_t>(_config.burst_size, 1));
+    std::vector<data_plane::uplink_packet> uplink;
+    std::vector<data_plane::downlink_packet> downlink;
+    uplink.reserve(jobs.size());
+    downlink.reserve(jobs.size());
+
+    size_t idle = 0;
+    while (true) {
+        const auto n = w.ring.pop_burst(jobs);
+
+        // Задачи проверяем после извлечения пакетов: задача, отправленная раньше пакета,
+        // выполнится раньше его обработки
+        if (w.tasks_posted.load(std::memory_order_acquire) != w.tasks_done.load(std::memory_order_relaxed)) {
+            std::vector<std::function<void(data_plane &)>> tasks;
+            {
+                std::lock_guard lock(w.tasks_mutex);
+                tasks.swap(w.tasks);
+            }
+            for (auto &task : tasks) {
+                task(*w.plane);
+            }
+            w.tasks_done.fetch_add(tasks.size(), std::memory_order_release);
+        }
+
+        // Отложенная работа data plane, в том числе когда пакетов нет
+        w.plane->poll();
+
+        if (n == 0) {
+            if (_stop.load(std::memory_order_acquire) && w.ring.empty()) {
+                break;
+            }
+            // Сначала крутимся, затем уступаем ядро, затем засыпаем
+            if (++idle > 4096) {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            } else if (idle > 64) {
+                std::this_thread::yield();
+            }
+            continue;
+        }
+        idle = 0;
+
+        for (size_t i = 0; i < n; ++i) {
+            auto &j = jobs[i];
+            if (j.dir == direction::uplink) {
+                uplink.push_back({j.key, std::move(j.packet)});
+            } else {
+                downlink.push_back({boost::asio::ip::address_v4(j.key), std::move(j.packet)});
+            }
+        }
+        if (!uplink.empty()) {
+            w.plane->handle_uplink_burst(uplink);
+            uplink.clear();
+        }
+        if (!downlink.empty()) {
+            w.plane->handle_downlink_burst(downlink);
+            downlink.clear();
+        }
+
+        // Счетчик пишет только этот поток, атомарный инкремент не нужен
+        w.processed.store(w.processed.load(std::memory_order_relaxed) + n, std::memory_order_release);
+    }
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <data_plane.h>
+#include <spsc_ring.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Многопоточный data plane: N рабочих потоков, у каждого свой экземпляр data_plane и свое
+// входное SPSC кольцо. Uplink распределяется по хешу CP TEID PDN, которому принадлежит bearer,
+// downlink - по хешу UE IP, поэтому пакеты одной сессии в одном направлении всегда обрабатывает
+// один поток и состояние сессии (например, session AMBR в rate_limited_data_plane) не требует
+// синхронизации.
+//
+// Если TEID выделяются с номером шарда в старших битах (teid_allocator), uplink распределяется
+// по шарду DP TEID без поиска bearer: все bearers одного PDN и так лежат в одном шарде.
+//
+// handle_* должны вызываться из одного потока-диспетчера.
+class sharded_data_plane {
+public:
+    using factory = std::function<std::unique_ptr<data_plane>(control_plane &control_plane, size_t worker)>;
+
+    struct config {
+        size_t workers = 1;
+        size_t ring_size = 4096;
+        size_t burst_size = 32;
+        // Привязка i-го рабочего потока к ядру first_cpu + i
+        bool pin_threads = false;
+        size_t first_cpu = 0;
+        // Совпадает с teid_allocator::config::shard_bits control plane; 0 - распределение по PDN
+        uint8_t teid_shard_bits = 0;
+    };
+
+    sharded_data_plane(control_plane &control_plane, const config &config, const factory &make_data_plane);
+    ~sharded_data_plane();
+
+    sharded_data_plane(const sharded_data_plane &) = delete;
+    sharded_data_plane &operator=(const sharded_data_plane &) = delete;
+
+    // false, если кольцо рабочего потока переполнено и пакет отброшен
+    bool handle_uplink(uint32_t dp_teid, data_plane::Packet &&packet);
+    bool handle_downlink(const boost::asio::ip::address_v4 &ue_ip, data_plane::Packet &&packet);
+
+    // Возвращают количество принятых пакетов
+    size_t handle_uplink_burst(std::span<data_plane::uplink_packet> burst);
+    size_t handle_downlink_burst(std::span<data_plane::downlink_packet> burst);
+
+    [[nodiscard]] size_t worker_for_dp_teid(uint32_t dp_teid) const;
+    [[nodiscard]] size_t worker_for_ue_ip(const boost::asio::ip::address_v4 &ue_ip) const;
+
+    // Выполняет функцию в рабочем потоке между burst'ами, например для настройки rate limits
+    void post(size_t worker, std::function<void(data_plane &)> task);
+    void broadcast(const std::function<void(data_plane &)> &task);
+
+    // Ждет, пока рабочие потоки обработают все отправленные пакеты и задачи
+    void drain();
+    void stop();
+
+    // Суммы счетчиков всех рабочих потоков; читаются на ходу, без остановки пересылки
+    [[nodiscard]] traffic_counters::usage bearer_usage(uint32_t bearer_handle) const;
+    [[nodiscard]] traffic_counters::usage pdn_usage(uint32_t pdn_handle) const;
+    [[nodiscard]] traffic_counters::usage apn_usage(uint32_t apn_id) const;
+    [[nodiscard]] uint64_t drops(traffic_counters::drop_reason reason) const;
+
+    [[nodiscard]] size_t workers() const { return _workers.size(); }
+    [[nodiscard]] uint64_t dropped() const { return _dropped; }
+
+private:
+    // Uplink burst без шардов TEID ищет bearers порциями, как control_plane
+    static constexpr size_t lookup_batch = 64;
+
+    enum class direction : uint8_t { uplink, downlink };
+
+    struct job {
+        direction dir{};
+        uint32_t key{};
+        data_plane::Packet packet;
+    };
+
+    struct worker {
+        worker(size_t ring_size, std::unique_ptr<data_plane> plane) : ring(ring_size), plane(std::move(plane)) {}
+
+        spsc_ring<job> ring;
+        std::unique_ptr<data_plane> plane;
+        std::thread thread;
+
+        uint64_t enqueued{};
+        alignas(64) std::atomic<uint64_t> processed{0};
+
+        std::mutex tasks_mutex;
+        std::vector<std::function<void(data_plane &)>> tasks;
+        std::atomic<uint64_t> tasks_posted{0};
+        std::atomic<uint64_t> tasks_done{0};
+    };
+
+    void run(worker &w, size_t index);
+    size_t worker_for(uint32_t key) const;
+    size_t worker_for_bearer(const bearer *found, uint32_t dp_teid) const;
+    template<class Burst>
+    size_t dispatch_burst(std::span<Burst> burst, direction dir);
+
+    control_plane &_control_plane;
+    config _config;
+    std::vector<std::unique_ptr<worker>> _workers;
+    std::atomic<bool> _stop{false};
+    uint64_t _dropped{};
+
+    std::vector<std::vector<job>> _staging;
+};
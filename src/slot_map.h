@@ -0,0 +1,156 @@
+#pragma once
+
+#include <huge_pages.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <new>
+#include <stdexcept>
+
+// Хранилище объектов с 32-битными дескрипторами: младшие 24 бита - номер слота, старшие 8 -
+// поколение слота. При удалении поколение увеличивается, поэтому устаревший дескриптор не
+// разыменовывается в новый объект. Дескриптор 0 никогда не выдается.
+//
+// Слоты лежат в блоках, которые никогда не перемещаются: get() можно вызывать из любых потоков
+// внутри epoch_guard, пока один управляющий поток вставляет и удаляет объекты. Объект владеется
+// через shared_ptr только со стороны писателя; читатель получает обычный указатель.
+template<class T>
+class slot_map {
+public:
+    using handle = uint32_t;
+
+    static constexpr uint32_t index_bits = 24;
+    static constexpr uint32_t index_mask = (1u << index_bits) - 1;
+    static constexpr size_t max_size = size_t{1} << index_bits;
+    static constexpr handle invalid_handle = 0;
+
+    slot_map() = default;
+    ~slot_map() {
+        for (auto &chunk : _chunks) {
+            if (auto *slots = chunk.load(std::memory_order_relaxed)) {
+                std::destroy_n(slots, chunk_size);
+                huge_pages::unmap(slots, chunk_size * sizeof(slot));
+            }
+        }
+    }
+
+    slot_map(const slot_map &) = delete;
+    slot_map &operator=(const slot_map &) = delete;
+
+    [[nodiscard]] static uint32_t index_of(handle h) { return h & index_mask; }
+
+    // nullptr для устаревшего или неизвестного дескриптора
+    [[nodiscard]] T *get(handle h) const {
+        const auto index = index_of(h);
+        const auto *chunk = _chunks[index / chunk_size].load(std::memory_order_acquire);
+        if (!chunk) {
+            return nullptr;
+        }
+        const auto &s = chunk[index % chunk_size];
+        const auto generation = h >> index_bits;
+        if (s.generation.load(std::memory_order_acquire) != generation) {
+            return nullptr;
+        }
+        auto *object = s.object.load(std::memory_order_acquire);
+        // Слот могли освободить и занять заново между двумя чтениями поколения
+        if (s.generation.load(std::memory_order_relaxed) != generation) {
+            return nullptr;
+        }
+        return object;
+    }
+
+    // Подгружает в кэш слот дескриптора перед пакетным get()
+    void prefetch(handle h) const {
+        const auto index = index_of(h);
+        if (const auto *chunk = _chunks[index / chunk_size].load(std::memory_order_acquire)) {
+            __builtin_prefetch(&chunk[index % chunk_size]);
+        }
+    }
+
+    // Дальше - только для писателя
+
+    handle insert(std::shared_ptr<T> object) {
+        if (_free.empty()) {
+            grow();
+        }
+        // FIFO: освобожденный слот возвращается в работу последним, что отдаляет
+        // повторение поколения для одного и того же слота
+        const auto index = _free.front();
+        _free.pop_front();
+
+        auto &s = slot_at(index);
+        s.object.store(object.get(), std::memory_order_release);
+        s.owner = std::move(object);
+        ++_size;
+        return (s.generation.load(std::memory_order_relaxed) << index_bits) | index;
+    }
+
+    // Возвращает владеющий указатель; освобождать его следует через epoch_domain
+    std::shared_ptr<T> erase(handle h) {
+        if (!get(h)) {
+            return nullptr;
+        }
+        const auto index = index_of(h);
+        auto &s = slot_at(index);
+        s.object.store(nullptr, std::memory_order_relaxed);
+        auto generation = (s.generation.load(std::memory_order_relaxed) + 1) & 0xff;
+        s.generation.store(generation ? generation : 1, std::memory_order_release);
+        _free.push_back(index);
+        --_size;
+        return std::move(s.owner);
+    }
+
+    [[nodiscard]] const std::shared_ptr<T> &owner(handle h) const {
+        static const std::shared_ptr<T> none;
+        return get(h) ? slot_at(index_of(h)).owner : none;
+    }
+
+    void reserve(size_t size) {
+        while (_capacity < std::min(size, max_size)) {
+            grow();
+        }
+    }
+
+    [[nodiscard]] size_t size() const { return _size; }
+
+private:
+    static constexpr size_t chunk_size = 65536;
+
+    struct slot {
+        std::atomic<uint32_t> generation{1};
+        std::atomic<T *> object{nullptr};
+        std::shared_ptr<T> owner;
+    };
+
+    slot &slot_at(uint32_t index) const {
+        return _chunks[index / chunk_size].load(std::memory_order_relaxed)[index % chunk_size];
+    }
+
+    void grow() {
+        if (_capacity >= max_size) {
+            throw std::length_error("slot_map: too many objects");
+        }
+        // Блок на миллионах сессий читается вразброс, поэтому в huge pages
+        auto *chunk = static_cast<slot *>(huge_pages::map(chunk_size * sizeof(slot)));
+        if (!chunk) {
+            throw std::bad_alloc();
+        }
+        std::uninitialized_default_construct_n(chunk, chunk_size);
+        const auto first = static_cast<uint32_t>(_capacity);
+        // Слот 0 с поколением 0 не существует, поэтому дескриптор 0 недостижим
+        for (uint32_t i = 0; i < chunk_size; ++i) {
+            _free.push_back(first + i);
+        }
+        _chunks[_capacity / chunk_size].store(chunk, std::memory_order_release);
+        _capacity += chunk_size;
+    }
+
+    std::array<std::atomic<slot *>, max_size / chunk_size> _chunks{};
+    std::deque<uint32_t> _free;
+    size_t _capacity{};
+    size_t _size{};
+};
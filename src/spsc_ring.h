@@ -0,0 +1,87 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <span>
+
+// Lock-free кольцевой буфер для одного производителя и одного потребителя.
+// Индексы производителя и потребителя лежат в разных кэш-линиях, каждая сторона кэширует
+// чужой индекс и перечитывает его, только когда кольцо кажется полным или пустым.
+template<class T>
+class spsc_ring {
+public:
+    explicit spsc_ring(size_t capacity) :
+        _mask(std::bit_ceil(std::max<size_t>(capacity, 2)) - 1), _items(std::make_unique<T[]>(_mask + 1)) {}
+
+    spsc_ring(const spsc_ring &) = delete;
+    spsc_ring &operator=(const spsc_ring &) = delete;
+
+    bool try_push(T &&item) {
+        const auto tail = _producer.tail.load(std::memory_order_relaxed);
+        if (tail - _producer.cached_head > _mask) {
+            _producer.cached_head = _consumer.head.load(std::memory_order_acquire);
+            if (tail - _producer.cached_head > _mask) {
+                return false;
+            }
+        }
+        _items[tail & _mask] = std::move(item);
+        _producer.tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Перемещает в кольцо сколько поместится, возвращает количество
+    size_t push_burst(std::span<T> items) {
+        const auto tail = _producer.tail.load(std::memory_order_relaxed);
+        auto free = _mask + 1 - (tail - _producer.cached_head);
+        if (free < items.size()) {
+            _producer.cached_head = _consumer.head.load(std::memory_order_acquire);
+            free = _mask + 1 - (tail - _producer.cached_head);
+        }
+        const auto n = std::min(free, items.size());
+        for (size_t i = 0; i < n; ++i) {
+            _items[(tail + i) & _mask] = std::move(items[i]);
+        }
+        _producer.tail.store(tail + n, std::memory_order_release);
+        return n;
+    }
+
+    size_t pop_burst(std::span<T> out) {
+        const auto head = _consumer.head.load(std::memory_order_relaxed);
+        auto available = _consumer.cached_tail - head;
+        if (available < out.size()) {
+            _consumer.cached_tail = _producer.tail.load(std::memory_order_acquire);
+            available = _consumer.cached_tail - head;
+        }
+        const auto n = std::min(available, out.size());
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = std::move(_items[(head + i) & _mask]);
+        }
+        _consumer.head.store(head + n, std::memory_order_release);
+        return n;
+    }
+
+    [[nodiscard]] bool empty() const {
+        return _consumer.head.load(std::memory_order_acquire) == _producer.tail.load(std::memory_order_acquire);
+    }
+
+    [[nodiscard]] size_t capacity() const { return _mask + 1; }
+
+private:
+    struct alignas(64) producer_side {
+        std::atomic<size_t> tail{0};
+        size_t cached_head{0};
+    };
+
+    struct alignas(64) consumer_side {
+        std::atomic<size_t> head{0};
+        size_t cached_tail{0};
+    };
+
+    const size_t _mask;
+    std::unique_ptr<T[]> _items;
+    producer_side _producer;
+    consumer_side _consumer;
+};
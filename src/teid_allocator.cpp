@@ -0,0 +1,131 @@
+#include <teid_allocator.h>
+
+#include <algorithm>
+
+teid_allocator::teid_allocator() : teid_allocator(config{}) {}
+
+teid_allocator::teid_allocator(const config &config) :
+    _config(config), _local_bits(32 - std::min(config.shard_bits, max_shard_bits)),
+    _local_limit(static_cast<uint32_t>((uint64_t{1} << _local_bits) - 1)),
+    _shards(size_t{1} << (32 - _local_bits)) {
+    _config.shard_bits = static_cast<uint8_t>(32 - _local_bits);
+}
+
+uint32_t teid_allocator::allocate(size_t shard_index, clock::time_point now) {
+    shard_index %= _shards.size();
+    auto &s = _shards[shard_index];
+
+    // Сначала возвращаем в работу TEID, отбывшие карантин, чтобы очередь не росла
+    if (!s.quarantine.empty() && now - s.quarantine.front().released >= _config.quarantine) {
+        const auto teid = s.quarantine.front().teid;
+        s.quarantine.pop_front();
+        return teid;
+    }
+    const auto prefix = _config.shard_bits ? static_cast<uint32_t>(shard_index) << _local_bits : 0;
+    if (const auto gap = take_gap(s, now)) {
+        return prefix | gap;
+    }
+
+    // Локальный TEID 0 не выдается, чтобы TEID шарда 0 не был нулевым
+    if (s.next == 0 || s.next > _local_limit) {
+        return 0;
+    }
+    return prefix | s.next++;
+}
+
+size_t teid_allocator::allocate(std::span<uint32_t> teids, size_t shard_index, clock::time_point now) {
+    shard_index %= _shards.size();
+    auto &s = _shards[shard_index];
+
+    size_t count = 0;
+    while (count < teids.size() && !s.quarantine.empty() &&
+           now - s.quarantine.front().released >= _config.quarantine) {
+        teids[count++] = s.quarantine.front().teid;
+        s.quarantine.pop_front();
+    }
+    const auto prefix = _config.shard_bits ? static_cast<uint32_t>(shard_index) << _local_bits : 0;
+    while (count < teids.size()) {
+        const auto gap = take_gap(s, now);
+        if (!gap) {
+            break;
+        }
+        teids[count++] = prefix | gap;
+    }
+
+    // Новые TEID - один отрезок счетчика шарда
+    if (s.next == 0) {
+        return count;
+    }
+    const auto fresh = std::min<size_t>(teids.size() - count, size_t{_local_limit} - s.next + 1);
+    for (size_t i = 0; i < fresh; ++i) {
+        teids[count++] = prefix | (s.next + static_cast<uint32_t>(i));
+    }
+    const auto next = uint64_t{s.next} + fresh;
+    s.next = next > _local_limit ? 0 : static_cast<uint32_t>(next);
+    return count;
+}
+
+void teid_allocator::release(uint32_t teid, clock::time_point now) {
+    if (teid == 0) {
+        return;
+    }
+    _shards[shard_of(teid)].quarantine.push_back({teid, now});
+}
+
+void teid_allocator::restore(uint32_t teid) {
+    const auto local = teid & _local_limit;
+    if (local == 0) {
+        return;
+    }
+    auto &s = _shards[shard_of(teid)];
+    if (!s.restoring) {
+        s.restoring = true;
+        s.restore_base = s.next;
+    }
+    s.restored.push_back(local);
+    // Счетчик 0 означает, что шард исчерпан
+    if (s.next != 0 && local >= s.next) {
+        s.next = local == _local_limit ? 0 : local + 1;
+    }
+}
+
+void teid_allocator::finish_restore(clock::time_point now) {
+    for (auto &s : _shards) {
+        if (!s.restoring) {
+            continue;
+        }
+        // Шард, исчерпанный еще до восстановления, промежутков не получает
+        if (s.restore_base != 0) {
+            std::sort(s.restored.begin(), s.restored.end());
+            const uint64_t end = s.next == 0 ? uint64_t{_local_limit} + 1 : s.next;
+            uint64_t free = s.restore_base;
+            for (auto local : s.restored) {
+                if (local > free) {
+                    s.gaps.push_back({static_cast<uint32_t>(free), local - 1});
+                }
+                free = std::max<uint64_t>(free, uint64_t{local} + 1);
+            }
+            if (free < end) {
+                s.gaps.push_back({static_cast<uint32_t>(free), static_cast<uint32_t>(end - 1)});
+            }
+            s.gaps_ready = now + _config.quarantine;
+        }
+        s.restoring = false;
+        s.restored.clear();
+        s.restored.shrink_to_fit();
+    }
+}
+
+uint32_t teid_allocator::take_gap(shard &s, clock::time_point now) {
+    if (s.gaps.empty() || now < s.gaps_ready) {
+        return 0;
+    }
+    auto &gap = s.gaps.front();
+    const auto local = gap.first;
+    if (gap.first == gap.last) {
+        s.gaps.pop_front();
+    } else {
+        ++gap.first;
+    }
+    return local;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <span>
+#include <vector>
+
+// Выделяет TEID без случайного перебора. Пространство TEID делится на 2^shard_bits шардов, номер
+// шарда хранится в старших битах TEID. Каждый шард - отдельная кэш-линия со своим счетчиком и
+// очередью освобожденных TEID, поэтому шард, которым пользуется один поток, не требует блокировок.
+//
+// Освобожденный TEID попадает в карантин и выдается снова не раньше, чем через quarantine:
+// запоздавшие GTP-U пакеты старой сессии не попадут в новую. Пока в карантине нет созревших TEID,
+// выдаются новые по порядку, поэтому последовательность TEID детерминирована.
+class teid_allocator {
+public:
+    using clock = std::chrono::steady_clock;
+
+    struct config {
+        uint8_t shard_bits = 0;
+        clock::duration quarantine = std::chrono::seconds(10);
+    };
+
+    static constexpr uint8_t max_shard_bits = 8;
+
+    teid_allocator();
+    explicit teid_allocator(const config &config);
+
+    // 0, если в шарде не осталось свободных TEID
+    uint32_t allocate(size_t shard = 0, clock::time_point now = clock::now());
+    // Заполняет teids из одного шарда: сначала TEID, отбывшие карантин, затем свободные после
+    // восстановления, затем новые подряд. Возвращает, сколько выдано; меньше размера teids, только
+    // если шард исчерпан
+    size_t allocate(std::span<uint32_t> teids, size_t shard = 0, clock::time_point now = clock::now());
+    void release(uint32_t teid, clock::time_point now = clock::now());
+    // Отмечает TEID, выданный до перезапуска, занятым: счетчик шарда уходит за него
+    void restore(uint32_t teid);
+    // После restore всех TEID: свободные TEID, через которые перешагнул счетчик, снова выдаются.
+    // Среди них могут быть бывшие в карантине до перезапуска, поэтому не раньше now + quarantine
+    void finish_restore(clock::time_point now = clock::now());
+
+    [[nodiscard]] size_t shard_of(uint32_t teid) const { return _config.shard_bits ? teid >> _local_bits : 0; }
+    [[nodiscard]] size_t shards() const { return _shards.size(); }
+
+private:
+    struct quarantined {
+        uint32_t teid;
+        clock::time_point released;
+    };
+
+    // Локальные TEID [first, last]
+    struct range {
+        uint32_t first;
+        uint32_t last;
+    };
+
+    struct alignas(64) shard {
+        uint32_t next{1};
+        std::deque<quarantined> quarantine;
+        // Промежутки между восстановленными TEID, выдаются с gaps_ready
+        std::deque<range> gaps;
+        clock::time_point gaps_ready;
+        // До finish_restore: счетчик до первого restore и восстановленные локальные TEID. Ниже
+        // restore_base все TEID выдавал этот процесс, там промежутков нет
+        bool restoring = false;
+        uint32_t restore_base{};
+        std::vector<uint32_t> restored;
+    };
+
+    uint32_t take_gap(shard &s, clock::time_point now);
+
+    config _config;
+    uint8_t _local_bits;
+    uint32_t _local_limit;
+    std::vector<shard> _shards;
+};
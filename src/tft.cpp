@@ -0,0 +1,118 @@
+#include <tft.h>
+
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace tft {
+    flow_key downlink_key(std::span<const uint8_t> packet) {
+        flow_key key;
+        if (packet.size() < 20 || packet[0] >> 4 != 4) {
+            return key;
+        }
+        const size_t header_size = (packet[0] & 0x0f) * 4u;
+        key.tos = packet[1];
+        key.protocol = packet[9];
+        key.remote_address = uint32_t{packet[12]} << 24 | uint32_t{packet[13]} << 16 | uint32_t{packet[14]} << 8 |
+                             uint32_t{packet[15]};
+
+        // TCP, UDP, SCTP: порты в первых четырех байтах заголовка
+        const bool first_fragment = ((packet[6] & 0x1f) | packet[7]) == 0;
+        const bool has_ports = key.protocol == 6 || key.protocol == 17 || key.protocol == 132;
+        if (first_fragment && has_ports && header_size >= 20 && packet.size() >= header_size + 4) {
+            key.remote_port = static_cast<uint16_t>(packet[header_size] << 8 | packet[header_size + 1]);
+            key.local_port = static_cast<uint16_t>(packet[header_size + 2] << 8 | packet[header_size + 3]);
+        }
+        return key;
+    }
+} // namespace tft
+
+tft_classifier::tft_classifier(std::span<const bearer_filters> bearers) {
+    struct entry {
+        const tft::packet_filter *filter;
+        bearer *owner;
+    };
+    std::vector<entry> entries;
+    for (const auto &b : bearers) {
+        for (const auto &filter : b.filters) {
+            entries.push_back({&filter, b.owner});
+        }
+    }
+    if (entries.size() > max_filters) {
+        throw std::length_error("tft_classifier: too many packet filters");
+    }
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](const entry &a, const entry &b) { return a.filter->precedence < b.filter->precedence; });
+
+    _size = entries.size();
+    _padded_size = std::min(max_filters, (_size + lanes - 1) / lanes * lanes);
+    for (size_t i = 0; i < max_filters; ++i) {
+        if (i >= _size) {
+            // Адрес вне маски: фильтр не совпадает ни с чем
+            _remote_address[i] = 1;
+            continue;
+        }
+        const auto &f = *entries[i].filter;
+        _remote_mask[i] = f.remote_mask;
+        _remote_address[i] = f.remote_address & f.remote_mask;
+        _protocol[i] = f.protocol;
+        _protocol_mask[i] = f.protocol ? 0xff : 0;
+        _local_port_low[i] = f.local_port_low;
+        _local_port_high[i] = f.local_port_high;
+        _remote_port_low[i] = f.remote_port_low;
+        _remote_port_high[i] = f.remote_port_high;
+        _tos_mask[i] = f.tos_mask;
+        _tos[i] = f.tos & f.tos_mask;
+        _bearers[i] = entries[i].owner;
+    }
+}
+
+uint64_t tft_classifier::match(const tft::flow_key &key) const {
+    uint64_t hits = 0;
+#if defined(__SSE2__)
+    // Четыре фильтра за итерацию. Порты меньше 2^16, поэтому знаковое сравнение SSE2 подходит
+    const auto remote_address = _mm_set1_epi32(static_cast<int>(key.remote_address));
+    const auto remote_port = _mm_set1_epi32(key.remote_port);
+    const auto local_port = _mm_set1_epi32(key.local_port);
+    const auto protocol = _mm_set1_epi32(key.protocol);
+    const auto tos = _mm_set1_epi32(key.tos);
+    const auto load = [](const std::array<uint32_t, max_filters> &field, size_t i) {
+        return _mm_load_si128(reinterpret_cast<const __m128i *>(field.data() + i));
+    };
+    for (size_t i = 0; i < _padded_size; i += lanes) {
+        auto m = _mm_cmpeq_epi32(_mm_and_si128(remote_address, load(_remote_mask, i)), load(_remote_address, i));
+        m = _mm_and_si128(m, _mm_cmpeq_epi32(_mm_and_si128(protocol, load(_protocol_mask, i)), load(_protocol, i)));
+        m = _mm_and_si128(m, _mm_cmpeq_epi32(_mm_and_si128(tos, load(_tos_mask, i)), load(_tos, i)));
+        // low <= port <= high: ни low > port, ни port > high
+        m = _mm_andnot_si128(_mm_cmpgt_epi32(load(_local_port_low, i), local_port), m);
+        m = _mm_andnot_si128(_mm_cmpgt_epi32(local_port, load(_local_port_high, i)), m);
+        m = _mm_andnot_si128(_mm_cmpgt_epi32(load(_remote_port_low, i), remote_port), m);
+        m = _mm_andnot_si128(_mm_cmpgt_epi32(remote_port, load(_remote_port_high, i)), m);
+        hits |= uint64_t{static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(m)))} << i;
+    }
+#else
+    for (size_t i = 0; i < _padded_size; ++i) {
+        const bool m = (key.remote_address & _remote_mask[i]) == _remote_address[i] &&
+                       (key.protocol & _protocol_mask[i]) == _protocol[i] && (key.tos & _tos_mask[i]) == _tos[i] &&
+                       key.local_port >= _local_port_low[i] && key.local_port <= _local_port_high[i] &&
+                       key.remote_port >= _remote_port_low[i] && key.remote_port <= _remote_port_high[i];
+        hits |= uint64_t{m} << i;
+    }
+#endif
+    return hits;
+}
+
+bearer *tft_classifier::classify(const tft::flow_key &key) const {
+    const auto hits = match(key);
+    return hits ? _bearers[std::countr_zero(hits)] : nullptr;
+}
+
+void tft_classifier::classify(std::span<const tft::flow_key> keys, std::span<bearer *> bearers) const {
+    for (size_t i = 0; i < keys.size(); ++i) {
+        bearers[i] = classify(keys[i]);
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+class bearer;
+
+// Traffic Flow Template (TS 24.008, 10.5.6.12) для downlink: пакетные фильтры dedicated bearers
+// одного PDN собираются в tft_classifier, который выбирает bearer для пакета.
+namespace tft {
+    // Компоненты пакетного фильтра. Для downlink remote - источник пакета, local - UE.
+    // Поле, которое не задано, совпадает с любым значением
+    struct packet_filter {
+        uint8_t precedence = 255;  // Меньше - важнее
+        uint32_t remote_address = 0;
+        uint32_t remote_mask = 0;
+        uint8_t protocol = 0;      // 0 - любой
+        uint16_t local_port_low = 0;
+        uint16_t local_port_high = UINT16_MAX;
+        uint16_t remote_port_low = 0;
+        uint16_t remote_port_high = UINT16_MAX;
+        uint8_t tos = 0;
+        uint8_t tos_mask = 0;
+    };
+
+    // Поля пакета, по которым работают фильтры
+    struct flow_key {
+        uint32_t remote_address = 0;
+        uint16_t remote_port = 0;
+        uint16_t local_port = 0;
+        uint8_t protocol = 0;
+        uint8_t tos = 0;
+    };
+
+    // Ключ downlink IPv4 пакета. Порты берутся из TCP, UDP и SCTP и только из первого фрагмента,
+    // иначе 0. У пакета, который не разобрать как IPv4, ключ нулевой
+    flow_key downlink_key(std::span<const uint8_t> packet);
+} // namespace tft
+
+// Фильтры всех bearers PDN в массивах по полям, отсортированные по приоритету. Пакет сверяется
+// со всеми фильтрами без ветвлений, по четыре за SSE2 инструкцию, результат - битовая маска
+// совпавших фильтров, первый установленный бит - ответ. Время не зависит от того, какой фильтр
+// совпал, и почти не зависит от их числа в пределах max_filters.
+class tft_classifier {
+public:
+    static constexpr size_t max_filters = 64;
+
+    struct bearer_filters {
+        bearer *owner;
+        std::span<const tft::packet_filter> filters;
+    };
+
+    // Бросает std::length_error, если фильтров больше max_filters. При равном приоритете
+    // раньше идут фильтры bearers, перечисленных раньше
+    explicit tft_classifier(std::span<const bearer_filters> bearers);
+
+    // nullptr, если ни один фильтр не совпал
+    [[nodiscard]] bearer *classify(const tft::flow_key &key) const;
+    void classify(std::span<const tft::flow_key> keys, std::span<bearer *> bearers) const;
+
+    [[nodiscard]] size_t size() const { return _size; }
+
+private:
+    // Фильтры сверяются группами по lanes; хвост последней группы не совпадает ни с чем
+    static constexpr size_t lanes = 4;
+
+    [[nodiscard]] uint64_t match(const tft::flow_key &key) const;
+
+    // Все поля в 32 битах, чтобы группа фильтров сравнивалась одной SSE2 инструкцией на поле
+    alignas(64) std::array<uint32_t, max_filters> _remote_address{};
+    alignas(64) std::array<uint32_t, max_filters> _remote_mask{};
+    alignas(64) std::array<uint32_t, max_filters> _local_port_low{};
+    alignas(64) std::array<uint32_t, max_filters> _local_port_high{};
+    alignas(64) std::array<uint32_t, max_filters> _remote_port_low{};
+    alignas(64) std::array<uint32_t, max_filters> _remote_port_high{};
+    alignas(64) std::array<uint32_t, max_filters> _protocol{};
+    alignas(64) std::array<uint32_t, max_filters> _protocol_mask{};
+    alignas(64) std::array<uint32_t, max_filters> _tos{};
+    alignas(64) std::array<uint32_t, max_filters> _tos_mask{};
+    std::array<bearer *, max_filters> _bearers{};
+    size_t _size{};
+    size_t _padded_size{};
+};
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// Иерархическое колесо таймеров: 4 уровня по 256 слотов. Слот уровня k покрывает 256^k тиков,
+// таймер кладется на уровень, соответствующий его удаленности, и спускается на уровень ниже,
+// когда колесо уровня 0 совершает оборот. Постановка и срабатывание - O(1) на таймер, один
+// тик обрабатывает весь слот разом, сколько бы таймеров в нем ни было.
+//
+// Отмены нет: владелец сам игнорирует устаревшие срабатывания.
+template<class T>
+class timer_wheel {
+public:
+    explicit timer_wheel(uint64_t now = 0) : _current(now) {}
+
+    // Срок в тиках; прошедший срок срабатывает на следующем тике
+    void schedule(T item, uint64_t expires) {
+        place({std::move(item), std::max(expires, _current + 1)});
+        ++_size;
+    }
+
+    // Продвигает колесо до now и вызывает fire(item) для всех наступивших таймеров
+    template<class F>
+    size_t advance(uint64_t now, F &&fire) {
+        size_t fired = 0;
+        while (_current < now) {
+            // Пустое колесо перематываем сразу
+            if (_size == 0) {
+                _current = now;
+                break;
+            }
+
+            // Если нижние k уровней пусты, до следующей границы 256^k ничего не сработает
+            size_t empty_levels = 0;
+            while (_level_size[empty_levels] == 0) {
+                ++empty_levels;
+            }
+            if (empty_levels > 0) {
+                const auto shift = slot_bits * empty_levels;
+                const auto boundary = ((_current >> shift) + 1) << shift;
+                if (std::min(now, boundary - 1) > _current) {
+                    _current = std::min(now, boundary - 1);
+                    continue;
+                }
+            }
+
+            ++_current;
+            if ((_current & slot_mask) == 0) {
+                cascade(1);
+            }
+
+            auto &slot = _wheels[0][_current & slot_mask];
+            if (slot.empty()) {
+                continue;
+            }
+            // fire может ставить новые таймеры, в том числе в этот же слот
+            auto expired = std::move(slot);
+            slot.clear();
+            _size -= expired.size();
+            _level_size[0] -= expired.size();
+            for (auto &e : expired) {
+                fire(std::move(e.item));
+            }
+            fired += expired.size();
+        }
+        return fired;
+    }
+
+    [[nodiscard]] bool empty() const { return _size == 0; }
+    [[nodiscard]] size_t size() const { return _size; }
+    [[nodiscard]] uint64_t now() const { return _current; }
+
+private:
+    static constexpr size_t levels = 4;
+    static constexpr unsigned slot_bits = 8;
+    static constexpr uint64_t slot_mask = (uint64_t{1} << slot_bits) - 1;
+
+    struct entry {
+        T item;
+        uint64_t expires;
+    };
+
+    void place(entry e) {
+        const auto delta = e.expires - _current;
+        size_t level = 0;
+        while (level + 1 < levels && delta >> (slot_bits * (level + 1))) {
+            ++level;
+        }
+        // Слишком далекие таймеры ждут на последнем уровне и переставляются при каскаде
+        const auto expires = level + 1 == levels ? std::min(e.expires, _current + (uint64_t{1} << 32) - 1) : e.expires;
+        _wheels[level][(expires >> (slot_bits * level)) & slot_mask].push_back(std::move(e));
+        ++_level_size[level];
+    }
+
+    void cascade(size_t level) {
+        if (level >= levels) {
+            return;
+        }
+        const auto index = (_current >> (slot_bits * level)) & slot_mask;
+        if (index == 0) {
+            cascade(level + 1);
+        }
+        auto entries = std::move(_wheels[level][index]);
+        _wheels[level][index].clear();
+        _level_size[level] -= entries.size();
+        for (auto &e : entries) {
+            place(std::move(e));
+        }
+    }
+
+    std::array<std::array<std::vector<entry>, slot_mask + 1>, levels> _wheels;
+    std::array<size_t, levels> _level_size{};
+    uint64_t _current;
+    size_t _size{};
+};
@@ -0,0 +1,56 @@
+#include <token_bucket.h>
+
+#include <algorithm>
+
+namespace {
+    __extension__ using uint128 = unsigned __int128;
+
+    uint64_t saturate(long double value) {
+        constexpr auto max = static_cast<long double>(UINT64_MAX / 2);
+        return value >= max ? UINT64_MAX / 2 : static_cast<uint64_t>(value);
+    }
+} // namespace
+
+token_bucket::token_bucket(double rate_, double capacity_) :
+    interval(rate_ > 0 ? saturate(1e9L * 4294967296.0L / rate_) : UINT64_MAX / 2),
+    burst(saturate(static_cast<long double>(capacity_) * interval / (uint64_t{1} << (32 - tick_shift)))) {}
+
+bool token_bucket::spend_tokens(double tokens_) { return spend_tokens(static_cast<uint64_t>(tokens_), now()); }
+
+bool token_bucket::spend_tokens(uint64_t tokens_, uint64_t now_) {
+    const auto tokens_cost = cost(tokens_);
+    if (tokens_cost > burst) {
+        return false;
+    }
+
+    // Пока bucket простаивал до now, токены копились: начинаем не раньше now
+    const auto next = std::max(tat, now_) + tokens_cost;
+    if (next > now_ + burst) {
+        return false;
+    }
+    tat = next;
+    return true;
+}
+
+void token_bucket::refund_tokens(uint64_t tokens_) {
+    tat -= std::min(cost(tokens_), burst);
+}
+
+uint64_t token_bucket::wait_time(uint64_t tokens_, uint64_t now_) const {
+    const auto tokens_cost = cost(tokens_);
+    if (tokens_cost > burst) {
+        return UINT64_MAX;
+    }
+    const auto next = std::max(tat, now_) + tokens_cost;
+    return next > now_ + burst ? next - now_ - burst : 0;
+}
+
+uint64_t token_bucket::cost(uint64_t tokens_) const {
+    const auto ticks = (static_cast<uint128>(tokens_) * interval) >> (32 - tick_shift);
+    return ticks > UINT64_MAX ? UINT64_MAX : static_cast<uint64_t>(ticks);
+}
+
+uint64_t token_bucket::now() {
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now().time_since_epoch()).count();
+    return static_cast<uint64_t>(ns) << tick_shift;
+}
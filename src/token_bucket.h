@@ -0,0 +1,46 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+
+// Token bucket в форме GCRA: состояние - одно время TAT (theoretical arrival time), до которого
+// израсходованы выданные токены. Пакет проходит, если max(TAT, now) + cost <= now + burst, где
+// cost и burst - время накопления токенов пакета и емкости. Время хранится в 1/16 нс, стоимость
+// токена - в 2^-32 нс, поэтому ошибка округления не превышает 0.1% даже для 64-байтных пакетов
+// на 100 Гбит/с.
+//
+// Без синхронизации: bucket принадлежит одному data plane, а тот - одному потоку (в
+// sharded_data_plane у каждого рабочего потока свой экземпляр).
+class token_bucket {
+public:
+    using clock = std::chrono::steady_clock;
+
+    // Единица времени token_bucket - 2^-tick_shift нс
+    static constexpr unsigned tick_shift = 4;
+
+    token_bucket(double rate, double capacity);
+
+    // Читает часы на каждый вызов; для burst'а лучше прочитать now() один раз
+    bool spend_tokens(double tokens);
+    bool spend_tokens(uint64_t tokens, uint64_t now);
+    // Возвращает токены, списанные spend_tokens, например если пакет отклонил другой уровень
+    void refund_tokens(uint64_t tokens);
+    // Через сколько тактов spend_tokens(tokens) пройдет; UINT64_MAX, если tokens больше емкости
+    [[nodiscard]] uint64_t wait_time(uint64_t tokens, uint64_t now) const;
+
+    // Текущее время в единицах token_bucket
+    static uint64_t now();
+
+private:
+    // Время накопления токенов в тактах, с насыщением
+    [[nodiscard]] uint64_t cost(uint64_t tokens) const;
+
+    uint64_t interval;  // Время накопления одного токена, 2^-32 нс
+    uint64_t burst;     // Время накопления capacity токенов, такты
+    uint64_t tat{0};
+};
+
+// Лимиты одного уровня QoS по направлениям: [0] - uplink, [1] - downlink. Пустой bucket не ограничивает
+using token_bucket_pair = std::array<std::optional<token_bucket>, 2>;
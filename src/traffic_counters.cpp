@@ -0,0 +1,90 @@
+#include <traffic_counters.h>
+
+#include <pdn_connection.h>
+
+traffic_counters::usage &traffic_counters::usage::operator+=(const usage &other) {
+    uplink_packets += other.uplink_packets;
+    uplink_bytes += other.uplink_bytes;
+    downlink_packets += other.downlink_packets;
+    downlink_bytes += other.downlink_bytes;
+    return *this;
+}
+
+void traffic_counters::count_uplink(const bearer &bearer, const pdn_connection &pdn, size_t bytes) {
+    count(uplink_packets, uplink_bytes, bearer, pdn, bytes);
+}
+
+void traffic_counters::count_downlink(const bearer &bearer, const pdn_connection &pdn, size_t bytes) {
+    count(downlink_packets, downlink_bytes, bearer, pdn, bytes);
+}
+
+void traffic_counters::prefetch(const bearer &bearer, const pdn_connection &pdn) const {
+    _bearers.prefetch(bearer.get_handle());
+    _pdns.prefetch(pdn.get_handle());
+}
+
+void traffic_counters::count(value packets, value bytes, const bearer &bearer, const pdn_connection &pdn,
+                             size_t size) {
+    for (auto *b : {&_bearers.writable(bearer.get_handle()), &_pdns.writable(pdn.get_handle()),
+                    &_apns.writable(pdn.get_apn_id() + 1)}) {
+        add(b->values[packets], 1);
+        add(b->values[bytes], size);
+    }
+}
+
+traffic_counters::table::~table() {
+    for (auto &chunk : _chunks) {
+        delete[] chunk.load(std::memory_order_relaxed);
+    }
+}
+
+traffic_counters::block &traffic_counters::table::writable(uint32_t key) {
+    const auto index = key & (max_size - 1);
+    auto *chunk = _chunks[index / chunk_size].load(std::memory_order_relaxed);
+    if (!chunk) {
+        chunk = new block[chunk_size];
+        _chunks[index / chunk_size].store(chunk, std::memory_order_release);
+    }
+
+    auto &b = chunk[index % chunk_size];
+    if (b.owner.load(std::memory_order_relaxed) != key) {
+        // Новый владелец слота. Как в seqlock: пока счетчики обнуляются, блок ничей
+        b.owner.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (auto &v : b.values) {
+            v.store(0, std::memory_order_relaxed);
+        }
+        b.owner.store(key, std::memory_order_release);
+    }
+    return b;
+}
+
+void traffic_counters::table::prefetch(uint32_t key) const {
+    const auto index = key & (max_size - 1);
+    if (const auto *chunk = _chunks[index / chunk_size].load(std::memory_order_relaxed)) {
+        __builtin_prefetch(&chunk[index % chunk_size], 1);
+    }
+}
+
+traffic_counters::usage traffic_counters::table::read(uint32_t key) const {
+    const auto index = key & (max_size - 1);
+    const auto *chunk = _chunks[index / chunk_size].load(std::memory_order_acquire);
+    if (!chunk || key == 0) {
+        return {};
+    }
+
+    const auto &b = chunk[index % chunk_size];
+    if (b.owner.load(std::memory_order_acquire) != key) {
+        return {};
+    }
+    usage result{b.values[uplink_packets].load(std::memory_order_relaxed),
+                 b.values[uplink_bytes].load(std::memory_order_relaxed),
+                 b.values[downlink_packets].load(std::memory_order_relaxed),
+                 b.values[downlink_bytes].load(std::memory_order_relaxed)};
+    // Блок могли отдать новому владельцу, пока мы читали
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (b.owner.load(std::memory_order_relaxed) != key) {
+        return {};
+    }
+    return result;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+class bearer;
+class pdn_connection;
+
+// Счетчики трафика одного data plane, то есть одного ядра. Пишет только поток этого data plane и
+// без атомарных read-modify-write: std::atomic здесь ради целостного чтения из другого потока, а
+// инкремент - обычные load и store. Читать можно из любого потока, не останавливая пересылку;
+// суммы по ядрам собирает sharded_data_plane.
+//
+// Счетчики bearer и PDN лежат в блоках по номеру слота их дескриптора в control plane. Блок
+// помнит дескриптор владельца: после удаления сессии ее счетчики можно дочитать, пока слот не
+// займет новая сессия, которая начнет счет с нуля.
+class traffic_counters {
+public:
+    enum drop_reason : size_t {
+        no_session,  // Неизвестный DP TEID или UE IP
+        no_bearer,   // У PDN нет default bearer
+        policed,     // Отброшен лимитами: без шейпинга, при полной очереди или не выпущен из нее
+        malformed,   // Не разобран GTP-U или внутренний IP
+        drop_reasons
+    };
+
+    struct usage {
+        uint64_t uplink_packets = 0;
+        uint64_t uplink_bytes = 0;
+        uint64_t downlink_packets = 0;
+        uint64_t downlink_bytes = 0;
+
+        usage &operator+=(const usage &other);
+        bool operator==(const usage &) const = default;
+    };
+
+    traffic_counters() = default;
+
+    traffic_counters(const traffic_counters &) = delete;
+    traffic_counters &operator=(const traffic_counters &) = delete;
+
+    // Только поток data plane
+    void count_uplink(const bearer &bearer, const pdn_connection &pdn, size_t bytes);
+    void count_downlink(const bearer &bearer, const pdn_connection &pdn, size_t bytes);
+    void count_drop(drop_reason reason, uint64_t packets = 1) { add(_drops[reason], packets); }
+    // Подгружает блоки пакета в кэш заранее, например на первом проходе burst'а
+    void prefetch(const bearer &bearer, const pdn_connection &pdn) const;
+
+    // Любой поток. Дескрипторы - bearer::get_handle() и pdn_connection::get_handle()
+    [[nodiscard]] usage bearer_usage(uint32_t handle) const { return _bearers.read(handle); }
+    [[nodiscard]] usage pdn_usage(uint32_t handle) const { return _pdns.read(handle); }
+    [[nodiscard]] usage apn_usage(uint32_t apn_id) const { return _apns.read(apn_id + 1); }
+    [[nodiscard]] uint64_t drops(drop_reason reason) const { return _drops[reason].load(std::memory_order_relaxed); }
+
+private:
+    enum value : size_t { uplink_packets, uplink_bytes, downlink_packets, downlink_bytes, value_count };
+
+    static void add(std::atomic<uint64_t> &counter, uint64_t n) {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    // Таблицы у каждого ядра свои, поэтому блоки не выравниваются по кэш-линии: плотнее лежат
+    struct block {
+        std::atomic<uint32_t> owner{0};
+        std::array<std::atomic<uint64_t>, value_count> values{};
+    };
+
+    // Блоки по младшим 24 битам ключа в неперемещаемых кусках, как в slot_map
+    class table {
+    public:
+        ~table();
+
+        block &writable(uint32_t key);
+        void prefetch(uint32_t key) const;
+        [[nodiscard]] usage read(uint32_t key) const;
+
+    private:
+        static constexpr size_t chunk_size = 4096;
+        static constexpr size_t max_size = size_t{1} << 24;
+
+        std::array<std::atomic<block *>, max_size / chunk_size> _chunks{};
+    };
+
+    void count(value packets, value bytes, const bearer &bearer, const pdn_connection &pdn, size_t size);
+
+    table _bearers;
+    table _pdns;
+    table _apns;  // Ключ - номер APN + 1: ключ 0 означает свободный блок
+    alignas(64) std::array<std::atomic<uint64_t>, drop_reasons> _drops{};
+};
@@ -0,0 +1,247 @@
+#include <udp_data_plane.h>
+
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <system_error>
+
+namespace {
+    [[noreturn]] void throw_errno(const char *what) { throw std::system_error(errno, std::generic_category(), what); }
+
+    sockaddr_in make_sockaddr(boost::asio::ip::address_v4 address, uint16_t port) {
+        sockaddr_in result{};
+        result.sin_family = AF_INET;
+        result.sin_addr.s_addr = htonl(address.to_uint());
+        result.sin_port = htons(port);
+        return result;
+    }
+
+    uint16_t bound_port(int fd) {
+        sockaddr_in local{};
+        socklen_t size = sizeof(local);
+        if (getsockname(fd, reinterpret_cast<sockaddr *>(&local), &size) != 0) {
+            return 0;
+        }
+        return ntohs(local.sin_port);
+    }
+} // namespace
+
+udp_data_plane::udp_data_plane(control_plane &control_plane, const config &config) :
+    data_plane(control_plane), _config(config), _pool(config.pool) {
+    set_gtpu_address(config.gtpu_address);
+    open(_gtpu, config.gtpu_address, config.gtpu_port);
+    try {
+        open(_sgi, config.sgi_address, config.sgi_port);
+    } catch (...) {
+        ::close(_gtpu.fd);
+        throw;
+    }
+}
+
+udp_data_plane::~udp_data_plane() {
+    flush();
+    ::close(_gtpu.fd);
+    ::close(_sgi.fd);
+}
+
+void udp_data_plane::open(udp_socket &socket, boost::asio::ip::address_v4 address, uint16_t port) {
+    socket.fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (socket.fd < 0) {
+        throw_errno("udp_data_plane: socket");
+    }
+    if (_config.socket_buffer_size) {
+        // Не критично: ядро может ограничить размер net.core.*mem_max
+        setsockopt(socket.fd, SOL_SOCKET, SO_RCVBUF, &_config.socket_buffer_size, sizeof(int));
+        setsockopt(socket.fd, SOL_SOCKET, SO_SNDBUF, &_config.socket_buffer_size, sizeof(int));
+    }
+    const auto local = make_sockaddr(address, port);
+    if (bind(socket.fd, reinterpret_cast<const sockaddr *>(&local), sizeof(local)) != 0) {
+        const auto error = errno;
+        ::close(socket.fd);
+        throw std::system_error(error, std::generic_category(), "udp_data_plane: bind");
+    }
+    socket.port = bound_port(socket.fd);
+    _batch.reserve(_config.batch_size);
+
+    const auto batch = _config.batch_size;
+    socket.rx_headers.resize(batch);
+    socket.rx_iovecs.resize(batch);
+    socket.rx_addresses.resize(batch);
+    socket.rx_buffers.resize(batch);
+    socket.tx_headers.resize(batch);
+    socket.tx_iovecs.resize(batch);
+    socket.tx_addresses.resize(batch);
+    socket.tx_buffers.resize(batch);
+    for (size_t i = 0; i < batch; ++i) {
+        socket.rx_headers[i].msg_hdr.msg_iov = &socket.rx_iovecs[i];
+        socket.rx_headers[i].msg_hdr.msg_iovlen = 1;
+        socket.tx_headers[i].msg_hdr.msg_iov = &socket.tx_iovecs[i];
+        socket.tx_headers[i].msg_hdr.msg_iovlen = 1;
+        socket.tx_headers[i].msg_hdr.msg_name = &socket.tx_addresses[i];
+        socket.tx_headers[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+    }
+}
+
+template<class Handler>
+size_t udp_data_plane::receive(udp_socket &socket, Handler &&handler) {
+    // Места, чей буфер ушел в конвейер в прошлый раз, получают новый из пула
+    size_t slots = 0;
+    for (; slots < _config.batch_size; ++slots) {
+        auto &buffer = socket.rx_buffers[slots];
+        if (!buffer) {
+            buffer = _pool.allocate();
+            if (!buffer) {
+                break;
+            }
+        }
+        socket.rx_iovecs[slots] = {buffer.data(), buffer.tailroom()};
+        auto &header = socket.rx_headers[slots].msg_hdr;
+        header.msg_name = &socket.rx_addresses[slots];
+        header.msg_namelen = sizeof(sockaddr_in);
+        header.msg_flags = 0;
+    }
+    if (!slots) {
+        return 0;
+    }
+
+    const int count = recvmmsg(socket.fd, socket.rx_headers.data(), static_cast<unsigned>(slots), MSG_DONTWAIT,
+                               nullptr);
+    if (count <= 0) {
+        return 0;
+    }
+    ++_io.receive_batches;
+    for (int i = 0; i < count; ++i) {
+        const auto &header = socket.rx_headers[i];
+        auto buffer = std::move(socket.rx_buffers[i]);
+        if (header.msg_hdr.msg_flags & MSG_TRUNC) {
+            ++_io.dropped;
+            continue;
+        }
+        buffer.append(header.msg_len);
+        const auto &from = socket.rx_addresses[i];
+        handler(std::move(buffer), gtpu::endpoint{boost::asio::ip::address_v4(ntohl(from.sin_addr.s_addr)),
+                                                  ntohs(from.sin_port)});
+    }
+    _io.received += static_cast<uint64_t>(count);
+    return static_cast<size_t>(count);
+}
+
+size_t udp_data_plane::poll_sockets() {
+    // Порт назначения - всегда 2152, как его проверяет gtpu::parse, даже если сокет на другом
+    const gtpu::endpoint gtpu_local{_config.gtpu_address, gtpu::port};
+    size_t received = receive(_gtpu, [&](packet_buffer &&datagram, const gtpu::endpoint &from) {
+        if (gtpu::prepend_ip_udp(datagram, from, gtpu_local)) {
+            _batch.push_back(std::move(datagram));
+        } else {
+            ++_io.dropped;
+        }
+    });
+    handle_gtpu_burst(_batch);
+    _batch.clear();
+    received += receive(_sgi, [&](packet_buffer &&packet, const gtpu::endpoint &) {
+        _batch.push_back(std::move(packet));
+    });
+    handle_ip_burst(_batch);
+    _batch.clear();
+    flush();
+    return received;
+}
+
+void udp_data_plane::run(const std::atomic<bool> &stop, std::chrono::milliseconds idle_timeout) {
+    pollfd fds[2]{{_gtpu.fd, POLLIN, 0}, {_sgi.fd, POLLIN, 0}};
+    while (!stop.load(std::memory_order_relaxed)) {
+        // Пока трафик идет, не спим; poll только когда оба сокета пусты
+        if (!poll_sockets()) {
+            poll();
+            ::poll(fds, 2, static_cast<int>(idle_timeout.count()));
+        }
+    }
+}
+
+void udp_data_plane::flush() {
+    flush(_gtpu);
+    flush(_sgi);
+}
+
+void udp_data_plane::forward_packet_to_sgw(boost::asio::ip::address_v4 sgw_addr, uint32_t sgw_dp_teid,
+                                           Packet &&packet) {
+    auto buffer = _pool.allocate(packet);
+    if (!buffer) {
+        ++_io.dropped;
+        return;
+    }
+    forward_buffer_to_sgw(sgw_addr, sgw_dp_teid, std::move(buffer));
+}
+
+void udp_data_plane::forward_packet_to_apn(boost::asio::ip::address_v4 apn_gateway, Packet &&packet) {
+    auto buffer = _pool.allocate(packet);
+    if (!buffer) {
+        ++_io.dropped;
+        return;
+    }
+    forward_buffer_to_apn(apn_gateway, std::move(buffer));
+}
+
+void udp_data_plane::forward_buffer_to_sgw(boost::asio::ip::address_v4 sgw_addr, uint32_t sgw_dp_teid,
+                                           packet_buffer &&packet) {
+    // Внешние заголовки пишет ядро, но их же отрежет send_gtpu; так путь один с handle_ip_packet
+    auto buffer = std::move(packet);
+    if (!gtpu::encapsulate(buffer, {_config.gtpu_address, sgw_addr, sgw_dp_teid})) {
+        ++_io.dropped;
+        return;
+    }
+    send_gtpu(sgw_addr, std::move(buffer));
+}
+
+void udp_data_plane::forward_buffer_to_apn(boost::asio::ip::address_v4 apn_gateway, packet_buffer &&packet) {
+    enqueue(_sgi, apn_gateway, _config.apn_gateway_port, std::move(packet));
+}
+
+void udp_data_plane::send_gtpu(boost::asio::ip::address_v4 peer, packet_buffer &&datagram) {
+    auto buffer = std::move(datagram);
+    // Порт назначения из UDP заголовка: ответ на Echo уходит на порт, с которого пришел запрос
+    const auto destination = gtpu::strip_ip_udp(buffer);
+    if (!destination) {
+        ++_io.dropped;
+        return;
+    }
+    enqueue(_gtpu, peer, destination->port, std::move(buffer));
+}
+
+void udp_data_plane::enqueue(udp_socket &socket, boost::asio::ip::address_v4 to, uint16_t port,
+                             packet_buffer &&packet) {
+    const auto i = socket.tx_count++;
+    socket.tx_addresses[i] = make_sockaddr(to, port);
+    socket.tx_iovecs[i] = {packet.data(), packet.size()};
+    socket.tx_buffers[i] = std::move(packet);
+    if (socket.tx_count == _config.batch_size) {
+        flush(socket);
+    }
+}
+
+void udp_data_plane::flush(udp_socket &socket) {
+    size_t sent = 0;
+    while (sent < socket.tx_count) {
+        const int count = sendmmsg(socket.fd, socket.tx_headers.data() + sent,
+                                   static_cast<unsigned>(socket.tx_count - sent), 0);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // Ошибка относится к первой датаграмме (например, ICMP unreachable от прошлой
+            // отправки); ее отбрасываем, остальные пробуем дальше
+            ++_io.dropped;
+            ++sent;
+            continue;
+        }
+        ++_io.send_batches;
+        _io.sent += static_cast<uint64_t>(count);
+        sent += static_cast<size_t>(count);
+    }
+    for (size_t i = 0; i < socket.tx_count; ++i) {
+        socket.tx_buffers[i].reset();
+    }
+    socket.tx_count = 0;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <data_plane.h>
+#include <packet_buffer.h>
+
+#include <boost/asio/ip/address_v4.hpp>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// Data plane на UDP сокетах: S5/S8-U - GTP-U от SGW и к SGW, SGi - IP пакеты в UDP датаграммах
+// от шлюзов APN и к ним (на порт apn_gateway_port адреса шлюза APN). Принимает и отправляет пачками через
+// recvmmsg/sendmmsg: за один системный вызов до batch_size датаграмм.
+//
+// Прием идет прямо в буферы packet_pool, выделенные под каждое место пачки заранее, и дальше
+// пачкой через handle_gtpu_burst и handle_ip_burst без копирования. Отправляемые буферы копятся в очереди сокета до конца
+// пачки приема или до заполнения очереди; адрес назначения у каждой датаграммы свой, так что
+// одна пачка sendmmsg уходит сразу нескольким SGW или шлюзам.
+//
+// Ядро снимает внешние IPv4/UDP заголовки GTP-U, поэтому перед handle_gtpu_datagram они
+// дописываются в headroom по адресу отправителя, а перед отправкой отрезаются.
+//
+// Все методы вызываются из одного потока.
+class udp_data_plane : public data_plane {
+public:
+    struct config {
+        boost::asio::ip::address_v4 gtpu_address;
+        uint16_t gtpu_port = gtpu::port;
+        boost::asio::ip::address_v4 sgi_address;
+        uint16_t sgi_port = 2153;
+        uint16_t apn_gateway_port = 2153;
+        size_t batch_size = 32;
+        packet_pool::config pool{.buffer_count = 8192, .buffer_size = 2048, .headroom = 128};
+        // Размер буферов сокетов (SO_RCVBUF/SO_SNDBUF); 0 - системный
+        int socket_buffer_size = 4 << 20;
+    };
+
+    struct io_statistics {
+        uint64_t received = 0;
+        uint64_t sent = 0;
+        uint64_t receive_batches = 0;
+        uint64_t send_batches = 0;
+        // Отброшены: не влезли в буфер, кончился пул или сокет не принял
+        uint64_t dropped = 0;
+    };
+
+    // Открывает и привязывает оба сокета; std::system_error, если не вышло
+    udp_data_plane(control_plane &control_plane, const config &config);
+    ~udp_data_plane() override;
+
+    udp_data_plane(const udp_data_plane &) = delete;
+    udp_data_plane &operator=(const udp_data_plane &) = delete;
+
+    // Принимает без ожидания до batch_size датаграмм с каждого сокета, обрабатывает их и отправляет
+    // все накопленное. Возвращает число принятых датаграмм
+    size_t poll_sockets();
+
+    // Ждет трафик и обрабатывает его, пока stop не станет true; stop проверяется не реже idle_timeout
+    void run(const std::atomic<bool> &stop, std::chrono::milliseconds idle_timeout = std::chrono::milliseconds(100));
+
+    // Отправляет накопленное в очередях, не дожидаясь конца пачки
+    void flush();
+
+    // Фактические порты сокетов, если в config был 0
+    [[nodiscard]] uint16_t gtpu_port() const { return _gtpu.port; }
+    [[nodiscard]] uint16_t sgi_port() const { return _sgi.port; }
+
+    [[nodiscard]] const io_statistics &get_io_statistics() const { return _io; }
+
+protected:
+    void forward_packet_to_sgw(boost::asio::ip::address_v4 sgw_addr, uint32_t sgw_dp_teid, Packet &&packet) override;
+    void forward_packet_to_apn(boost::asio::ip::address_v4 apn_gateway, Packet &&packet) override;
+
+    void forward_buffer_to_sgw(boost::asio::ip::address_v4 sgw_addr, uint32_t sgw_dp_teid,
+                               packet_buffer &&packet) override;
+    void forward_buffer_to_apn(boost::asio::ip::address_v4 apn_gateway, packet_buffer &&packet) override;
+
+    void send_gtpu(boost::asio::ip::address_v4 peer, packet_buffer &&datagram) override;
+
+private:
+    // Сокет с местами под пачку приема и очередью отправки
+    struct udp_socket {
+        int fd = -1;
+        uint16_t port = 0;
+        std::vector<mmsghdr> rx_headers;
+        std::vector<iovec> rx_iovecs;
+        std::vector<sockaddr_in> rx_addresses;
+        std::vector<packet_buffer> rx_buffers;
+
+        std::vector<mmsghdr> tx_headers;
+        std::vector<iovec> tx_iovecs;
+        std::vector<sockaddr_in> tx_addresses;
+        std::vector<packet_buffer> tx_buffers;
+        size_t tx_count = 0;
+    };
+
+    void open(udp_socket &socket, boost::asio::ip::address_v4 address, uint16_t port);
+    // Принятые датаграммы уходят в handler по одной
+    template<class Handler>
+    size_t receive(udp_socket &socket, Handler &&handler);
+    void enqueue(udp_socket &socket, boost::asio::ip::address_v4 to, uint16_t port, packet_buffer &&packet);
+    void flush(udp_socket &socket);
+
+    config _config;
+    packet_pool _pool;
+    udp_socket _gtpu;
+    udp_socket _sgi;
+    // Принятая пачка одного сокета
+    std::vector<packet_buffer> _batch;
+    io_statistics _io;
+};
@@ -0,0 +1,316 @@
+#include <control_plane.h>
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <atomic>
+#include <set>
+#include <thread>
+#include <vector>
+
+class control_plane_test : public ::testing::Test {
+public:
+    static const inline std::string apn{"test.apn"};
+    static const inline auto apn_gw{boost::asio::ip::make_address_v4("127.0.0.1")};
+    static const inline auto sgw_addr{boost::asio::ip::make_address_v4("127.1.0.1")};
+
+    control_plane_test() { _control_plane.add_apn(apn, apn_gw); }
+
+    std::shared_ptr<pdn_connection> create_session(uint32_t sgw_teid) {
+        auto pdn = _control_plane.create_pdn_connection(apn, sgw_addr, sgw_teid);
+        pdn->set_default_bearer(_control_plane.create_bearer(pdn, sgw_teid));
+        return pdn;
+    }
+
+    control_plane _control_plane;
+};
+
+TEST_F(control_plane_test, delete_pdn_connection_removes_bearers) {
+    auto pdn = create_session(1);
+    auto dedicated = _control_plane.create_bearer(pdn, 2);
+    const auto default_teid = pdn->get_default_bearer()->get_dp_teid();
+
+    _control_plane.delete_pdn_connection(pdn->get_cp_teid());
+
+    ASSERT_EQ(nullptr, _control_plane.find_pdn_by_cp_teid(pdn->get_cp_teid()));
+    ASSERT_EQ(nullptr, _control_plane.find_pdn_by_ip_address(pdn->get_ue_ip_addr()));
+    ASSERT_EQ(nullptr, _control_plane.find_bearer_by_dp_teid(default_teid));
+    ASSERT_EQ(nullptr, _control_plane.find_bearer_by_dp_teid(dedicated->get_dp_teid()));
+    ASSERT_EQ(nullptr, pdn->get_default_bearer());
+}
+
+TEST_F(control_plane_test, create_bearer_rejects_deleted_pdn) {
+    auto pdn = create_session(1);
+    _control_plane.delete_pdn_connection(pdn->get_cp_teid());
+
+    ASSERT_EQ(nullptr, _control_plane.create_bearer(pdn, 2));
+}
+
+TEST_F(control_plane_test, views_match_owning_lookups) {
+    auto pdn = create_session(1);
+    const auto dp_teid = pdn->get_default_bearer()->get_dp_teid();
+
+    epoch_guard guard;
+    auto *found_bearer = _control_plane.find_bearer_view(dp_teid);
+    ASSERT_EQ(_control_plane.find_bearer_by_dp_teid(dp_teid).get(), found_bearer);
+    ASSERT_EQ(pdn.get(), &found_bearer->get_pdn_view());
+    ASSERT_EQ(pdn.get(), _control_plane.find_pdn_view_by_ip_address(pdn->get_ue_ip_addr()));
+    ASSERT_EQ(found_bearer, pdn->get_default_bearer_view());
+
+    _control_plane.delete_bearer(dp_teid);
+    ASSERT_EQ(nullptr, _control_plane.find_bearer_view(dp_teid));
+    ASSERT_EQ(nullptr, pdn->get_default_bearer_view());
+}
+
+TEST_F(control_plane_test, ue_addresses_come_from_apn_pool) {
+    const std::string pooled_apn{"pooled.apn"};
+    ASSERT_TRUE(_control_plane.add_apn(pooled_apn, apn_gw, {boost::asio::ip::make_network_v4("100.64.0.0/30"), {}}));
+    ASSERT_FALSE(_control_plane.add_apn("other.apn", apn_gw, {boost::asio::ip::make_network_v4("100.64.0.0/24"), {}}));
+
+    auto first = _control_plane.create_pdn_connection(pooled_apn, sgw_addr, 1);
+    auto second = _control_plane.create_pdn_connection(pooled_apn, sgw_addr, 2);
+    ASSERT_EQ(boost::asio::ip::make_address_v4("100.64.0.1"), first->get_ue_ip_addr());
+    ASSERT_EQ(boost::asio::ip::make_address_v4("100.64.0.2"), second->get_ue_ip_addr());
+
+    // Пул исчерпан, пока адрес не вернут удалением сессии
+    ASSERT_EQ(nullptr, _control_plane.create_pdn_connection(pooled_apn, sgw_addr, 3));
+    _control_plane.delete_pdn_connection(first->get_cp_teid());
+    auto third = _control_plane.create_pdn_connection(pooled_apn, sgw_addr, 3);
+    ASSERT_EQ(first->get_ue_ip_addr(), third->get_ue_ip_addr());
+
+    // APN без собственного пула получает адрес из 10.0.0.0/8
+    ASSERT_EQ(10, _control_plane.create_pdn_connection(apn, sgw_addr, 4)->get_ue_ip_addr().to_bytes()[0]);
+}
+
+TEST_F(control_plane_test, apn_pool_inside_default_pool_accepted_in_any_order) {
+    const auto network = boost::asio::ip::make_network_v4("10.0.0.0/16");
+    const auto first_default_ip = boost::asio::ip::make_address_v4("10.1.0.0");
+
+    // Общий пул уже создан фикстурой
+    ASSERT_TRUE(_control_plane.add_apn("pooled.apn", apn_gw, {network, {}}));
+    ASSERT_EQ(first_default_ip, _control_plane.create_pdn_connection(apn, sgw_addr, 1)->get_ue_ip_addr());
+
+    control_plane pool_first;
+    ASSERT_TRUE(pool_first.add_apn("pooled.apn", apn_gw, {network, {}}));
+    pool_first.add_apn(apn, apn_gw);
+    ASSERT_EQ(first_default_ip, pool_first.create_pdn_connection(apn, sgw_addr, 1)->get_ue_ip_addr());
+
+    // Адрес, уже выданный из общего пула, не может перейти к APN
+    ASSERT_FALSE(_control_plane.add_apn("other.apn", apn_gw, {boost::asio::ip::make_network_v4("10.1.0.0/24"), {}}));
+    ASSERT_FALSE(_control_plane.add_apn("other.apn", apn_gw, {boost::asio::ip::make_network_v4("10.0.128.0/24"), {}}));
+}
+
+TEST_F(control_plane_test, bulk_sessions_match_single_ones) {
+    const std::string pooled_apn{"pooled.apn"};
+    ASSERT_TRUE(_control_plane.add_apn(pooled_apn, apn_gw, {boost::asio::ip::make_network_v4("100.64.0.0/29"), {}}));
+
+    // Больше пачки, с неизвестным APN и пулом на шесть адресов для десяти сессий
+    std::vector<control_plane::session_spec> specs;
+    for (uint32_t i = 0; i < 300; ++i) {
+        specs.push_back({i == 100 ? "unknown.apn" : i % 30 == 0 ? pooled_apn : apn, sgw_addr, i, 1000 + i});
+    }
+    const auto created = _control_plane.create_sessions(specs);
+    ASSERT_EQ(specs.size(), created.size());
+
+    std::set<uint32_t> cp_teids;
+    std::set<uint32_t> dp_teids;
+    std::vector<uint32_t> to_delete;
+    size_t pooled = 0;
+    for (uint32_t i = 0; i < specs.size(); ++i) {
+        const auto &pdn = created[i];
+        if (i == 100 || (i % 30 == 0 && ++pooled > 6)) {
+            ASSERT_EQ(nullptr, pdn);
+            continue;
+        }
+        ASSERT_NE(nullptr, pdn);
+        EXPECT_EQ(pdn, _control_plane.find_pdn_by_cp_teid(pdn->get_cp_teid()));
+        EXPECT_EQ(pdn, _control_plane.find_pdn_by_ip_address(pdn->get_ue_ip_addr()));
+        EXPECT_EQ(i, pdn->get_sgw_cp_teid());
+        EXPECT_EQ(sgw_addr, pdn->get_sgw_address());
+        auto bearer = pdn->get_default_bearer();
+        ASSERT_NE(nullptr, bearer);
+        EXPECT_EQ(1000 + i, bearer->get_sgw_dp_teid());
+        EXPECT_EQ(bearer, _control_plane.find_bearer_by_dp_teid(bearer->get_dp_teid()));
+        EXPECT_TRUE(cp_teids.insert(pdn->get_cp_teid()).second);
+        EXPECT_TRUE(dp_teids.insert(bearer->get_dp_teid()).second);
+        if (i % 2) {
+            to_delete.push_back(pdn->get_cp_teid());
+        }
+    }
+    EXPECT_EQ(boost::asio::ip::make_address_v4("100.64.0.1"), created[0]->get_ue_ip_addr());
+    EXPECT_EQ(boost::asio::ip::make_address_v4("100.64.0.6"), created[150]->get_ue_ip_addr());
+
+    to_delete.push_back(0xdeadbeef);
+    std::vector<std::shared_ptr<bearer>> bearers;
+    for (const auto &pdn : created) {
+        bearers.push_back(pdn ? pdn->get_default_bearer() : nullptr);
+    }
+    _control_plane.delete_sessions(to_delete);
+    for (uint32_t i = 0; i < specs.size(); ++i) {
+        if (created[i]) {
+            EXPECT_EQ(i % 2 == 0, _control_plane.find_pdn_by_cp_teid(created[i]->get_cp_teid()) != nullptr);
+            EXPECT_EQ(i % 2 == 0, _control_plane.find_bearer_by_dp_teid(bearers[i]->get_dp_teid()) != nullptr);
+        }
+    }
+}
+
+TEST_F(control_plane_test, delete_sessions_skips_duplicate_and_unknown_teids) {
+    auto first = create_session(1);
+    auto second = create_session(2);
+    auto kept = create_session(3);
+    const auto dedicated = _control_plane.create_bearer(first, 4);
+
+    const std::vector<uint32_t> cp_teids{first->get_cp_teid(), 0xdeadbeef, first->get_cp_teid(),
+                                         second->get_cp_teid(), second->get_cp_teid()};
+    _control_plane.delete_sessions(cp_teids);
+
+    EXPECT_EQ(nullptr, _control_plane.find_pdn_by_cp_teid(first->get_cp_teid()));
+    EXPECT_EQ(nullptr, _control_plane.find_pdn_by_cp_teid(second->get_cp_teid()));
+    EXPECT_EQ(nullptr, _control_plane.find_bearer_by_dp_teid(dedicated->get_dp_teid()));
+    EXPECT_EQ(kept, _control_plane.find_pdn_by_cp_teid(kept->get_cp_teid()));
+    EXPECT_EQ(1, _control_plane.count_sgw_sessions(sgw_addr));
+}
+
+TEST_F(control_plane_test, sgw_restart_drops_only_its_sessions) {
+    const auto other_sgw = boost::asio::ip::make_address_v4("127.1.0.2");
+    std::vector<std::shared_ptr<pdn_connection>> pdns;
+    std::vector<uint32_t> dp_teids;
+    for (uint32_t i = 0; i < 100; ++i) {
+        pdns.push_back(create_session(i));
+        dp_teids.push_back(pdns.back()->get_default_bearer()->get_dp_teid());
+        if (i % 3 == 0) {
+            ASSERT_TRUE(_control_plane.set_sgw_address(pdns.back()->get_cp_teid(), other_sgw));
+            EXPECT_EQ(other_sgw, pdns.back()->get_sgw_address());
+        }
+    }
+    // Удаление из середины списка peer
+    _control_plane.delete_pdn_connection(pdns[50]->get_cp_teid());
+    EXPECT_EQ(65, _control_plane.count_sgw_sessions(sgw_addr));
+    EXPECT_EQ(34, _control_plane.count_sgw_sessions(other_sgw));
+
+    EXPECT_EQ(65, _control_plane.delete_sgw_sessions(sgw_addr));
+    EXPECT_EQ(0, _control_plane.count_sgw_sessions(sgw_addr));
+    EXPECT_EQ(0, _control_plane.delete_sgw_sessions(sgw_addr));
+    for (size_t i = 0; i < pdns.size(); ++i) {
+        const bool kept = i % 3 == 0;
+        EXPECT_EQ(kept, _control_plane.find_pdn_by_cp_teid(pdns[i]->get_cp_teid()) != nullptr);
+        EXPECT_EQ(kept, _control_plane.find_pdn_by_ip_address(pdns[i]->get_ue_ip_addr()) != nullptr);
+        EXPECT_EQ(kept, _control_plane.find_bearer_by_dp_teid(dp_teids[i]) != nullptr);
+    }
+
+    // Peer появляется снова с первой новой сессией
+    create_session(1000);
+    EXPECT_EQ(1, _control_plane.count_sgw_sessions(sgw_addr));
+}
+
+TEST_F(control_plane_test, sgw_relocation_moves_all_sessions) {
+    const auto moved_sgw = boost::asio::ip::make_address_v4("127.1.0.2");
+    const auto busy_sgw = boost::asio::ip::make_address_v4("127.1.0.3");
+    std::vector<std::shared_ptr<pdn_connection>> pdns;
+    for (uint32_t i = 0; i < 10; ++i) {
+        pdns.push_back(create_session(i));
+    }
+    auto busy = _control_plane.create_pdn_connection(apn, busy_sgw, 100);
+
+    // По новому адресу сессий нет: адрес меняется у самого peer
+    EXPECT_TRUE(_control_plane.relocate_sgw(sgw_addr, moved_sgw));
+    EXPECT_EQ(0, _control_plane.count_sgw_sessions(sgw_addr));
+    EXPECT_EQ(10, _control_plane.count_sgw_sessions(moved_sgw));
+    for (const auto &pdn : pdns) {
+        EXPECT_EQ(moved_sgw, pdn->get_sgw_address());
+    }
+
+    // По новому адресу уже есть сессии: списки сливаются
+    EXPECT_TRUE(_control_plane.relocate_sgw(moved_sgw, busy_sgw));
+    EXPECT_EQ(0, _control_plane.count_sgw_sessions(moved_sgw));
+    EXPECT_EQ(11, _control_plane.count_sgw_sessions(busy_sgw));
+    for (const auto &pdn : pdns) {
+        EXPECT_EQ(busy_sgw, pdn->get_sgw_address());
+    }
+    EXPECT_FALSE(_control_plane.relocate_sgw(moved_sgw, sgw_addr));
+
+    _control_plane.delete_pdn_connection(pdns[3]->get_cp_teid());
+    EXPECT_EQ(10, _control_plane.delete_sgw_sessions(busy_sgw));
+    EXPECT_EQ(nullptr, _control_plane.find_pdn_by_cp_teid(busy->get_cp_teid()));
+}
+
+TEST_F(control_plane_test, lookups_survive_session_churn) {
+    constexpr size_t stable_sessions = 32;
+    constexpr size_t churn_iterations = 5000;
+    constexpr size_t readers = 4;
+
+    std::vector<std::shared_ptr<pdn_connection>> stable;
+    for (size_t i = 0; i < stable_sessions; ++i) {
+        stable.push_back(create_session(static_cast<uint32_t>(i)));
+    }
+
+    // Ключи сессий, которые управляющий поток создает и удаляет
+    constexpr size_t churn_slots = 64;
+    std::array<std::atomic<uint32_t>, churn_slots> churn_teids{};
+    std::array<std::atomic<uint32_t>, churn_slots> churn_ips{};
+
+    std::atomic<bool> stop{false};
+    std::atomic<size_t> errors{0};
+    std::atomic<size_t> lookups{0};
+
+    auto reader = [&] {
+        size_t n = 0;
+        while (!stop.load(std::memory_order_relaxed)) {
+            const auto &pdn = stable[n % stable_sessions];
+            auto found_bearer = _control_plane.find_bearer_by_dp_teid(pdn->get_default_bearer()->get_dp_teid());
+            auto found_pdn = _control_plane.find_pdn_by_ip_address(pdn->get_ue_ip_addr());
+            if (!found_bearer || found_bearer->get_pdn_connection() != pdn || found_pdn != pdn) {
+                errors.fetch_add(1);
+            }
+
+            // Сессия может исчезнуть в любой момент, но найденный объект обязан соответствовать ключу
+            auto teid = churn_teids[n % churn_slots].load(std::memory_order_relaxed);
+            if (auto churned = _control_plane.find_bearer_by_dp_teid(teid)) {
+                if (churned->get_dp_teid() != teid) {
+                    errors.fetch_add(1);
+                }
+                if (auto churned_pdn = churned->get_pdn_connection()) {
+                    (void) churned_pdn->get_default_bearer();
+                }
+            }
+            auto ip = boost::asio::ip::address_v4(churn_ips[n % churn_slots].load(std::memory_order_relaxed));
+            if (auto churned = _control_plane.find_pdn_by_ip_address(ip)) {
+                if (churned->get_ue_ip_addr() != ip) {
+                    errors.fetch_add(1);
+                }
+            }
+            ++n;
+        }
+        lookups.fetch_add(n);
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < readers; ++i) {
+        threads.emplace_back(reader);
+    }
+
+    std::array<uint32_t, churn_slots> churn_cp_teids{};
+    for (size_t i = 0; i < churn_iterations; ++i) {
+        const auto slot = i % churn_slots;
+        if (churn_cp_teids[slot]) {
+            _control_plane.delete_pdn_connection(churn_cp_teids[slot]);
+        }
+
+        auto pdn = create_session(static_cast<uint32_t>(i));
+        _control_plane.create_bearer(pdn, static_cast<uint32_t>(i));
+        churn_cp_teids[slot] = pdn->get_cp_teid();
+        churn_teids[slot].store(pdn->get_default_bearer()->get_dp_teid(), std::memory_order_relaxed);
+        churn_ips[slot].store(pdn->get_ue_ip_addr().to_uint(), std::memory_order_relaxed);
+    }
+
+    stop.store(true);
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    ASSERT_EQ(0, errors.load());
+    ASSERT_GT(lookups.load(), 0);
+
+    epoch_domain::global().synchronize();
+    ASSERT_EQ(0, epoch_domain::global().pending());
+}
@@ -11,6 +11,9 @@ public:
     std::unordered_map<boost::asio::ip::address_v4, std::unordered_map<uint32_t, std::vector<Packet>>>
             _forwarded_to_sgw;
     std::unordered_map<boost::asio::ip::address_v4, std::vector<Packet>> _forwarded_to_apn;
+    size_t _sgw_bursts{};
+    size_t _apn_bursts{};
+    std::vector<std::pair<boost::asio::ip::address_v4, Packet>> _sent_gtpu;
 
 protected:
     void forward_packet_to_sgw(boost::asio::ip::address_v4 sgw_addr, uint32_t sgw_dp_teid, Packet &&packet) override {
@@ -20,6 +23,20 @@ protected:
     void forward_packet_to_apn(boost::asio::ip::address_v4 apn_gateway, Packet &&packet) override {
         _forwarded_to_apn[apn_gateway].emplace_back(std::move(packet));
     }
+
+    void send_gtpu(boost::asio::ip::address_v4 peer, packet_buffer &&datagram) override {
+        _sent_gtpu.emplace_back(peer, Packet(datagram.data(), datagram.data() + datagram.size()));
+    }
+
+    void forward_burst_to_sgw(boost::asio::ip::address_v4 sgw_addr, std::span<sgw_packet> packets) override {
+        ++_sgw_bursts;
+        data_plane::forward_burst_to_sgw(sgw_addr, packets);
+    }
+
+    void forward_burst_to_apn(boost::asio::ip::address_v4 apn_gateway, std::span<Packet> packets) override {
+        ++_apn_bursts;
+        data_plane::forward_burst_to_apn(apn_gateway, packets);
+    }
 };
 
 class data_plane_test : public ::testing::Test {
@@ -98,6 +115,196 @@ TEST_F(data_plane_test, didnt_handle_downlink_for_unknown_ue_ip) {
     ASSERT_TRUE(_data_plane._forwarded_to_apn.empty());
 }
 
+TEST_F(data_plane_test, handle_uplink_burst_groups_by_apn_gateway) {
+    std::vector<data_plane::uplink_packet> burst{
+            {_default_bearer->get_dp_teid(), {1, 2, 3}},
+            {UINT32_MAX, {4}},
+            {_dedicated_bearer->get_dp_teid(), {5, 6}},
+    };
+    _data_plane.handle_uplink_burst(burst);
+
+    ASSERT_EQ(1, _data_plane._apn_bursts);
+    ASSERT_EQ(1, _data_plane._forwarded_to_apn.size());
+    ASSERT_EQ(2, _data_plane._forwarded_to_apn[apn_gw].size());
+    ASSERT_EQ((data_plane::Packet{1, 2, 3}), _data_plane._forwarded_to_apn[apn_gw][0]);
+    ASSERT_EQ((data_plane::Packet{5, 6}), _data_plane._forwarded_to_apn[apn_gw][1]);
+}
+
+TEST_F(data_plane_test, handle_downlink_burst_uses_default_bearer) {
+    const auto sgw_addr2 = boost::asio::ip::make_address_v4("127.1.0.2");
+    auto pdn2 = _control_plane.create_pdn_connection(apn, sgw_addr2, 3);
+    pdn2->set_default_bearer(_control_plane.create_bearer(pdn2, 4));
+    auto pdn_without_bearer = _control_plane.create_pdn_connection(apn, sgw_addr, 5);
+
+    std::vector<data_plane::downlink_packet> burst{
+            {_pdn->get_ue_ip_addr(), {1}},
+            {pdn2->get_ue_ip_addr(), {2}},
+            {boost::asio::ip::address_v4::any(), {3}},
+            {pdn_without_bearer->get_ue_ip_addr(), {4}},
+            {_pdn->get_ue_ip_addr(), {5}},
+    };
+    _data_plane.handle_downlink_burst(burst);
+
+    ASSERT_EQ(2, _data_plane._sgw_bursts);
+    ASSERT_EQ(2, _data_plane._forwarded_to_sgw.size());
+    ASSERT_EQ(2, _data_plane._forwarded_to_sgw[sgw_addr][sgw_default_bearer_teid].size());
+    ASSERT_EQ((data_plane::Packet{1}), _data_plane._forwarded_to_sgw[sgw_addr][sgw_default_bearer_teid][0]);
+    ASSERT_EQ((data_plane::Packet{5}), _data_plane._forwarded_to_sgw[sgw_addr][sgw_default_bearer_teid][1]);
+    ASSERT_EQ((data_plane::Packet{2}), _data_plane._forwarded_to_sgw[sgw_addr2][4][0]);
+}
+
+TEST_F(data_plane_test, buffer_path_uses_packet_adapter) {
+    packet_pool pool({.buffer_count = 4, .buffer_size = 256, .headroom = 64});
+
+    _data_plane.handle_uplink_buffer(_dedicated_bearer->get_dp_teid(), pool.allocate(std::vector<uint8_t>{1, 2}));
+    _data_plane.handle_downlink_buffer(_pdn->get_ue_ip_addr(), pool.allocate(std::vector<uint8_t>{3}));
+    _data_plane.handle_uplink_buffer(UINT32_MAX, pool.allocate(std::vector<uint8_t>{4}));
+
+    ASSERT_EQ((data_plane::Packet{1, 2}), _data_plane._forwarded_to_apn[apn_gw][0]);
+    ASSERT_EQ((data_plane::Packet{3}), _data_plane._forwarded_to_sgw[sgw_addr][sgw_default_bearer_teid][0]);
+
+    // Буферы вернулись в пул после копирования в Packet
+    std::vector<packet_buffer> packets;
+    while (auto packet = pool.allocate()) {
+        packets.emplace_back(std::move(packet));
+    }
+    ASSERT_EQ(pool.buffer_count(), packets.size());
+}
+
+TEST_F(data_plane_test, counters_track_usage_and_drops) {
+    _data_plane.handle_uplink(_default_bearer->get_dp_teid(), data_plane::Packet(100));
+    _data_plane.handle_uplink(_dedicated_bearer->get_dp_teid(), data_plane::Packet(200));
+    std::vector<data_plane::downlink_packet> burst{{_pdn->get_ue_ip_addr(), data_plane::Packet(300)},
+                                                   {boost::asio::ip::address_v4::any(), data_plane::Packet(1)}};
+    _data_plane.handle_downlink_burst(burst);
+    _data_plane.handle_uplink(UINT32_MAX, data_plane::Packet(1));
+
+    const auto &counters = _data_plane.get_counters();
+    EXPECT_EQ((traffic_counters::usage{1, 100, 1, 300}), counters.bearer_usage(_default_bearer->get_handle()));
+    EXPECT_EQ((traffic_counters::usage{1, 200, 0, 0}), counters.bearer_usage(_dedicated_bearer->get_handle()));
+    EXPECT_EQ((traffic_counters::usage{2, 300, 1, 300}), counters.pdn_usage(_pdn->get_handle()));
+    EXPECT_EQ((traffic_counters::usage{2, 300, 1, 300}), counters.apn_usage(*_control_plane.find_apn_id(apn)));
+    EXPECT_EQ(2, counters.drops(traffic_counters::no_session));
+
+    // Без default bearer
+    _pdn->set_default_bearer(nullptr);
+    _data_plane.handle_downlink(_pdn->get_ue_ip_addr(), data_plane::Packet(1));
+    EXPECT_EQ(1, counters.drops(traffic_counters::no_bearer));
+}
+
+TEST_F(data_plane_test, tft_steers_downlink_to_dedicated_bearer) {
+    ASSERT_TRUE(_control_plane.set_bearer_tft(_dedicated_bearer->get_dp_teid(),
+                                              {{.protocol = 17, .local_port_low = 5000, .local_port_high = 5010}}));
+    ASSERT_FALSE(_control_plane.set_bearer_tft(UINT32_MAX, {{}}));
+
+    // UDP пакеты на порт 5004 и 80
+    data_plane::Packet rtp(28, 0);
+    rtp[0] = 0x45;
+    rtp[9] = 17;
+    rtp[22] = 5004 >> 8;
+    rtp[23] = 5004 & 0xff;
+    data_plane::Packet http = rtp;
+    http[22] = 0;
+    http[23] = 80;
+
+    _data_plane.handle_downlink(_pdn->get_ue_ip_addr(), data_plane::Packet(rtp));
+    _data_plane.handle_downlink(_pdn->get_ue_ip_addr(), data_plane::Packet(http));
+    std::vector<data_plane::downlink_packet> burst{{_pdn->get_ue_ip_addr(), rtp}, {_pdn->get_ue_ip_addr(), http}};
+    _data_plane.handle_downlink_burst(burst);
+    EXPECT_EQ(2, _data_plane._forwarded_to_sgw[sgw_addr][sgw_ded_bearer_teid].size());
+    EXPECT_EQ(2, _data_plane._forwarded_to_sgw[sgw_addr][sgw_default_bearer_teid].size());
+
+    // Фильтры удаляются вместе с bearer
+    _control_plane.delete_bearer(_dedicated_bearer->get_dp_teid());
+    _data_plane.handle_downlink(_pdn->get_ue_ip_addr(), data_plane::Packet(rtp));
+    EXPECT_EQ(3, _data_plane._forwarded_to_sgw[sgw_addr][sgw_default_bearer_teid].size());
+}
+
+TEST_F(data_plane_test, gtpu_uplink_is_decapsulated_and_downlink_encapsulated) {
+    const auto pgw_addr = boost::asio::ip::make_address_v4("127.2.0.1");
+    _data_plane.set_gtpu_address(pgw_addr);
+    packet_pool pool({.buffer_count = 4, .buffer_size = 512, .headroom = 128});
+
+    // Внутренний IPv4 пакет от UE к серверу
+    data_plane::Packet inner(28, 0);
+    inner[0] = 0x45;
+    const auto ue_ip = _pdn->get_ue_ip_addr().to_bytes();
+    std::copy(ue_ip.begin(), ue_ip.end(), inner.begin() + 12);
+
+    auto uplink = pool.allocate(inner);
+    ASSERT_TRUE(gtpu::encapsulate(uplink, {sgw_addr, pgw_addr, _dedicated_bearer->get_dp_teid()}));
+    _data_plane.handle_gtpu_datagram(std::move(uplink));
+    ASSERT_EQ(1, _data_plane._forwarded_to_apn[apn_gw].size());
+    EXPECT_EQ(inner, _data_plane._forwarded_to_apn[apn_gw][0]);
+
+    // Ответ: адрес UE - адрес назначения
+    std::copy(ue_ip.begin(), ue_ip.end(), inner.begin() + 16);
+    _data_plane.handle_ip_packet(pool.allocate(inner));
+    ASSERT_EQ(1, _data_plane._sent_gtpu.size());
+    const auto &[peer, datagram] = _data_plane._sent_gtpu[0];
+    EXPECT_EQ(sgw_addr, peer);
+    const auto header = gtpu::parse(datagram);
+    ASSERT_TRUE(header);
+    EXPECT_EQ(sgw_default_bearer_teid, header->teid);
+    EXPECT_EQ(pgw_addr, header->peer);
+    EXPECT_EQ(inner, data_plane::Packet(datagram.begin() + header->payload_offset, datagram.end()));
+
+    // Неизвестный UE
+    inner[16] = 0;
+    _data_plane.handle_ip_packet(pool.allocate(inner));
+    EXPECT_EQ(1, _data_plane._sent_gtpu.size());
+}
+
+TEST_F(data_plane_test, gtpu_and_ip_bursts_pass_the_pipeline) {
+    const auto pgw_addr = boost::asio::ip::make_address_v4("127.2.0.1");
+    _data_plane.set_gtpu_address(pgw_addr);
+    packet_pool pool({.buffer_count = 8, .buffer_size = 512, .headroom = 128});
+
+    data_plane::Packet inner(28, 0);
+    inner[0] = 0x45;
+    const auto ue_ip = _pdn->get_ue_ip_addr().to_bytes();
+    std::copy(ue_ip.begin(), ue_ip.end(), inner.begin() + 12);
+
+    // G-PDU на известный и неизвестный TEID и битая датаграмма
+    std::vector<packet_buffer> datagrams;
+    for (const auto teid : {_dedicated_bearer->get_dp_teid(), UINT32_MAX}) {
+        datagrams.push_back(pool.allocate(inner));
+        ASSERT_TRUE(gtpu::encapsulate(datagrams.back(), {sgw_addr, pgw_addr, teid}));
+    }
+    datagrams.push_back(pool.allocate(data_plane::Packet{1, 2, 3}));
+    _data_plane.handle_gtpu_burst(datagrams);
+    ASSERT_EQ(1, _data_plane._forwarded_to_apn[apn_gw].size());
+    EXPECT_EQ(inner, _data_plane._forwarded_to_apn[apn_gw][0]);
+    EXPECT_EQ(1, _data_plane.get_counters().drops(traffic_counters::no_session));
+    EXPECT_EQ(1, _data_plane.get_counters().drops(traffic_counters::malformed));
+
+    // Ответы UE и пакет на неизвестный адрес
+    std::copy(ue_ip.begin(), ue_ip.end(), inner.begin() + 16);
+    std::vector<packet_buffer> packets;
+    packets.push_back(pool.allocate(inner));
+    packets.push_back(pool.allocate(inner));
+    inner[16] = 0;
+    packets.push_back(pool.allocate(inner));
+    _data_plane.handle_ip_burst(packets);
+    ASSERT_EQ(2, _data_plane._sent_gtpu.size());
+    for (const auto &[peer, datagram] : _data_plane._sent_gtpu) {
+        EXPECT_EQ(sgw_addr, peer);
+        const auto header = gtpu::parse(datagram);
+        ASSERT_TRUE(header);
+        EXPECT_EQ(sgw_default_bearer_teid, header->teid);
+    }
+    EXPECT_EQ(2, _data_plane.get_counters().drops(traffic_counters::no_session));
+
+    // Отброшенные при разборе буферы остаются вызывающему, остальные вернулись в пул
+    datagrams.clear();
+    packets.clear();
+    std::vector<packet_buffer> all;
+    for (size_t i = 0; i < pool.buffer_count(); ++i) {
+        all.push_back(pool.allocate());
+        EXPECT_TRUE(all.back());
+    }
+}
+
 class mock_rate_limited_data_plane : public rate_limited_data_plane {
 protected:
     void forward_packet_to_sgw(boost::asio::ip::address_v4 sgw_addr, uint32_t sgw_dp_teid, Packet &&packet) override {
@@ -277,6 +484,25 @@ TEST_F(rate_limited_data_plane_test, delete_rate_limits) {
     EXPECT_EQ(5, _data_plane._forwarded_to_sgw[sgw_addr][sgw_default_bearer_teid].size());
 }
 
+TEST_F(rate_limited_data_plane_test, limits_live_in_session_records) {
+    rate_limited_data_plane::rate_limit_config ambr{.uplink_rate = 1, .uplink_capacity = 1024};
+    _data_plane.set_rate_limits(_pdn->get_cp_teid(), ambr);
+    ASSERT_TRUE(_data_plane.set_bearer_rate_limits(_dedicated_bearer->get_dp_teid(),
+                                                   {.mbr = {.uplink_rate = 1, .uplink_capacity = 1024}}));
+    ASSERT_NE(nullptr, _pdn->get_qos_limits_view());
+    ASSERT_NE(nullptr, _dedicated_bearer->get_qos_limits_view());
+    EXPECT_EQ(nullptr, _default_bearer->get_qos_limits_view());
+
+    // Лимиты удаляются вместе с сессией, даже без delete_rate_limits
+    std::weak_ptr<pdn_connection> pdn = _pdn;
+    _control_plane.delete_pdn_connection(_pdn->get_cp_teid());
+    _pdn.reset();
+    _default_bearer.reset();
+    _dedicated_bearer.reset();
+    epoch_domain::global().synchronize();
+    EXPECT_TRUE(pdn.expired());
+}
+
 TEST_F(rate_limited_data_plane_test, multiple_pdns_independent_limits) {
     // Создаем второй PDN с другими ограничениями
     auto pdn2 = _control_plane.create_pdn_connection(apn, sgw_addr, 101);
@@ -312,3 +538,139 @@ TEST_F(rate_limited_data_plane_test, multiple_pdns_independent_limits) {
     // PDN1 должен пропустить только 1 пакет, PDN2 - все 5
     EXPECT_EQ(6, _data_plane._forwarded_to_apn[apn_gw].size());
 }
+
+TEST_F(rate_limited_data_plane_test, burst_matches_per_packet_limits) {
+    rate_limited_data_plane::rate_limit_config config{
+        .uplink_rate = 1024,
+        .uplink_capacity = 3 * 1024,
+        .downlink_rate = 1024,
+        .downlink_capacity = 2 * 1024
+    };
+    _data_plane.set_rate_limits(_pdn->get_cp_teid(), config);
+
+    std::vector<data_plane::uplink_packet> uplink;
+    std::vector<data_plane::downlink_packet> downlink;
+    for (int i = 0; i < 5; ++i) {
+        uplink.push_back({_default_bearer->get_dp_teid(), data_plane::Packet(1024, static_cast<uint8_t>(i))});
+        downlink.push_back({_pdn->get_ue_ip_addr(), data_plane::Packet(1024, static_cast<uint8_t>(i))});
+    }
+    _data_plane.handle_uplink_burst(uplink);
+    _data_plane.handle_downlink_burst(downlink);
+
+    // Проходят первые пакеты в пределах capacity, как и при поштучной обработке
+    ASSERT_EQ(3, _data_plane._forwarded_to_apn[apn_gw].size());
+    ASSERT_EQ(2, _data_plane._forwarded_to_apn[apn_gw][2][0]);
+    ASSERT_EQ(2, _data_plane._forwarded_to_sgw[sgw_addr][sgw_default_bearer_teid].size());
+    ASSERT_EQ(1, _data_plane._forwarded_to_sgw[sgw_addr][sgw_default_bearer_teid][1][0]);
+}
+
+TEST_F(rate_limited_data_plane_test, apn_limit_shared_between_sessions) {
+    auto pdn2 = _control_plane.create_pdn_connection(apn, sgw_addr, 101);
+    auto bearer2 = _control_plane.create_bearer(pdn2, 2);
+    pdn2->set_default_bearer(bearer2);
+
+    ASSERT_TRUE(_data_plane.set_apn_rate_limits(
+        apn, {.uplink_rate = 1, .uplink_capacity = 3 * 1024, .downlink_rate = 1, .downlink_capacity = 1024}));
+    ASSERT_FALSE(_data_plane.set_apn_rate_limits("unknown.apn", {}));
+
+    for (int i = 0; i < 3; ++i) {
+        _data_plane.handle_uplink(_default_bearer->get_dp_teid(), data_plane::Packet(1024, 0));
+        _data_plane.handle_uplink(bearer2->get_dp_teid(), data_plane::Packet(1024, 0));
+        _data_plane.handle_downlink(_pdn->get_ue_ip_addr(), data_plane::Packet(1024, 0));
+        _data_plane.handle_downlink(pdn2->get_ue_ip_addr(), data_plane::Packet(1024, 0));
+    }
+
+    EXPECT_EQ(3, _data_plane._forwarded_to_apn[apn_gw].size());
+    EXPECT_EQ(1, _data_plane._forwarded_to_sgw[sgw_addr][sgw_default_bearer_teid].size() +
+                     _data_plane._forwarded_to_sgw[sgw_addr][2].size());
+}
+
+TEST_F(rate_limited_data_plane_test, gbr_traffic_bypasses_session_ambr) {
+    rate_limited_data_plane::rate_limit_config ambr{
+        .uplink_rate = 1, .uplink_capacity = 1024, .downlink_rate = 1, .downlink_capacity = 1024};
+    _data_plane.set_rate_limits(_pdn->get_cp_teid(), ambr);
+    ASSERT_TRUE(_data_plane.set_bearer_rate_limits(
+        _dedicated_bearer->get_dp_teid(), {.mbr = {.uplink_rate = 1, .uplink_capacity = 4 * 1024},
+                                           .gbr = {.uplink_rate = 1, .uplink_capacity = 2 * 1024}}));
+
+    // Два пакета в пределах GBR, третий - из AMBR сессии, остальные упираются в AMBR
+    for (int i = 0; i < 5; ++i) {
+        _data_plane.handle_uplink(_dedicated_bearer->get_dp_teid(), data_plane::Packet(1024, 0));
+    }
+    EXPECT_EQ(3, _data_plane._forwarded_to_apn[apn_gw].size());
+
+    // AMBR сессии исчерпан и для default bearer
+    _data_plane.handle_uplink(_default_bearer->get_dp_teid(), data_plane::Packet(1024, 0));
+    EXPECT_EQ(3, _data_plane._forwarded_to_apn[apn_gw].size());
+}
+
+TEST_F(rate_limited_data_plane_test, rejected_packet_refunds_lower_levels) {
+    rate_limited_data_plane::rate_limit_config ambr{
+        .uplink_rate = 1, .uplink_capacity = 1024, .downlink_rate = 1, .downlink_capacity = 1024};
+    _data_plane.set_rate_limits(_pdn->get_cp_teid(), ambr);
+    ASSERT_TRUE(_data_plane.set_bearer_rate_limits(_dedicated_bearer->get_dp_teid(),
+                                                   {.mbr = {.uplink_rate = 1, .uplink_capacity = 2 * 1024}}));
+
+    // Второй пакет проходит MBR, но отклоняется AMBR: MBR получает токены обратно
+    _data_plane.handle_uplink(_dedicated_bearer->get_dp_teid(), data_plane::Packet(1024, 0));
+    _data_plane.handle_uplink(_dedicated_bearer->get_dp_teid(), data_plane::Packet(1024, 0));
+    EXPECT_EQ(1, _data_plane._forwarded_to_apn[apn_gw].size());
+
+    ambr.uplink_capacity = 10 * 1024;
+    _data_plane.set_rate_limits(_pdn->get_cp_teid(), ambr);
+    _data_plane.handle_uplink(_dedicated_bearer->get_dp_teid(), data_plane::Packet(1024, 0));
+    _data_plane.handle_uplink(_dedicated_bearer->get_dp_teid(), data_plane::Packet(1024, 0));
+    EXPECT_EQ(2, _data_plane._forwarded_to_apn[apn_gw].size());
+}
+
+TEST_F(rate_limited_data_plane_test, shaping_queues_and_releases_over_limit_packets) {
+    rate_limited_data_plane::rate_limit_config ambr{.uplink_rate = 1'000'000, .uplink_capacity = 1024};
+    _data_plane.set_rate_limits(_pdn->get_cp_teid(), ambr);
+    _data_plane.set_shaping({.queue_depth = 2});
+
+    // Первый пакет проходит сразу, два встают в очередь, остальные не помещаются
+    for (int i = 0; i < 5; ++i) {
+        _data_plane.handle_uplink(_default_bearer->get_dp_teid(), data_plane::Packet(1024, static_cast<uint8_t>(i)));
+    }
+    EXPECT_EQ(1, _data_plane._forwarded_to_apn[apn_gw].size());
+    EXPECT_EQ(2, _data_plane.get_shaping_counters().queued);
+    EXPECT_EQ(2, _data_plane.get_shaping_counters().dropped);
+    EXPECT_EQ(2, _data_plane.get_counters().drops(traffic_counters::policed));
+
+    // На 1 МБ/с каждый следующий пакет выпускается примерно через 1 мс
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (_data_plane._forwarded_to_apn[apn_gw].size() < 3 && std::chrono::steady_clock::now() < deadline) {
+        _data_plane.poll();
+    }
+    ASSERT_EQ(3, _data_plane._forwarded_to_apn[apn_gw].size());
+    EXPECT_EQ(1, _data_plane._forwarded_to_apn[apn_gw][1][0]);
+    EXPECT_EQ(2, _data_plane._forwarded_to_apn[apn_gw][2][0]);
+    EXPECT_EQ(2, _data_plane.get_shaping_counters().released);
+    EXPECT_GT(_data_plane.get_shaping_counters().max_delay_ns, 0);
+
+    // Выпущенные пакеты учтены как доставленные, а не отброшенные
+    EXPECT_EQ(2, _data_plane.get_counters().drops(traffic_counters::policed));
+    EXPECT_EQ(3, _data_plane.get_counters().bearer_usage(_default_bearer->get_handle()).uplink_packets);
+}
+
+TEST(token_bucket_test, enforces_rate_within_one_percent) {
+    // 1 Гбит/с, предлагается вдвое больше; время задаем сами, в единицах token_bucket (1/16 нс)
+    constexpr double rate = 125'000'000;
+    constexpr double capacity = 15'000;
+    constexpr uint64_t ticks_per_second = 16'000'000'000;
+    token_bucket bucket(rate, capacity);
+
+    const uint64_t start = 1'000 * ticks_per_second;
+    uint64_t accepted = 0;
+    uint64_t now = start;
+    for (uint64_t i = 0; now < start + ticks_per_second; ++i) {
+        const uint64_t size = 64 + (i * 7919) % 1437;
+        if (bucket.spend_tokens(size, now)) {
+            accepted += size;
+        }
+        now += size * 64;
+    }
+
+    const double expected = rate + capacity;
+    ASSERT_NEAR(expected, static_cast<double>(accepted), expected * 0.01);
+}
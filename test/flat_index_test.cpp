@@ -0,0 +1,115 @@
+#include <flat_index.h>
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <unordered_map>
+
+TEST(flat_index_test, insert_find_erase) {
+    flat_index<uint32_t> index;
+
+    index.insert_or_assign(1, 10);
+    index.insert_or_assign(0, 20);
+    index.insert_or_assign(UINT32_MAX, 30);
+    ASSERT_EQ(10, index.find(1));
+    ASSERT_EQ(20, index.find(0));
+    ASSERT_EQ(30, index.find(UINT32_MAX));
+    ASSERT_EQ(0, index.find(2));
+
+    index.insert_or_assign(1, 11);
+    ASSERT_EQ(11, index.find(1));
+    ASSERT_EQ(3, index.size());
+
+    ASSERT_TRUE(index.erase(1));
+    ASSERT_FALSE(index.erase(1));
+    ASSERT_EQ(0, index.find(1));
+    ASSERT_EQ(2, index.size());
+}
+
+TEST(flat_index_test, reserve_avoids_growth) {
+    flat_index<uint32_t> index;
+    index.reserve(100000);
+    const auto capacity = index.capacity();
+
+    for (uint32_t i = 0; i < 100000; ++i) {
+        index.insert_or_assign(i * 7919, i + 1);
+    }
+    ASSERT_EQ(capacity, index.capacity());
+    for (uint32_t i = 0; i < 100000; ++i) {
+        ASSERT_EQ(i + 1, index.find(i * 7919));
+    }
+}
+
+TEST(flat_index_test, reinserted_key_reuses_its_slot) {
+    flat_index<uint32_t> index;
+    for (uint32_t i = 1; i <= 13; ++i) {
+        index.insert_or_assign(i, i);
+    }
+    const auto pending = epoch_domain::global().pending();
+
+    for (uint32_t round = 100; round < 1100; ++round) {
+        ASSERT_TRUE(index.erase(5));
+        index.insert_or_assign(5, round);
+        ASSERT_EQ(round, index.find(5));
+    }
+    // Каждая вставка в новый слот почти сразу заполнила бы таблицу, и старые таблицы уходили бы в retire
+    ASSERT_EQ(pending, epoch_domain::global().pending());
+    ASSERT_EQ(13, index.size());
+}
+
+TEST(flat_index_test, churn_with_fresh_keys_rebuilds_rarely) {
+    // Живых ключей почти 7/8 емкости, каждая вставка - новый ключ, как новые TEID
+    flat_index<uint32_t> busy(1000);
+    const auto capacity = busy.capacity();
+    uint32_t oldest = 1;
+    uint32_t next = 1;
+    for (; next <= capacity * 27 / 32; ++next) {
+        busy.insert_or_assign(next, next);
+    }
+    auto pending = epoch_domain::global().pending();
+    for (size_t i = 0; i < capacity * 4; ++i, ++next) {
+        ASSERT_TRUE(busy.erase(oldest++));
+        busy.insert_or_assign(next, next);
+    }
+    // Таблица выросла один раз, дальше deleted вычищаются редко, а не через каждые 1/32 емкости
+    ASSERT_EQ(capacity * 2, busy.capacity());
+    ASSERT_GE(6, epoch_domain::global().pending() - pending);
+    for (uint32_t key = oldest; key < next; ++key) {
+        ASSERT_EQ(key, busy.find(key));
+    }
+
+    // При малой загрузке место deleted возвращается без роста
+    flat_index<uint32_t> idle(1000);
+    for (next = oldest = 1; next <= capacity / 4; ++next) {
+        idle.insert_or_assign(next, next);
+    }
+    for (size_t i = 0; i < capacity * 4; ++i, ++next) {
+        ASSERT_TRUE(idle.erase(oldest++));
+        idle.insert_or_assign(next, next);
+    }
+    ASSERT_EQ(capacity, idle.capacity());
+}
+
+TEST(flat_index_test, matches_unordered_map_under_churn) {
+    flat_index<uint32_t> index;
+    std::unordered_map<uint32_t, uint32_t> reference;
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<uint32_t> keys(0, 20000);
+
+    for (uint32_t i = 1; i <= 200000; ++i) {
+        const auto key = keys(gen);
+        if (gen() % 3 == 0) {
+            ASSERT_EQ(reference.erase(key) == 1, index.erase(key));
+        } else {
+            reference[key] = i;
+            index.insert_or_assign(key, i);
+        }
+    }
+
+    ASSERT_EQ(reference.size(), index.size());
+    for (uint32_t key = 0; key <= 20000; ++key) {
+        auto it = reference.find(key);
+        ASSERT_EQ(it != reference.end() ? it->second : 0, index.find(key));
+    }
+    epoch_domain::global().synchronize();
+}
@@ -0,0 +1,434 @@
+#include <gtpc_engine.h>
+
+#include <gtest/gtest.h>
+
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/io_context.hpp>
+
+#include <array>
+#include <vector>
+
+namespace {
+    using boost::asio::ip::udp;
+
+    const auto pgw_addr{boost::asio::ip::make_address_v4("127.0.0.1")};
+    const auto sgw_addr{boost::asio::ip::make_address_v4("127.1.0.1")};
+
+    std::vector<uint8_t> create_session_request(uint32_t sequence, uint32_t sgw_teid, std::string_view apn) {
+        std::array<uint8_t, 256> buffer;
+        const auto message = gtpc::writer(buffer, gtpc::create_session_request, 0, sequence)
+                                 .add_imsi("250011234567890")
+                                 .add_apn(apn)
+                                 .add_fteid({gtpc::s5_s8_sgw_gtp_c, sgw_teid, sgw_addr}, gtpc::instance::sender_f_teid)
+                                 .begin_group(gtpc::bearer_context)
+                                 .add_ebi(5)
+                                 .add_fteid({gtpc::s5_s8_sgw_gtp_u, sgw_teid, sgw_addr},
+                                            gtpc::instance::s5_s8_u_sgw_f_teid)
+                                 .end_group()
+                                 .finish();
+        return {message.begin(), message.end()};
+    }
+
+    std::vector<uint8_t> delete_session_request(uint32_t sequence, uint32_t pgw_teid) {
+        std::array<uint8_t, 64> buffer;
+        const auto message = gtpc::writer(buffer, gtpc::delete_session_request, pgw_teid, sequence)
+                                 .add_ebi(5)
+                                 .finish();
+        return {message.begin(), message.end()};
+    }
+
+    std::optional<gtpc::cause_value> cause_of(const gtpc::header &message) {
+        const auto cause = message.ies.find(gtpc::cause);
+        return cause ? gtpc::decode_cause(cause->value) : std::nullopt;
+    }
+} // namespace
+
+class gtpc_engine_test : public ::testing::Test {
+public:
+    static const inline std::string apn{"test.apn"};
+
+    gtpc_engine_test() {
+        _control_plane.add_apn(apn, pgw_addr);
+        memory_transport::connect(_pgw, _sgw);
+        boost::asio::co_spawn(_io, _engine.run(), boost::asio::detached);
+    }
+
+    // Следующая датаграмма, пришедшая SGW
+    std::vector<uint8_t> receive() {
+        std::vector<uint8_t> received;
+        bool done = false;
+        boost::asio::co_spawn(
+            _io,
+            [&]() -> boost::asio::awaitable<void> {
+                std::array<uint8_t, gtpc_engine::max_datagram_size> buffer;
+                udp::endpoint from;
+                const auto size = co_await _sgw.receive(buffer, from);
+                received.assign(buffer.begin(), buffer.begin() + static_cast<ptrdiff_t>(size));
+                done = true;
+            },
+            boost::asio::detached);
+        run_until(done);
+        return received;
+    }
+
+    std::vector<uint8_t> exchange(std::span<const uint8_t> request) {
+        _sgw.send(request, _pgw.local_endpoint());
+        return receive();
+    }
+
+    // Ответ на наш Create Bearer Request: SGW принимает bearer со своим TEID или отказывает
+    void answer_create_bearer(std::span<const uint8_t> request, uint32_t pgw_teid, gtpc::cause_value cause,
+                              uint32_t sgw_teid) {
+        const auto response = create_bearer_response(request, pgw_teid, cause, sgw_teid);
+        _sgw.send(response, _pgw.local_endpoint());
+    }
+
+    static std::vector<uint8_t> create_bearer_response(std::span<const uint8_t> request, uint32_t pgw_teid,
+                                                       gtpc::cause_value cause, uint32_t sgw_teid) {
+        const auto header = gtpc::parse(request).value();
+        EXPECT_EQ(gtpc::create_bearer_request, header.type);
+        std::array<uint8_t, 128> buffer;
+        const auto response = gtpc::writer(buffer, gtpc::create_bearer_response, pgw_teid, header.sequence)
+                                  .add_cause(cause)
+                                  .begin_group(gtpc::bearer_context)
+                                  .add_ebi(6)
+                                  .add_cause(cause)
+                                  .add_fteid({gtpc::s5_s8_sgw_gtp_u, sgw_teid, sgw_addr},
+                                             gtpc::instance::s5_s8_u_sgw_f_teid)
+                                  .end_group()
+                                  .finish();
+        return {response.begin(), response.end()};
+    }
+
+    std::shared_ptr<pdn_connection> create_session(uint32_t sequence, uint32_t sgw_teid) {
+        const auto response = exchange(create_session_request(sequence, sgw_teid, apn));
+        const auto header = gtpc::parse(response);
+        const auto pgw_control = gtpc::decode_fteid(header->ies.find(gtpc::f_teid)->value);
+        return _control_plane.find_pdn_by_cp_teid(pgw_control->teid);
+    }
+
+    void run_until(const bool &done) {
+        for (int i = 0; i < 1000 && !done; ++i) {
+            _io.run_one_for(std::chrono::milliseconds(10));
+        }
+        ASSERT_TRUE(done);
+    }
+
+    boost::asio::io_context _io;
+    control_plane _control_plane;
+    memory_transport _pgw{_io.get_executor(), udp::endpoint(pgw_addr, gtpc::port)};
+    memory_transport _sgw{_io.get_executor(), udp::endpoint(sgw_addr, gtpc::port)};
+    gtpc_engine _engine{_control_plane, _pgw,
+                        gtpc_engine::config{.control_address = pgw_addr,
+                                            .user_address = pgw_addr,
+                                            .restart_counter = 7,
+                                            .t3 = std::chrono::milliseconds(20),
+                                            .n3 = 2}};
+};
+
+TEST_F(gtpc_engine_test, create_session_sets_up_pdn_and_default_bearer) {
+    const auto response = exchange(create_session_request(1, 100, apn));
+
+    const auto header = gtpc::parse(response);
+    ASSERT_TRUE(header);
+    ASSERT_EQ(gtpc::create_session_response, header->type);
+    ASSERT_EQ(1u, header->sequence);
+    ASSERT_EQ(100u, header->teid);
+    ASSERT_EQ(gtpc::request_accepted, cause_of(*header));
+
+    const auto pgw_control = gtpc::decode_fteid(header->ies.find(gtpc::f_teid)->value);
+    ASSERT_TRUE(pgw_control);
+    ASSERT_EQ(gtpc::s5_s8_pgw_gtp_c, pgw_control->interface);
+    const auto pdn = _control_plane.find_pdn_by_cp_teid(pgw_control->teid);
+    ASSERT_NE(nullptr, pdn);
+    ASSERT_EQ(sgw_addr, pdn->get_sgw_address());
+    ASSERT_EQ(100u, pdn->get_sgw_cp_teid());
+    ASSERT_EQ(pdn->get_ue_ip_addr(), gtpc::decode_paa(header->ies.find(gtpc::paa)->value));
+
+    const auto context = gtpc::grouped(header->ies.find(gtpc::bearer_context)->value);
+    ASSERT_TRUE(context);
+    ASSERT_EQ(5, gtpc::decode_ebi(context->find(gtpc::ebi)->value));
+    const auto pgw_user = gtpc::decode_fteid(context->find(gtpc::f_teid, gtpc::instance::s5_s8_u_pgw_f_teid)->value);
+    ASSERT_TRUE(pgw_user);
+    ASSERT_EQ(pdn->get_default_bearer()->get_dp_teid(), pgw_user->teid);
+    ASSERT_EQ(100u, pdn->get_default_bearer()->get_sgw_dp_teid());
+}
+
+TEST_F(gtpc_engine_test, create_session_rejects_bad_requests) {
+    auto header_of = [](const std::vector<uint8_t> &response) { return *gtpc::parse(response); };
+
+    ASSERT_EQ(gtpc::missing_or_unknown_apn,
+              cause_of(header_of(exchange(create_session_request(1, 100, "unknown.apn")))));
+
+    std::array<uint8_t, 64> buffer;
+    const auto no_bearer = gtpc::writer(buffer, gtpc::create_session_request, 0, 2)
+                               .add_apn(apn)
+                               .add_fteid({gtpc::s5_s8_sgw_gtp_c, 100, sgw_addr}, gtpc::instance::sender_f_teid)
+                               .finish();
+    ASSERT_EQ(gtpc::mandatory_ie_missing, cause_of(header_of(exchange(no_bearer))));
+    ASSERT_EQ(0u, _control_plane.count_sgw_sessions(sgw_addr));
+
+    // Мусор и неизвестные сообщения молча отбрасываются
+    const uint8_t garbage[]{1, 2, 3};
+    _sgw.send(garbage, _pgw.local_endpoint());
+    ASSERT_EQ(gtpc::request_accepted, cause_of(header_of(exchange(create_session_request(3, 100, apn)))));
+    ASSERT_EQ(1u, _engine.get_statistics().dropped);
+}
+
+TEST_F(gtpc_engine_test, delete_session_releases_pdn) {
+    const auto pdn = create_session(1, 100);
+    ASSERT_NE(nullptr, pdn);
+
+    const auto response = exchange(delete_session_request(2, pdn->get_cp_teid()));
+    const auto header = gtpc::parse(response);
+    ASSERT_TRUE(header);
+    ASSERT_EQ(gtpc::delete_session_response, header->type);
+    ASSERT_EQ(100u, header->teid);
+    ASSERT_EQ(gtpc::request_accepted, cause_of(*header));
+    ASSERT_EQ(nullptr, _control_plane.find_pdn_by_cp_teid(pdn->get_cp_teid()));
+
+    const auto again = exchange(delete_session_request(3, pdn->get_cp_teid()));
+    ASSERT_EQ(gtpc::context_not_found, cause_of(*gtpc::parse(again)));
+}
+
+TEST_F(gtpc_engine_test, delete_session_only_from_session_sgw) {
+    const auto pdn = create_session(1, 100);
+
+    const auto request = delete_session_request(2, pdn->get_cp_teid());
+    _engine.handle(request, udp::endpoint(boost::asio::ip::make_address_v4("127.9.0.1"), gtpc::port));
+    ASSERT_EQ(gtpc::context_not_found, cause_of(*gtpc::parse(receive())));
+    ASSERT_EQ(pdn, _control_plane.find_pdn_by_cp_teid(pdn->get_cp_teid()));
+}
+
+TEST_F(gtpc_engine_test, retransmitted_request_gets_cached_response) {
+    const auto request = create_session_request(1, 100, apn);
+    const auto first = exchange(request);
+    const auto second = exchange(request);
+
+    ASSERT_EQ(first, second);
+    ASSERT_EQ(1u, _control_plane.count_sgw_sessions(sgw_addr));
+    ASSERT_EQ(2u, _engine.get_statistics().requests);
+    ASSERT_EQ(1u, _engine.get_statistics().duplicate_requests);
+
+    // Тот же sequence number с другим сообщением - новый запрос
+    const auto pgw_control = gtpc::decode_fteid(gtpc::parse(first)->ies.find(gtpc::f_teid)->value);
+    exchange(delete_session_request(1, pgw_control->teid));
+    ASSERT_EQ(0u, _control_plane.count_sgw_sessions(sgw_addr));
+}
+
+TEST_F(gtpc_engine_test, early_request_stays_cached_behind_many_later_ones) {
+    const auto request = create_session_request(1, 100, apn);
+    const auto first = exchange(request);
+
+    // Больше запросов, чем помещалось в кэш по sequence number, пока ответ на первый еще хранится
+    for (uint32_t sequence = 2; sequence <= 1100; ++sequence) {
+        exchange(delete_session_request(sequence, 0));
+    }
+
+    ASSERT_EQ(first, exchange(request));
+    ASSERT_EQ(1u, _control_plane.count_sgw_sessions(sgw_addr));
+    ASSERT_EQ(1u, _engine.get_statistics().duplicate_requests);
+    ASSERT_EQ(0u, _engine.get_statistics().evicted_responses);
+}
+
+TEST_F(gtpc_engine_test, echo_carries_restart_counter) {
+    std::array<uint8_t, 64> buffer;
+    const auto response = exchange(gtpc::writer(buffer, gtpc::echo_request, std::nullopt, 9).add_recovery(1).finish());
+
+    const auto header = gtpc::parse(response);
+    ASSERT_TRUE(header);
+    ASSERT_EQ(gtpc::echo_response, header->type);
+    ASSERT_EQ(9u, header->sequence);
+    ASSERT_EQ(7, header->ies.find(gtpc::recovery)->value[0]);
+}
+
+TEST_F(gtpc_engine_test, create_bearer_completes_on_response) {
+    const auto pdn = create_session(1, 100);
+
+    std::shared_ptr<bearer> created;
+    bool done = false;
+    boost::asio::co_spawn(
+        _io,
+        [&]() -> boost::asio::awaitable<void> {
+            created = co_await _engine.create_bearer(pdn->get_cp_teid(), 5, gtpc::qos{.qci = 1});
+            done = true;
+        },
+        boost::asio::detached);
+
+    const auto request = receive();
+    const auto header = gtpc::parse(request);
+    ASSERT_TRUE(header);
+    ASSERT_EQ(100u, header->teid);
+    ASSERT_EQ(5, gtpc::decode_ebi(header->ies.find(gtpc::ebi)->value));
+    const auto context = gtpc::grouped(header->ies.find(gtpc::bearer_context)->value);
+    const auto pgw_user =
+        gtpc::decode_fteid(context->find(gtpc::f_teid, gtpc::instance::create_bearer_s5_s8_u_pgw_f_teid)->value);
+    ASSERT_TRUE(pgw_user);
+    ASSERT_EQ(1, gtpc::decode_bearer_qos(context->find(gtpc::bearer_qos)->value)->qci);
+
+    answer_create_bearer(request, pdn->get_cp_teid(), gtpc::request_accepted, 300);
+    run_until(done);
+    ASSERT_NE(nullptr, created);
+    ASSERT_EQ(pgw_user->teid, created->get_dp_teid());
+    ASSERT_EQ(300u, created->get_sgw_dp_teid());
+    ASSERT_EQ(created, _control_plane.find_bearer_by_dp_teid(pgw_user->teid));
+    ASSERT_EQ(0u, _engine.get_statistics().retransmissions);
+}
+
+TEST_F(gtpc_engine_test, create_bearer_response_only_from_session_sgw) {
+    const auto pdn = create_session(1, 100);
+
+    std::shared_ptr<bearer> created;
+    bool done = false;
+    boost::asio::co_spawn(
+        _io,
+        [&]() -> boost::asio::awaitable<void> {
+            created = co_await _engine.create_bearer(pdn->get_cp_teid(), 5, gtpc::qos{.qci = 1});
+            done = true;
+        },
+        boost::asio::detached);
+
+    // Чужой адрес или чужой TEID в заголовке: ответ отбрасывается, транзакция ждет дальше
+    const auto request = receive();
+    _engine.handle(create_bearer_response(request, pdn->get_cp_teid(), gtpc::request_accepted, 666),
+                   udp::endpoint(boost::asio::ip::make_address_v4("127.9.0.1"), gtpc::port));
+    _engine.handle(create_bearer_response(request, pdn->get_cp_teid() + 1, gtpc::no_resources_available, 666),
+                   _sgw.local_endpoint());
+    ASSERT_EQ(2u, _engine.get_statistics().dropped);
+    ASSERT_FALSE(done);
+
+    answer_create_bearer(request, pdn->get_cp_teid(), gtpc::request_accepted, 300);
+    run_until(done);
+    ASSERT_NE(nullptr, created);
+    ASSERT_EQ(300u, created->get_sgw_dp_teid());
+}
+
+TEST_F(gtpc_engine_test, create_bearer_retransmits_and_gives_up) {
+    const auto pdn = create_session(1, 100);
+
+    std::shared_ptr<bearer> created;
+    bool done = false;
+    boost::asio::co_spawn(
+        _io,
+        [&]() -> boost::asio::awaitable<void> {
+            created = co_await _engine.create_bearer(pdn->get_cp_teid(), 5, gtpc::qos{.qci = 1});
+            done = true;
+        },
+        boost::asio::detached);
+
+    // Первая отправка и n3 повтора с тем же sequence number, ответа нет
+    const auto request = receive();
+    ASSERT_EQ(request, receive());
+    ASSERT_EQ(request, receive());
+    run_until(done);
+
+    ASSERT_EQ(nullptr, created);
+    ASSERT_EQ(1u, pdn->get_bearers().size());
+    ASSERT_EQ(2u, _engine.get_statistics().retransmissions);
+    ASSERT_EQ(1u, _engine.get_statistics().timeouts);
+
+    // Опоздавший ответ ни на что не влияет
+    answer_create_bearer(request, pdn->get_cp_teid(), gtpc::request_accepted, 300);
+    exchange(delete_session_request(2, pdn->get_cp_teid()));
+    ASSERT_EQ(1u, _engine.get_statistics().dropped);
+}
+
+TEST_F(gtpc_engine_test, create_bearer_rejected_by_sgw) {
+    const auto pdn = create_session(1, 100);
+
+    std::shared_ptr<bearer> created;
+    bool done = false;
+    boost::asio::co_spawn(
+        _io,
+        [&]() -> boost::asio::awaitable<void> {
+            created = co_await _engine.create_bearer(pdn->get_cp_teid(), 5, gtpc::qos{.qci = 1});
+            done = true;
+        },
+        boost::asio::detached);
+
+    answer_create_bearer(receive(), pdn->get_cp_teid(), gtpc::no_resources_available, 300);
+    run_until(done);
+    ASSERT_EQ(nullptr, created);
+    ASSERT_EQ(1u, pdn->get_bearers().size());
+}
+
+TEST_F(gtpc_engine_test, create_bearer_fails_if_session_deleted_meanwhile) {
+    const auto pdn = create_session(1, 100);
+
+    std::shared_ptr<bearer> created;
+    bool done = false;
+    boost::asio::co_spawn(
+        _io,
+        [&]() -> boost::asio::awaitable<void> {
+            created = co_await _engine.create_bearer(pdn->get_cp_teid(), 5, gtpc::qos{.qci = 1});
+            done = true;
+        },
+        boost::asio::detached);
+
+    // Delete Session обгоняет ответ на Create Bearer
+    const auto request = receive();
+    ASSERT_EQ(gtpc::request_accepted, cause_of(*gtpc::parse(exchange(delete_session_request(2, pdn->get_cp_teid())))));
+    answer_create_bearer(request, pdn->get_cp_teid(), gtpc::request_accepted, 300);
+    run_until(done);
+
+    ASSERT_EQ(nullptr, created);
+    ASSERT_EQ(0u, _control_plane.count_sgw_sessions(sgw_addr));
+}
+
+TEST(gtpc_engine_cache_test, cache_is_bounded_for_all_peers) {
+    boost::asio::io_context io;
+    control_plane cp;
+    memory_transport pgw(io.get_executor(), udp::endpoint(pgw_addr, gtpc::port));
+    gtpc_engine engine(cp, pgw, {.control_address = pgw_addr, .user_address = pgw_addr, .max_cached_responses = 4});
+    const auto from = [](uint16_t port) { return udp::endpoint(sgw_addr, port); };
+
+    // Echo с любых адресов не занимает кэш
+    std::array<uint8_t, 64> buffer;
+    for (uint16_t port = 1; port <= 100; ++port) {
+        engine.handle(gtpc::writer(buffer, gtpc::echo_request, std::nullopt, 1).add_recovery(1).finish(), from(port));
+    }
+    ASSERT_EQ(100u, engine.get_statistics().requests);
+
+    // Пятый peer вытесняет ответ первому, и его повтор выполняется заново
+    for (uint16_t port = 1; port <= 5; ++port) {
+        engine.handle(delete_session_request(1, 0), from(port));
+    }
+    ASSERT_EQ(1u, engine.get_statistics().evicted_responses);
+    engine.handle(delete_session_request(1, 0), from(1));
+    ASSERT_EQ(0u, engine.get_statistics().duplicate_requests);
+    engine.handle(delete_session_request(1, 0), from(5));
+    ASSERT_EQ(1u, engine.get_statistics().duplicate_requests);
+}
+
+TEST(gtpc_engine_udp_test, create_session_over_loopback) {
+    boost::asio::io_context io;
+    control_plane cp;
+    cp.add_apn("test.apn", pgw_addr);
+    udp_transport pgw(io.get_executor(), udp::endpoint(pgw_addr, 0));
+    udp_transport sgw(io.get_executor(), udp::endpoint(pgw_addr, 0));
+    gtpc_engine engine(cp, pgw, gtpc_engine::config{.control_address = pgw_addr, .user_address = pgw_addr});
+    boost::asio::co_spawn(io, engine.run(), boost::asio::detached);
+
+    std::vector<uint8_t> response;
+    boost::asio::co_spawn(
+        io,
+        [&]() -> boost::asio::awaitable<void> {
+            const auto request = create_session_request(1, 100, "test.apn");
+            sgw.send(request, pgw.local_endpoint());
+            std::array<uint8_t, gtpc_engine::max_datagram_size> buffer;
+            udp::endpoint from;
+            const auto size = co_await sgw.receive(buffer, from);
+            response.assign(buffer.begin(), buffer.begin() + static_cast<ptrdiff_t>(size));
+        },
+        boost::asio::detached);
+    for (int i = 0; i < 100 && response.empty(); ++i) {
+        io.run_one_for(std::chrono::milliseconds(10));
+    }
+
+    const auto header = gtpc::parse(response);
+    ASSERT_TRUE(header);
+    ASSERT_EQ(gtpc::request_accepted, cause_of(*header));
+    // Адрес SGW в F-TEID, а не адрес, с которого пришел запрос
+    ASSERT_EQ(1u, cp.count_sgw_sessions(sgw_addr));
+}
@@ -0,0 +1,111 @@
+#include <gtpc.h>
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <vector>
+
+namespace {
+    const auto sgw_addr{boost::asio::ip::make_address_v4("127.1.0.1")};
+
+    std::span<const uint8_t> create_session_request(std::span<uint8_t> buffer) {
+        return gtpc::writer(buffer, gtpc::create_session_request, 0, 0x123456)
+            .add_imsi("250011234567890")
+            .add_apn("internet.mnc001.mcc250.gprs")
+            .add_fteid({gtpc::s5_s8_sgw_gtp_c, 100, sgw_addr}, gtpc::instance::sender_f_teid)
+            .begin_group(gtpc::bearer_context)
+            .add_ebi(5)
+            .add_fteid({gtpc::s5_s8_sgw_gtp_u, 200, sgw_addr}, gtpc::instance::s5_s8_u_sgw_f_teid)
+            .end_group()
+            .finish();
+    }
+} // namespace
+
+TEST(gtpc_test, writer_output_parses_back) {
+    std::array<uint8_t, 256> buffer;
+    const auto message = create_session_request(buffer);
+    ASSERT_FALSE(message.empty());
+
+    const auto header = gtpc::parse(message);
+    ASSERT_TRUE(header);
+    ASSERT_EQ(gtpc::create_session_request, header->type);
+    ASSERT_EQ(0u, header->teid);
+    ASSERT_EQ(0x123456u, header->sequence);
+    ASSERT_EQ(message.size(), header->message_size);
+
+    std::array<char, 32> text;
+    const auto imsi = header->ies.find(gtpc::imsi);
+    ASSERT_TRUE(imsi);
+    ASSERT_EQ("250011234567890", gtpc::decode_imsi(imsi->value, text));
+    const auto apn = header->ies.find(gtpc::apn);
+    ASSERT_TRUE(apn);
+    ASSERT_EQ("internet.mnc001.mcc250.gprs", gtpc::decode_apn(apn->value, text));
+
+    const auto sender = gtpc::decode_fteid(header->ies.find(gtpc::f_teid)->value);
+    ASSERT_TRUE(sender);
+    ASSERT_EQ(gtpc::s5_s8_sgw_gtp_c, sender->interface);
+    ASSERT_EQ(100u, sender->teid);
+    ASSERT_EQ(sgw_addr, sender->ipv4);
+
+    const auto context = gtpc::grouped(header->ies.find(gtpc::bearer_context)->value);
+    ASSERT_TRUE(context);
+    ASSERT_EQ(5, gtpc::decode_ebi(context->find(gtpc::ebi)->value));
+    // F-TEID bearer ищется по instance, F-TEID с другим instance не подходит
+    ASSERT_FALSE(context->find(gtpc::f_teid, gtpc::instance::sender_f_teid));
+    const auto user = gtpc::decode_fteid(context->find(gtpc::f_teid, gtpc::instance::s5_s8_u_sgw_f_teid)->value);
+    ASSERT_TRUE(user);
+    ASSERT_EQ(200u, user->teid);
+}
+
+TEST(gtpc_test, truncated_or_foreign_messages_are_rejected) {
+    std::array<uint8_t, 256> buffer;
+    const auto message = create_session_request(buffer);
+
+    for (size_t size = 0; size < message.size(); ++size) {
+        ASSERT_FALSE(gtpc::parse(message.first(size))) << size;
+    }
+
+    // GTPv1 в том же порту
+    std::vector<uint8_t> v1(message.begin(), message.end());
+    v1[0] = 0x30;
+    ASSERT_FALSE(gtpc::parse(v1));
+
+    // Длина IE за пределами сообщения
+    std::vector<uint8_t> broken(message.begin(), message.end());
+    broken[12 + 2] = 0xff;
+    ASSERT_FALSE(gtpc::parse(broken));
+}
+
+TEST(gtpc_test, writer_reports_overflow) {
+    std::array<uint8_t, 32> buffer;
+    ASSERT_TRUE(create_session_request(buffer).empty());
+}
+
+TEST(gtpc_test, echo_has_no_teid) {
+    std::array<uint8_t, 64> buffer;
+    const auto message = gtpc::writer(buffer, gtpc::echo_request, std::nullopt, 7).add_recovery(3).finish();
+    ASSERT_EQ(13u, message.size());
+
+    const auto header = gtpc::parse(message);
+    ASSERT_TRUE(header);
+    ASSERT_FALSE(header->teid);
+    ASSERT_EQ(7u, header->sequence);
+    ASSERT_EQ(3, header->ies.find(gtpc::recovery)->value[0]);
+}
+
+TEST(gtpc_test, bearer_qos_round_trip) {
+    const gtpc::qos qos{1, 9, true, false, 5'000'000'000, 1'000, 256, 0};
+    std::array<uint8_t, 64> buffer;
+    const auto message = gtpc::writer(buffer, gtpc::create_bearer_request, 1, 1).add_bearer_qos(qos).finish();
+
+    const auto decoded = gtpc::decode_bearer_qos(gtpc::parse(message)->ies.find(gtpc::bearer_qos)->value);
+    ASSERT_TRUE(decoded);
+    ASSERT_EQ(qos.qci, decoded->qci);
+    ASSERT_EQ(qos.priority_level, decoded->priority_level);
+    ASSERT_EQ(qos.preemption_capability, decoded->preemption_capability);
+    ASSERT_EQ(qos.preemption_vulnerability, decoded->preemption_vulnerability);
+    ASSERT_EQ(qos.max_uplink, decoded->max_uplink);
+    ASSERT_EQ(qos.max_downlink, decoded->max_downlink);
+    ASSERT_EQ(qos.guaranteed_uplink, decoded->guaranteed_uplink);
+    ASSERT_EQ(qos.guaranteed_downlink, decoded->guaranteed_downlink);
+}
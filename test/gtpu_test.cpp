@@ -0,0 +1,159 @@
+#include <gtpu.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+namespace {
+    const auto local = boost::asio::ip::make_address_v4("192.0.2.1");
+    const auto remote = boost::asio::ip::make_address_v4("192.0.2.2");
+
+    packet_pool make_pool() { return packet_pool({.buffer_count = 8, .buffer_size = 512, .headroom = 128}); }
+
+    // Датаграмма с GTP-U заголовком, собранным вручную, и корректными внешними IPv4/UDP
+    packet_buffer make_datagram(packet_pool &pool, const std::vector<uint8_t> &gtp) {
+        auto datagram = pool.allocate(gtp);
+        auto *udp = datagram.prepend(gtpu::udp_header_size);
+        const auto udp_size = static_cast<uint16_t>(datagram.size());
+        std::fill_n(udp, gtpu::udp_header_size, 0);
+        udp[0] = udp[2] = gtpu::port >> 8;
+        udp[1] = udp[3] = gtpu::port & 0xff;
+        udp[4] = udp_size >> 8;
+        udp[5] = udp_size & 0xff;
+
+        auto *ip = datagram.prepend(gtpu::ipv4_header_size);
+        const auto total_size = static_cast<uint16_t>(datagram.size());
+        std::fill_n(ip, gtpu::ipv4_header_size, 0);
+        ip[0] = 0x45;
+        ip[2] = total_size >> 8;
+        ip[3] = total_size & 0xff;
+        ip[9] = 17;
+        const auto source = remote.to_bytes();
+        std::copy(source.begin(), source.end(), ip + 12);
+        return datagram;
+    }
+} // namespace
+
+TEST(gtpu_test, encapsulation_round_trip_keeps_payload_in_place) {
+    auto pool = make_pool();
+    const std::vector<uint8_t> inner{0x45, 0, 0, 4, 1, 2, 3, 4};
+    auto packet = pool.allocate(inner);
+    const auto *payload = packet.data();
+
+    ASSERT_TRUE(gtpu::encapsulate(packet, {local, remote, 0x12345678, 42}));
+    ASSERT_EQ(gtpu::encapsulation_size + gtpu::optional_fields_size + inner.size(), packet.size());
+
+    // Контрольная сумма внешнего IPv4 заголовка сходится
+    uint32_t sum = 0;
+    for (size_t i = 0; i < gtpu::ipv4_header_size; i += 2) {
+        sum += packet.data()[i] << 8 | packet.data()[i + 1];
+    }
+    ASSERT_EQ(0xffff, (sum & 0xffff) + (sum >> 16));
+
+    const auto header = gtpu::parse(packet.bytes());
+    ASSERT_TRUE(header);
+    EXPECT_EQ(gtpu::g_pdu, header->type);
+    EXPECT_EQ(0x12345678, header->teid);
+    EXPECT_EQ(42, header->sequence);
+    EXPECT_EQ(local, header->peer);
+    EXPECT_EQ(gtpu::port, header->peer_port);
+
+    ASSERT_TRUE(gtpu::decapsulate(packet, *header));
+    EXPECT_EQ(payload, packet.data());
+    EXPECT_EQ(inner, std::vector<uint8_t>(packet.data(), packet.data() + packet.size()));
+}
+
+TEST(gtpu_test, parse_skips_extension_headers) {
+    auto pool = make_pool();
+    // E и S: sequence 7, затем PDU Session Container (одно слово) и UDP Port (одно слово), затем данные
+    auto datagram = make_datagram(pool, {0x36, gtpu::g_pdu, 0, 14, 0, 0, 0, 9,
+                                         0, 7, 0, 0x85,
+                                         1, 0x00, 0x01, 0x40,
+                                         1, 0x08, 0x68, 0x00,
+                                         0xaa, 0xbb});
+
+    const auto header = gtpu::parse(datagram.bytes());
+    ASSERT_TRUE(header);
+    EXPECT_EQ(9, header->teid);
+    EXPECT_EQ(7, header->sequence);
+    ASSERT_TRUE(gtpu::decapsulate(datagram, *header));
+    EXPECT_EQ(std::vector<uint8_t>({0xaa, 0xbb}), std::vector<uint8_t>(datagram.data(), datagram.data() + 2));
+    EXPECT_EQ(2, datagram.size());
+}
+
+TEST(gtpu_test, parse_rejects_malformed_datagrams) {
+    auto pool = make_pool();
+
+    // Неизвестное расширение, обязательное для получателя
+    auto unknown_extension = make_datagram(pool, {0x34, gtpu::g_pdu, 0, 8, 0, 0, 0, 1, 0, 0, 0, 0x83,
+                                                  1, 0, 0, 0});
+    EXPECT_FALSE(gtpu::parse(unknown_extension.bytes()));
+
+    // Расширение нулевой длины
+    auto empty_extension = make_datagram(pool, {0x34, gtpu::g_pdu, 0, 8, 0, 0, 0, 1, 0, 0, 0, 0x85,
+                                                0, 0, 0, 0});
+    EXPECT_FALSE(gtpu::parse(empty_extension.bytes()));
+
+    // Длина GTP-U больше датаграммы
+    auto too_long = make_datagram(pool, {0x30, gtpu::g_pdu, 0, 9, 0, 0, 0, 1, 1, 2, 3, 4});
+    EXPECT_FALSE(gtpu::parse(too_long.bytes()));
+
+    // GTP версии 2
+    auto gtpv2 = make_datagram(pool, {0x48, gtpu::g_pdu, 0, 4, 0, 0, 0, 1, 1, 2, 3, 4});
+    EXPECT_FALSE(gtpu::parse(gtpv2.bytes()));
+
+    // Обрезанный внешний заголовок
+    auto truncated = pool.allocate(std::vector<uint8_t>{0x45, 0, 0, 20});
+    EXPECT_FALSE(gtpu::parse(truncated.bytes()));
+}
+
+TEST(gtpu_test, echo_request_is_answered_in_place) {
+    auto pool = make_pool();
+    auto request = pool.allocate();
+    ASSERT_TRUE(gtpu::encapsulate(request, {remote, local, 0, 1234}, gtpu::echo_request));
+    // Источник запроса - порт SGW; в заголовок UDP он попадает как порт отправителя
+    request.data()[gtpu::ipv4_header_size] = 40000 >> 8;
+    request.data()[gtpu::ipv4_header_size + 1] = 40000 & 0xff;
+
+    const auto header = gtpu::parse(request.bytes());
+    ASSERT_TRUE(header);
+    ASSERT_EQ(gtpu::echo_request, header->type);
+    ASSERT_TRUE(gtpu::make_echo_response(request, *header, local));
+
+    // Ответ уходит на порт, с которого пришел запрос
+    auto *udp = request.data() + gtpu::ipv4_header_size;
+    EXPECT_EQ(40000, udp[2] << 8 | udp[3]);
+    udp[2] = gtpu::port >> 8;
+    udp[3] = gtpu::port & 0xff;
+
+    const auto response = gtpu::parse(request.bytes());
+    ASSERT_TRUE(response);
+    EXPECT_EQ(gtpu::echo_response, response->type);
+    EXPECT_EQ(1234, response->sequence);
+    EXPECT_EQ(0, response->teid);
+    EXPECT_EQ(local, response->peer);
+
+    // Recovery IE со счетчиком 0
+    ASSERT_EQ(2, response->payload_size);
+    EXPECT_EQ(14, request.data()[response->payload_offset]);
+    EXPECT_EQ(0, request.data()[response->payload_offset + 1]);
+}
+
+TEST(gtpu_test, socket_headers_round_trip) {
+    auto pool = make_pool();
+    const std::vector<uint8_t> gtp{0x30, gtpu::g_pdu, 0, 1, 0, 0, 0, 7, 0xaa};
+    auto datagram = pool.allocate(gtp);
+
+    ASSERT_TRUE(gtpu::prepend_ip_udp(datagram, {remote, 40000}, {local, gtpu::port}));
+    const auto header = gtpu::parse(datagram.bytes());
+    ASSERT_TRUE(header);
+    ASSERT_EQ(remote, header->peer);
+    ASSERT_EQ(40000, header->peer_port);
+    ASSERT_EQ(7u, header->teid);
+
+    const auto destination = gtpu::strip_ip_udp(datagram);
+    ASSERT_TRUE(destination);
+    ASSERT_EQ(local, destination->address);
+    ASSERT_EQ(gtpu::port, destination->port);
+    ASSERT_TRUE(std::equal(gtp.begin(), gtp.end(), datagram.data(), datagram.data() + datagram.size()));
+}
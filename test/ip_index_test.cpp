@@ -0,0 +1,90 @@
+#include <ip_index.h>
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+using boost::asio::ip::make_address_v4;
+using boost::asio::ip::make_network_v4;
+
+namespace {
+    uint32_t ip(const char *address) { return make_address_v4(address).to_uint(); }
+} // namespace
+
+TEST(ip_index_test, finds_inserted_addresses) {
+    ip_index index;
+    index.add_range(make_network_v4("10.0.0.0/8"));
+
+    index.insert_or_assign(ip("10.0.0.1"), 1);
+    index.insert_or_assign(ip("10.255.255.255"), 2);
+
+    ASSERT_EQ(1u, index.find(ip("10.0.0.1")));
+    ASSERT_EQ(2u, index.find(ip("10.255.255.255")));
+    ASSERT_EQ(0u, index.find(ip("10.0.0.2")));
+    ASSERT_EQ(0u, index.find(ip("11.0.0.1")));
+    ASSERT_EQ(0u, index.find(ip("0.0.0.0")));
+    ASSERT_EQ(0u, index.find(ip("255.255.255.255")));
+    ASSERT_EQ(2u, index.size());
+}
+
+TEST(ip_index_test, assign_and_erase) {
+    ip_index index;
+    index.add_range(make_network_v4("10.0.0.0/8"));
+
+    index.insert_or_assign(ip("10.1.2.3"), 5);
+    index.insert_or_assign(ip("10.1.2.3"), 6);
+    ASSERT_EQ(6u, index.find(ip("10.1.2.3")));
+    ASSERT_EQ(1u, index.size());
+
+    ASSERT_TRUE(index.erase(ip("10.1.2.3")));
+    ASSERT_FALSE(index.erase(ip("10.1.2.3")));
+    ASSERT_FALSE(index.erase(ip("192.168.0.1")));
+    ASSERT_EQ(0u, index.find(ip("10.1.2.3")));
+    ASSERT_EQ(0u, index.size());
+}
+
+TEST(ip_index_test, separate_and_nested_ranges) {
+    ip_index index;
+    // Пул APN внутри общего пула, как в control_plane, и пулы меньше /24 в одной /24
+    index.add_range(make_network_v4("10.1.0.0/16"));
+    index.add_range(make_network_v4("10.0.0.0/8"));
+    index.add_range(make_network_v4("172.16.0.0/28"));
+    index.add_range(make_network_v4("172.16.0.64/26"));
+
+    const uint32_t addresses[]{ip("10.1.0.1"), ip("10.2.0.1"), ip("172.16.0.1"), ip("172.16.0.65")};
+    for (uint32_t i = 0; i < std::size(addresses); ++i) {
+        index.insert_or_assign(addresses[i], i + 1);
+    }
+    for (uint32_t i = 0; i < std::size(addresses); ++i) {
+        ASSERT_EQ(i + 1, index.find(addresses[i]));
+    }
+}
+
+TEST(ip_index_test, address_outside_ranges_gets_own_block) {
+    ip_index index;
+    index.insert_or_assign(ip("192.168.1.10"), 7);
+
+    ASSERT_EQ(7u, index.find(ip("192.168.1.10")));
+    ASSERT_EQ(0u, index.find(ip("192.168.1.11")));
+    ASSERT_EQ(0u, index.find(ip("192.168.2.10")));
+}
+
+TEST(ip_index_test, batch_find_matches_single) {
+    ip_index index;
+    index.add_range(make_network_v4("10.0.0.0/8"));
+    std::vector<uint32_t> addresses;
+    for (uint32_t i = 0; i < 100; ++i) {
+        const auto address = ip("10.0.0.0") + i * 7919;
+        if (i % 3) {
+            index.insert_or_assign(address, i + 1);
+        }
+        addresses.push_back(address);
+    }
+    addresses.push_back(ip("8.8.8.8"));
+
+    std::vector<uint32_t> values(addresses.size());
+    index.find(addresses, values);
+    for (size_t i = 0; i < addresses.size(); ++i) {
+        ASSERT_EQ(index.find(addresses[i]), values[i]) << i;
+    }
+}
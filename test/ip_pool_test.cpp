@@ -0,0 +1,111 @@
+#include <ip_pool.h>
+
+#include <gtest/gtest.h>
+
+#include <set>
+#include <vector>
+
+using boost::asio::ip::make_address_v4;
+using boost::asio::ip::make_network_v4;
+
+TEST(ip_pool_test, allocates_lowest_free_host_address) {
+    ip_pool pool({make_network_v4("192.168.0.0/24"), {make_network_v4("192.168.0.1/32")}});
+    ASSERT_EQ(253, pool.capacity());
+
+    ASSERT_EQ(make_address_v4("192.168.0.2"), pool.allocate());
+    ASSERT_EQ(make_address_v4("192.168.0.3"), pool.allocate());
+    ASSERT_TRUE(pool.release(make_address_v4("192.168.0.2")));
+    ASSERT_FALSE(pool.release(make_address_v4("192.168.0.2")));
+    ASSERT_FALSE(pool.release(make_address_v4("192.168.1.2")));
+    ASSERT_EQ(make_address_v4("192.168.0.2"), pool.allocate());
+    ASSERT_EQ(251, pool.available());
+}
+
+TEST(ip_pool_test, exhausts_and_refills) {
+    ip_pool pool({make_network_v4("10.0.0.0/20"), {make_network_v4("10.0.8.0/22")}});
+    const auto capacity = pool.capacity();
+    ASSERT_EQ(4096 - 1024 - 2, capacity);
+
+    std::set<boost::asio::ip::address_v4> allocated;
+    while (auto ip = pool.allocate()) {
+        ASSERT_TRUE(pool.contains(*ip));
+        ASSERT_NE(make_address_v4("10.0.8.0").to_uint(), ip->to_uint() & 0xfffffc00);
+        ASSERT_TRUE(allocated.insert(*ip).second);
+    }
+    ASSERT_EQ(capacity, allocated.size());
+    ASSERT_EQ(0, pool.available());
+
+    // Освобожденный адрес сразу доступен снова при полном пуле
+    ASSERT_TRUE(pool.release(make_address_v4("10.0.12.34")));
+    ASSERT_EQ(make_address_v4("10.0.12.34"), pool.allocate());
+
+    for (const auto &ip : allocated) {
+        ASSERT_TRUE(pool.release(ip));
+    }
+    ASSERT_EQ(capacity, pool.available());
+}
+
+TEST(ip_pool_test, detects_overlapping_networks) {
+    ip_pool pool({make_network_v4("10.1.0.0/16"), {}});
+    ASSERT_TRUE(pool.overlaps(make_network_v4("10.0.0.0/8")));
+    ASSERT_TRUE(pool.overlaps(make_network_v4("10.1.2.0/24")));
+    ASSERT_FALSE(pool.overlaps(make_network_v4("10.2.0.0/16")));
+}
+
+TEST(ip_pool_test, excluded_network_is_no_longer_allocated) {
+    ip_pool pool({make_network_v4("10.0.0.0/22"), {make_network_v4("10.0.1.0/25")}});
+    const auto capacity = pool.capacity();
+    ASSERT_EQ(make_address_v4("10.0.0.1"), pool.allocate());
+
+    // Выданный адрес не дает исключить подсеть
+    ASSERT_FALSE(pool.exclude(make_network_v4("10.0.0.0/24")));
+    ASSERT_EQ(capacity - 1, pool.available());
+
+    // Уже исключенные адреса и адрес сети не мешают
+    ASSERT_TRUE(pool.exclude(make_network_v4("10.0.1.0/24")));
+    ASSERT_TRUE(pool.exclude(make_network_v4("10.0.3.0/24")));
+    ASSERT_EQ(capacity - 128 - 255, pool.capacity());
+    ASSERT_FALSE(pool.take(make_address_v4("10.0.1.200")));
+
+    ASSERT_TRUE(pool.release(make_address_v4("10.0.0.1")));
+    ASSERT_TRUE(pool.exclude(make_network_v4("10.0.0.0/24")));
+    ASSERT_EQ(make_address_v4("10.0.2.0"), pool.allocate());
+}
+
+TEST(ip_pool_test, excluded_addresses_cannot_be_released) {
+    ip_pool pool({make_network_v4("10.0.0.0/24"), {make_network_v4("10.0.0.128/25")}});
+    ASSERT_TRUE(pool.exclude(make_network_v4("10.0.0.64/26")));
+    const auto available = pool.available();
+
+    // Адреса сети и broadcast, исключенные в конфиге и через exclude
+    for (const auto *address : {"10.0.0.0", "10.0.0.255", "10.0.0.200", "10.0.0.64", "10.0.0.100"}) {
+        ASSERT_FALSE(pool.release(make_address_v4(address))) << address;
+    }
+    ASSERT_EQ(available, pool.available());
+    ASSERT_EQ(make_address_v4("10.0.0.1"), pool.allocate());
+}
+
+TEST(ip_pool_test, block_allocation_takes_lowest_free_addresses) {
+    ip_pool pool({make_network_v4("10.0.0.0/16"), {make_network_v4("10.0.0.64/26")}});
+    ASSERT_TRUE(pool.take(make_address_v4("10.0.0.3")));
+
+    // Блок переходит через исключенную подсеть и границы слов битовой карты
+    std::vector<boost::asio::ip::address_v4> block(200);
+    ASSERT_EQ(200, pool.allocate(block));
+    ASSERT_EQ(make_address_v4("10.0.0.1"), block[0]);
+    ASSERT_EQ(make_address_v4("10.0.0.2"), block[1]);
+    ASSERT_EQ(make_address_v4("10.0.0.4"), block[2]);
+    ASSERT_EQ(make_address_v4("10.0.0.63"), block[61]);
+    ASSERT_EQ(make_address_v4("10.0.0.128"), block[62]);
+    ASSERT_EQ(make_address_v4("10.0.1.9"), block[199]);
+    ASSERT_EQ(make_address_v4("10.0.1.10"), pool.allocate());
+
+    // Остаток пула выдается до конца, верхние уровни карты сходятся с нижним
+    std::vector<boost::asio::ip::address_v4> rest(pool.available() + 10);
+    ASSERT_EQ(rest.size() - 10, pool.allocate(rest));
+    ASSERT_EQ(0, pool.available());
+    ASSERT_FALSE(pool.allocate());
+    ASSERT_TRUE(pool.release(make_address_v4("10.0.200.1")));
+    ASSERT_EQ(1, pool.allocate(block));
+    ASSERT_EQ(make_address_v4("10.0.200.1"), block[0]);
+}
@@ -0,0 +1,97 @@
+#include <control_plane.h>
+#include <latency.h>
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+TEST(latency_test, buckets_are_log_linear) {
+    using latency::histogram;
+
+    for (uint64_t value = 0; value < 64; ++value) {
+        ASSERT_EQ(value, histogram::bucket_of(value));
+        ASSERT_EQ(value, histogram::lowest_value(value));
+    }
+    ASSERT_EQ(histogram::bucket_count - 1, histogram::bucket_of(UINT64_MAX));
+
+    std::mt19937_64 random(1);
+    for (int i = 0; i < 100000; ++i) {
+        const auto value = random() >> (random() % 64);
+        const auto bucket = histogram::bucket_of(value);
+        const auto lowest = histogram::lowest_value(bucket);
+        ASSERT_LE(lowest, value);
+        ASSERT_LE(value - lowest, lowest / 32);
+        if (bucket + 1 < histogram::bucket_count) {
+            ASSERT_GT(histogram::lowest_value(bucket + 1), value);
+        }
+    }
+}
+
+TEST(latency_test, percentiles_within_precision) {
+    latency::histogram h;
+    ASSERT_EQ(0, h.percentile(50));
+
+    for (uint64_t value = 1; value <= 100000; ++value) {
+        h.record(value);
+    }
+    ASSERT_EQ(100000, h.count());
+    ASSERT_EQ(100000, h.max());
+    EXPECT_NEAR(50000, h.percentile(50), 50000 / 32);
+    EXPECT_NEAR(99000, h.percentile(99), 99000 / 32);
+    EXPECT_NEAR(99900, h.percentile(99.9), 99900 / 32);
+    EXPECT_EQ(100000, h.percentile(100));
+
+    // Редкий выброс виден в максимуме и хвосте, но не в медиане
+    h.record(10'000'000, 200);
+    EXPECT_NEAR(50100, h.percentile(50), 50100 / 32);
+    EXPECT_EQ(10'000'000, h.percentile(99.9));
+    EXPECT_EQ(10'000'000, h.max());
+}
+
+TEST(latency_test, merges_histograms_of_all_threads) {
+    const auto before = latency::merged(latency::delete_bearer).count();
+
+    std::vector<std::thread> threads;
+    for (uint64_t t = 1; t <= 4; ++t) {
+        threads.emplace_back([t] {
+            for (uint64_t i = 0; i < 1000; ++i) {
+                latency::record(latency::delete_bearer, t * 1000);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    // Потоки завершились, а их замеры остались
+    const auto merged = latency::merged(latency::delete_bearer);
+    ASSERT_EQ(before + 4000, merged.count());
+    EXPECT_LE(4000, merged.max());
+
+    // Новый поток продолжает гистограммы завершившегося, а не заводит свои
+    std::thread([] { latency::record(latency::delete_bearer, 1); }).join();
+    EXPECT_EQ(before + 4001, latency::merged(latency::delete_bearer).count());
+}
+
+TEST(latency_test, operations_are_timed_only_when_enabled) {
+    control_plane cp;
+    cp.add_apn("test.apn", boost::asio::ip::make_address_v4("127.0.0.1"));
+    const auto before = latency::merged(latency::create_pdn_connection).count();
+
+    auto pdn = cp.create_pdn_connection("test.apn", boost::asio::ip::make_address_v4("127.1.0.1"), 1);
+    ASSERT_NE(nullptr, pdn);
+    EXPECT_EQ(before + (latency::enabled ? 1 : 0), latency::merged(latency::create_pdn_connection).count());
+}
+
+TEST(latency_test, dump_lists_recorded_operations) {
+    latency::record(latency::uplink, 1000);
+
+    std::ostringstream out;
+    latency::dump(out);
+    const auto text = out.str();
+    EXPECT_NE(std::string::npos, text.find("p99.9_ns"));
+    EXPECT_NE(std::string::npos, text.find("uplink"));
+}
@@ -0,0 +1,72 @@
+#include <object_arena.h>
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <set>
+#include <thread>
+#include <vector>
+
+TEST(object_arena_test, reuses_freed_blocks_of_same_size) {
+    object_arena arena;
+    auto *small = arena.allocate(100);
+    auto *other = arena.allocate(100);
+    auto *large = arena.allocate(300);
+    EXPECT_EQ(0, reinterpret_cast<uintptr_t>(small) % object_arena::block_alignment);
+    EXPECT_EQ(0, reinterpret_cast<uintptr_t>(large) % object_arena::block_alignment);
+
+    arena.deallocate(small, 100);
+    EXPECT_EQ(small, arena.allocate(128));
+    EXPECT_NE(large, arena.allocate(300));
+
+    // Больше max_block_size - обычная куча
+    auto *huge = arena.allocate(object_arena::max_block_size + 1);
+    arena.deallocate(huge, object_arena::max_block_size + 1);
+    arena.deallocate(other, 100);
+}
+
+TEST(object_arena_test, blocks_freed_by_other_threads_come_back) {
+    object_arena arena;
+    std::vector<void *> blocks;
+    for (int i = 0; i < 10000; ++i) {
+        blocks.push_back(arena.allocate(64));
+    }
+    const std::set<void *> allocated(blocks.begin(), blocks.end());
+    ASSERT_EQ(blocks.size(), allocated.size());
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t] {
+            for (size_t i = t; i < blocks.size(); i += 4) {
+                arena.deallocate(blocks[i], 64);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    // Все освобожденные блоки выдаются снова, новых не нарезается
+    std::set<void *> reused;
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        reused.insert(arena.allocate(64));
+    }
+    EXPECT_EQ(allocated, reused);
+}
+
+TEST(object_arena_test, objects_keep_arena_alive) {
+    struct counted : std::enable_shared_from_this<counted> {
+        int value = 42;
+    };
+
+    auto arena = std::make_shared<object_arena>();
+    auto object = std::allocate_shared<counted>(object_arena::allocator<counted>(arena));
+    std::weak_ptr<object_arena> weak = arena;
+    arena.reset();
+
+    EXPECT_FALSE(weak.expired());
+    EXPECT_EQ(object, object->shared_from_this());
+    EXPECT_EQ(42, object->value);
+    object.reset();
+    EXPECT_TRUE(weak.expired());
+}
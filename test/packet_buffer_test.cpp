@@ -0,0 +1,75 @@
+#include <packet_buffer.h>
+
+#include <gtest/gtest.h>
+
+#include <thread>
+
+TEST(packet_buffer_test, allocate_reserves_headroom) {
+    packet_pool pool({.buffer_count = 4, .buffer_size = 256, .headroom = 64, .tailroom = 16});
+    const std::vector<uint8_t> payload{1, 2, 3};
+
+    auto packet = pool.allocate(payload);
+    ASSERT_TRUE(packet);
+    ASSERT_EQ(3, packet.size());
+    ASSERT_EQ(64, packet.headroom());
+    ASSERT_EQ(256 - 64 - 3, packet.tailroom());
+    ASSERT_TRUE(std::equal(payload.begin(), payload.end(), packet.data()));
+
+    ASSERT_FALSE(pool.allocate(std::vector<uint8_t>(pool.max_data_size() + 1)));
+
+    auto empty = pool.allocate(std::span<const uint8_t>{});
+    ASSERT_TRUE(empty);
+    ASSERT_EQ(0, empty.size());
+    ASSERT_EQ(64, empty.headroom());
+}
+
+TEST(packet_buffer_test, prepend_and_trim_do_not_move_payload) {
+    packet_pool pool({.buffer_count = 1, .buffer_size = 256, .headroom = 64});
+    auto packet = pool.allocate(std::vector<uint8_t>{7, 8, 9});
+    auto *payload = packet.data();
+
+    auto *header = packet.prepend(8);
+    ASSERT_EQ(payload - 8, header);
+    ASSERT_EQ(11, packet.size());
+    ASSERT_EQ(nullptr, packet.prepend(57));
+
+    ASSERT_TRUE(packet.trim_front(8));
+    ASSERT_EQ(payload, packet.data());
+    ASSERT_TRUE(packet.trim_back(1));
+    ASSERT_EQ(2, packet.size());
+    ASSERT_FALSE(packet.trim_back(3));
+}
+
+TEST(packet_buffer_test, buffers_return_to_pool) {
+    packet_pool pool({.buffer_count = 2, .buffer_size = 128, .headroom = 0});
+
+    auto first = pool.allocate();
+    auto second = pool.allocate();
+    ASSERT_TRUE(first);
+    ASSERT_TRUE(second);
+    ASSERT_FALSE(pool.allocate());
+
+    auto moved = std::move(first);
+    ASSERT_FALSE(first);
+    moved.reset();
+    ASSERT_TRUE(pool.allocate());
+}
+
+TEST(packet_buffer_test, buffers_freed_by_other_thread_are_reused) {
+    packet_pool pool({.buffer_count = packet_pool::thread_cache_size * 2, .buffer_size = 128, .headroom = 0});
+
+    std::vector<packet_buffer> packets;
+    while (auto packet = pool.allocate()) {
+        packets.emplace_back(std::move(packet));
+    }
+    ASSERT_EQ(pool.buffer_count(), packets.size());
+
+    std::thread([&packets] { packets.clear(); }).join();
+
+    size_t reallocated = 0;
+    while (auto packet = pool.allocate()) {
+        packets.emplace_back(std::move(packet));
+        ++reallocated;
+    }
+    ASSERT_EQ(pool.buffer_count(), reallocated);
+}
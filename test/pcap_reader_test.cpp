@@ -0,0 +1,267 @@
+#include <pcap_reader.h>
+
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <bit>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace {
+    struct temp_path {
+        temp_path() {
+            auto pattern = (std::filesystem::temp_directory_path() / "pcap_reader_test.XXXXXX").string();
+            const auto fd = ::mkstemp(pattern.data());
+            ::close(fd);
+            path = pattern;
+        }
+        ~temp_path() { std::filesystem::remove(path); }
+
+        std::string path;
+    };
+
+    // resize и copy вместо insert: на insert в конец вектора GCC 12 с -O2 ложно срабатывает
+    // -Warray-bounds и -Wstringop-overflow
+    void append(std::vector<uint8_t> &bytes, std::span<const uint8_t> data) {
+        const auto offset = bytes.size();
+        bytes.resize(offset + data.size());
+        std::copy(data.begin(), data.end(), bytes.begin() + static_cast<ptrdiff_t>(offset));
+    }
+
+    // Файл захвата в заданном порядке байт
+    struct capture {
+        explicit capture(bool big_endian) : big_endian(big_endian) {}
+
+        void add16(uint16_t value) {
+            value = big_endian ? std::byteswap(value) : value;
+            append(bytes, {reinterpret_cast<const uint8_t *>(&value), sizeof(value)});
+        }
+        void add32(uint32_t value) {
+            value = big_endian ? std::byteswap(value) : value;
+            append(bytes, {reinterpret_cast<const uint8_t *>(&value), sizeof(value)});
+        }
+        void add(std::span<const uint8_t> data) {
+            append(bytes, data);
+            bytes.resize((bytes.size() + 3) & ~size_t{3});
+        }
+
+        void write(const std::string &path) const {
+            std::ofstream(path, std::ios::binary)
+                .write(reinterpret_cast<const char *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+        }
+
+        bool big_endian;
+        std::vector<uint8_t> bytes;
+    };
+
+    std::vector<uint8_t> make_ipv4(uint16_t total_length) {
+        std::vector<uint8_t> packet(total_length, 0);
+        packet[0] = 0x45;
+        packet[2] = static_cast<uint8_t>(total_length >> 8);
+        packet[3] = static_cast<uint8_t>(total_length);
+        packet[9] = 17;
+        return packet;
+    }
+
+    // Ethernet с тегом VLAN и добивкой до 60 байт
+    std::vector<uint8_t> make_ethernet(const std::vector<uint8_t> &ip) {
+        constexpr uint8_t tag[]{0x81, 0x00, 0x00, 0x0a, 0x08, 0x00};
+        std::vector<uint8_t> frame(std::max<size_t>(12 + sizeof(tag) + ip.size(), 60), 0);
+        std::fill_n(frame.begin(), 12, 0xee);
+        std::copy(std::begin(tag), std::end(tag), frame.begin() + 12);
+        std::copy(ip.begin(), ip.end(), frame.begin() + 12 + sizeof(tag));
+        return frame;
+    }
+
+    void add_pcap_record(capture &file, uint32_t seconds, uint32_t fraction, std::span<const uint8_t> data) {
+        file.add32(seconds);
+        file.add32(fraction);
+        file.add32(static_cast<uint32_t>(data.size()));
+        file.add32(static_cast<uint32_t>(data.size()));
+        append(file.bytes, data);
+    }
+} // namespace
+
+TEST(pcap_reader_test, pcap_microseconds_ethernet_with_vlan) {
+    const temp_path path;
+    capture file(false);
+    file.add32(0xa1b2c3d4);
+    file.add16(2);
+    file.add16(4);
+    file.add32(0);
+    file.add32(0);
+    file.add32(65535);
+    file.add32(pcap_reader::ethernet);
+    const auto ip = make_ipv4(28);
+    const auto frame = make_ethernet(ip);
+    add_pcap_record(file, 10, 250, frame);
+    add_pcap_record(file, 11, 0, frame);
+    file.write(path.path);
+
+    pcap_reader reader(path.path);
+    const auto first = reader.next();
+    ASSERT_TRUE(first);
+    ASSERT_EQ(std::chrono::seconds(10) + std::chrono::microseconds(250), first->timestamp);
+    ASSERT_EQ(frame.size(), first->data.size());
+    const auto packet = pcap_reader::ipv4_packet(*first);
+    ASSERT_TRUE(packet);
+    // Без заголовка Ethernet, тега VLAN и добивки
+    ASSERT_TRUE(std::ranges::equal(ip, *packet));
+
+    ASSERT_TRUE(reader.next());
+    ASSERT_FALSE(reader.next());
+    ASSERT_EQ(reader.size(), reader.position());
+}
+
+TEST(pcap_reader_test, pcap_nanoseconds_big_endian_raw) {
+    const temp_path path;
+    capture file(true);
+    file.add32(0xa1b23c4d);
+    file.add16(2);
+    file.add16(4);
+    file.add32(0);
+    file.add32(0);
+    file.add32(65535);
+    file.add32(pcap_reader::raw);
+    const auto ip = make_ipv4(40);
+    add_pcap_record(file, 1, 123456789, ip);
+    file.write(path.path);
+
+    pcap_reader reader(path.path);
+    const auto record = reader.next();
+    ASSERT_TRUE(record);
+    ASSERT_EQ(std::chrono::nanoseconds(1'123'456'789), record->timestamp);
+    ASSERT_TRUE(std::ranges::equal(ip, *pcap_reader::ipv4_packet(*record)));
+}
+
+TEST(pcap_reader_test, pcapng_interfaces_and_blocks) {
+    for (const bool big_endian : {false, true}) {
+        const temp_path path;
+        capture file(big_endian);
+        // SHB
+        file.add32(0x0a0d0d0a);
+        file.add32(28);
+        file.add32(0x1a2b3c4d);
+        file.add16(1);
+        file.add16(0);
+        file.add32(UINT32_MAX);
+        file.add32(UINT32_MAX);
+        file.add32(28);
+        // IDB 0: Ethernet, микросекунды по умолчанию
+        file.add32(1);
+        file.add32(20);
+        file.add16(pcap_reader::ethernet);
+        file.add16(0);
+        file.add32(65535);
+        file.add32(20);
+        // IDB 1: raw IP, if_tsresol = 9
+        file.add32(1);
+        file.add32(32);
+        file.add16(pcap_reader::raw);
+        file.add16(0);
+        file.add32(65535);
+        file.add16(9);
+        file.add16(1);
+        file.add(std::array<uint8_t, 1>{9});
+        file.add16(0);
+        file.add16(0);
+        file.add32(32);
+        // Неизвестный блок пропускается
+        file.add32(0x0bad);
+        file.add32(16);
+        file.add32(0);
+        file.add32(16);
+
+        const auto ip = make_ipv4(33);
+        const auto frame = make_ethernet(ip);
+        const auto epb = [&](uint32_t interface, uint64_t time, std::span<const uint8_t> data) {
+            const auto length = static_cast<uint32_t>(32 + ((data.size() + 3) & ~size_t{3}));
+            file.add32(6);
+            file.add32(length);
+            file.add32(interface);
+            file.add32(static_cast<uint32_t>(time >> 32));
+            file.add32(static_cast<uint32_t>(time));
+            file.add32(static_cast<uint32_t>(data.size()));
+            file.add32(static_cast<uint32_t>(data.size()));
+            file.add(data);
+            file.add32(length);
+        };
+        epb(0, 5'000'001, frame);
+        epb(1, 7'000'000'002, ip);
+        // SPB - от первого интерфейса, время предыдущей записи
+        const auto spb_length = static_cast<uint32_t>(16 + ((frame.size() + 3) & ~size_t{3}));
+        file.add32(3);
+        file.add32(spb_length);
+        file.add32(static_cast<uint32_t>(frame.size()));
+        file.add(frame);
+        file.add32(spb_length);
+        file.write(path.path);
+
+        pcap_reader reader(path.path);
+        const auto first = reader.next();
+        ASSERT_TRUE(first) << big_endian;
+        ASSERT_EQ(std::chrono::microseconds(5'000'001), first->timestamp);
+        ASSERT_TRUE(std::ranges::equal(ip, *pcap_reader::ipv4_packet(*first)));
+
+        const auto second = reader.next();
+        ASSERT_TRUE(second);
+        ASSERT_EQ(uint32_t{pcap_reader::raw}, second->link_type);
+        ASSERT_EQ(std::chrono::nanoseconds(7'000'000'002), second->timestamp);
+        ASSERT_TRUE(std::ranges::equal(ip, *pcap_reader::ipv4_packet(*second)));
+
+        const auto third = reader.next();
+        ASSERT_TRUE(third);
+        ASSERT_EQ(uint32_t{pcap_reader::ethernet}, third->link_type);
+        ASSERT_EQ(second->timestamp, third->timestamp);
+        ASSERT_FALSE(reader.next());
+    }
+}
+
+TEST(pcap_reader_test, truncated_tail_ends_capture) {
+    const temp_path path;
+    capture file(false);
+    file.add32(0xa1b2c3d4);
+    file.add16(2);
+    file.add16(4);
+    file.add32(0);
+    file.add32(0);
+    file.add32(65535);
+    file.add32(pcap_reader::raw);
+    const auto ip = make_ipv4(40);
+    add_pcap_record(file, 1, 0, ip);
+    add_pcap_record(file, 2, 0, ip);
+    file.bytes.resize(file.bytes.size() - 1);
+    file.write(path.path);
+
+    pcap_reader reader(path.path);
+    ASSERT_TRUE(reader.next());
+    ASSERT_FALSE(reader.next());
+}
+
+TEST(pcap_reader_test, non_ipv4_is_rejected) {
+    pcap_reader::record record;
+    record.link_type = pcap_reader::ethernet;
+    std::vector<uint8_t> arp(60, 0);
+    arp[12] = 0x08;
+    arp[13] = 0x06;
+    record.data = arp;
+    ASSERT_FALSE(pcap_reader::ipv4_packet(record));
+
+    const auto ip = make_ipv4(40);
+    record.link_type = 12345;
+    record.data = ip;
+    ASSERT_FALSE(pcap_reader::ipv4_packet(record));
+}
+
+TEST(pcap_reader_test, bad_files_throw) {
+    ASSERT_THROW(pcap_reader("/nonexistent/capture.pcap"), std::system_error);
+
+    const temp_path path;
+    capture file(false);
+    file.bytes.assign(64, 0x42);
+    file.write(path.path);
+    ASSERT_THROW(pcap_reader reader(path.path), std::runtime_error);
+}
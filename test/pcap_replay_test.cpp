@@ -0,0 +1,204 @@
+#include <pcap_replay.h>
+
+#include <gtpu.h>
+
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+using boost::asio::ip::make_address_v4;
+
+namespace {
+    const auto sgw_addr{make_address_v4("192.168.10.1")};
+    const auto pgw_addr{make_address_v4("192.168.10.2")};
+    const auto captured_ue{make_address_v4("100.64.0.5")};
+    const auto server{make_address_v4("198.51.100.7")};
+    constexpr uint32_t captured_teid = 0x1111;
+
+    struct temp_path {
+        temp_path() {
+            auto pattern = (std::filesystem::temp_directory_path() / "pcap_replay_test.XXXXXX").string();
+            const auto fd = ::mkstemp(pattern.data());
+            ::close(fd);
+            path = pattern;
+        }
+        ~temp_path() { std::filesystem::remove(path); }
+
+        std::string path;
+    };
+
+    class recording_data_plane : public data_plane {
+    public:
+        using data_plane::data_plane;
+
+        std::vector<std::pair<boost::asio::ip::address_v4, Packet>> _to_sgw;
+        std::vector<Packet> _to_apn;
+
+    protected:
+        void forward_packet_to_sgw(boost::asio::ip::address_v4, uint32_t, Packet &&) override {}
+        void forward_packet_to_apn(boost::asio::ip::address_v4, Packet &&packet) override {
+            _to_apn.push_back(std::move(packet));
+        }
+        // Downlink уходит отсюда уже в GTP-U; в записи - внутренний пакет
+        void send_gtpu(boost::asio::ip::address_v4 peer, packet_buffer &&datagram) override {
+            const auto header = gtpu::parse(datagram.bytes());
+            ASSERT_TRUE(header);
+            const auto inner = datagram.bytes().subspan(header->payload_offset, header->payload_size);
+            _to_sgw.emplace_back(peer, Packet(inner.begin(), inner.end()));
+        }
+    };
+
+    std::vector<uint8_t> make_ip(boost::asio::ip::address_v4 src, boost::asio::ip::address_v4 dst) {
+        std::vector<uint8_t> packet(48, 0);
+        packet[0] = 0x45;
+        packet[3] = static_cast<uint8_t>(packet.size());
+        packet[9] = 6;
+        const auto src_bytes = src.to_bytes();
+        const auto dst_bytes = dst.to_bytes();
+        std::copy(src_bytes.begin(), src_bytes.end(), packet.begin() + 12);
+        std::copy(dst_bytes.begin(), dst_bytes.end(), packet.begin() + 16);
+        return packet;
+    }
+
+    // Классический pcap с raw IPv4, записи через 1 мс
+    class capture_file {
+    public:
+        capture_file() {
+            const uint32_t header[]{0xa1b2c3d4, 0x00040002, 0, 0, 65535, pcap_reader::raw};
+            append(header);
+        }
+
+        void add(std::span<const uint8_t> packet) {
+            const uint32_t header[]{1, _records++ * 1000, static_cast<uint32_t>(packet.size()),
+                                    static_cast<uint32_t>(packet.size())};
+            append(header);
+            append_bytes(packet);
+        }
+
+        void add_gtpu(boost::asio::ip::address_v4 from, boost::asio::ip::address_v4 to, uint32_t teid,
+                      std::span<const uint8_t> inner) {
+            auto buffer = _pool.allocate(inner);
+            gtpu::encapsulate(buffer, {from, to, teid});
+            add(buffer.bytes());
+        }
+
+        void write(const std::string &path) const {
+            std::ofstream(path, std::ios::binary)
+                .write(reinterpret_cast<const char *>(_bytes.data()), static_cast<std::streamsize>(_bytes.size()));
+        }
+
+    private:
+        void append(std::span<const uint32_t> words) {
+            append_bytes({reinterpret_cast<const uint8_t *>(words.data()), words.size_bytes()});
+        }
+
+        // resize и copy вместо insert: на insert в конец вектора GCC 12 с -O2 ложно срабатывает
+        // -Warray-bounds и -Wstringop-overflow
+        void append_bytes(std::span<const uint8_t> data) {
+            const auto offset = _bytes.size();
+            _bytes.resize(offset + data.size());
+            std::copy(data.begin(), data.end(), _bytes.begin() + static_cast<ptrdiff_t>(offset));
+        }
+
+        packet_pool _pool{{.buffer_count = 4}};
+        std::vector<uint8_t> _bytes;
+        uint32_t _records = 0;
+    };
+} // namespace
+
+class pcap_replay_test : public ::testing::Test {
+public:
+    pcap_replay_test() { _control_plane.add_apn("replay", make_address_v4("192.0.2.1")); }
+
+    // Uplink G-PDU, его декапсулированная копия на SGi, ответ сервера и он же в туннеле к SGW
+    void write_exchange() {
+        const auto uplink = make_ip(captured_ue, server);
+        const auto downlink = make_ip(server, captured_ue);
+        _capture.add_gtpu(sgw_addr, pgw_addr, captured_teid, uplink);
+        _capture.add(uplink);
+        _capture.add(downlink);
+        _capture.add_gtpu(pgw_addr, sgw_addr, 0x2222, downlink);
+        _capture.write(_file.path);
+    }
+
+    temp_path _file;
+    capture_file _capture;
+    control_plane _control_plane;
+    recording_data_plane _data_plane{_control_plane};
+};
+
+TEST_F(pcap_replay_test, provisions_sessions_and_forwards_both_directions) {
+    write_exchange();
+    pcap_reader reader(_file.path);
+    size_t hooked = 0;
+    pcap_replay replay(_control_plane, _data_plane,
+                       {.apn = "replay",
+                        .pgw_address = pgw_addr,
+                        .ue_network = boost::asio::ip::make_network_v4("100.64.0.0/16"),
+                        .on_session = [&](pdn_connection &) { ++hooked; }});
+    replay.run(reader);
+
+    const auto &report = replay.get_report();
+    ASSERT_EQ(4u, report.records);
+    ASSERT_EQ(1u, report.uplink);
+    ASSERT_EQ(1u, report.downlink);
+    ASSERT_EQ(2u, report.skipped);
+    ASSERT_EQ(1u, report.sessions);
+    ASSERT_EQ(1u, hooked);
+    ASSERT_EQ(2u, report.processing.count());
+
+    // Uplink дошел до APN как есть, downlink - к SGW из захвата с выданным адресом UE
+    ASSERT_EQ(1u, _data_plane._to_apn.size());
+    ASSERT_EQ(make_ip(captured_ue, server), _data_plane._to_apn[0]);
+    ASSERT_EQ(1u, _data_plane._to_sgw.size());
+    ASSERT_EQ(sgw_addr, _data_plane._to_sgw[0].first);
+    const auto &forwarded = _data_plane._to_sgw[0].second;
+    const boost::asio::ip::address_v4 ue_ip({forwarded[16], forwarded[17], forwarded[18], forwarded[19]});
+    ASSERT_TRUE(_control_plane.find_pdn_by_ip_address(ue_ip));
+    ASSERT_EQ(0u, _data_plane.get_counters().drops(traffic_counters::no_session));
+}
+
+TEST_F(pcap_replay_test, direction_is_guessed_from_known_ues_without_addresses) {
+    write_exchange();
+    pcap_reader reader(_file.path);
+    pcap_replay replay(_control_plane, _data_plane, {.apn = "replay"});
+    replay.run(reader);
+
+    const auto &report = replay.get_report();
+    ASSERT_EQ(1u, report.uplink);
+    ASSERT_EQ(1u, report.downlink);
+    ASSERT_EQ(2u, report.skipped);
+    ASSERT_EQ(1u, report.sessions);
+}
+
+TEST_F(pcap_replay_test, downlink_first_session_learns_sgw_from_uplink) {
+    const auto downlink = make_ip(server, captured_ue);
+    _capture.add(downlink);
+    _capture.add_gtpu(sgw_addr, pgw_addr, captured_teid, make_ip(captured_ue, server));
+    _capture.add(downlink);
+    _capture.write(_file.path);
+
+    pcap_reader reader(_file.path);
+    pcap_replay replay(_control_plane, _data_plane,
+                       {.apn = "replay", .ue_network = boost::asio::ip::make_network_v4("100.64.0.0/16")});
+    replay.run(reader);
+
+    ASSERT_EQ(1u, replay.get_report().sessions);
+    ASSERT_EQ(2u, _data_plane._to_sgw.size());
+    ASSERT_EQ(sgw_addr, _data_plane._to_sgw.back().first);
+}
+
+TEST_F(pcap_replay_test, recorded_pacing_is_kept) {
+    write_exchange();
+    pcap_reader reader(_file.path);
+    pcap_replay replay(_control_plane, _data_plane, {.apn = "replay", .pgw_address = pgw_addr, .speed = 1});
+    replay.run(reader);
+
+    // Четыре записи через 1 мс: от первой до последней 3 мс
+    ASSERT_GE(replay.get_report().elapsed, std::chrono::milliseconds(3));
+}
@@ -0,0 +1,323 @@
+#include <control_plane.h>
+#include <rate_limited_data_plane.h>
+#include <session_store.h>
+
+#include <gtest/gtest.h>
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <csignal>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <stdexcept>
+
+using boost::asio::ip::make_address_v4;
+using boost::asio::ip::make_network_v4;
+
+namespace {
+    // Уникальный временный файл, удаляется вместе с объектом
+    struct temp_path {
+        temp_path() {
+            auto pattern = (std::filesystem::temp_directory_path() / "session_store_test.XXXXXX").string();
+            const auto fd = ::mkstemp(pattern.data());
+            ::close(fd);
+            std::filesystem::remove(pattern);
+            path = pattern;
+        }
+        ~temp_path() { std::filesystem::remove(path); }
+
+        std::string path;
+    };
+
+    off_t copy_position(uint32_t slot, uint8_t copy) {
+        return static_cast<off_t>(session_store::header_size + size_t{slot} * session_store::slot_size +
+                                  copy * session_store::record_size);
+    }
+
+    // Копия слота с последней версией - с большим счетчиком в начале записи
+    uint8_t newest_copy(const std::string &path, uint32_t slot) {
+        const auto fd = ::open(path.c_str(), O_RDONLY);
+        uint32_t sequences[2]{};
+        for (uint8_t copy = 0; copy < 2; ++copy) {
+            ::pread(fd, &sequences[copy], sizeof(uint32_t), copy_position(slot, copy));
+        }
+        ::close(fd);
+        return sequences[1] > sequences[0] ? 1 : 0;
+    }
+
+    void corrupt(const std::string &path, uint32_t slot, size_t offset, uint32_t value) {
+        const auto fd = ::open(path.c_str(), O_WRONLY);
+        ASSERT_LE(0, fd);
+        const auto position = copy_position(slot, newest_copy(path, slot)) + static_cast<off_t>(offset);
+        ASSERT_EQ(sizeof(value), ::pwrite(fd, &value, sizeof(value), position));
+        ::close(fd);
+    }
+
+    class discarding_data_plane : public rate_limited_data_plane {
+    public:
+        using rate_limited_data_plane::rate_limited_data_plane;
+
+    protected:
+        void forward_packet_to_sgw(boost::asio::ip::address_v4, uint32_t, Packet &&) override {}
+        void forward_packet_to_apn(boost::asio::ip::address_v4, Packet &&) override {}
+    };
+} // namespace
+
+TEST(session_store_test, sessions_survive_restart) {
+    temp_path file;
+    uint32_t cp_teid{}, default_dp_teid{}, dedicated_dp_teid{}, custom_cp_teid{};
+    boost::asio::ip::address_v4 ue_ip, custom_ue_ip;
+    {
+        session_store store(file.path);
+        control_plane cp;
+        cp.add_apn("test.apn", make_address_v4("127.0.0.1"));
+        ASSERT_EQ(0, cp.attach_store(store));
+        ASSERT_TRUE(cp.add_apn("custom.apn", make_address_v4("172.16.0.1"), {make_network_v4("172.16.0.0/24"), {}}));
+        discarding_data_plane dp(cp);
+
+        auto pdn = cp.create_pdn_connection("test.apn", make_address_v4("127.1.0.1"), 11);
+        auto default_bearer = cp.create_bearer(pdn, 21);
+        auto dedicated = cp.create_bearer(pdn, 22);
+        pdn->set_default_bearer(default_bearer);
+        pdn->set_sgw_cp_teid(12);
+        ASSERT_TRUE(cp.set_sgw_address(pdn->get_cp_teid(), make_address_v4("127.1.0.2")));
+        default_bearer->set_sgw_dp_teid(23);
+        cp_teid = pdn->get_cp_teid();
+        default_dp_teid = default_bearer->get_dp_teid();
+        dedicated_dp_teid = dedicated->get_dp_teid();
+        ue_ip = pdn->get_ue_ip_addr();
+
+        auto custom = cp.create_pdn_connection("custom.apn", make_address_v4("127.1.0.1"), 31);
+        custom->set_default_bearer(cp.create_bearer(custom, 32));
+        custom_cp_teid = custom->get_cp_teid();
+        custom_ue_ip = custom->get_ue_ip_addr();
+
+        // Удаленная сессия не возвращается
+        auto gone = cp.create_pdn_connection("test.apn", make_address_v4("127.1.0.1"), 41);
+        cp.create_bearer(gone, 42);
+        cp.delete_pdn_connection(gone->get_cp_teid());
+
+        rate_limited_data_plane::rate_limit_config ambr{1000, 1000, 2000, 2000};
+        dp.set_rate_limits(cp_teid, ambr);
+        ASSERT_TRUE(dp.set_apn_rate_limits("custom.apn", {3000, 3000, 0, 0}));
+        ASSERT_TRUE(dp.set_bearer_rate_limits(dedicated_dp_teid, {{500, 500, 0, 0}, {}}));
+    }
+
+    session_store store(file.path);
+    EXPECT_EQ(0, store.discarded());
+    EXPECT_EQ(2, store.size<session_store::pdn_record>());
+    EXPECT_EQ(3, store.size<session_store::bearer_record>());
+
+    control_plane cp;
+    cp.add_apn("test.apn", make_address_v4("127.0.0.1"));
+    ASSERT_EQ(2, cp.attach_store(store));
+    discarding_data_plane dp(cp);
+    dp.restore_rate_limits();
+
+    auto pdn = cp.find_pdn_by_cp_teid(cp_teid);
+    ASSERT_NE(nullptr, pdn);
+    EXPECT_EQ(12, pdn->get_sgw_cp_teid());
+    EXPECT_EQ(make_address_v4("127.1.0.2"), pdn->get_sgw_address());
+    EXPECT_EQ(ue_ip, pdn->get_ue_ip_addr());
+    EXPECT_EQ(make_address_v4("127.0.0.1"), pdn->get_apn_gw());
+    EXPECT_EQ(pdn, cp.find_pdn_by_ip_address(ue_ip));
+    EXPECT_EQ(2, pdn->get_bearers().size());
+    ASSERT_NE(nullptr, pdn->get_default_bearer());
+    EXPECT_EQ(default_dp_teid, pdn->get_default_bearer()->get_dp_teid());
+    EXPECT_EQ(23, pdn->get_default_bearer()->get_sgw_dp_teid());
+    EXPECT_NE(nullptr, pdn->get_qos_limits_view());
+    EXPECT_NE(nullptr, cp.find_bearer_by_dp_teid(dedicated_dp_teid)->get_qos_limits_view());
+    EXPECT_EQ(nullptr, pdn->get_default_bearer()->get_qos_limits_view());
+
+    // APN с собственным пулом пришел из файла, хотя в конфигурации его нет
+    auto custom = cp.find_pdn_by_cp_teid(custom_cp_teid);
+    ASSERT_NE(nullptr, custom);
+    EXPECT_EQ(custom_ue_ip, custom->get_ue_ip_addr());
+    EXPECT_EQ(make_address_v4("172.16.0.1"), custom->get_apn_gw());
+    EXPECT_TRUE(cp.find_apn_id("custom.apn"));
+
+    // Новые сессии не получают занятые TEID и адреса
+    std::set<uint32_t> cp_teids{cp_teid, custom_cp_teid};
+    std::set<uint32_t> dp_teids{default_dp_teid, dedicated_dp_teid, custom->get_default_bearer()->get_dp_teid()};
+    std::set<boost::asio::ip::address_v4> ips{ue_ip, custom_ue_ip};
+    for (int i = 0; i < 10; ++i) {
+        auto fresh = cp.create_pdn_connection(i % 2 ? "test.apn" : "custom.apn", make_address_v4("127.1.0.1"), 100);
+        ASSERT_NE(nullptr, fresh);
+        EXPECT_TRUE(cp_teids.insert(fresh->get_cp_teid()).second);
+        EXPECT_TRUE(dp_teids.insert(cp.create_bearer(fresh, 101)->get_dp_teid()).second);
+        EXPECT_TRUE(ips.insert(fresh->get_ue_ip_addr()).second);
+    }
+    EXPECT_EQ(12, store.size<session_store::pdn_record>());
+}
+
+TEST(session_store_test, sessions_of_unregistered_apn_are_kept) {
+    temp_path file;
+    uint32_t cp_teid{};
+    {
+        session_store store(file.path);
+        control_plane cp;
+        ASSERT_TRUE(cp.add_apn("corp", make_address_v4("10.1.0.1"), {make_network_v4("10.1.0.0/16"), {}}));
+        cp.add_apn("internet", make_address_v4("127.0.0.1"));
+        cp.attach_store(store);
+        auto pdn = cp.create_pdn_connection("corp", make_address_v4("127.1.0.1"), 1);
+        pdn->set_default_bearer(cp.create_bearer(pdn, 1));
+        cp_teid = pdn->get_cp_teid();
+    }
+    {
+        // Пул corp из файла пересекается с пулом из конфигурации: сессия не поднимается, но остается
+        session_store store(file.path);
+        control_plane cp;
+        ASSERT_TRUE(cp.add_apn("lab", make_address_v4("10.1.2.1"), {make_network_v4("10.1.2.0/24"), {}}));
+        ASSERT_EQ(0, cp.attach_store(store));
+        EXPECT_EQ(1, store.size<session_store::pdn_record>());
+        EXPECT_EQ(1, store.size<session_store::bearer_record>());
+    }
+
+    // Порядок APN в конфигурации не важен: общий пул уступает подсеть corp
+    session_store store(file.path);
+    control_plane cp;
+    cp.add_apn("internet", make_address_v4("127.0.0.1"));
+    ASSERT_EQ(1, cp.attach_store(store));
+    auto pdn = cp.find_pdn_by_cp_teid(cp_teid);
+    ASSERT_NE(nullptr, pdn);
+    EXPECT_NE(nullptr, pdn->get_default_bearer());
+}
+
+TEST(session_store_test, torn_records_are_discarded) {
+    temp_path file;
+    uint32_t kept{}, torn_pdn{}, broken_bearer{};
+    {
+        session_store store(file.path, {.initial_records = 16});
+        control_plane cp;
+        cp.add_apn("test.apn", make_address_v4("127.0.0.1"));
+        cp.attach_store(store);
+        std::vector<std::shared_ptr<pdn_connection>> pdns;
+        for (uint32_t i = 0; i < 3; ++i) {
+            auto pdn = cp.create_pdn_connection("test.apn", make_address_v4("127.1.0.1"), i);
+            pdn->set_default_bearer(cp.create_bearer(pdn, i));
+            pdns.push_back(pdn);
+        }
+        kept = pdns[0]->get_cp_teid();
+        torn_pdn = pdns[1]->get_store_slot();
+        broken_bearer = pdns[2]->get_default_bearer()->get_store_slot();
+    }
+
+    // Обрыв посреди записи оставляет нечетный счетчик, порча данных - чужую контрольную сумму.
+    // Запись PDN менялась после вставки, у bearer версия одна
+    corrupt(file.path, torn_pdn, 0, 7);
+    corrupt(file.path, broken_bearer, 4, 0xdeadbeef);
+
+    session_store store(file.path);
+    EXPECT_EQ(2, store.discarded());
+    control_plane cp;
+    cp.add_apn("test.apn", make_address_v4("127.0.0.1"));
+    // PDN поднимается из версии до обрыва, еще без default bearer; сессия с испорченным bearer -
+    // без него
+    ASSERT_EQ(3, cp.attach_store(store));
+    EXPECT_NE(nullptr, cp.find_pdn_by_cp_teid(kept));
+    EXPECT_EQ(3, store.size<session_store::pdn_record>());
+    EXPECT_EQ(2, store.size<session_store::bearer_record>());
+
+    // Освободившиеся слоты выдаются снова, файл не растет
+    const auto size = std::filesystem::file_size(file.path);
+    auto pdn = cp.create_pdn_connection("test.apn", make_address_v4("127.1.0.1"), 10);
+    cp.create_bearer(pdn, 10);
+    EXPECT_EQ(size, std::filesystem::file_size(file.path));
+
+    // Оборванные версии затерты при открытии и больше не считаются
+    session_store reopened(file.path);
+    EXPECT_EQ(0, reopened.discarded());
+}
+
+TEST(session_store_test, interrupted_modify_keeps_committed_version) {
+    temp_path file;
+    uint32_t cp_teid{}, slot{};
+    boost::asio::ip::address_v4 ue_ip;
+    {
+        session_store store(file.path, {.initial_records = 16});
+        control_plane cp;
+        cp.add_apn("test.apn", make_address_v4("127.0.0.1"));
+        cp.attach_store(store);
+        auto pdn = cp.create_pdn_connection("test.apn", make_address_v4("127.1.0.1"), 11);
+        pdn->set_default_bearer(cp.create_bearer(pdn, 21));
+        pdn->set_sgw_cp_teid(12);
+        cp_teid = pdn->get_cp_teid();
+        slot = pdn->get_store_slot();
+        ue_ip = pdn->get_ue_ip_addr();
+
+        // Modify Bearer прерван: счетчик новой версии уже нечетный, поля записаны наполовину
+        pdn->set_sgw_cp_teid(13);
+    }
+    corrupt(file.path, slot, 0, 9);
+    corrupt(file.path, slot, 16, 0);
+
+    session_store store(file.path);
+    EXPECT_EQ(1, store.discarded());
+    control_plane cp;
+    cp.add_apn("test.apn", make_address_v4("127.0.0.1"));
+    ASSERT_EQ(1, cp.attach_store(store));
+
+    auto pdn = cp.find_pdn_by_cp_teid(cp_teid);
+    ASSERT_NE(nullptr, pdn);
+    EXPECT_EQ(12, pdn->get_sgw_cp_teid());
+    EXPECT_EQ(ue_ip, pdn->get_ue_ip_addr());
+    ASSERT_NE(nullptr, pdn->get_default_bearer());
+    EXPECT_EQ(1, store.size<session_store::bearer_record>());
+}
+
+TEST(session_store_test, recovers_after_process_kill) {
+    temp_path file;
+    constexpr uint32_t sessions = 20000;
+
+    const auto child = ::fork();
+    ASSERT_LE(0, child);
+    if (child == 0) {
+        // Без деструкторов и msync: переживают только страницы, уже записанные в отображение
+        session_store store(file.path, {.initial_records = 1024});
+        control_plane cp;
+        cp.add_apn("test.apn", make_address_v4("127.0.0.1"));
+        cp.attach_store(store);
+        for (uint32_t i = 0; i < sessions; ++i) {
+            auto pdn = cp.create_pdn_connection("test.apn", make_address_v4("127.1.0.1"), i);
+            pdn->set_default_bearer(cp.create_bearer(pdn, i));
+            if (i % 2) {
+                cp.delete_pdn_connection(pdn->get_cp_teid());
+            }
+        }
+        std::raise(SIGKILL);
+    }
+
+    int status = 0;
+    ASSERT_EQ(child, ::waitpid(child, &status, 0));
+    ASSERT_TRUE(WIFSIGNALED(status));
+
+    session_store store(file.path);
+    EXPECT_EQ(0, store.discarded());
+    control_plane cp;
+    cp.add_apn("test.apn", make_address_v4("127.0.0.1"));
+    ASSERT_EQ(sessions / 2, cp.attach_store(store));
+    EXPECT_EQ(sessions / 2, store.size<session_store::bearer_record>());
+
+    size_t with_default = 0;
+    store.for_each<session_store::pdn_record>([&](uint32_t, const session_store::pdn_record &record) {
+        EXPECT_EQ(0, record.sgw_cp_teid % 2);
+        auto pdn = cp.find_pdn_by_cp_teid(record.cp_teid);
+        if (pdn && pdn->get_default_bearer() && pdn->get_default_bearer()->get_sgw_dp_teid() == record.sgw_cp_teid) {
+            ++with_default;
+        }
+    });
+    EXPECT_EQ(sessions / 2, with_default);
+}
+
+TEST(session_store_test, rejects_foreign_file) {
+    temp_path file;
+    {
+        std::ofstream out(file.path, std::ios::binary);
+        out << std::string(session_store::header_size + session_store::slot_size, 'x');
+    }
+    EXPECT_THROW(session_store store(file.path), std::runtime_error);
+}
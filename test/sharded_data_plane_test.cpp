@@ -0,0 +1,152 @@
+#include <sharded_data_plane.h>
+
+#include <gtest/gtest.h>
+
+#include <set>
+
+#include "rate_limited_data_plane.h"
+
+namespace {
+    class counting_data_plane : public rate_limited_data_plane {
+    public:
+        counting_data_plane(control_plane &control_plane, size_t worker) :
+            rate_limited_data_plane(control_plane), _worker(worker) {}
+
+        size_t _worker;
+        std::vector<uint32_t> _uplink_sgw_teids;
+        std::vector<data_plane::Packet> _to_apn;
+        std::vector<data_plane::Packet> _to_sgw;
+
+    protected:
+        void forward_packet_to_sgw(boost::asio::ip::address_v4, uint32_t sgw_dp_teid, Packet &&packet) override {
+            _uplink_sgw_teids.push_back(sgw_dp_teid);
+            _to_sgw.emplace_back(std::move(packet));
+        }
+
+        void forward_packet_to_apn(boost::asio::ip::address_v4, Packet &&packet) override {
+            _to_apn.emplace_back(std::move(packet));
+        }
+    };
+} // namespace
+
+class sharded_data_plane_test : public ::testing::Test {
+public:
+    static const inline std::string apn{"test.apn"};
+    static const inline auto apn_gw{boost::asio::ip::make_address_v4("127.0.0.1")};
+    static const inline auto sgw_addr{boost::asio::ip::make_address_v4("127.1.0.1")};
+    static constexpr size_t workers = 4;
+    static constexpr size_t sessions = 64;
+
+    sharded_data_plane_test() {
+        _control_plane.add_apn(apn, apn_gw);
+        for (uint32_t i = 0; i < sessions; ++i) {
+            auto pdn = _control_plane.create_pdn_connection(apn, sgw_addr, i);
+            pdn->set_default_bearer(_control_plane.create_bearer(pdn, i));
+            _pdns.push_back(pdn);
+        }
+    }
+
+    counting_data_plane &worker_plane(size_t worker) { return *_planes[worker]; }
+
+    control_plane _control_plane;
+    std::vector<std::shared_ptr<pdn_connection>> _pdns;
+    std::vector<counting_data_plane *> _planes{workers};
+    sharded_data_plane _data_plane{_control_plane, {.workers = workers, .ring_size = 1024},
+                                   [this](control_plane &cp, size_t worker) {
+                                       auto plane = std::make_unique<counting_data_plane>(cp, worker);
+                                       _planes[worker] = plane.get();
+                                       return plane;
+                                   }};
+};
+
+TEST_F(sharded_data_plane_test, session_always_lands_on_same_worker) {
+    for (int round = 0; round < 3; ++round) {
+        for (uint32_t i = 0; i < sessions; ++i) {
+            auto teid = _pdns[i]->get_default_bearer()->get_dp_teid();
+            ASSERT_TRUE(_data_plane.handle_uplink(teid, {static_cast<uint8_t>(i)}));
+            ASSERT_TRUE(_data_plane.handle_downlink(_pdns[i]->get_ue_ip_addr(), {static_cast<uint8_t>(i)}));
+        }
+    }
+    _data_plane.drain();
+
+    size_t to_apn = 0;
+    size_t to_sgw = 0;
+    for (size_t w = 0; w < workers; ++w) {
+        for (auto &packet : worker_plane(w)._to_apn) {
+            auto teid = _pdns[packet[0]]->get_default_bearer()->get_dp_teid();
+            ASSERT_EQ(w, _data_plane.worker_for_dp_teid(teid));
+        }
+        for (auto &packet : worker_plane(w)._to_sgw) {
+            ASSERT_EQ(w, _data_plane.worker_for_ue_ip(_pdns[packet[0]]->get_ue_ip_addr()));
+        }
+        to_apn += worker_plane(w)._to_apn.size();
+        to_sgw += worker_plane(w)._to_sgw.size();
+    }
+    ASSERT_EQ(3 * sessions, to_apn);
+    ASSERT_EQ(3 * sessions, to_sgw);
+    ASSERT_EQ(0, _data_plane.dropped());
+}
+
+TEST_F(sharded_data_plane_test, burst_dispatch_reports_overflow) {
+    std::vector<data_plane::uplink_packet> burst;
+    const auto teid = _pdns[0]->get_default_bearer()->get_dp_teid();
+    for (size_t i = 0; i < 4096; ++i) {
+        burst.push_back({teid, {1}});
+    }
+
+    // Все пакеты одной сессии идут в одно кольцо на 1024 элемента
+    auto accepted = _data_plane.handle_uplink_burst(burst);
+    _data_plane.drain();
+
+    const auto worker = _data_plane.worker_for_dp_teid(teid);
+    ASSERT_EQ(accepted, worker_plane(worker)._to_apn.size());
+    ASSERT_EQ(4096 - accepted, _data_plane.dropped());
+}
+
+TEST_F(sharded_data_plane_test, session_limits_shared_by_pdn_bearers) {
+    const auto &pdn = _pdns[0];
+    std::vector<uint32_t> dp_teids{pdn->get_default_bearer()->get_dp_teid()};
+    for (uint32_t i = 0; i < 7; ++i) {
+        dp_teids.push_back(_control_plane.create_bearer(pdn, 100 + i)->get_dp_teid());
+    }
+
+    // Лимиты сессии задаются один раз из управляющего потока
+    rate_limited_data_plane::rate_limit_config config{
+        .uplink_rate = 1024, .uplink_capacity = 1024, .downlink_rate = 1024, .downlink_capacity = 1024};
+    worker_plane(0).set_rate_limits(pdn->get_cp_teid(), config);
+
+    const auto worker = _data_plane.worker_for_dp_teid(dp_teids[0]);
+    std::vector<data_plane::uplink_packet> burst;
+    for (auto dp_teid : dp_teids) {
+        ASSERT_EQ(worker, _data_plane.worker_for_dp_teid(dp_teid));
+        burst.push_back({dp_teid, data_plane::Packet(1024, 0)});
+    }
+    _data_plane.handle_uplink_burst(burst);
+    _data_plane.drain();
+
+    size_t forwarded = 0;
+    for (size_t w = 0; w < workers; ++w) {
+        forwarded += worker_plane(w)._to_apn.size();
+    }
+    ASSERT_EQ(1, forwarded);
+    ASSERT_EQ(1, worker_plane(worker)._to_apn.size());
+}
+
+TEST(sharded_data_plane_teid_shards_test, pdn_bearers_share_worker) {
+    control_plane cp({.teids = {.shard_bits = 2}});
+    cp.add_apn("test.apn", boost::asio::ip::make_address_v4("127.0.0.1"));
+    sharded_data_plane plane(cp, {.workers = 4, .teid_shard_bits = 2}, [](control_plane &cp, size_t worker) {
+        return std::make_unique<counting_data_plane>(cp, worker);
+    });
+
+    std::set<size_t> used_workers;
+    for (uint32_t i = 0; i < 8; ++i) {
+        auto pdn = cp.create_pdn_connection("test.apn", boost::asio::ip::make_address_v4("127.1.0.1"), i);
+        const auto worker = plane.worker_for_dp_teid(cp.create_bearer(pdn, i)->get_dp_teid());
+        for (uint32_t j = 0; j < 3; ++j) {
+            ASSERT_EQ(worker, plane.worker_for_dp_teid(cp.create_bearer(pdn, i)->get_dp_teid()));
+        }
+        used_workers.insert(worker);
+    }
+    ASSERT_EQ(4, used_workers.size());
+}
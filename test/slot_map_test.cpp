@@ -0,0 +1,62 @@
+#include <slot_map.h>
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+TEST(slot_map_test, insert_get_erase) {
+    slot_map<int> slots;
+
+    auto first = slots.insert(std::make_shared<int>(1));
+    auto second = slots.insert(std::make_shared<int>(2));
+    ASSERT_NE(slot_map<int>::invalid_handle, first);
+    ASSERT_NE(first, second);
+    ASSERT_EQ(1, *slots.get(first));
+    ASSERT_EQ(2, *slots.get(second));
+    ASSERT_EQ(nullptr, slots.get(slot_map<int>::invalid_handle));
+    ASSERT_EQ(2, slots.size());
+
+    auto owner = slots.erase(first);
+    ASSERT_EQ(1, *owner);
+    ASSERT_EQ(nullptr, slots.get(first));
+    ASSERT_EQ(nullptr, slots.erase(first));
+    ASSERT_EQ(2, *slots.get(second));
+    ASSERT_EQ(1, slots.size());
+}
+
+TEST(slot_map_test, stale_handle_does_not_resolve_to_reused_slot) {
+    slot_map<int> slots;
+    slots.reserve(1);
+
+    // Занимаем и освобождаем каждый слот блока, пока первый слот не будет занят снова
+    auto stale = slots.insert(std::make_shared<int>(0));
+    slots.erase(stale);
+    std::vector<slot_map<int>::handle> handles;
+    while (true) {
+        auto h = slots.insert(std::make_shared<int>(1));
+        if (slot_map<int>::index_of(h) == slot_map<int>::index_of(stale)) {
+            ASSERT_NE(stale, h);
+            ASSERT_EQ(nullptr, slots.get(stale));
+            ASSERT_EQ(1, *slots.get(h));
+            break;
+        }
+        handles.push_back(h);
+    }
+}
+
+TEST(slot_map_test, generation_skips_zero_on_wrap) {
+    slot_map<int> slots;
+    slots.reserve(1);
+
+    // Держим все слоты занятыми, кроме одного, чтобы он переиспользовался каждый раз
+    std::vector<slot_map<int>::handle> handles;
+    for (size_t i = 0; i < 65535; ++i) {
+        handles.push_back(slots.insert(std::make_shared<int>(0)));
+    }
+    for (int i = 0; i < 600; ++i) {
+        auto h = slots.insert(std::make_shared<int>(i));
+        ASSERT_NE(0u, h >> slot_map<int>::index_bits);
+        ASSERT_EQ(i, *slots.get(h));
+        slots.erase(h);
+    }
+}
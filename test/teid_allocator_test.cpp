@@ -0,0 +1,95 @@
+#include <teid_allocator.h>
+
+#include <gtest/gtest.h>
+
+#include <array>
+
+using namespace std::chrono_literals;
+
+TEST(teid_allocator_test, allocates_sequentially_per_shard) {
+    teid_allocator teids({.shard_bits = 4, .quarantine = 0s});
+    ASSERT_EQ(16, teids.shards());
+
+    ASSERT_EQ(1u, teids.allocate(0));
+    ASSERT_EQ(2u, teids.allocate(0));
+    ASSERT_EQ(0x30000001u, teids.allocate(3));
+    ASSERT_EQ(3, teids.shard_of(0x30000001u));
+    ASSERT_EQ(0xf0000001u, teids.allocate(15));
+}
+
+TEST(teid_allocator_test, released_teid_waits_out_quarantine) {
+    teid_allocator teids({.shard_bits = 0, .quarantine = 10s});
+    const teid_allocator::clock::time_point start{};
+
+    const auto teid = teids.allocate(0, start);
+    teids.release(teid, start);
+
+    // До конца карантина выдаются новые TEID
+    ASSERT_NE(teid, teids.allocate(0, start + 9s));
+    ASSERT_EQ(teid, teids.allocate(0, start + 10s));
+}
+
+TEST(teid_allocator_test, shard_exhaustion_returns_zero) {
+    teid_allocator teids({.shard_bits = 8, .quarantine = 1s});
+    const teid_allocator::clock::time_point start{};
+
+    uint32_t last = 0;
+    for (uint32_t i = 0; i < (1u << 24) - 1; ++i) {
+        last = teids.allocate(7, start);
+    }
+    ASSERT_EQ(0x07ffffffu, last);
+    ASSERT_EQ(0u, teids.allocate(7, start));
+
+    teids.release(last, start);
+    ASSERT_EQ(0u, teids.allocate(7, start));
+    ASSERT_EQ(last, teids.allocate(7, start + 1s));
+}
+
+TEST(teid_allocator_test, block_allocation_matches_single) {
+    teid_allocator teids({.shard_bits = 8, .quarantine = 1s});
+    const teid_allocator::clock::time_point start{};
+    teids.release(teids.allocate(5, start), start);
+
+    // Сначала созревший карантин, затем отрезок новых TEID шарда
+    std::array<uint32_t, 4> block{};
+    ASSERT_EQ(4, teids.allocate(block, 5, start + 1s));
+    ASSERT_EQ((std::array<uint32_t, 4>{0x05000001u, 0x05000002u, 0x05000003u, 0x05000004u}), block);
+    ASSERT_EQ(0x05000005u, teids.allocate(5, start + 1s));
+
+    // У конца шарда выдается остаток
+    teids.restore(0x05fffffdu);
+    ASSERT_EQ(2, teids.allocate(block, 5, start + 1s));
+    ASSERT_EQ(0x05fffffeu, block[0]);
+    ASSERT_EQ(0x05ffffffu, block[1]);
+    ASSERT_EQ(0, teids.allocate(block, 5, start + 1s));
+}
+
+TEST(teid_allocator_test, restore_hands_out_free_teids_below_restored) {
+    teid_allocator teids({.shard_bits = 0, .quarantine = 1s});
+    const teid_allocator::clock::time_point start{};
+    teids.restore(10);
+    teids.restore(5);
+    teids.finish_restore(start);
+
+    // Промежутки ждут карантин: до перезапуска в нем могли быть любые из них
+    ASSERT_EQ(11u, teids.allocate(0, start));
+    for (uint32_t expected : {1u, 2u, 3u, 4u, 6u}) {
+        ASSERT_EQ(expected, teids.allocate(0, start + 1s));
+    }
+    std::array<uint32_t, 4> block{};
+    ASSERT_EQ(4, teids.allocate(block, 0, start + 1s));
+    ASSERT_EQ((std::array<uint32_t, 4>{7u, 8u, 9u, 12u}), block);
+}
+
+TEST(teid_allocator_test, restore_keeps_teids_allocated_before_it) {
+    teid_allocator teids({.shard_bits = 0, .quarantine = 0s});
+    ASSERT_EQ(1u, teids.allocate(0));
+    ASSERT_EQ(2u, teids.allocate(0));
+    teids.restore(5);
+    teids.finish_restore();
+
+    // 1 и 2 заняты с этого запуска, промежуток - только 3 и 4
+    ASSERT_EQ(3u, teids.allocate(0));
+    ASSERT_EQ(4u, teids.allocate(0));
+    ASSERT_EQ(6u, teids.allocate(0));
+}
@@ -0,0 +1,119 @@
+#include <tft.h>
+
+#include <gtest/gtest.h>
+
+#include <random>
+
+namespace {
+    // Заголовки IPv4 и UDP/TCP downlink пакета от remote к UE
+    std::vector<uint8_t> make_packet(uint32_t remote, uint8_t protocol, uint16_t remote_port, uint16_t local_port,
+                                     uint8_t tos = 0) {
+        std::vector<uint8_t> packet(28, 0);
+        packet[0] = 0x45;
+        packet[1] = tos;
+        packet[9] = protocol;
+        for (int i = 0; i < 4; ++i) {
+            packet[12 + i] = static_cast<uint8_t>(remote >> (24 - 8 * i));
+        }
+        packet[20] = static_cast<uint8_t>(remote_port >> 8);
+        packet[21] = static_cast<uint8_t>(remote_port);
+        packet[22] = static_cast<uint8_t>(local_port >> 8);
+        packet[23] = static_cast<uint8_t>(local_port);
+        return packet;
+    }
+
+    // В тестах классификатору нужны только адреса bearers
+    bearer *fake_bearer(uintptr_t n) { return reinterpret_cast<bearer *>(n * 64); }
+} // namespace
+
+TEST(tft_test, downlink_key_reads_ports_only_from_first_fragment) {
+    auto packet = make_packet(0xc0000201, 17, 5060, 40000, 0xb8);
+    auto key = tft::downlink_key(packet);
+    EXPECT_EQ(0xc0000201, key.remote_address);
+    EXPECT_EQ(17, key.protocol);
+    EXPECT_EQ(5060, key.remote_port);
+    EXPECT_EQ(40000, key.local_port);
+    EXPECT_EQ(0xb8, key.tos);
+
+    // Не первый фрагмент: портов в нем нет
+    packet[7] = 1;
+    key = tft::downlink_key(packet);
+    EXPECT_EQ(0, key.remote_port);
+    EXPECT_EQ(0, key.local_port);
+
+    EXPECT_EQ(0, tft::downlink_key(std::vector<uint8_t>{7}).remote_address);
+}
+
+TEST(tft_test, first_matching_filter_by_precedence_wins) {
+    // Голос: SIP и RTP с сервера IMS; видео: любой TCP 443 из подсети CDN
+    const std::vector<tft::packet_filter> voice{
+            {.precedence = 10, .remote_address = 0x0a640000, .remote_mask = 0xffff0000, .protocol = 17,
+             .local_port_low = 10000, .local_port_high = 20000},
+            {.precedence = 11, .remote_address = 0x0a640001, .remote_mask = 0xffffffff, .remote_port_low = 5060,
+             .remote_port_high = 5060},
+    };
+    const std::vector<tft::packet_filter> video{
+            {.precedence = 20, .remote_address = 0x0a000000, .remote_mask = 0xff000000, .protocol = 6,
+             .remote_port_low = 443, .remote_port_high = 443},
+            {.precedence = 5, .tos = 0xb8, .tos_mask = 0xfc},
+    };
+    const std::vector<tft_classifier::bearer_filters> bearers{{fake_bearer(1), voice}, {fake_bearer(2), video}};
+    tft_classifier classifier(bearers);
+    ASSERT_EQ(4, classifier.size());
+
+    EXPECT_EQ(fake_bearer(1), classifier.classify(tft::downlink_key(make_packet(0x0a640007, 17, 1, 15000))));
+    EXPECT_EQ(nullptr, classifier.classify(tft::downlink_key(make_packet(0x0a640007, 17, 1, 25000))));
+    EXPECT_EQ(fake_bearer(1), classifier.classify(tft::downlink_key(make_packet(0x0a640001, 6, 5060, 80))));
+    EXPECT_EQ(fake_bearer(2), classifier.classify(tft::downlink_key(make_packet(0x0a640001, 6, 443, 80))));
+    EXPECT_EQ(nullptr, classifier.classify(tft::downlink_key(make_packet(0x0b000001, 6, 443, 80))));
+
+    // TOS фильтр важнее порта: EF трафик уходит во второй bearer даже с портов голоса
+    EXPECT_EQ(fake_bearer(2), classifier.classify(tft::downlink_key(make_packet(0x0a640007, 17, 1, 15000, 0xb8))));
+
+    std::vector<tft::flow_key> keys{tft::downlink_key(make_packet(0x0a640007, 17, 1, 15000)),
+                                    tft::downlink_key(make_packet(0x0b000001, 6, 443, 80))};
+    std::vector<bearer *> result(keys.size());
+    classifier.classify(keys, result);
+    EXPECT_EQ(fake_bearer(1), result[0]);
+    EXPECT_EQ(nullptr, result[1]);
+}
+
+TEST(tft_test, classifier_matches_linear_scan) {
+    // Случайные фильтры: ответ классификатора совпадает с перебором по приоритету
+    std::mt19937 gen(3);
+    std::vector<tft::packet_filter> filters(tft_classifier::max_filters);
+    for (auto &f : filters) {
+        f.precedence = static_cast<uint8_t>(gen() % 32);
+        f.remote_mask = gen() % 2 ? 0xffffff00 : 0;
+        f.remote_address = gen() % 4 << 8;
+        f.protocol = gen() % 2 ? 17 : 0;
+        f.local_port_low = static_cast<uint16_t>(gen() % 100);
+        f.local_port_high = static_cast<uint16_t>(f.local_port_low + gen() % 50);
+    }
+    const std::vector<tft_classifier::bearer_filters> bearers{{fake_bearer(1), {filters.data(), 32}},
+                                                              {fake_bearer(2), {filters.data() + 32, 32}}};
+    tft_classifier classifier(bearers);
+
+    for (int i = 0; i < 10000; ++i) {
+        tft::flow_key key{.remote_address = static_cast<uint32_t>(gen() % 4 << 8 | gen() % 256),
+                          .local_port = static_cast<uint16_t>(gen() % 160),
+                          .protocol = static_cast<uint8_t>(gen() % 2 ? 17 : 6)};
+        const tft::packet_filter *best = nullptr;
+        size_t best_index = 0;
+        for (size_t j = 0; j < filters.size(); ++j) {
+            const auto &f = filters[j];
+            const bool matches = (key.remote_address & f.remote_mask) == (f.remote_address & f.remote_mask) &&
+                                 (!f.protocol || key.protocol == f.protocol) && key.local_port >= f.local_port_low &&
+                                 key.local_port <= f.local_port_high;
+            if (matches && (!best || f.precedence < best->precedence)) {
+                best = &f;
+                best_index = j;
+            }
+        }
+        ASSERT_EQ(best ? fake_bearer(best_index < 32 ? 1 : 2) : nullptr, classifier.classify(key));
+    }
+
+    filters.emplace_back();
+    const std::vector<tft_classifier::bearer_filters> too_many{{fake_bearer(1), filters}};
+    EXPECT_THROW(tft_classifier{too_many}, std::length_error);
+}
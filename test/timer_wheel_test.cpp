@@ -0,0 +1,66 @@
+#include <timer_wheel.h>
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+
+TEST(timer_wheel_test, fires_on_expiry_tick) {
+    timer_wheel<int> wheel(1000);
+    wheel.schedule(1, 1001);
+    wheel.schedule(2, 1300);
+    wheel.schedule(3, 1000 + 70000);
+    wheel.schedule(4, 500);  // Уже прошедший срок срабатывает на следующем тике
+
+    std::vector<std::pair<int, uint64_t>> fired;
+    auto record = [&](int item) { fired.emplace_back(item, wheel.now()); };
+
+    wheel.advance(1001, record);
+    ASSERT_EQ((std::vector<std::pair<int, uint64_t>>{{1, 1001}, {4, 1001}}), fired);
+
+    wheel.advance(1299, record);
+    ASSERT_EQ(2, fired.size());
+    wheel.advance(100000, record);
+    ASSERT_EQ((std::vector<std::pair<int, uint64_t>>{{1, 1001}, {4, 1001}, {2, 1300}, {3, 71000}}), fired);
+    ASSERT_TRUE(wheel.empty());
+}
+
+TEST(timer_wheel_test, matches_sorted_deadlines_across_levels) {
+    timer_wheel<uint32_t> wheel;
+    std::multimap<uint64_t, uint32_t> expected;
+    std::mt19937 gen(3);
+
+    for (uint32_t i = 0; i < 20000; ++i) {
+        // Сроки от одного тика до нескольких оборотов третьего уровня
+        const uint64_t expires = 1 + gen() % (uint64_t{1} << (8 + gen() % 20));
+        wheel.schedule(i, expires);
+        expected.emplace(expires, i);
+    }
+
+    size_t checked = 0;
+    for (uint64_t now = 0; !wheel.empty(); now += 1 + gen() % 5000) {
+        wheel.advance(now, [&](uint32_t item) {
+            auto range = expected.equal_range(wheel.now());
+            auto it = std::find_if(range.first, range.second, [&](const auto &e) { return e.second == item; });
+            ASSERT_NE(range.second, it);
+            expected.erase(it);
+            ++checked;
+        });
+    }
+    ASSERT_EQ(20000, checked);
+}
+
+TEST(timer_wheel_test, fire_can_reschedule) {
+    timer_wheel<int> wheel;
+    wheel.schedule(0, 10);
+
+    int fired = 0;
+    wheel.advance(1000, [&](int item) {
+        ++fired;
+        if (item < 5) {
+            wheel.schedule(item + 1, wheel.now() + 100);
+        }
+    });
+    ASSERT_EQ(6, fired);
+    ASSERT_TRUE(wheel.empty());
+}
@@ -0,0 +1,77 @@
+#include <control_plane.h>
+#include <traffic_counters.h>
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+
+namespace {
+    const auto sgw_addr = boost::asio::ip::make_address_v4("127.1.0.1");
+} // namespace
+
+TEST(traffic_counters_test, reused_slot_starts_from_zero) {
+    control_plane cp;
+    cp.add_apn("test.apn", boost::asio::ip::make_address_v4("127.0.0.1"));
+    traffic_counters counters;
+
+    auto pdn = cp.create_pdn_connection("test.apn", sgw_addr, 1);
+    auto bearer = cp.create_bearer(pdn, 1);
+    counters.count_uplink(*bearer, *pdn, 100);
+    const auto old_handle = bearer->get_handle();
+
+    // Удаленную сессию можно дочитать, пока ее слот свободен
+    cp.delete_pdn_connection(pdn->get_cp_teid());
+    EXPECT_EQ(1, counters.bearer_usage(old_handle).uplink_packets);
+
+    // Новые bearers в конце концов занимают тот же слот с другим поколением
+    std::shared_ptr<pdn_connection> reused_pdn;
+    std::shared_ptr<::bearer> reused;
+    for (uint32_t i = 0; i < (1u << 17) && !reused; ++i) {
+        auto next_pdn = cp.create_pdn_connection("test.apn", sgw_addr, i);
+        auto next = cp.create_bearer(next_pdn, i);
+        if (slot_map<::bearer>::index_of(next->get_handle()) == slot_map<::bearer>::index_of(old_handle)) {
+            reused_pdn = next_pdn;
+            reused = next;
+        } else {
+            cp.delete_pdn_connection(next_pdn->get_cp_teid());
+        }
+    }
+    ASSERT_TRUE(reused);
+    ASSERT_NE(old_handle, reused->get_handle());
+
+    counters.count_downlink(*reused, *reused_pdn, 10);
+    EXPECT_EQ((traffic_counters::usage{0, 0, 1, 10}), counters.bearer_usage(reused->get_handle()));
+    EXPECT_EQ(traffic_counters::usage{}, counters.bearer_usage(old_handle));
+    // APN копит все
+    EXPECT_EQ((traffic_counters::usage{1, 100, 1, 10}), counters.apn_usage(reused_pdn->get_apn_id()));
+}
+
+TEST(traffic_counters_test, snapshot_while_counting) {
+    control_plane cp;
+    cp.add_apn("test.apn", boost::asio::ip::make_address_v4("127.0.0.1"));
+    auto pdn = cp.create_pdn_connection("test.apn", sgw_addr, 1);
+    auto bearer = cp.create_bearer(pdn, 1);
+    traffic_counters counters;
+
+    constexpr uint64_t packets = 200000;
+    std::atomic<bool> done{false};
+    std::thread writer([&] {
+        for (uint64_t i = 0; i < packets; ++i) {
+            counters.count_uplink(*bearer, *pdn, 64);
+        }
+        done = true;
+    });
+
+    // Счетчики только растут и не рвутся: байты всегда кратны размеру пакета
+    uint64_t last = 0;
+    while (!done) {
+        const auto usage = counters.pdn_usage(pdn->get_handle());
+        ASSERT_GE(usage.uplink_packets, last);
+        ASSERT_EQ(0, usage.uplink_bytes % 64);
+        last = usage.uplink_packets;
+    }
+    writer.join();
+    EXPECT_EQ(packets, counters.pdn_usage(pdn->get_handle()).uplink_packets);
+    EXPECT_EQ(packets * 64, counters.pdn_usage(pdn->get_handle()).uplink_bytes);
+}
@@ -0,0 +1,160 @@
+#include <udp_data_plane.h>
+
+#include <gtest/gtest.h>
+
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <vector>
+
+namespace {
+    const auto pgw_addr{boost::asio::ip::make_address_v4("127.0.0.1")};
+    const auto sgw_addr{boost::asio::ip::make_address_v4("127.0.0.2")};
+    const auto apn_gw{boost::asio::ip::make_address_v4("127.0.0.3")};
+
+    // UDP сокет SGW или шлюза APN
+    class peer_socket {
+    public:
+        peer_socket(boost::asio::ip::address_v4 address, uint16_t port) : _fd(socket(AF_INET, SOCK_DGRAM, 0)) {
+            const auto local = make_sockaddr(address, port);
+            EXPECT_EQ(0, bind(_fd, reinterpret_cast<const sockaddr *>(&local), sizeof(local)));
+        }
+        ~peer_socket() { close(_fd); }
+
+        [[nodiscard]] uint16_t port() const {
+            sockaddr_in local{};
+            socklen_t size = sizeof(local);
+            getsockname(_fd, reinterpret_cast<sockaddr *>(&local), &size);
+            return ntohs(local.sin_port);
+        }
+
+        void send(std::span<const uint8_t> datagram, boost::asio::ip::address_v4 address, uint16_t port) const {
+            const auto to = make_sockaddr(address, port);
+            sendto(_fd, datagram.data(), datagram.size(), 0, reinterpret_cast<const sockaddr *>(&to), sizeof(to));
+        }
+
+        // Принимает датаграмму, крутя data plane; пустой вектор, если ничего не пришло
+        std::vector<uint8_t> receive(udp_data_plane &data_plane) const {
+            std::vector<uint8_t> buffer(2048);
+            for (int i = 0; i < 100; ++i) {
+                data_plane.poll_sockets();
+                const auto size = recv(_fd, buffer.data(), buffer.size(), MSG_DONTWAIT);
+                if (size >= 0) {
+                    buffer.resize(static_cast<size_t>(size));
+                    return buffer;
+                }
+                pollfd fd{_fd, POLLIN, 0};
+                ::poll(&fd, 1, 10);
+            }
+            return {};
+        }
+
+    private:
+        static sockaddr_in make_sockaddr(boost::asio::ip::address_v4 address, uint16_t port) {
+            sockaddr_in result{};
+            result.sin_family = AF_INET;
+            result.sin_addr.s_addr = htonl(address.to_uint());
+            result.sin_port = htons(port);
+            return result;
+        }
+
+        int _fd;
+    };
+
+    std::vector<uint8_t> make_inner(boost::asio::ip::address_v4 src, boost::asio::ip::address_v4 dst) {
+        std::vector<uint8_t> inner(64, 0);
+        inner[0] = 0x45;
+        const auto src_bytes = src.to_bytes();
+        const auto dst_bytes = dst.to_bytes();
+        std::copy(src_bytes.begin(), src_bytes.end(), inner.begin() + 12);
+        std::copy(dst_bytes.begin(), dst_bytes.end(), inner.begin() + 16);
+        return inner;
+    }
+} // namespace
+
+class udp_data_plane_test : public ::testing::Test {
+public:
+    static const inline std::string apn{"test.apn"};
+
+    udp_data_plane_test() {
+        _control_plane.add_apn(apn, apn_gw);
+        _pdn = _control_plane.create_pdn_connection(apn, sgw_addr, 1);
+        _pdn->set_default_bearer(_control_plane.create_bearer(_pdn, 100));
+    }
+
+    // G-PDU или другое сообщение GTP-U без внешних заголовков, как его отправляет сокет SGW
+    std::vector<uint8_t> gtpu_message(std::span<const uint8_t> payload, uint32_t teid,
+                                      gtpu::message_type type = gtpu::g_pdu,
+                                      std::optional<uint16_t> sequence = std::nullopt) {
+        auto buffer = _pool.allocate(payload);
+        gtpu::encapsulate(buffer, {sgw_addr, pgw_addr, teid, sequence}, type);
+        gtpu::strip_ip_udp(buffer);
+        return {buffer.data(), buffer.data() + buffer.size()};
+    }
+
+    packet_pool _pool{{.buffer_count = 16}};
+    control_plane _control_plane;
+    std::shared_ptr<pdn_connection> _pdn;
+    peer_socket _gateway{apn_gw, 0};
+    udp_data_plane _data_plane{_control_plane,
+                               {.gtpu_address = pgw_addr,
+                                .gtpu_port = 0,
+                                .sgi_address = pgw_addr,
+                                .sgi_port = 0,
+                                .apn_gateway_port = _gateway.port(),
+                                .pool = {.buffer_count = 256}}};
+};
+
+TEST_F(udp_data_plane_test, uplink_reaches_apn_gateway) {
+    const peer_socket sgw(sgw_addr, 0);
+    const auto inner = make_inner(_pdn->get_ue_ip_addr(), apn_gw);
+
+    sgw.send(gtpu_message(inner, _pdn->get_default_bearer()->get_dp_teid()), pgw_addr, _data_plane.gtpu_port());
+
+    ASSERT_EQ(inner, _gateway.receive(_data_plane));
+    ASSERT_EQ(1u, _data_plane.get_io_statistics().received);
+    ASSERT_EQ(1u, _data_plane.get_io_statistics().sent);
+}
+
+TEST_F(udp_data_plane_test, downlink_reaches_sgw) {
+    const peer_socket sgw(sgw_addr, gtpu::port);
+    const auto inner = make_inner(apn_gw, _pdn->get_ue_ip_addr());
+
+    _gateway.send(inner, pgw_addr, _data_plane.sgi_port());
+
+    ASSERT_EQ(gtpu_message(inner, 100), sgw.receive(_data_plane));
+}
+
+TEST_F(udp_data_plane_test, echo_request_answered_to_sender_port) {
+    const peer_socket sgw(sgw_addr, 0);
+    const uint8_t recovery[]{14, 0};
+
+    sgw.send(gtpu_message({}, 0, gtpu::echo_request, 7), pgw_addr, _data_plane.gtpu_port());
+
+    ASSERT_EQ(gtpu_message(recovery, 0, gtpu::echo_response, 7), sgw.receive(_data_plane));
+}
+
+TEST_F(udp_data_plane_test, batch_of_datagrams_is_forwarded) {
+    const peer_socket sgw(sgw_addr, 0);
+    const auto inner = make_inner(_pdn->get_ue_ip_addr(), apn_gw);
+    const auto message = gtpu_message(inner, _pdn->get_default_bearer()->get_dp_teid());
+    constexpr size_t count = 100;
+
+    for (size_t i = 0; i < count; ++i) {
+        sgw.send(message, pgw_addr, _data_plane.gtpu_port());
+    }
+    for (size_t i = 0; i < count; ++i) {
+        ASSERT_EQ(inner, _gateway.receive(_data_plane)) << i;
+    }
+    // Пачки по batch_size, а не по одной датаграмме
+    ASSERT_LT(_data_plane.get_io_statistics().receive_batches, count);
+}
+
+TEST(udp_data_plane_bind_test, busy_port_throws) {
+    control_plane cp;
+    const peer_socket taken(pgw_addr, 0);
+    ASSERT_THROW(udp_data_plane(cp, {.gtpu_address = pgw_addr, .gtpu_port = taken.port(), .sgi_address = pgw_addr,
+                                     .sgi_port = 0}),
+                 std::system_error);
+}
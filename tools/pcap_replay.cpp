@@ -0,0 +1,172 @@
+#include <pcap_replay.h>
+#include <rate_limited_data_plane.h>
+
+#include <algorithm>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace {
+    struct options {
+        std::string path;
+        pcap_replay::config replay;
+        std::optional<size_t> ambr;
+    };
+
+    constexpr std::string_view usage =
+        "usage: pcap_replay FILE [--apn NAME] [--pgw ADDR] [--ue-net ADDR/LEN] [--speed X] [--ambr BYTES_PER_SEC]\n"
+        "  FILE      pcap or pcapng with S5/S8-U (GTP-U on port 2152) and/or SGi traffic\n"
+        "  --pgw     S5/S8-U address of the PGW in the capture; GTP-U to other addresses is skipped\n"
+        "  --ue-net  UE subnet in the capture; SGi packets to other addresses are skipped\n"
+        "  --speed   1 replays at recorded pacing, 2 twice as fast; 0 as fast as possible (default)\n"
+        "  --ambr    per-session AMBR in both directions, through rate_limited_data_plane\n";
+
+    // Data plane, который только считает пересланные пакеты, как null_sink в бенчмарках
+    template<class Base>
+    class replay_sink : public Base {
+    public:
+        explicit replay_sink(control_plane &control_plane) : Base(control_plane) {}
+
+        uint64_t _forwarded{};
+
+    protected:
+        using typename Base::Packet;
+        using typename Base::sgw_packet;
+
+        void forward_packet_to_sgw(boost::asio::ip::address_v4, uint32_t, Packet &&) override { ++_forwarded; }
+        void forward_packet_to_apn(boost::asio::ip::address_v4, Packet &&) override { ++_forwarded; }
+
+        void forward_burst_to_sgw(boost::asio::ip::address_v4, std::span<sgw_packet> packets) override {
+            _forwarded += packets.size();
+        }
+        void forward_burst_to_apn(boost::asio::ip::address_v4, std::span<Packet> packets) override {
+            _forwarded += packets.size();
+        }
+
+        void forward_buffer_to_sgw(boost::asio::ip::address_v4, uint32_t, packet_buffer &&) override { ++_forwarded; }
+        void forward_buffer_to_apn(boost::asio::ip::address_v4, packet_buffer &&) override { ++_forwarded; }
+        void send_gtpu(boost::asio::ip::address_v4, packet_buffer &&) override { ++_forwarded; }
+    };
+
+    options parse_options(int argc, char **argv) {
+        options result;
+        result.replay.apn = "replay";
+        for (int i = 1; i < argc; ++i) {
+            const std::string_view name = argv[i];
+            if (!name.starts_with("--")) {
+                if (!result.path.empty()) {
+                    throw std::invalid_argument(std::string(name));
+                }
+                result.path = name;
+                continue;
+            }
+            if (i + 1 == argc) {
+                throw std::invalid_argument(std::string(name));
+            }
+            const std::string value = argv[++i];
+            if (name == "--apn") {
+                result.replay.apn = value;
+            } else if (name == "--pgw") {
+                result.replay.pgw_address = boost::asio::ip::make_address_v4(value);
+            } else if (name == "--ue-net") {
+                result.replay.ue_network = boost::asio::ip::make_network_v4(value);
+            } else if (name == "--speed") {
+                result.replay.speed = std::stod(value);
+            } else if (name == "--ambr") {
+                result.ambr = std::stoul(value);
+            } else {
+                throw std::invalid_argument(std::string(name));
+            }
+        }
+        if (result.path.empty() || result.replay.speed < 0) {
+            throw std::invalid_argument("FILE");
+        }
+        return result;
+    }
+
+    const char *drop_name(traffic_counters::drop_reason reason) {
+        switch (reason) {
+            case traffic_counters::no_session:
+                return "no_session";
+            case traffic_counters::no_bearer:
+                return "no_bearer";
+            case traffic_counters::policed:
+                return "policed";
+            case traffic_counters::malformed:
+                return "malformed";
+            default:
+                return "unknown";
+        }
+    }
+
+    void print_report(const pcap_replay::report &report, const data_plane &data_plane, uint64_t forwarded) {
+        const auto seconds = std::chrono::duration<double>(report.elapsed).count();
+        const auto packets = report.uplink + report.downlink;
+        const auto ns = [](uint64_t ticks) { return static_cast<uint64_t>(ticks / latency::ticks_per_ns()); };
+
+        std::cout << std::fixed << std::setprecision(1);
+        std::cout << "records      " << report.records << " (" << report.skipped << " skipped)\n"
+                  << "packets      " << packets << " (uplink " << report.uplink << ", downlink " << report.downlink
+                  << ")\n"
+                  << "sessions     " << report.sessions << " (" << report.provisioning_failures << " failed)\n"
+                  << "elapsed      " << seconds << " s\n"
+                  << "rate         " << (seconds > 0 ? packets / seconds : 0) << " pps, "
+                  << (seconds > 0 ? report.bytes * 8 / seconds / 1e6 : 0) << " Mbit/s\n"
+                  << "forwarded    " << forwarded << "\n";
+        for (size_t reason = 0; reason < traffic_counters::drop_reasons; ++reason) {
+            const auto drop = static_cast<traffic_counters::drop_reason>(reason);
+            std::cout << "drop " << std::left << std::setw(12) << drop_name(drop) << std::right
+                      << data_plane.get_counters().drops(drop) << "\n";
+        }
+        std::cout << "latency ns   p50 " << ns(report.processing.percentile(50)) << ", p99 "
+                  << ns(report.processing.percentile(99)) << ", p99.9 " << ns(report.processing.percentile(99.9))
+                  << ", max " << ns(report.processing.max()) << "\n";
+    }
+} // namespace
+
+// Прогоняет захват через data plane с пустым стоком и печатает пропускную способность, отбросы
+// по причинам и задержку обработки пакета
+int main(int argc, char **argv) {
+    options config;
+    try {
+        config = parse_options(argc, argv);
+    } catch (const std::exception &error) {
+        std::cerr << "pcap_replay: bad argument " << error.what() << "\n" << usage;
+        return 2;
+    }
+
+    try {
+        pcap_reader reader(config.path);
+        control_plane cp;
+        // Шлюз APN не важен: пересланные пакеты только считаются
+        cp.add_apn(config.replay.apn, boost::asio::ip::make_address_v4("192.0.2.1"));
+
+        if (config.ambr) {
+            replay_sink<rate_limited_data_plane> data_plane(cp);
+            const auto rate = *config.ambr;
+            // Емкость - 100 мс трафика, но не меньше самого большого пакета
+            const auto capacity = std::max<size_t>(rate / 10, UINT16_MAX);
+            rate_limited_data_plane::rate_limit_config limits{rate, capacity, rate, capacity};
+            config.replay.on_session = [&](pdn_connection &pdn) {
+                data_plane.set_rate_limits(pdn.get_cp_teid(), limits);
+            };
+            pcap_replay replay(cp, data_plane, config.replay);
+            replay.run(reader);
+            print_report(replay.get_report(), data_plane, data_plane._forwarded);
+        } else {
+            replay_sink<data_plane> data_plane(cp);
+            pcap_replay replay(cp, data_plane, config.replay);
+            replay.run(reader);
+            print_report(replay.get_report(), data_plane, data_plane._forwarded);
+        }
+    } catch (const std::exception &error) {
+        std::cerr << "pcap_replay: " << error.what() << "\n";
+        return 1;
+    }
+    return 0;
+}